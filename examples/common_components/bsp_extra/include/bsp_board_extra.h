@@ -14,6 +14,8 @@
 #include "driver/i2s_std.h"
 #include "audio_player.h"
 #include "file_iterator.h"
+#include "bsp_extra_mixer.h"
+#include "bsp_extra_pcm_ring.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +35,17 @@ extern "C" {
  * BSP Extra interface
  * Mainly provided some I2S Codec interfaces.
  **************************************************************************************************/
+/**
+ * @brief I2S DMA counters, since `bsp_extra_codec_init`
+ *
+ * The driver counts a period as lost whenever nobody takes it in time, including while a direction is not used:
+ * take the difference of two readings around a running stream.
+ */
+typedef struct {
+    uint32_t tx_underruns;      /*!< DMA periods played as silence, the player did not write in time */
+    uint32_t rx_overruns;       /*!< Recorded DMA periods dropped, the recorder did not read in time */
+} bsp_extra_i2s_stats_t;
+
 /**
  * @brief Player set mute.
  *
@@ -67,6 +80,8 @@ int bsp_extra_codec_volume_get(void);
 /**
  * @brief Stop I2S function.
  *
+ * Closes the codec under every user: apps use a session instead, see `bsp_extra_codec_session.h`.
+ *
  * @return
  *    - ESP_OK: Success
  *    - Others: Fail
@@ -85,6 +100,8 @@ esp_err_t bsp_extra_codec_dev_resume(void);
 /**
  * @brief Set I2S format to codec.
  *
+ * The codec is only reopened when the format changes. Apps use a session instead, see `bsp_extra_codec_session.h`.
+ *
  * @param rate: Sample rate of sample
  * @param bits_cfg: Bit lengths of one channel data
  * @param ch: Channels of sample
@@ -95,6 +112,15 @@ esp_err_t bsp_extra_codec_dev_resume(void);
  */
 esp_err_t bsp_extra_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
 
+/**
+ * @brief Get the I2S format last set by `bsp_extra_codec_set_fs`.
+ *
+ * @param rate: Returned sample rate, can be NULL if not needed
+ * @param bits_cfg: Returned bit length of one channel data, can be NULL if not needed
+ * @param ch: Returned channels, can be NULL if not needed
+ */
+void bsp_extra_codec_get_fs(uint32_t *rate, uint32_t *bits_cfg, uint32_t *ch);
+
 /**
  * @brief Read data from recoder.
  *
@@ -123,6 +149,73 @@ esp_err_t bsp_extra_i2s_read(void *audio_buffer, size_t len, size_t *bytes_read,
  */
 esp_err_t bsp_extra_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
 
+/**
+ * @brief Copy the audio written to the player into a ring, e.g. for a visualizer.
+ *
+ * `bsp_extra_i2s_write` is the producer: it copies each buffer after the codec accepted it, in the format given by
+ * `bsp_extra_codec_get_fs`, and skips the whole buffer when the ring has no room, so the player never waits for the
+ * consumer. The data leads the speaker by the I2S DMA buffering.
+ *
+ * @param ring: Ring to copy into, NULL to remove the tap. A removed ring may still receive the buffer being written:
+ *              keep it allocated, or only delete it once the player is stopped
+ */
+void bsp_extra_i2s_set_tap(bsp_extra_pcm_ring_handle_t ring);
+
+/**
+ * @brief Get the I2S DMA counters.
+ *
+ * @param stats: Returned counters
+ */
+void bsp_extra_i2s_get_stats(bsp_extra_i2s_stats_t *stats);
+
+/**
+ * @brief Get the frames of one I2S DMA period, the unit in which the driver hands audio over.
+ *
+ * Reading one period at a time wakes the reader once per DMA interrupt, with the least latency.
+ *
+ * @return
+ *    - Frames per DMA period
+ */
+uint32_t bsp_extra_i2s_get_period_frames(void);
+
+/**
+ * @brief Get the number of I2S DMA periods in the ring of each direction.
+ *
+ * The driver queues up to this number minus one played periods for the writer, oldest first.
+ *
+ * @return
+ *    - DMA periods per channel
+ */
+uint32_t bsp_extra_i2s_get_period_num(void);
+
+/**
+ * @brief Get the playback clock: duration of the player audio mixed since the last reset.
+ *
+ * The player writes into a stream of the audio mixer (see `bsp_extra_mixer.h`), the clock counts the frames the mixer
+ * took from it at the rate of the file. It stops while nothing is written (pause, end of file) and leads the speaker
+ * by one mixer block and the I2S DMA buffering.
+ *
+ * @return
+ *    - Played time in microseconds
+ */
+int64_t bsp_extra_audio_clock_get_us(void);
+
+/**
+ * @brief Restart the playback clock from zero.
+ *
+ * `bsp_extra_player_play_file` and `bsp_extra_player_play_index` already do it, so the clock gives the position in
+ * the file being played.
+ */
+void bsp_extra_audio_clock_reset(void);
+
+/**
+ * @brief Get when the player first wrote audio after the last clock reset, e.g. to time the start of a file.
+ *
+ * @return
+ *    - `esp_timer_get_time` time of the write, 0 if the player did not write since the reset
+ */
+int64_t bsp_extra_player_get_first_write_us(void);
+
 
 /**
  * @brief Initialize codec play and record handle.
@@ -136,6 +229,9 @@ esp_err_t bsp_extra_codec_init();
 /**
  * @brief Initialize audio player task.
  *
+ * The player plays through a stream of the audio mixer, which is started on the first file: files at any rate share
+ * the codec with the other streams, and muting the player only silences its stream.
+ *
  * @param path file path
  *
  * @return
@@ -153,6 +249,30 @@ esp_err_t bsp_extra_player_init(void);
  */
 esp_err_t bsp_extra_player_del(void);
 
+/**
+ * @brief Get the buffering counters of the player: the decoded audio waiting in its mixer stream, the underruns and
+ *        the longest time the player took to decode the next data while playing.
+ *
+ * The ring size and memory are set by `CONFIG_BSP_EXTRA_PLAYER_BUFFER_KB` and `CONFIG_BSP_EXTRA_PLAYER_BUFFER_CAPS`.
+ * Pauses and the end of files are not counted.
+ *
+ * @param stats Returned counters
+ *
+ * @return
+ *      - ESP_OK: Success
+ *      - ESP_ERR_INVALID_STATE: The player is not initialized
+ */
+esp_err_t bsp_extra_player_get_buffer_stats(bsp_extra_mixer_stream_stats_t *stats);
+
+/**
+ * @brief Restart the buffering counters of the player.
+ *
+ * @return
+ *      - ESP_OK: Success
+ *      - ESP_ERR_INVALID_STATE: The player is not initialized
+ */
+esp_err_t bsp_extra_player_reset_buffer_stats(void);
+
 /**
  * @brief Initialize a file iterator instance
  *
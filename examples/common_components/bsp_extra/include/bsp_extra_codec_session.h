@@ -0,0 +1,114 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/i2s_std.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_EXTRA_CODEC_SESSION_NUM         (8)
+
+#define BSP_EXTRA_CODEC_SESSION_PLAYBACK    (1 << 0)
+#define BSP_EXTRA_CODEC_SESSION_CAPTURE     (1 << 1)
+
+/**
+ * @brief Session priorities, a higher one takes the codec from a lower one at another format
+ */
+typedef enum {
+    BSP_EXTRA_CODEC_PRIORITY_MEDIA = 0,     /*!< The audio mixer: music, videos and UI sounds */
+    BSP_EXTRA_CODEC_PRIORITY_CAPTURE = 10,  /*!< Recording and echo, at their own format */
+} bsp_extra_codec_priority_t;
+
+/**************************************************************************************************
+ * Codec sessions
+ * Every user of the codec opens a session with the format and directions it needs. The codec plays the format of the
+ * highest priority session, the first opened among equals. The sessions at that format are granted and share the
+ * codec; the others are suspended until it comes back to their format. The codec is only reopened when the granted
+ * format changes, and closed when the last session closes. The output is unmuted while a granted session plays.
+ **************************************************************************************************/
+typedef struct bsp_extra_codec_session_t *bsp_extra_codec_session_handle_t;
+
+/**
+ * @brief Called when a session loses or gets back the codec, with the session lock held
+ *
+ * On a loss it is called before the codec changes format and must return once the owner stopped using the codec. It
+ * must not open or close sessions.
+ */
+typedef void (*bsp_extra_codec_session_cb_t)(bsp_extra_codec_session_handle_t session, bool granted, void *user_ctx);
+
+/**
+ * @brief Session configuration
+ */
+typedef struct {
+    const char *name;                       /*!< For logs, kept by reference */
+    uint32_t rate;                          /*!< Sample rate */
+    uint32_t bits_cfg;                      /*!< Bits per sample */
+    i2s_slot_mode_t ch;                     /*!< Channels */
+    uint32_t flags;                         /*!< Directions used, BSP_EXTRA_CODEC_SESSION_* */
+    bsp_extra_codec_priority_t priority;
+    bsp_extra_codec_session_cb_t cb;        /*!< Grant changes after the open, can be NULL */
+    void *user_ctx;
+} bsp_extra_codec_session_cfg_t;
+
+/**
+ * @brief Session counters, since boot
+ */
+typedef struct {
+    uint32_t sessions;                      /*!< Sessions open now */
+    uint32_t opens;                         /*!< Sessions opened */
+    uint32_t shared;                        /*!< Opens granted at the format already set, without touching the codec */
+    uint32_t preemptions;                   /*!< Sessions suspended for a higher priority one */
+    uint32_t reconfigs;                     /*!< Codec reopened at another format */
+    uint32_t reconfig_us_last;              /*!< Time taken by the last reopen */
+    uint32_t reconfig_us_max;
+    uint64_t reconfig_us_total;
+} bsp_extra_codec_session_stats_t;
+
+/**
+ * @brief Open a session, `bsp_extra_codec_init` must have been called.
+ *
+ * @param config: Session configuration
+ * @param ret_session: Returned session, granted or not
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid argument
+ *    - ESP_ERR_NOT_FOUND: All the sessions are in use
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t bsp_extra_codec_session_open(const bsp_extra_codec_session_cfg_t *config,
+                                       bsp_extra_codec_session_handle_t *ret_session);
+
+/**
+ * @brief Close a session, the codec goes to the format of the sessions left.
+ *
+ * @param session: Session handle, NULL is ignored
+ */
+void bsp_extra_codec_session_close(bsp_extra_codec_session_handle_t session);
+
+/**
+ * @brief Check whether a session may use the codec.
+ *
+ * @param session: Session handle
+ */
+bool bsp_extra_codec_session_is_granted(bsp_extra_codec_session_handle_t session);
+
+/**
+ * @brief Get the session counters.
+ *
+ * @param stats: Returned counters
+ */
+void bsp_extra_codec_session_get_stats(bsp_extra_codec_session_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
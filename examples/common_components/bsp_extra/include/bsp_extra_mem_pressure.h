@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+ * Memory pressure
+ * Apps keeping PSRAM caches register a reclaimer. An app about to allocate large PSRAM buffers asks
+ * for free space, and the caches give back what nobody uses, without the apps knowing each other.
+ **************************************************************************************************/
+
+/**
+ * @brief Reclaimer, releases unused memory until `free_size` bytes of PSRAM are free.
+ *
+ * @param free_size: Free PSRAM wanted, in bytes
+ * @param user_ctx: Context given at registration
+ *
+ * @return
+ *    - Bytes released
+ */
+typedef size_t (*bsp_extra_mem_reclaim_cb_t)(size_t free_size, void *user_ctx);
+
+/**
+ * @brief Register a reclaimer. Reclaimers run in registration order.
+ *
+ * @param cb: Reclaimer
+ * @param user_ctx: Context passed to the reclaimer
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid argument
+ *    - ESP_ERR_NO_MEM: No slot left
+ */
+esp_err_t bsp_extra_mem_pressure_register(bsp_extra_mem_reclaim_cb_t cb, void *user_ctx);
+
+/**
+ * @brief Run the reclaimers until at least `free_size` bytes of PSRAM are free.
+ *
+ * @param free_size: Free PSRAM wanted, in bytes
+ *
+ * @return
+ *    - Bytes released
+ */
+size_t bsp_extra_mem_pressure_reclaim(size_t free_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,204 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_EXTRA_MIXER_SAMPLE_RATE         (44100)     /* Most music needs no resampling */
+#define BSP_EXTRA_MIXER_STREAM_NUM          (4)
+#define BSP_EXTRA_MIXER_TASK_PRIORITY       (10)        /* Above the audio player */
+#define BSP_EXTRA_MIXER_RATE_MAX            (2 * BSP_EXTRA_MIXER_SAMPLE_RATE)
+
+/**************************************************************************************************
+ * Audio mixer
+ * Plays several 16-bit PCM streams at once. The codec is opened once at the mixer rate, in stereo; each stream is
+ * resampled to it on the fly, scaled by its gain and summed with saturation. Writers only fill a ring, so starting a
+ * stream or changing its format never reopens the codec.
+ *
+ * The mixer holds a media priority playback session on the codec (see `bsp_extra_codec_session.h`). While a higher
+ * priority session takes the codec at another format, mixing pauses and the streams keep their data. Writes that do
+ * not fit in a stream meanwhile are dropped at the pace they would have played, see `bsp_extra_mixer_stream_write`.
+ **************************************************************************************************/
+typedef struct bsp_extra_mixer_stream_t *bsp_extra_mixer_stream_handle_t;
+
+/**
+ * @brief Mixer counters, since `bsp_extra_mixer_start`
+ */
+typedef struct {
+    uint32_t blocks;                /*!< Blocks written to the codec */
+    uint32_t starved;               /*!< Blocks in which a playing stream ran out of data */
+    uint64_t frames;                /*!< Output frames mixed */
+    uint64_t mix_cycles;            /*!< CPU cycles spent mixing, divide by `frames` for the cycles per frame */
+    uint32_t mix_cycles_max;        /*!< Most CPU cycles spent on one block */
+} bsp_extra_mixer_stats_t;
+
+/**
+ * @brief Stream buffering counters, since the stream was created or its counters reset
+ */
+typedef struct {
+    size_t size;                    /*!< Ring size in bytes */
+    size_t filled;                  /*!< Bytes in the ring now */
+    size_t filled_min;              /*!< Fewest bytes left in the ring after a block was mixed from it, 0 once it ran
+                                         out while playing */
+    uint32_t underruns;             /*!< Blocks in which the stream ran out of data while playing */
+    uint32_t refill_us_max;         /*!< Longest time the writer took between two writes while the stream played,
+                                         it must stay below the ring duration */
+    uint32_t dropped_ms;            /*!< Audio dropped because the mixer was paused for another session */
+} bsp_extra_mixer_stream_stats_t;
+
+/**
+ * @brief Open the mixer codec session and start mixing once it is granted. Starting twice is harmless.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NO_MEM: Out of memory
+ *    - Others: Session error
+ */
+esp_err_t bsp_extra_mixer_start(void);
+
+/**
+ * @brief Stop mixing and close the session, the audio left in the streams stays there.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_TIMEOUT: The mixer task did not stop
+ */
+esp_err_t bsp_extra_mixer_stop(void);
+
+/**
+ * @brief Check whether the mixer is started, it may be paused for another session.
+ */
+bool bsp_extra_mixer_is_running(void);
+
+/**
+ * @brief Get the mixer counters.
+ *
+ * @param stats: Returned counters
+ */
+void bsp_extra_mixer_get_stats(bsp_extra_mixer_stats_t *stats);
+
+/**
+ * @brief Create a stream, silent until data is written.
+ *
+ * @param ring_size: Bytes buffered ahead of the mixer, the latency added to the stream
+ * @param caps: Memory of the ring, e.g. MALLOC_CAP_SPIRAM or MALLOC_CAP_INTERNAL
+ * @param ret_stream: Returned stream handle
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid argument
+ *    - ESP_ERR_NOT_FOUND: All the streams are in use
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t bsp_extra_mixer_stream_new(size_t ring_size, uint32_t caps, bsp_extra_mixer_stream_handle_t *ret_stream);
+
+/**
+ * @brief Delete a stream, its writer must be stopped.
+ *
+ * @param stream: Stream handle
+ */
+void bsp_extra_mixer_stream_del(bsp_extra_mixer_stream_handle_t stream);
+
+/**
+ * @brief Set the format of the data written next.
+ *
+ * Waits for the mixer to play the data already written, so it is not played at the new format.
+ *
+ * @param stream: Stream handle
+ * @param rate: Sample rate, up to BSP_EXTRA_MIXER_RATE_MAX
+ * @param bits: Bits per sample, only 16 is supported
+ * @param channels: 1 or 2
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NOT_SUPPORTED: Unsupported format
+ */
+esp_err_t bsp_extra_mixer_stream_set_format(bsp_extra_mixer_stream_handle_t stream, uint32_t rate, uint32_t bits,
+                                            uint32_t channels);
+
+/**
+ * @brief Write interleaved samples, blocking while the stream ring is full.
+ *
+ * While the mixer is paused for another session, what does not fit in the ring is dropped instead: the write takes as
+ * long as the dropped audio lasts, counts it in `dropped_ms` and in the played time, and succeeds.
+ *
+ * @param stream: Stream handle
+ * @param data: Samples at the stream format
+ * @param len: Data length in bytes
+ * @param bytes_written: Bytes actually written, can be NULL if not needed
+ * @param timeout_ms: Max block time
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_TIMEOUT: The mixer did not make room in time, e.g. it is stopped
+ */
+esp_err_t bsp_extra_mixer_stream_write(bsp_extra_mixer_stream_handle_t stream, const void *data, size_t len,
+                                       size_t *bytes_written, uint32_t timeout_ms);
+
+/**
+ * @brief Set the stream gain, applied to the data being mixed.
+ *
+ * @param stream: Stream handle
+ * @param gain: From 0 (silent) to 2, 1 plays the data as written
+ */
+void bsp_extra_mixer_stream_set_gain(bsp_extra_mixer_stream_handle_t stream, float gain);
+
+/**
+ * @brief Get the duration of the stream data mixed since the last reset.
+ *
+ * It stops while nothing is written and leads the speaker by the mixer block and the I2S DMA buffering. Audio dropped
+ * while the mixer is paused counts as played.
+ *
+ * @param stream: Stream handle
+ *
+ * @return
+ *    - Played time in microseconds
+ */
+int64_t bsp_extra_mixer_stream_get_played_us(bsp_extra_mixer_stream_handle_t stream);
+
+/**
+ * @brief Restart the played time of a stream from zero.
+ *
+ * @param stream: Stream handle
+ */
+void bsp_extra_mixer_stream_reset_played(bsp_extra_mixer_stream_handle_t stream);
+
+/**
+ * @brief Tell the mixer that the writer stops writing on purpose, e.g. on pause or at the end of its data.
+ *
+ * Until the next write, the stream drains without counting underruns, and the wait for that write is not counted as
+ * a refill.
+ *
+ * @param stream: Stream handle
+ */
+void bsp_extra_mixer_stream_mark_idle(bsp_extra_mixer_stream_handle_t stream);
+
+/**
+ * @brief Get the buffering counters of a stream, to size its ring against the stalls of its writer.
+ *
+ * @param stream: Stream handle
+ * @param stats: Returned counters
+ */
+void bsp_extra_mixer_stream_get_stats(bsp_extra_mixer_stream_handle_t stream, bsp_extra_mixer_stream_stats_t *stats);
+
+/**
+ * @brief Restart the buffering counters of a stream.
+ *
+ * @param stream: Stream handle
+ */
+void bsp_extra_mixer_stream_reset_stats(bsp_extra_mixer_stream_handle_t stream);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,99 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+ * PCM ring
+ * Lock-free byte ring for one producer task and one consumer task, such as an I2S capture task
+ * feeding a file writer. Neither side ever blocks or takes a lock, so the audio side keeps its timing
+ * whatever the other side does.
+ **************************************************************************************************/
+typedef struct bsp_extra_pcm_ring_t *bsp_extra_pcm_ring_handle_t;
+
+/**
+ * @brief Create a PCM ring.
+ *
+ * @param size: Capacity in bytes, rounded up to a power of two
+ * @param caps: Heap capabilities of the ring storage, e.g. MALLOC_CAP_SPIRAM
+ * @param ret_ring: Returned ring handle
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid argument
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t bsp_extra_pcm_ring_new(size_t size, uint32_t caps, bsp_extra_pcm_ring_handle_t *ret_ring);
+
+/**
+ * @brief Delete a PCM ring, neither side may use it anymore.
+ *
+ * @param ring: Ring handle
+ */
+void bsp_extra_pcm_ring_del(bsp_extra_pcm_ring_handle_t ring);
+
+/**
+ * @brief Copy data into the ring. Producer only.
+ *
+ * @param ring: Ring handle
+ * @param data: Data to copy
+ * @param len: Data length
+ *
+ * @return
+ *    - Bytes copied, less than `len` when the ring is full
+ */
+size_t bsp_extra_pcm_ring_write(bsp_extra_pcm_ring_handle_t ring, const void *data, size_t len);
+
+/**
+ * @brief Copy data out of the ring. Consumer only.
+ *
+ * @param ring: Ring handle
+ * @param data: Destination buffer
+ * @param len: Maximum length to copy
+ *
+ * @return
+ *    - Bytes copied, less than `len` when the ring runs empty
+ */
+size_t bsp_extra_pcm_ring_read(bsp_extra_pcm_ring_handle_t ring, void *data, size_t len);
+
+/**
+ * @brief Get the bytes waiting in the ring.
+ *
+ * @param ring: Ring handle
+ *
+ * @return
+ *    - Bytes the consumer can read, at least
+ */
+size_t bsp_extra_pcm_ring_get_filled(bsp_extra_pcm_ring_handle_t ring);
+
+/**
+ * @brief Get the free space of the ring.
+ *
+ * @param ring: Ring handle
+ *
+ * @return
+ *    - Bytes the producer can write, at least
+ */
+size_t bsp_extra_pcm_ring_get_free(bsp_extra_pcm_ring_handle_t ring);
+
+/**
+ * @brief Empty the ring. Only while neither side uses it.
+ *
+ * @param ring: Ring handle
+ */
+void bsp_extra_pcm_ring_reset(bsp_extra_pcm_ring_handle_t ring);
+
+#ifdef __cplusplus
+}
+#endif
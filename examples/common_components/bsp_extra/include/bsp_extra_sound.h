@@ -0,0 +1,53 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+ * UI sounds
+ * Short MP3 files decoded by their own task into their own stream of the audio mixer (see `bsp_extra_mixer.h`), so
+ * they play over the audio player instead of replacing what it plays. A sound cuts the one playing before it.
+ **************************************************************************************************/
+
+/**
+ * @brief Create the sound stream and its decoder task. Initializing twice is harmless.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NO_MEM: Out of memory
+ *    - Others: Mixer error
+ */
+esp_err_t bsp_extra_sound_init(void);
+
+/**
+ * @brief Play an MP3 file, without waiting for it. Starts the mixer if needed.
+ *
+ * @param path: File path, copied
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Path is NULL or too long
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - Others: Mixer error
+ */
+esp_err_t bsp_extra_sound_play_file(const char *path);
+
+/**
+ * @brief Set the gain of the sounds, independent from the player mute.
+ *
+ * @param gain: From 0 (silent) to 2, 1 plays the files as they are
+ */
+void bsp_extra_sound_set_gain(float gain);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,12 +7,16 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sys/param.h>
 #include "esp_log.h"
 #include "esp_check.h"
 #include "esp_codec_dev_defaults.h"
 #include "esp_err.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_vfs_fat.h"
+#include "freertos/FreeRTOS.h"
 #include "driver/i2c.h"
 #include "driver/i2s_std.h"
 #include "driver/gpio.h"
@@ -20,6 +24,15 @@
 
 #include "bsp/esp-bsp.h"
 #include "bsp_board_extra.h"
+#include "bsp_extra_mixer.h"
+
+#define PLAYER_STREAM_RING_SIZE     (CONFIG_BSP_EXTRA_PLAYER_BUFFER_KB * 1024)
+#if CONFIG_BSP_EXTRA_PLAYER_BUFFER_INTERNAL
+#define PLAYER_STREAM_RING_CAPS     (MALLOC_CAP_INTERNAL)
+#else
+#define PLAYER_STREAM_RING_CAPS     (MALLOC_CAP_SPIRAM)
+#endif
+#define PLAYER_WRITE_TIMEOUT_MS     (1000)
 
 static const char *TAG = "bsp_extra_board";
 
@@ -34,6 +47,25 @@ static audio_player_cb_t audio_idle_callback = NULL;
 static void *audio_idle_cb_user_data = NULL;
 static char audio_file_path[128];
 
+/* The player writes into a mixer stream, the playback clock is the time of its audio mixed so far */
+static bsp_extra_mixer_stream_handle_t player_stream;
+static portMUX_TYPE player_write_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t player_first_write_us;       /* First write since the clock reset, 0 before it */
+
+/* Codec format, as last set by `bsp_extra_codec_set_fs` */
+static portMUX_TYPE codec_fs_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t codec_fs_rate = CODEC_DEFAULT_SAMPLE_RATE;
+static uint32_t codec_fs_bits = CODEC_DEFAULT_BIT_WIDTH;
+static uint32_t codec_fs_channels = CODEC_DEFAULT_CHANNEL;
+static bool codec_fs_open;                  /* Play and record handles open at the format above */
+
+/* DMA periods lost, counted from the I2S driver queue overflow events */
+static volatile uint32_t i2s_tx_underruns;
+static volatile uint32_t i2s_rx_overruns;
+
+/* Copy of the played audio, see `bsp_extra_i2s_set_tap` */
+static bsp_extra_pcm_ring_handle_t volatile i2s_tap_ring;
+
 /**************************************************************************************************
  *
  * Extra Board Function
@@ -42,21 +74,43 @@ static char audio_file_path[128];
 
 static esp_err_t audio_mute_function(AUDIO_PLAYER_MUTE_SETTING setting)
 {
-    // Volume saved when muting and restored when unmuting. Restoring volume is necessary
-    // as es8311_set_voice_mute(true) results in voice volume (REG32) being set to zero.
+    // Only the player stream is muted, the codec keeps playing the other streams
+    bsp_extra_mixer_stream_set_gain(player_stream, (setting == AUDIO_PLAYER_MUTE) ? 0.0f : 1.0f);
 
-    bsp_extra_codec_mute_set(setting == AUDIO_PLAYER_MUTE ? true : false);
+    return ESP_OK;
+}
 
-    // restore the voice volume upon unmuting
-    if (setting == AUDIO_PLAYER_UNMUTE) {
-        ESP_RETURN_ON_ERROR(esp_codec_dev_set_out_vol(play_dev_handle, _vloume_intensity), TAG, "Set Codec volume failed");
+static esp_err_t audio_write_function(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&player_write_lock);
+    if (!player_first_write_us) {
+        player_first_write_us = now;
     }
+    portEXIT_CRITICAL(&player_write_lock);
 
-    return ESP_OK;
+    // While a capture session pauses the mixer, the write drops the audio at the pace it would have played. The bound is
+    // for a stopped mixer, which never makes room.
+    return bsp_extra_mixer_stream_write(player_stream, audio_buffer, len, bytes_written,
+                                        MIN(timeout_ms, PLAYER_WRITE_TIMEOUT_MS));
+}
+
+static esp_err_t audio_clk_set_function(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    // The codec stays at the mixer format, the mixer resamples the player stream
+    ESP_RETURN_ON_ERROR(bsp_extra_mixer_start(), TAG, "Start mixer failed");
+
+    return bsp_extra_mixer_stream_set_format(player_stream, rate, bits_cfg, ch);
 }
 
 static void audio_callback(audio_player_cb_ctx_t *ctx)
 {
+    // The player stops writing on purpose, the stream drains without counting underruns
+    if ((ctx->audio_event == AUDIO_PLAYER_CALLBACK_EVENT_IDLE) ||
+            (ctx->audio_event == AUDIO_PLAYER_CALLBACK_EVENT_PAUSE)) {
+        bsp_extra_mixer_stream_mark_idle(player_stream);
+    }
+
     if (audio_idle_callback) {
         ctx->user_ctx = audio_idle_cb_user_data;
         audio_idle_callback(ctx);
@@ -76,9 +130,102 @@ esp_err_t bsp_extra_i2s_write(void *audio_buffer, size_t len, size_t *bytes_writ
     esp_err_t ret = ESP_OK;
     ret = esp_codec_dev_write(play_dev_handle, audio_buffer, len);
     *bytes_written = len;
+
+    if (ret == ESP_OK) {
+        /* Whole buffers only, so the consumer stays aligned on frames */
+        bsp_extra_pcm_ring_handle_t tap = i2s_tap_ring;
+        if (tap && (bsp_extra_pcm_ring_get_free(tap) >= len)) {
+            bsp_extra_pcm_ring_write(tap, audio_buffer, len);
+        }
+    }
     return ret;
 }
 
+void bsp_extra_i2s_set_tap(bsp_extra_pcm_ring_handle_t ring)
+{
+    i2s_tap_ring = ring;
+}
+
+static bool IRAM_ATTR i2s_tx_queue_overflow_cb(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    i2s_tx_underruns++;
+    return false;
+}
+
+static bool IRAM_ATTR i2s_rx_queue_overflow_cb(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    i2s_rx_overruns++;
+    return false;
+}
+
+/* Called before the codec devices are opened, see `bsp_audio_register_i2s_callbacks` */
+static esp_err_t i2s_stats_init(void)
+{
+    const i2s_event_callbacks_t tx_cbs = {
+        .on_send_q_ovf = i2s_tx_queue_overflow_cb,
+    };
+    const i2s_event_callbacks_t rx_cbs = {
+        .on_recv_q_ovf = i2s_rx_queue_overflow_cb,
+    };
+
+    return bsp_audio_register_i2s_callbacks(&tx_cbs, &rx_cbs, NULL);
+}
+
+void bsp_extra_i2s_get_stats(bsp_extra_i2s_stats_t *stats)
+{
+    stats->tx_underruns = i2s_tx_underruns;
+    stats->rx_overruns = i2s_rx_overruns;
+}
+
+uint32_t bsp_extra_i2s_get_period_frames(void)
+{
+    return CONFIG_BSP_I2S_DMA_FRAME_NUM;
+}
+
+uint32_t bsp_extra_i2s_get_period_num(void)
+{
+    return CONFIG_BSP_I2S_DMA_DESC_NUM;
+}
+
+int64_t bsp_extra_audio_clock_get_us(void)
+{
+    return player_stream ? bsp_extra_mixer_stream_get_played_us(player_stream) : 0;
+}
+
+void bsp_extra_audio_clock_reset(void)
+{
+    if (player_stream) {
+        bsp_extra_mixer_stream_reset_played(player_stream);
+    }
+    portENTER_CRITICAL(&player_write_lock);
+    player_first_write_us = 0;
+    portEXIT_CRITICAL(&player_write_lock);
+}
+
+int64_t bsp_extra_player_get_first_write_us(void)
+{
+    portENTER_CRITICAL(&player_write_lock);
+    int64_t first_write_us = player_first_write_us;
+    portEXIT_CRITICAL(&player_write_lock);
+
+    return first_write_us;
+}
+
+void bsp_extra_codec_get_fs(uint32_t *rate, uint32_t *bits_cfg, uint32_t *ch)
+{
+    portENTER_CRITICAL(&codec_fs_lock);
+    if (rate) {
+        *rate = codec_fs_rate;
+    }
+    if (bits_cfg) {
+        *bits_cfg = codec_fs_bits;
+    }
+    if (ch) {
+        *ch = codec_fs_channels;
+    }
+    portEXIT_CRITICAL(&codec_fs_lock);
+}
+
 esp_err_t bsp_extra_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
 {
     esp_err_t ret = ESP_OK;
@@ -91,6 +238,17 @@ esp_err_t bsp_extra_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode
         // .mclk_multiple = I2S_MCLK_MULTIPLE_256,
     };
 
+    /* Reopening flushes the DMA buffers and clicks, skip it when the format is already set */
+    portENTER_CRITICAL(&codec_fs_lock);
+    bool same = codec_fs_open && (codec_fs_rate == rate) && (codec_fs_bits == bits_cfg) && (codec_fs_channels == ch);
+    codec_fs_rate = rate;
+    codec_fs_bits = bits_cfg;
+    codec_fs_channels = ch;
+    portEXIT_CRITICAL(&codec_fs_lock);
+    if (same) {
+        return ESP_OK;
+    }
+
     if (play_dev_handle) {
         ret = esp_codec_dev_close(play_dev_handle);
     }
@@ -105,6 +263,7 @@ esp_err_t bsp_extra_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode
     if (record_dev_handle) {
         ret |= esp_codec_dev_open(record_dev_handle, &fs);
     }
+    codec_fs_open = (ret == ESP_OK);
     return ret;
 }
 
@@ -134,6 +293,8 @@ esp_err_t bsp_extra_codec_dev_stop(void)
 {
     esp_err_t ret = ESP_OK;
 
+    codec_fs_open = false;
+
     if (play_dev_handle) {
         ret = esp_codec_dev_close(play_dev_handle);
     }
@@ -161,6 +322,10 @@ esp_err_t bsp_extra_codec_init()
     record_dev_handle = bsp_audio_codec_microphone_init();
     assert((record_dev_handle) && "record_dev_handle not initialized");
 
+    if (i2s_stats_init() != ESP_OK) {
+        ESP_LOGW(TAG, "I2S underruns and overruns are not counted");
+    }
+
     bsp_extra_codec_set_fs(CODEC_DEFAULT_SAMPLE_RATE, CODEC_DEFAULT_BIT_WIDTH, CODEC_DEFAULT_CHANNEL);
 
     _is_audio_init = true;
@@ -174,12 +339,20 @@ esp_err_t bsp_extra_player_init(void)
         return ESP_OK;
     }
 
+    ESP_RETURN_ON_ERROR(bsp_extra_mixer_stream_new(PLAYER_STREAM_RING_SIZE, PLAYER_STREAM_RING_CAPS, &player_stream),
+                        TAG, "Create player stream failed");
+
     audio_player_config_t config = { .mute_fn = audio_mute_function,
-                                     .write_fn = bsp_extra_i2s_write,
-                                     .clk_set_fn = bsp_extra_codec_set_fs,
-                                     .priority = 5
+                                     .write_fn = audio_write_function,
+                                     .clk_set_fn = audio_clk_set_function,
+                                     .priority = CONFIG_BSP_EXTRA_PLAYER_TASK_PRIORITY
                                    };
-    ESP_RETURN_ON_ERROR(audio_player_new(config), TAG, "audio_player_init failed");
+    if (audio_player_new(config) != ESP_OK) {
+        bsp_extra_mixer_stream_del(player_stream);
+        player_stream = NULL;
+        ESP_LOGE(TAG, "audio_player_init failed");
+        return ESP_FAIL;
+    }
     audio_player_callback_register(audio_callback, NULL);
 
     _is_player_init = true;
@@ -192,6 +365,27 @@ esp_err_t bsp_extra_player_del(void)
     _is_player_init = false;
 
     ESP_RETURN_ON_ERROR(audio_player_delete(), TAG, "audio_player_delete failed");
+    bsp_extra_mixer_stream_del(player_stream);
+    player_stream = NULL;
+
+    return ESP_OK;
+}
+
+esp_err_t bsp_extra_player_get_buffer_stats(bsp_extra_mixer_stream_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "stats is NULL");
+    ESP_RETURN_ON_FALSE(player_stream, ESP_ERR_INVALID_STATE, TAG, "player not initialized");
+
+    bsp_extra_mixer_stream_get_stats(player_stream, stats);
+
+    return ESP_OK;
+}
+
+esp_err_t bsp_extra_player_reset_buffer_stats(void)
+{
+    ESP_RETURN_ON_FALSE(player_stream, ESP_ERR_INVALID_STATE, TAG, "player not initialized");
+
+    bsp_extra_mixer_stream_reset_stats(player_stream);
 
     return ESP_OK;
 }
@@ -223,6 +417,8 @@ esp_err_t bsp_extra_player_play_index(file_iterator_instance_t *instance, int in
     ESP_RETURN_ON_FALSE(fp, ESP_FAIL, TAG, "unable to open file");
 
     ESP_LOGI(TAG, "Playing '%s'", filename);
+    /* The clock gives the position in the new file */
+    bsp_extra_audio_clock_reset();
     ESP_RETURN_ON_ERROR(audio_player_play(fp), TAG, "audio_player_play failed");
 
     memcpy(audio_file_path, filename, sizeof(audio_file_path));
@@ -237,6 +433,8 @@ esp_err_t bsp_extra_player_play_file(const char *file_path)
     ESP_RETURN_ON_FALSE(fp, ESP_FAIL, TAG, "unable to open file");
 
     ESP_LOGI(TAG, "Playing '%s'", file_path);
+    /* The clock gives the position in the new file */
+    bsp_extra_audio_clock_reset();
     ESP_RETURN_ON_ERROR(audio_player_play(fp), TAG, "audio_player_play failed");
 
     memcpy(audio_file_path, file_path, sizeof(audio_file_path));
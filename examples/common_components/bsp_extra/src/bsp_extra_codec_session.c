@@ -0,0 +1,242 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "bsp_board_extra.h"
+#include "bsp_extra_codec_session.h"
+
+static const char *TAG = "bsp_extra_codec_session";
+
+struct bsp_extra_codec_session_t {
+    bsp_extra_codec_session_cfg_t cfg;
+    uint32_t seq;                           /* Open order, the first opened leads among equal priorities */
+    bool granted;
+};
+
+typedef struct {
+    SemaphoreHandle_t lock;
+    bsp_extra_codec_session_handle_t sessions[BSP_EXTRA_CODEC_SESSION_NUM];
+    uint32_t seq;
+    /* Format the codec was last set to by a session */
+    bool open;
+    uint32_t rate;
+    uint32_t bits_cfg;
+    i2s_slot_mode_t ch;
+    bool muted;
+    portMUX_TYPE stats_lock;
+    bsp_extra_codec_session_stats_t stats;
+} codec_session_mgr_t;
+
+static codec_session_mgr_t mgr = {
+    .muted = true,
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static bool session_same_format(const bsp_extra_codec_session_cfg_t *cfg, uint32_t rate, uint32_t bits_cfg,
+                                i2s_slot_mode_t ch)
+{
+    return (cfg->rate == rate) && (cfg->bits_cfg == bits_cfg) && (cfg->ch == ch);
+}
+
+static bsp_extra_codec_session_handle_t session_get_leader(void)
+{
+    bsp_extra_codec_session_handle_t leader = NULL;
+
+    for (int i = 0; i < BSP_EXTRA_CODEC_SESSION_NUM; i++) {
+        bsp_extra_codec_session_handle_t s = mgr.sessions[i];
+        if (s && (!leader || (s->cfg.priority > leader->cfg.priority) ||
+                  ((s->cfg.priority == leader->cfg.priority) && (s->seq < leader->seq)))) {
+            leader = s;
+        }
+    }
+
+    return leader;
+}
+
+/* Bring the codec and the grants in line with the open sessions, with the lock held */
+static void session_update(void)
+{
+    bsp_extra_codec_session_handle_t leader = session_get_leader();
+
+    if (!leader) {
+        if (mgr.open) {
+            bsp_extra_codec_mute_set(true);
+            bsp_extra_codec_dev_stop();
+            mgr.open = false;
+            mgr.muted = true;
+            ESP_LOGI(TAG, "Codec closed, no session left");
+        }
+        return;
+    }
+
+    const uint32_t rate = leader->cfg.rate;
+    const uint32_t bits_cfg = leader->cfg.bits_cfg;
+    const i2s_slot_mode_t ch = leader->cfg.ch;
+
+    /* Owners at another format stop before the codec changes under them */
+    for (int i = 0; i < BSP_EXTRA_CODEC_SESSION_NUM; i++) {
+        bsp_extra_codec_session_handle_t s = mgr.sessions[i];
+        if (s && s->granted && !session_same_format(&s->cfg, rate, bits_cfg, ch)) {
+            s->granted = false;
+            ESP_LOGI(TAG, "Session '%s' suspended for '%s'", s->cfg.name, leader->cfg.name);
+            if (s->cfg.cb) {
+                s->cfg.cb(s, false, s->cfg.user_ctx);
+            }
+            portENTER_CRITICAL(&mgr.stats_lock);
+            mgr.stats.preemptions++;
+            portEXIT_CRITICAL(&mgr.stats_lock);
+        }
+    }
+
+    bool reopened = !mgr.open || (mgr.rate != rate) || (mgr.bits_cfg != bits_cfg) || (mgr.ch != ch);
+    if (reopened) {
+        int64_t start = esp_timer_get_time();
+        esp_err_t ret = bsp_extra_codec_set_fs(rate, bits_cfg, ch);
+        uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Set codec format for '%s' failed", leader->cfg.name);
+        }
+        mgr.open = true;
+        mgr.rate = rate;
+        mgr.bits_cfg = bits_cfg;
+        mgr.ch = ch;
+
+        portENTER_CRITICAL(&mgr.stats_lock);
+        mgr.stats.reconfigs++;
+        mgr.stats.reconfig_us_last = elapsed_us;
+        mgr.stats.reconfig_us_max = MAX(mgr.stats.reconfig_us_max, elapsed_us);
+        mgr.stats.reconfig_us_total += elapsed_us;
+        portEXIT_CRITICAL(&mgr.stats_lock);
+        ESP_LOGI(TAG, "Codec set to %" PRIu32 " Hz, %" PRIu32 " bits, %d channels for '%s' in %" PRIu32 " us", rate,
+                 bits_cfg, ch, leader->cfg.name, elapsed_us);
+    }
+
+    /* The output plays while a granted session plays */
+    bool playback = false;
+    for (int i = 0; i < BSP_EXTRA_CODEC_SESSION_NUM; i++) {
+        bsp_extra_codec_session_handle_t s = mgr.sessions[i];
+        if (s && (s->cfg.flags & BSP_EXTRA_CODEC_SESSION_PLAYBACK) &&
+                session_same_format(&s->cfg, rate, bits_cfg, ch)) {
+            playback = true;
+        }
+    }
+    if (reopened || (playback == mgr.muted)) {
+        bsp_extra_codec_mute_set(!playback);
+        if (playback) {
+            // es8311 clears the volume when muted, so it is restored
+            bsp_extra_codec_volume_set(bsp_extra_codec_volume_get(), NULL);
+        }
+        mgr.muted = !playback;
+    }
+
+    for (int i = 0; i < BSP_EXTRA_CODEC_SESSION_NUM; i++) {
+        bsp_extra_codec_session_handle_t s = mgr.sessions[i];
+        if (s && !s->granted && session_same_format(&s->cfg, rate, bits_cfg, ch)) {
+            s->granted = true;
+            /* The session being opened learns it from the open */
+            if (s->seq != mgr.seq) {
+                ESP_LOGI(TAG, "Session '%s' resumed", s->cfg.name);
+                if (s->cfg.cb) {
+                    s->cfg.cb(s, true, s->cfg.user_ctx);
+                }
+            }
+        }
+    }
+}
+
+esp_err_t bsp_extra_codec_session_open(const bsp_extra_codec_session_cfg_t *config,
+                                       bsp_extra_codec_session_handle_t *ret_session)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config && config->rate && config->bits_cfg && config->ch && ret_session, ESP_ERR_INVALID_ARG,
+                        TAG, "Invalid argument");
+    if (!mgr.lock) {
+        mgr.lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(mgr.lock, ESP_ERR_NO_MEM, TAG, "No memory for session lock");
+    }
+
+    bsp_extra_codec_session_handle_t session = calloc(1, sizeof(struct bsp_extra_codec_session_t));
+    ESP_RETURN_ON_FALSE(session, ESP_ERR_NO_MEM, TAG, "No memory for session");
+    session->cfg = *config;
+    if (!session->cfg.name) {
+        session->cfg.name = "?";
+    }
+
+    xSemaphoreTake(mgr.lock, portMAX_DELAY);
+    int slot = -1;
+    for (int i = 0; i < BSP_EXTRA_CODEC_SESSION_NUM; i++) {
+        if (!mgr.sessions[i]) {
+            slot = i;
+            break;
+        }
+    }
+    ESP_GOTO_ON_FALSE(slot >= 0, ESP_ERR_NOT_FOUND, err, TAG, "All %d sessions are in use",
+                      BSP_EXTRA_CODEC_SESSION_NUM);
+    session->seq = ++mgr.seq;
+    mgr.sessions[slot] = session;
+
+    bool shared = mgr.open && session_same_format(config, mgr.rate, mgr.bits_cfg, mgr.ch);
+    session_update();
+
+    portENTER_CRITICAL(&mgr.stats_lock);
+    mgr.stats.sessions++;
+    mgr.stats.opens++;
+    mgr.stats.shared += (shared && session->granted);
+    portEXIT_CRITICAL(&mgr.stats_lock);
+    ESP_LOGI(TAG, "Session '%s' opened, %s", session->cfg.name, session->granted ? "granted" : "suspended");
+    xSemaphoreGive(mgr.lock);
+
+    *ret_session = session;
+
+    return ESP_OK;
+
+err:
+    xSemaphoreGive(mgr.lock);
+    free(session);
+    return ret;
+}
+
+void bsp_extra_codec_session_close(bsp_extra_codec_session_handle_t session)
+{
+    if (!session) {
+        return;
+    }
+
+    xSemaphoreTake(mgr.lock, portMAX_DELAY);
+    for (int i = 0; i < BSP_EXTRA_CODEC_SESSION_NUM; i++) {
+        if (mgr.sessions[i] == session) {
+            mgr.sessions[i] = NULL;
+            portENTER_CRITICAL(&mgr.stats_lock);
+            mgr.stats.sessions--;
+            portEXIT_CRITICAL(&mgr.stats_lock);
+        }
+    }
+    ESP_LOGI(TAG, "Session '%s' closed", session->cfg.name);
+    session_update();
+    xSemaphoreGive(mgr.lock);
+
+    free(session);
+}
+
+bool bsp_extra_codec_session_is_granted(bsp_extra_codec_session_handle_t session)
+{
+    return session && session->granted;
+}
+
+void bsp_extra_codec_session_get_stats(bsp_extra_codec_session_stats_t *stats)
+{
+    portENTER_CRITICAL(&mgr.stats_lock);
+    *stats = mgr.stats;
+    portEXIT_CRITICAL(&mgr.stats_lock);
+}
@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "bsp_extra_mem_pressure.h"
+
+#define MEM_RECLAIMER_NUM       (4)
+
+typedef struct {
+    bsp_extra_mem_reclaim_cb_t cb;
+    void *user_ctx;
+} mem_reclaimer_t;
+
+static const char *TAG = "bsp_extra_mem";
+
+static mem_reclaimer_t reclaimers[MEM_RECLAIMER_NUM];
+static int reclaimer_num;
+static portMUX_TYPE reclaimer_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t bsp_extra_mem_pressure_register(bsp_extra_mem_reclaim_cb_t cb, void *user_ctx)
+{
+    ESP_RETURN_ON_FALSE(cb, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&reclaimer_lock);
+    if (reclaimer_num < MEM_RECLAIMER_NUM) {
+        reclaimers[reclaimer_num] = (mem_reclaimer_t) {
+            .cb = cb,
+            .user_ctx = user_ctx,
+        };
+        reclaimer_num++;
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&reclaimer_lock);
+    ESP_RETURN_ON_ERROR(ret, TAG, "No reclaimer slot left");
+
+    return ESP_OK;
+}
+
+size_t bsp_extra_mem_pressure_reclaim(size_t free_size)
+{
+    size_t released = 0;
+
+    // Slots are only ever added, a reclaimer registered meanwhile waits for the next call
+    portENTER_CRITICAL(&reclaimer_lock);
+    int num = reclaimer_num;
+    portEXIT_CRITICAL(&reclaimer_lock);
+
+    for (int i = 0; (i < num) && (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) < free_size); i++) {
+        released += reclaimers[i].cb(free_size, reclaimers[i].user_ctx);
+    }
+    if (released) {
+        ESP_LOGI(TAG, "Reclaimed %zu KB of PSRAM", released / 1024);
+    }
+
+    return released;
+}
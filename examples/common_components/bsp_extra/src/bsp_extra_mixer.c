@@ -0,0 +1,629 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "bsp_board_extra.h"
+#include "bsp_extra_codec_session.h"
+#include "bsp_extra_mixer.h"
+
+#define MIXER_BLOCK_PERIODS         (4)         /* Output frames mixed per block, in I2S DMA periods */
+#define MIXER_CHANNELS              (2)
+#define MIXER_TASK_STACK_SIZE       (4 * 1024)
+#define MIXER_STOP_TIMEOUT_MS       (1000)
+#define MIXER_DRAIN_TIMEOUT_MS      (1000)
+#define MIXER_FRAC_BITS             (16)
+#define MIXER_FRAC_ONE              (1 << MIXER_FRAC_BITS)
+#define MIXER_GAIN_BITS             (15)
+#define MIXER_GAIN_ONE              (1 << MIXER_GAIN_BITS)
+
+static const char *TAG = "bsp_extra_mixer";
+
+struct bsp_extra_mixer_stream_t {
+    bsp_extra_pcm_ring_handle_t ring;
+    SemaphoreHandle_t space_sem;            /* Given by the mixer after it read from the ring */
+    atomic_int gain;                        /* Q15 */
+    /* Format and played time, shared by the writer and the mixer */
+    portMUX_TYPE lock;
+    uint32_t rate;
+    uint32_t channels;
+    uint32_t step;                          /* Input frames per output frame, Q16, rounded down */
+    uint32_t step_rem;                      /* What the rounding left out, in 1 / BSP_EXTRA_MIXER_SAMPLE_RATE Q16 */
+    bool format_changed;                    /* The resampler restarts on the next block */
+    uint64_t played_base_us;                /* Time played at formats used before the current one */
+    uint64_t played_frames;                 /* Frames played at the current format */
+    /* Buffering counters, shared by the writer and the mixer */
+    size_t ring_size;
+    size_t filled_min;
+    uint32_t underruns;
+    uint32_t refill_us_max;
+    uint64_t dropped_us;                    /* Audio dropped while the mixer was paused for another session */
+    int64_t write_end_us;                   /* End of the last write, 0 while the writer is idle on purpose */
+    /* Resampler, only used by the mixer */
+    uint32_t frac;                          /* Position of the next output from `hist[0]`, Q16, may skip frames */
+    int16_t hist[2 * MIXER_CHANNELS];       /* Frames read but still needed to interpolate */
+    uint32_t hist_frames;
+    uint32_t rem_acc;                       /* `step_rem` of the frames mixed, carried into `frac` once whole */
+    bool active;                            /* Filled the previous block */
+    bool deferred;                          /* Waited one block for more data before starting */
+};
+
+typedef struct {
+    SemaphoreHandle_t streams_lock;         /* Held by the mixer for a whole block, and to add or remove streams */
+    SemaphoreHandle_t wake_sem;             /* Given by the writers, the mixer sleeps on it while all is silent */
+    SemaphoreHandle_t exit_sem;
+    bsp_extra_mixer_stream_handle_t streams[BSP_EXTRA_MIXER_STREAM_NUM];
+    bsp_extra_codec_session_handle_t session;   /* Open from start to stop */
+    volatile bool running;                      /* The task runs, while the session is granted */
+    uint32_t block_frames;
+    int32_t *acc;
+    int16_t *out;
+    int16_t *scratch;                       /* The history of a stream followed by the frames read for a block */
+    portMUX_TYPE stats_lock;
+    bsp_extra_mixer_stats_t stats;
+} mixer_t;
+
+static mixer_t mixer = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/*
+ * Add `n` output frames of `in` to the stereo accumulator. The output frame `j` sits at the input position
+ * `frac + j * step` in Q16, between the frames `in[i]` and `in[i + 1]`.
+ */
+static void mixer_kernel(const int16_t *in, uint32_t channels, uint32_t frac, uint32_t step, int32_t gain,
+                         int32_t *acc, uint32_t n)
+{
+    if ((step == MIXER_FRAC_ONE) && !(frac & (MIXER_FRAC_ONE - 1))) {
+        /* Same rate and in phase: no interpolation */
+        const int16_t *p = in + (frac >> MIXER_FRAC_BITS) * channels;
+        if (channels == MIXER_CHANNELS) {
+            for (uint32_t j = 0; j < n * MIXER_CHANNELS; j++) {
+                acc[j] += (p[j] * gain) >> MIXER_GAIN_BITS;
+            }
+        } else {
+            for (uint32_t j = 0; j < n; j++) {
+                int32_t v = (p[j] * gain) >> MIXER_GAIN_BITS;
+                acc[2 * j] += v;
+                acc[2 * j + 1] += v;
+            }
+        }
+        return;
+    }
+
+    uint32_t pos = frac;
+    for (uint32_t j = 0; j < n; j++, pos += step) {
+        const int16_t *a = in + (pos >> MIXER_FRAC_BITS) * channels;
+        const int16_t *b = a + channels;
+        /* Q15 weight so that the difference times the weight fits in 32 bits */
+        int32_t w = (pos & (MIXER_FRAC_ONE - 1)) >> 1;
+        int32_t l = a[0] + (((b[0] - a[0]) * w) >> 15);
+        int32_t r = (channels == MIXER_CHANNELS) ? a[1] + (((b[1] - a[1]) * w) >> 15) : l;
+        acc[2 * j] += (l * gain) >> MIXER_GAIN_BITS;
+        acc[2 * j + 1] += (r * gain) >> MIXER_GAIN_BITS;
+    }
+}
+
+static void mixer_saturate(const int32_t *acc, int16_t *out, uint32_t samples)
+{
+    for (uint32_t i = 0; i < samples; i++) {
+        int32_t v = acc[i];
+        out[i] = (int16_t)((v > INT16_MAX) ? INT16_MAX : ((v < INT16_MIN) ? INT16_MIN : v));
+    }
+}
+
+/*
+ * Mix as much of one stream as it has for the block, return whether it had any data. A stream that runs out stays
+ * silent for the rest of the block. A stream that starts with less than a block waits one block for its writer, so
+ * that it does not start with a gap.
+ */
+static bool mixer_mix_stream(bsp_extra_mixer_stream_handle_t stream, int32_t *acc, uint32_t out_frames,
+                             bool *starved, bool *deferred)
+{
+    portENTER_CRITICAL(&stream->lock);
+    if (stream->format_changed) {
+        stream->format_changed = false;
+        stream->frac = 0;
+        stream->hist_frames = 0;
+        stream->rem_acc = 0;
+    }
+    const uint32_t channels = stream->channels;
+    const uint32_t step = stream->step;
+    const uint32_t step_rem = stream->step_rem;
+    /* Counted under the lock: no data at a newer format can be in it yet */
+    const size_t frame_bytes = channels * sizeof(int16_t);
+    const uint32_t avail = bsp_extra_pcm_ring_get_filled(stream->ring) / frame_bytes;
+    portEXIT_CRITICAL(&stream->lock);
+
+    /* The output `j` at `frac + j * step` needs the frames `i` and `i + 1`, so `i + 1` must be below `total` */
+    const uint64_t frac = stream->frac;
+    const uint64_t total = stream->hist_frames + avail;
+    uint32_t n = 0;
+    uint64_t read = avail;
+    if ((total >= 2) && (((total - 1) << MIXER_FRAC_BITS) > frac)) {
+        n = (uint32_t)MIN((((total - 1) << MIXER_FRAC_BITS) - frac - 1) / step + 1, out_frames);
+        read = ((frac + (uint64_t)(n - 1) * step) >> MIXER_FRAC_BITS) + 2 - stream->hist_frames;
+    }
+    if (!read && !n) {
+        return false;
+    }
+    if (!stream->active && (n < out_frames) && !stream->deferred) {
+        stream->deferred = true;
+        *deferred = true;
+        return false;
+    }
+    stream->deferred = false;
+    *starved = stream->active && (n < out_frames);
+    stream->active = (n == out_frames);
+
+    int16_t *in = mixer.scratch;
+    memcpy(in, stream->hist, stream->hist_frames * frame_bytes);
+    if (read) {
+        bsp_extra_pcm_ring_read(stream->ring, in + stream->hist_frames * channels, read * frame_bytes);
+        xSemaphoreGive(stream->space_sem);
+    }
+
+    mixer_kernel(in, channels, stream->frac, step, atomic_load_explicit(&stream->gain, memory_order_relaxed), acc, n);
+
+    /* Keep the frames from the next output position on, at most the last two; frames past it are skipped */
+    const uint64_t frames = stream->hist_frames + read;
+    /* The rounding error of `step` is made up once per block, so the pitch does not drift */
+    uint64_t rem = (uint64_t)stream->rem_acc + (uint64_t)n * step_rem;
+    const uint64_t end = frac + (uint64_t)n * step + rem / BSP_EXTRA_MIXER_SAMPLE_RATE;
+    stream->rem_acc = (uint32_t)(rem % BSP_EXTRA_MIXER_SAMPLE_RATE);
+    const uint64_t base = MIN(end >> MIXER_FRAC_BITS, frames - 1);
+    stream->hist_frames = (uint32_t)(frames - base);
+    memcpy(stream->hist, in + base * channels, stream->hist_frames * frame_bytes);
+    stream->frac = (uint32_t)(end - (base << MIXER_FRAC_BITS));
+
+    portENTER_CRITICAL(&stream->lock);
+    stream->played_frames += read;
+    if (stream->write_end_us) {
+        /* A stream left idle on purpose drains without counting */
+        stream->underruns += *starved;
+        stream->filled_min = *starved ? 0 : MIN(stream->filled_min, bsp_extra_pcm_ring_get_filled(stream->ring));
+    }
+    portEXIT_CRITICAL(&stream->lock);
+
+    return (n > 0);
+}
+
+static void mixer_task(void *arg)
+{
+    const uint32_t frames = mixer.block_frames;
+    const size_t out_bytes = frames * MIXER_CHANNELS * sizeof(int16_t);
+    const TickType_t block_ticks = MAX(pdMS_TO_TICKS(frames * 1000 / BSP_EXTRA_MIXER_SAMPLE_RATE), 1);
+
+    ESP_LOGI(TAG, "Mixer started, %" PRIu32 " frames per block", frames);
+
+    while (mixer.running) {
+        uint32_t start = esp_cpu_get_cycle_count();
+        bool any = false;
+        bool deferred = false;
+        uint32_t starved = 0;
+
+        memset(mixer.acc, 0, frames * MIXER_CHANNELS * sizeof(int32_t));
+        xSemaphoreTake(mixer.streams_lock, portMAX_DELAY);
+        for (int i = 0; i < BSP_EXTRA_MIXER_STREAM_NUM; i++) {
+            bool stream_starved = false;
+            if (mixer.streams[i]) {
+                any |= mixer_mix_stream(mixer.streams[i], mixer.acc, frames, &stream_starved, &deferred);
+                starved += stream_starved;
+            }
+        }
+        xSemaphoreGive(mixer.streams_lock);
+
+        if (!any) {
+            /* The DMA plays silence on its own until a writer brings data */
+            xSemaphoreTake(mixer.wake_sem, deferred ? block_ticks : portMAX_DELAY);
+            continue;
+        }
+        mixer_saturate(mixer.acc, mixer.out, frames * MIXER_CHANNELS);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+        portENTER_CRITICAL(&mixer.stats_lock);
+        mixer.stats.blocks++;
+        mixer.stats.starved += (starved > 0);
+        mixer.stats.frames += frames;
+        mixer.stats.mix_cycles += cycles;
+        mixer.stats.mix_cycles_max = MAX(mixer.stats.mix_cycles_max, cycles);
+        portEXIT_CRITICAL(&mixer.stats_lock);
+
+        /* Paced by the DMA: returns once the block fits in the DMA buffers */
+        size_t written = 0;
+        if (bsp_extra_i2s_write(mixer.out, out_bytes, &written, portMAX_DELAY) != ESP_OK) {
+            ESP_LOGW(TAG, "Write to codec failed");
+        }
+    }
+
+    ESP_LOGI(TAG, "Mixer stopped");
+    xSemaphoreGive(mixer.exit_sem);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t mixer_init_sync(void)
+{
+    if (!mixer.streams_lock) {
+        mixer.streams_lock = xSemaphoreCreateMutex();
+    }
+    if (!mixer.wake_sem) {
+        mixer.wake_sem = xSemaphoreCreateBinary();
+    }
+    if (!mixer.exit_sem) {
+        mixer.exit_sem = xSemaphoreCreateBinary();
+    }
+    ESP_RETURN_ON_FALSE(mixer.streams_lock && mixer.wake_sem && mixer.exit_sem, ESP_ERR_NO_MEM, TAG,
+                        "No memory for mixer semaphores");
+
+    return ESP_OK;
+}
+
+static void mixer_free_buffers(void)
+{
+    free(mixer.acc);
+    free(mixer.out);
+    free(mixer.scratch);
+    mixer.acc = NULL;
+    mixer.out = NULL;
+    mixer.scratch = NULL;
+}
+
+static esp_err_t mixer_task_start(void)
+{
+    xSemaphoreTake(mixer.exit_sem, 0);
+    mixer.running = true;
+    BaseType_t res = xTaskCreatePinnedToCore(mixer_task, "Audio Mixer", MIXER_TASK_STACK_SIZE, NULL,
+                                             BSP_EXTRA_MIXER_TASK_PRIORITY, NULL, portNUM_PROCESSORS - 1);
+    if (res != pdPASS) {
+        mixer.running = false;
+        ESP_LOGE(TAG, "Create mixer task failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t mixer_task_stop(void)
+{
+    if (!mixer.running) {
+        return ESP_OK;
+    }
+
+    mixer.running = false;
+    xSemaphoreGive(mixer.wake_sem);
+    ESP_RETURN_ON_FALSE(xSemaphoreTake(mixer.exit_sem, pdMS_TO_TICKS(MIXER_STOP_TIMEOUT_MS)) == pdTRUE,
+                        ESP_ERR_TIMEOUT, TAG, "Mixer task did not stop");
+
+    return ESP_OK;
+}
+
+/* Started, but another session holds the codec: nothing drains the streams until it is given back */
+static bool mixer_is_paused(void)
+{
+    return mixer.session && !mixer.running;
+}
+
+/* Wake the writers waiting for room, so that they see the pause */
+static void mixer_wake_writers(void)
+{
+    xSemaphoreTake(mixer.streams_lock, portMAX_DELAY);
+    for (int i = 0; i < BSP_EXTRA_MIXER_STREAM_NUM; i++) {
+        if (mixer.streams[i]) {
+            xSemaphoreGive(mixer.streams[i]->space_sem);
+        }
+    }
+    xSemaphoreGive(mixer.streams_lock);
+}
+
+/*
+ * Drop what does not fit in the ring while the mixer is paused, at the pace it would have played, so that the writer
+ * neither fails nor races through its source. It counts as played, the clock of the stream keeps time.
+ */
+static void mixer_stream_drop(bsp_extra_mixer_stream_handle_t stream, size_t len)
+{
+    portENTER_CRITICAL(&stream->lock);
+    const uint64_t frames = len / (stream->channels * sizeof(int16_t));
+    const uint64_t us = frames * 1000000 / stream->rate;
+    stream->played_frames += frames;
+    stream->dropped_us += us;
+    portEXIT_CRITICAL(&stream->lock);
+
+    vTaskDelay(MAX(pdMS_TO_TICKS(us / 1000), 1));
+}
+
+/* The streams keep their data while another session holds the codec */
+static void mixer_session_cb(bsp_extra_codec_session_handle_t session, bool granted, void *user_ctx)
+{
+    if (granted) {
+        mixer_task_start();
+    } else {
+        mixer_task_stop();
+        mixer_wake_writers();
+    }
+}
+
+esp_err_t bsp_extra_mixer_start(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (mixer.session) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(mixer_init_sync(), TAG, "Init mixer failed");
+
+    /* Read for every sample, kept in internal RAM */
+    const uint32_t frames = bsp_extra_i2s_get_period_frames() * MIXER_BLOCK_PERIODS;
+    const uint32_t in_frames = frames * BSP_EXTRA_MIXER_RATE_MAX / BSP_EXTRA_MIXER_SAMPLE_RATE + 4;
+    mixer.block_frames = frames;
+    mixer.acc = heap_caps_malloc(frames * MIXER_CHANNELS * sizeof(int32_t), MALLOC_CAP_INTERNAL);
+    mixer.out = heap_caps_malloc(frames * MIXER_CHANNELS * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    mixer.scratch = heap_caps_malloc(in_frames * MIXER_CHANNELS * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    ESP_GOTO_ON_FALSE(mixer.acc && mixer.out && mixer.scratch, ESP_ERR_NO_MEM, err, TAG, "No memory for mixer buffers");
+
+    portENTER_CRITICAL(&mixer.stats_lock);
+    memset(&mixer.stats, 0, sizeof(mixer.stats));
+    portEXIT_CRITICAL(&mixer.stats_lock);
+
+    /* Streams mute themselves with their gain, the session keeps the codec unmuted */
+    const bsp_extra_codec_session_cfg_t session_cfg = {
+        .name = "mixer",
+        .rate = BSP_EXTRA_MIXER_SAMPLE_RATE,
+        .bits_cfg = 16,
+        .ch = I2S_SLOT_MODE_STEREO,
+        .flags = BSP_EXTRA_CODEC_SESSION_PLAYBACK,
+        .priority = BSP_EXTRA_CODEC_PRIORITY_MEDIA,
+        .cb = mixer_session_cb,
+    };
+    ESP_GOTO_ON_ERROR(bsp_extra_codec_session_open(&session_cfg, &mixer.session), err, TAG, "Open session failed");
+    if (bsp_extra_codec_session_is_granted(mixer.session)) {
+        ESP_GOTO_ON_ERROR(mixer_task_start(), err_session, TAG, "Start mixer task failed");
+    }
+
+    return ESP_OK;
+
+err_session:
+    bsp_extra_codec_session_close(mixer.session);
+    mixer.session = NULL;
+err:
+    mixer_free_buffers();
+    return ret;
+}
+
+esp_err_t bsp_extra_mixer_stop(void)
+{
+    if (!mixer.session) {
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_ERROR(mixer_task_stop(), TAG, "Stop mixer task failed");
+    bsp_extra_codec_session_close(mixer.session);
+    mixer.session = NULL;
+    mixer_free_buffers();
+
+    return ESP_OK;
+}
+
+bool bsp_extra_mixer_is_running(void)
+{
+    return mixer.session != NULL;
+}
+
+void bsp_extra_mixer_get_stats(bsp_extra_mixer_stats_t *stats)
+{
+    portENTER_CRITICAL(&mixer.stats_lock);
+    *stats = mixer.stats;
+    portEXIT_CRITICAL(&mixer.stats_lock);
+}
+
+esp_err_t bsp_extra_mixer_stream_new(size_t ring_size, uint32_t caps, bsp_extra_mixer_stream_handle_t *ret_stream)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(ring_size && ret_stream, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_ERROR(mixer_init_sync(), TAG, "Init mixer failed");
+
+    bsp_extra_mixer_stream_handle_t stream = calloc(1, sizeof(struct bsp_extra_mixer_stream_t));
+    ESP_RETURN_ON_FALSE(stream, ESP_ERR_NO_MEM, TAG, "No memory for stream");
+    stream->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    stream->rate = BSP_EXTRA_MIXER_SAMPLE_RATE;
+    stream->channels = MIXER_CHANNELS;
+    stream->step = MIXER_FRAC_ONE;
+    atomic_init(&stream->gain, MIXER_GAIN_ONE);
+    stream->space_sem = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(stream->space_sem, ESP_ERR_NO_MEM, err, TAG, "No memory for stream semaphore");
+    ESP_GOTO_ON_ERROR(bsp_extra_pcm_ring_new(ring_size, caps, &stream->ring), err, TAG, "Create stream ring failed");
+    stream->ring_size = bsp_extra_pcm_ring_get_free(stream->ring);
+    stream->filled_min = stream->ring_size;
+
+    int slot = -1;
+    xSemaphoreTake(mixer.streams_lock, portMAX_DELAY);
+    for (int i = 0; i < BSP_EXTRA_MIXER_STREAM_NUM; i++) {
+        if (!mixer.streams[i]) {
+            mixer.streams[i] = stream;
+            slot = i;
+            break;
+        }
+    }
+    xSemaphoreGive(mixer.streams_lock);
+    ESP_GOTO_ON_FALSE(slot >= 0, ESP_ERR_NOT_FOUND, err, TAG, "All %d streams are in use",
+                      BSP_EXTRA_MIXER_STREAM_NUM);
+
+    *ret_stream = stream;
+
+    return ESP_OK;
+
+err:
+    bsp_extra_pcm_ring_del(stream->ring);
+    if (stream->space_sem) {
+        vSemaphoreDelete(stream->space_sem);
+    }
+    free(stream);
+    return ret;
+}
+
+void bsp_extra_mixer_stream_del(bsp_extra_mixer_stream_handle_t stream)
+{
+    if (!stream) {
+        return;
+    }
+
+    /* The mixer is done with the stream once it gives the lock back */
+    xSemaphoreTake(mixer.streams_lock, portMAX_DELAY);
+    for (int i = 0; i < BSP_EXTRA_MIXER_STREAM_NUM; i++) {
+        if (mixer.streams[i] == stream) {
+            mixer.streams[i] = NULL;
+        }
+    }
+    xSemaphoreGive(mixer.streams_lock);
+
+    bsp_extra_pcm_ring_del(stream->ring);
+    vSemaphoreDelete(stream->space_sem);
+    free(stream);
+}
+
+esp_err_t bsp_extra_mixer_stream_set_format(bsp_extra_mixer_stream_handle_t stream, uint32_t rate, uint32_t bits,
+                                            uint32_t channels)
+{
+    ESP_RETURN_ON_FALSE(stream, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE((bits == 16) && ((channels == 1) || (channels == 2)) && rate &&
+                        (rate <= BSP_EXTRA_MIXER_RATE_MAX), ESP_ERR_NOT_SUPPORTED, TAG,
+                        "Unsupported format %" PRIu32 " Hz, %" PRIu32 " bits, %" PRIu32 " channels", rate, bits,
+                        channels);
+
+    if ((rate == stream->rate) && (channels == stream->channels)) {
+        return ESP_OK;
+    }
+
+    /* Let the mixer play the data written at the old format, the ring only holds whole frames of it */
+    const size_t frame_bytes = stream->channels * sizeof(int16_t);
+    while (mixer.running && (bsp_extra_pcm_ring_get_filled(stream->ring) >= frame_bytes)) {
+        if (xSemaphoreTake(stream->space_sem, pdMS_TO_TICKS(MIXER_DRAIN_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "Stream did not drain, the rest plays at the new format");
+            break;
+        }
+    }
+
+    portENTER_CRITICAL(&stream->lock);
+    stream->played_base_us += stream->played_frames * 1000000 / stream->rate;
+    stream->played_frames = 0;
+    stream->rate = rate;
+    stream->channels = channels;
+    stream->step = (uint32_t)(((uint64_t)rate << MIXER_FRAC_BITS) / BSP_EXTRA_MIXER_SAMPLE_RATE);
+    stream->step_rem = (uint32_t)(((uint64_t)rate << MIXER_FRAC_BITS) % BSP_EXTRA_MIXER_SAMPLE_RATE);
+    stream->format_changed = true;
+    portEXIT_CRITICAL(&stream->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t bsp_extra_mixer_stream_write(bsp_extra_mixer_stream_handle_t stream, const void *data, size_t len,
+                                       size_t *bytes_written, uint32_t timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
+    const TickType_t wait = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    size_t done = 0;
+
+    ESP_RETURN_ON_FALSE(stream && (data || !len), ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    /* The time spent outside of the writes is how long the writer took to bring the next data */
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stream->lock);
+    if (stream->write_end_us) {
+        stream->refill_us_max = MAX(stream->refill_us_max, (uint32_t)MIN(now - stream->write_end_us, UINT32_MAX));
+    }
+    portEXIT_CRITICAL(&stream->lock);
+
+    while (done < len) {
+        done += bsp_extra_pcm_ring_write(stream->ring, (const uint8_t *)data + done, len - done);
+        xSemaphoreGive(mixer.wake_sem);
+        if (done == len) {
+            break;
+        }
+        if (mixer_is_paused()) {
+            mixer_stream_drop(stream, len - done);
+            done = len;
+            break;
+        }
+        /* Also given when the mixer pauses */
+        if ((xSemaphoreTake(stream->space_sem, wait) != pdTRUE) && !mixer_is_paused()) {
+            ret = ESP_ERR_TIMEOUT;
+            break;
+        }
+    }
+    if (bytes_written) {
+        *bytes_written = done;
+    }
+
+    now = esp_timer_get_time();
+    portENTER_CRITICAL(&stream->lock);
+    stream->write_end_us = now;
+    portEXIT_CRITICAL(&stream->lock);
+
+    return ret;
+}
+
+void bsp_extra_mixer_stream_set_gain(bsp_extra_mixer_stream_handle_t stream, float gain)
+{
+    gain = (gain < 0.0f) ? 0.0f : ((gain > 2.0f) ? 2.0f : gain);
+    atomic_store_explicit(&stream->gain, (int)(gain * MIXER_GAIN_ONE), memory_order_relaxed);
+}
+
+int64_t bsp_extra_mixer_stream_get_played_us(bsp_extra_mixer_stream_handle_t stream)
+{
+    portENTER_CRITICAL(&stream->lock);
+    uint64_t played_us = stream->played_base_us + stream->played_frames * 1000000 / stream->rate;
+    portEXIT_CRITICAL(&stream->lock);
+
+    return (int64_t)played_us;
+}
+
+void bsp_extra_mixer_stream_reset_played(bsp_extra_mixer_stream_handle_t stream)
+{
+    portENTER_CRITICAL(&stream->lock);
+    stream->played_base_us = 0;
+    stream->played_frames = 0;
+    portEXIT_CRITICAL(&stream->lock);
+}
+
+void bsp_extra_mixer_stream_mark_idle(bsp_extra_mixer_stream_handle_t stream)
+{
+    portENTER_CRITICAL(&stream->lock);
+    stream->write_end_us = 0;
+    portEXIT_CRITICAL(&stream->lock);
+}
+
+void bsp_extra_mixer_stream_get_stats(bsp_extra_mixer_stream_handle_t stream, bsp_extra_mixer_stream_stats_t *stats)
+{
+    portENTER_CRITICAL(&stream->lock);
+    stats->size = stream->ring_size;
+    stats->filled = bsp_extra_pcm_ring_get_filled(stream->ring);
+    stats->filled_min = stream->filled_min;
+    stats->underruns = stream->underruns;
+    stats->refill_us_max = stream->refill_us_max;
+    stats->dropped_ms = (uint32_t)MIN(stream->dropped_us / 1000, UINT32_MAX);
+    portEXIT_CRITICAL(&stream->lock);
+}
+
+void bsp_extra_mixer_stream_reset_stats(bsp_extra_mixer_stream_handle_t stream)
+{
+    portENTER_CRITICAL(&stream->lock);
+    stream->filled_min = stream->ring_size;
+    stream->underruns = 0;
+    stream->refill_us_max = 0;
+    stream->dropped_us = 0;
+    stream->write_end_us = 0;
+    portEXIT_CRITICAL(&stream->lock);
+}
@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "bsp_extra_pcm_ring.h"
+
+static const char *TAG = "bsp_extra_pcm_ring";
+
+struct bsp_extra_pcm_ring_t {
+    uint8_t *buf;
+    size_t mask;                        /* Capacity - 1, the capacity is a power of two */
+    /* Free running positions, only the producer moves `head` and only the consumer moves `tail` */
+    atomic_size_t head;
+    atomic_size_t tail;
+};
+
+esp_err_t bsp_extra_pcm_ring_new(size_t size, uint32_t caps, bsp_extra_pcm_ring_handle_t *ret_ring)
+{
+    ESP_RETURN_ON_FALSE(size && (size <= (SIZE_MAX / 2 + 1)) && ret_ring, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    size_t capacity = 1;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+
+    bsp_extra_pcm_ring_handle_t ring = calloc(1, sizeof(struct bsp_extra_pcm_ring_t));
+    ESP_RETURN_ON_FALSE(ring, ESP_ERR_NO_MEM, TAG, "No memory for ring");
+    ring->buf = heap_caps_malloc(capacity, caps);
+    if (!ring->buf) {
+        free(ring);
+        ESP_LOGE(TAG, "No memory for %zu bytes ring", capacity);
+        return ESP_ERR_NO_MEM;
+    }
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    *ret_ring = ring;
+
+    return ESP_OK;
+}
+
+void bsp_extra_pcm_ring_del(bsp_extra_pcm_ring_handle_t ring)
+{
+    if (ring) {
+        free(ring->buf);
+        free(ring);
+    }
+}
+
+size_t bsp_extra_pcm_ring_write(bsp_extra_pcm_ring_handle_t ring, const void *data, size_t len)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    /* Acquire: the consumer is done with the bytes it released */
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    len = MIN(len, ring->mask + 1 - (head - tail));
+    size_t pos = head & ring->mask;
+    size_t first = MIN(len, ring->mask + 1 - pos);
+    memcpy(ring->buf + pos, data, first);
+    memcpy(ring->buf, (const uint8_t *)data + first, len - first);
+
+    /* Release: the bytes are in place before the consumer sees them */
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+
+    return len;
+}
+
+size_t bsp_extra_pcm_ring_read(bsp_extra_pcm_ring_handle_t ring, void *data, size_t len)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    len = MIN(len, head - tail);
+    size_t pos = tail & ring->mask;
+    size_t first = MIN(len, ring->mask + 1 - pos);
+    memcpy(data, ring->buf + pos, first);
+    memcpy((uint8_t *)data + first, ring->buf, len - first);
+
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+
+    return len;
+}
+
+size_t bsp_extra_pcm_ring_get_filled(bsp_extra_pcm_ring_handle_t ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    return head - tail;
+}
+
+size_t bsp_extra_pcm_ring_get_free(bsp_extra_pcm_ring_handle_t ring)
+{
+    return ring->mask + 1 - bsp_extra_pcm_ring_get_filled(ring);
+}
+
+void bsp_extra_pcm_ring_reset(bsp_extra_pcm_ring_handle_t ring)
+{
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+}
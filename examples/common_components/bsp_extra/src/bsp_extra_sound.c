@@ -0,0 +1,171 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "mp3dec.h"
+#include "bsp_extra_mixer.h"
+#include "bsp_extra_sound.h"
+
+#define SOUND_PATH_MAX              (128)
+#define SOUND_STREAM_RING_SIZE      (16 * 1024)         /* About 90 ms at 44.1 kHz stereo */
+#define SOUND_IN_SIZE               (MAINBUF_SIZE * 2)
+#define SOUND_OUT_SAMPLES           (MAX_NSAMP * MAX_NGRAN * MAX_NCHAN)
+#define SOUND_TASK_STACK_SIZE       (4 * 1024)
+#define SOUND_TASK_PRIORITY         (CONFIG_BSP_EXTRA_PLAYER_TASK_PRIORITY)
+
+static const char *TAG = "bsp_extra_sound";
+
+typedef struct {
+    bsp_extra_mixer_stream_handle_t stream;
+    QueueHandle_t queue;                    /* The next path, a newer one overwrites it */
+    HMP3Decoder decoder;
+    uint8_t *in;
+    int16_t *out;
+} sound_t;
+
+static sound_t sound;
+
+/* Decode a file into the stream, until its end or until another sound is queued */
+static void sound_play(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        ESP_LOGW(TAG, "Unable to open %s", path);
+        return;
+    }
+
+    uint8_t *p = sound.in;
+    int left = 0;
+    bool eof = false;
+    while (!uxQueueMessagesWaiting(sound.queue)) {
+        if (!eof && (left < MAINBUF_SIZE)) {
+            memmove(sound.in, p, left);
+            p = sound.in;
+            size_t len = fread(sound.in + left, 1, SOUND_IN_SIZE - left, fp);
+            left += len;
+            eof = (len == 0);
+        }
+        int offset = MP3FindSyncWord(p, left);
+        if (offset < 0) {
+            if (eof) {
+                break;
+            }
+            /* No frame in what is buffered, e.g. a cover picture in a tag */
+            left = 0;
+            continue;
+        }
+        p += offset;
+        left -= offset;
+
+        int err = MP3Decode(sound.decoder, &p, &left, sound.out, 0);
+        if (err == ERR_MP3_INDATA_UNDERFLOW) {
+            if (eof) {
+                break;
+            }
+            continue;
+        }
+        if (err == ERR_MP3_MAINDATA_UNDERFLOW) {
+            /* The frame needs data from frames before it, e.g. at the start of the file */
+            continue;
+        }
+        if (err != ERR_MP3_NONE) {
+            /* A false sync word, e.g. in a tag: look for the next one */
+            p++;
+            left--;
+            continue;
+        }
+
+        MP3FrameInfo info;
+        MP3GetLastFrameInfo(sound.decoder, &info);
+        if (bsp_extra_mixer_stream_set_format(sound.stream, info.samprate, info.bitsPerSample, info.nChans) != ESP_OK) {
+            break;
+        }
+        bsp_extra_mixer_stream_write(sound.stream, sound.out, info.outputSamps * sizeof(int16_t), NULL,
+                                     portMAX_DELAY);
+    }
+    bsp_extra_mixer_stream_mark_idle(sound.stream);
+
+    fclose(fp);
+}
+
+static void sound_task(void *arg)
+{
+    char path[SOUND_PATH_MAX];
+
+    while (1) {
+        if (xQueueReceive(sound.queue, path, portMAX_DELAY) == pdTRUE) {
+            sound_play(path);
+        }
+    }
+}
+
+esp_err_t bsp_extra_sound_init(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (sound.queue) {
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_ERROR(bsp_extra_mixer_stream_new(SOUND_STREAM_RING_SIZE, MALLOC_CAP_SPIRAM, &sound.stream), TAG,
+                        "Create sound stream failed");
+    sound.decoder = MP3InitDecoder();
+    sound.in = malloc(SOUND_IN_SIZE);
+    sound.out = malloc(SOUND_OUT_SAMPLES * sizeof(int16_t));
+    sound.queue = xQueueCreate(1, SOUND_PATH_MAX);
+    ESP_GOTO_ON_FALSE(sound.decoder && sound.in && sound.out && sound.queue, ESP_ERR_NO_MEM, err, TAG,
+                      "No memory for sounds");
+    ESP_GOTO_ON_FALSE(xTaskCreate(sound_task, "UI Sound", SOUND_TASK_STACK_SIZE, NULL, SOUND_TASK_PRIORITY,
+                                  NULL) == pdPASS, ESP_ERR_NO_MEM, err, TAG, "Create sound task failed");
+
+    return ESP_OK;
+
+err:
+    if (sound.queue) {
+        vQueueDelete(sound.queue);
+        sound.queue = NULL;
+    }
+    if (sound.decoder) {
+        MP3FreeDecoder(sound.decoder);
+        sound.decoder = NULL;
+    }
+    free(sound.in);
+    free(sound.out);
+    sound.in = NULL;
+    sound.out = NULL;
+    bsp_extra_mixer_stream_del(sound.stream);
+    sound.stream = NULL;
+    return ret;
+}
+
+esp_err_t bsp_extra_sound_play_file(const char *path)
+{
+    char buf[SOUND_PATH_MAX];
+
+    ESP_RETURN_ON_FALSE(path && (strlen(path) < sizeof(buf)), ESP_ERR_INVALID_ARG, TAG, "Invalid path");
+    ESP_RETURN_ON_FALSE(sound.queue, ESP_ERR_INVALID_STATE, TAG, "Sounds not initialized");
+    ESP_RETURN_ON_ERROR(bsp_extra_mixer_start(), TAG, "Start mixer failed");
+
+    strcpy(buf, path);
+    xQueueOverwrite(sound.queue, buf);
+
+    return ESP_OK;
+}
+
+void bsp_extra_sound_set_gain(float gain)
+{
+    if (sound.stream) {
+        bsp_extra_mixer_stream_set_gain(sound.stream, gain);
+    }
+}
@@ -0,0 +1,378 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "bsp_board_extra.h"
+#include "bsp_extra_mixer.h"
+
+#define TEST_RING_SIZE          (16384)
+#define TEST_SINE_AMPLITUDE     (16000)
+#define TEST_SINE_FREQ          (1000.0)
+#define TEST_FIT_SKIP           (100)       /* Output frames left out at both ends of the fit */
+
+/* First output frame that is not silence, where the stream starts */
+static size_t test_first_sound(void)
+{
+    size_t frames;
+    const int16_t *out = test_sink_get(&frames);
+
+    for (size_t i = 0; i < frames * 2; i++) {
+        if (out[i]) {
+            return i / 2;
+        }
+    }
+    return frames;
+}
+
+/* Write the same block to both streams while the mixer is stopped, so the first output block mixes both */
+static void test_play_together(bsp_extra_mixer_stream_handle_t a, bsp_extra_mixer_stream_handle_t b,
+                               const int16_t *pcm_a, const int16_t *pcm_b, size_t len)
+{
+    size_t written;
+
+    TEST_ESP_OK(bsp_extra_mixer_stop());
+    test_sink_reset();
+    TEST_ESP_OK(bsp_extra_mixer_stream_write(a, pcm_a, len, &written, 0));
+    TEST_ESP_OK(bsp_extra_mixer_stream_write(b, pcm_b, len, &written, 0));
+    TEST_ESP_OK(bsp_extra_mixer_start());
+    test_sink_wait_idle();
+}
+
+/* RMS error of the left channel against an ideal sine, over the best sub-frame alignment */
+static double test_sine_error(size_t start, size_t frames)
+{
+    size_t sink_frames;
+    const int16_t *out = test_sink_get(&sink_frames);
+    double best = INFINITY;
+
+    for (double offset = -3; offset <= 3; offset += 0.01) {
+        double sum = 0;
+        for (size_t i = TEST_FIT_SKIP; i < frames - TEST_FIT_SKIP; i++) {
+            double ideal = TEST_SINE_AMPLITUDE * sin(2 * M_PI * TEST_SINE_FREQ * (i + offset) /
+                                                     BSP_EXTRA_MIXER_SAMPLE_RATE);
+            double diff = out[2 * (start + i)] - ideal;
+            sum += diff * diff;
+        }
+        best = fmin(best, sqrt(sum / (frames - 2 * TEST_FIT_SKIP)));
+    }
+
+    return best;
+}
+
+TEST_CASE("mixer passes a stream at the mixer rate through unchanged", "[mixer]")
+{
+    const int frames = 20000;
+    int16_t *pcm = malloc(frames * 2 * sizeof(int16_t));
+    bsp_extra_mixer_stream_handle_t stream = NULL;
+    size_t written;
+    size_t sink_frames;
+
+    TEST_ASSERT_NOT_NULL(pcm);
+    TEST_ESP_OK(bsp_extra_mixer_stream_new(TEST_RING_SIZE, 0, &stream));
+    TEST_ESP_OK(bsp_extra_mixer_start());
+
+    /* Stereo: every sample distinct, so a dropped or repeated frame shows. The last frame of a write stays in the
+     * resampler until more data comes, so it is left out. */
+    for (int i = 0; i < frames; i++) {
+        pcm[2 * i] = i + 1;
+        pcm[2 * i + 1] = -(i + 1);
+    }
+    test_sink_reset();
+    TEST_ESP_OK(bsp_extra_mixer_stream_write(stream, pcm, frames * 2 * sizeof(int16_t), &written, 1000));
+    test_sink_wait_idle();
+    size_t start = test_first_sound();
+    const int16_t *out = test_sink_get(&sink_frames);
+    TEST_ASSERT_GREATER_OR_EQUAL(start + frames - 1, sink_frames);
+    for (int i = 0; i < frames - 1; i++) {
+        TEST_ASSERT_EQUAL_INT16(i + 1, out[2 * (start + i)]);
+        TEST_ASSERT_EQUAL_INT16(-(i + 1), out[2 * (start + i) + 1]);
+    }
+
+    /* Mono: each sample goes to both channels */
+    TEST_ESP_OK(bsp_extra_mixer_stream_set_format(stream, BSP_EXTRA_MIXER_SAMPLE_RATE, 16, I2S_SLOT_MODE_MONO));
+    for (int i = 0; i < frames; i++) {
+        pcm[i] = 1000 + i % 20000;
+    }
+    test_sink_reset();
+    TEST_ESP_OK(bsp_extra_mixer_stream_write(stream, pcm, frames * sizeof(int16_t), &written, 1000));
+    test_sink_wait_idle();
+    start = test_first_sound();
+    out = test_sink_get(&sink_frames);
+    TEST_ASSERT_GREATER_OR_EQUAL(start + frames - 1, sink_frames);
+    for (int i = 0; i < frames - 1; i++) {
+        TEST_ASSERT_EQUAL_INT16(pcm[i], out[2 * (start + i)]);
+        TEST_ASSERT_EQUAL_INT16(pcm[i], out[2 * (start + i) + 1]);
+    }
+
+    bsp_extra_mixer_stream_del(stream);
+    TEST_ESP_OK(bsp_extra_mixer_stop());
+    free(pcm);
+}
+
+TEST_CASE("mixer resamples a sine within the interpolation error", "[mixer]")
+{
+    const uint32_t rates[] = {8000, 16000, 22050, 32000, 48000, 88200};
+    int16_t *pcm = malloc(BSP_EXTRA_MIXER_RATE_MAX / 2 * sizeof(int16_t));
+    bsp_extra_mixer_stream_handle_t stream = NULL;
+    size_t written;
+
+    TEST_ASSERT_NOT_NULL(pcm);
+    TEST_ESP_OK(bsp_extra_mixer_stream_new(TEST_RING_SIZE, 0, &stream));
+    TEST_ESP_OK(bsp_extra_mixer_start());
+
+    for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        const uint32_t rate = rates[r];
+        const size_t frames = rate / 2;
+        for (size_t i = 0; i < frames; i++) {
+            pcm[i] = (int16_t)lrint(TEST_SINE_AMPLITUDE * sin(2 * M_PI * TEST_SINE_FREQ * i / rate));
+        }
+        TEST_ESP_OK(bsp_extra_mixer_stream_set_format(stream, rate, 16, I2S_SLOT_MODE_MONO));
+        test_sink_reset();
+        TEST_ESP_OK(bsp_extra_mixer_stream_write(stream, pcm, frames * sizeof(int16_t), &written, 1000));
+        test_sink_wait_idle();
+
+        size_t sink_frames;
+        test_sink_get(&sink_frames);
+        const size_t start = test_first_sound();
+        const double expected = (double)frames * BSP_EXTRA_MIXER_SAMPLE_RATE / rate;
+        TEST_ASSERT_DOUBLE_WITHIN(expected * 0.01 + 600, expected, (double)(sink_frames - start));
+
+        /* Linear interpolation error of a sine, relative to its RMS: (pi * f / rate)^2 / 2, plus rounding. At twice
+         * the mixer rate every output frame falls on an input frame. */
+        const double rms = TEST_SINE_AMPLITUDE / M_SQRT2;
+        const double limit = (rate == 2 * BSP_EXTRA_MIXER_SAMPLE_RATE) ? 2 :
+                             1.3 * pow(M_PI * TEST_SINE_FREQ / rate, 2) / 2 * rms + 2;
+        const double error = test_sine_error(start, (size_t)expected);
+        printf("%6" PRIu32 " Hz: RMS error %.2f LSB, limit %.2f, %.1f dB below the signal\n",
+               rate, error, limit, 20 * log10(rms / error));
+        TEST_ASSERT_TRUE(error < limit);
+    }
+
+    bsp_extra_mixer_stream_del(stream);
+    TEST_ESP_OK(bsp_extra_mixer_stop());
+    free(pcm);
+}
+
+TEST_CASE("mixer sums streams with their gain and saturates", "[mixer]")
+{
+    const int frames = TEST_RING_SIZE / 4;
+    const size_t len = frames * 2 * sizeof(int16_t);
+    int16_t *pcm_a = malloc(len);
+    int16_t *pcm_b = malloc(len);
+    bsp_extra_mixer_stream_handle_t a = NULL;
+    bsp_extra_mixer_stream_handle_t b = NULL;
+    size_t sink_frames;
+
+    TEST_ASSERT_NOT_NULL(pcm_a);
+    TEST_ASSERT_NOT_NULL(pcm_b);
+    for (int i = 0; i < frames; i++) {
+        pcm_a[2 * i] = 10000;
+        pcm_a[2 * i + 1] = -20000;
+        pcm_b[2 * i] = 30000;
+        pcm_b[2 * i + 1] = -30000;
+    }
+    TEST_ESP_OK(bsp_extra_mixer_stream_new(TEST_RING_SIZE, 0, &a));
+    TEST_ESP_OK(bsp_extra_mixer_stream_new(TEST_RING_SIZE, 0, &b));
+
+    /* Left: 10000 + 30000 / 2, right: -20000 - 30000 / 2 clips */
+    bsp_extra_mixer_stream_set_gain(b, 0.5f);
+    test_play_together(a, b, pcm_a, pcm_b, len);
+    size_t start = test_first_sound();
+    const int16_t *out = test_sink_get(&sink_frames);
+    TEST_ASSERT_EQUAL_INT16(25000, out[2 * (start + 100)]);
+    TEST_ASSERT_EQUAL_INT16(INT16_MIN, out[2 * (start + 100) + 1]);
+
+    bsp_extra_mixer_stream_set_gain(b, 2.0f);
+    test_play_together(a, b, pcm_a, pcm_b, len);
+    start = test_first_sound();
+    TEST_ASSERT_EQUAL_INT16(INT16_MAX, out[2 * (start + 100)]);
+    TEST_ASSERT_EQUAL_INT16(INT16_MIN, out[2 * (start + 100) + 1]);
+
+    bsp_extra_mixer_stream_set_gain(b, 0.0f);
+    test_play_together(a, b, pcm_a, pcm_b, len);
+    start = test_first_sound();
+    TEST_ASSERT_EQUAL_INT16(10000, out[2 * (start + 100)]);
+    TEST_ASSERT_EQUAL_INT16(-20000, out[2 * (start + 100) + 1]);
+
+    bsp_extra_mixer_stream_del(a);
+    bsp_extra_mixer_stream_del(b);
+    TEST_ESP_OK(bsp_extra_mixer_stop());
+    free(pcm_a);
+    free(pcm_b);
+}
+
+TEST_CASE("mixer write times out on a full ring and streams are limited", "[mixer]")
+{
+    bsp_extra_mixer_stream_handle_t streams[BSP_EXTRA_MIXER_STREAM_NUM + 1] = {NULL};
+    const size_t len = TEST_RING_SIZE * 2;
+    void *pcm = calloc(1, len);
+    size_t written = 0;
+
+    TEST_ASSERT_NOT_NULL(pcm);
+    TEST_ESP_OK(bsp_extra_mixer_stream_new(TEST_RING_SIZE, 0, &streams[0]));
+    TEST_ESP_OK(bsp_extra_mixer_stop());
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, bsp_extra_mixer_stream_write(streams[0], pcm, len, &written, 50));
+    TEST_ASSERT_EQUAL(TEST_RING_SIZE, written);
+
+    for (int i = 1; i < BSP_EXTRA_MIXER_STREAM_NUM; i++) {
+        TEST_ESP_OK(bsp_extra_mixer_stream_new(1024, 0, &streams[i]));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, bsp_extra_mixer_stream_new(1024, 0, &streams[BSP_EXTRA_MIXER_STREAM_NUM]));
+
+    for (int i = 0; i < BSP_EXTRA_MIXER_STREAM_NUM; i++) {
+        bsp_extra_mixer_stream_del(streams[i]);
+    }
+    free(pcm);
+}
+
+TEST_CASE("mixer stream counts underruns and refill time", "[mixer]")
+{
+    int16_t *pcm = malloc(TEST_RING_SIZE);
+    bsp_extra_mixer_stream_handle_t stream = NULL;
+    bsp_extra_mixer_stream_stats_t stats;
+    size_t written;
+
+    TEST_ASSERT_NOT_NULL(pcm);
+    for (int i = 0; i < TEST_RING_SIZE / sizeof(int16_t); i++) {
+        pcm[i] = 1000;
+    }
+    TEST_ESP_OK(bsp_extra_mixer_stream_new(TEST_RING_SIZE, 0, &stream));
+    TEST_ESP_OK(bsp_extra_mixer_start());
+
+    /* A writer that stalls for 50 ms: the sink drains the ring long before */
+    TEST_ESP_OK(bsp_extra_mixer_stream_write(stream, pcm, TEST_RING_SIZE, &written, 1000));
+    for (int i = 0; i < 5; i++) {
+        usleep(1000);
+        TEST_ESP_OK(bsp_extra_mixer_stream_write(stream, pcm, TEST_RING_SIZE / 2, &written, 1000));
+    }
+    usleep(50000);
+    TEST_ESP_OK(bsp_extra_mixer_stream_write(stream, pcm, TEST_RING_SIZE, &written, 1000));
+    test_sink_wait_idle();
+    bsp_extra_mixer_stream_get_stats(stream, &stats);
+    TEST_ASSERT_EQUAL(TEST_RING_SIZE, stats.size);
+    TEST_ASSERT_EQUAL(0, stats.filled_min);
+    TEST_ASSERT_GREATER_OR_EQUAL(1, stats.underruns);
+    TEST_ASSERT_INT_WITHIN(30000, 65000, stats.refill_us_max);
+
+    /* The same gap after mark_idle is a pause, not a stall */
+    bsp_extra_mixer_stream_reset_stats(stream);
+    TEST_ESP_OK(bsp_extra_mixer_stream_write(stream, pcm, TEST_RING_SIZE, &written, 1000));
+    bsp_extra_mixer_stream_mark_idle(stream);
+    usleep(100000);
+    TEST_ESP_OK(bsp_extra_mixer_stream_write(stream, pcm, TEST_RING_SIZE, &written, 1000));
+    bsp_extra_mixer_stream_mark_idle(stream);
+    test_sink_wait_idle();
+    bsp_extra_mixer_stream_get_stats(stream, &stats);
+    TEST_ASSERT_EQUAL(0, stats.underruns);
+    TEST_ASSERT_EQUAL(0, stats.refill_us_max);
+    TEST_ASSERT_EQUAL(TEST_RING_SIZE, stats.filled_min);
+
+    bsp_extra_mixer_stream_del(stream);
+    TEST_ESP_OK(bsp_extra_mixer_stop());
+    free(pcm);
+}
+
+TEST_CASE("mixer drops writes at their pace while paused for another session", "[mixer]")
+{
+    const size_t drop_len = BSP_EXTRA_MIXER_SAMPLE_RATE / 5 * 2 * sizeof(int16_t);     /* 200 ms of stereo */
+    const size_t len = TEST_RING_SIZE + drop_len;
+    int16_t *pcm = malloc(len);
+    bsp_extra_mixer_stream_handle_t stream = NULL;
+    bsp_extra_mixer_stream_stats_t stats;
+    size_t written = 0;
+    size_t sink_frames;
+
+    TEST_ASSERT_NOT_NULL(pcm);
+    for (size_t i = 0; i < len / sizeof(int16_t); i++) {
+        pcm[i] = 1000;
+    }
+    TEST_ESP_OK(bsp_extra_mixer_stream_new(TEST_RING_SIZE, 0, &stream));
+    TEST_ESP_OK(bsp_extra_mixer_start());
+
+    /* The ring keeps what fits, the rest takes as long as it would have played and is counted, well past the timeout */
+    test_codec_session_set_granted(false);
+    test_sink_reset();
+    int64_t start_us = esp_timer_get_time();
+    TEST_ESP_OK(bsp_extra_mixer_stream_write(stream, pcm, len, &written, 50));
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    TEST_ASSERT_EQUAL(len, written);
+    TEST_ASSERT_INT_WITHIN(50000, 200000, elapsed_us);
+    bsp_extra_mixer_stream_get_stats(stream, &stats);
+    TEST_ASSERT_EQUAL(TEST_RING_SIZE, stats.filled);
+    TEST_ASSERT_INT_WITHIN(1, 200, stats.dropped_ms);
+    TEST_ASSERT_INT_WITHIN(1000, 200000, bsp_extra_mixer_stream_get_played_us(stream));
+    test_sink_get(&sink_frames);
+    TEST_ASSERT_EQUAL(0, sink_frames);
+
+    /* Given back, the mixer plays the data kept in the ring */
+    test_codec_session_set_granted(true);
+    test_sink_wait_idle();
+    test_sink_get(&sink_frames);
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_RING_SIZE / (2 * sizeof(int16_t)) - 1, sink_frames);
+    bsp_extra_mixer_stream_get_stats(stream, &stats);
+    TEST_ASSERT_INT_WITHIN(1, 200, stats.dropped_ms);
+
+    bsp_extra_mixer_stream_del(stream);
+    TEST_ESP_OK(bsp_extra_mixer_stop());
+    free(pcm);
+}
+
+TEST_CASE("mixer cycles per output frame", "[mixer][performance]")
+{
+    const struct {
+        const char *name;
+        uint32_t rate;
+        i2s_slot_mode_t ch;
+    } cases[] = {
+        {"stereo 44.1 kHz", BSP_EXTRA_MIXER_SAMPLE_RATE, I2S_SLOT_MODE_STEREO},
+        {"mono 44.1 kHz", BSP_EXTRA_MIXER_SAMPLE_RATE, I2S_SLOT_MODE_MONO},
+        {"stereo 48 kHz", 48000, I2S_SLOT_MODE_STEREO},
+        {"mono 16 kHz", 16000, I2S_SLOT_MODE_MONO},
+    };
+    const size_t ring_size = 256 * 1024;
+    int16_t *pcm = malloc(ring_size);
+    bsp_extra_mixer_stream_handle_t stream = NULL;
+    bsp_extra_mixer_stats_t stats;
+    size_t written;
+
+    TEST_ASSERT_NOT_NULL(pcm);
+    for (size_t i = 0; i < ring_size / sizeof(int16_t); i++) {
+        pcm[i] = (int16_t)(i * 7);
+    }
+    TEST_ESP_OK(bsp_extra_mixer_stream_new(ring_size, 0, &stream));
+
+    /* The mixer counters restart on start, so each case only counts its own blocks */
+    for (int c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        TEST_ESP_OK(bsp_extra_mixer_stop());
+        TEST_ESP_OK(bsp_extra_mixer_stream_set_format(stream, cases[c].rate, 16, cases[c].ch));
+        TEST_ESP_OK(bsp_extra_mixer_stream_write(stream, pcm, ring_size, &written, 0));
+        test_sink_reset();
+        TEST_ESP_OK(bsp_extra_mixer_start());
+        test_sink_wait_idle();
+        bsp_extra_mixer_get_stats(&stats);
+        TEST_ASSERT_GREATER_THAN(0, stats.frames);
+        printf("%-16s %.2f cycles per frame, %" PRIu32 " at most per %" PRIu64 "-frame block\n", cases[c].name,
+               (double)stats.mix_cycles / stats.frames, stats.mix_cycles_max, stats.frames / stats.blocks);
+    }
+
+    bsp_extra_mixer_stream_del(stream);
+    TEST_ESP_OK(bsp_extra_mixer_stop());
+    free(pcm);
+}
+
+void app_main(void)
+{
+    printf("bsp_extra mixer host test, cycles are nanoseconds on the linux target\n");
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    UNITY_END();
+}
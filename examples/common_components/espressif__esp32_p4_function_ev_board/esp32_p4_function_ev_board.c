@@ -48,6 +48,8 @@ static i2c_master_bus_handle_t i2c_handle = NULL;  // I2C Handle
 #endif
 static i2s_chan_handle_t i2s_tx_chan = NULL;
 static i2s_chan_handle_t i2s_rx_chan = NULL;
+static bool i2s_tx_enabled = false;  /* Enabled by the BSP, the codec data interface owns the state once opened */
+static bool i2s_rx_enabled = false;
 static const audio_codec_data_if_t *i2s_data_if = NULL;  /* Codec data interface */
 
 /* Can be used for `i2s_std_gpio_config_t` and/or `i2s_std_config_t` initialization */
@@ -191,6 +193,8 @@ esp_err_t bsp_audio_init(const i2s_std_config_t *i2s_config)
     /* Setup I2S peripheral */
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(CONFIG_BSP_I2S_NUM, I2S_ROLE_MASTER);
     chan_cfg.auto_clear = true; // Auto clear the legacy data in the DMA buffer
+    chan_cfg.dma_desc_num = CONFIG_BSP_I2S_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = CONFIG_BSP_I2S_DMA_FRAME_NUM;
     ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, &i2s_tx_chan, &i2s_rx_chan));
 
     /* Setup I2S channels */
@@ -203,11 +207,13 @@ esp_err_t bsp_audio_init(const i2s_std_config_t *i2s_config)
     if (i2s_tx_chan != NULL) {
         ESP_ERROR_CHECK(i2s_channel_init_std_mode(i2s_tx_chan, p_i2s_cfg));
         ESP_ERROR_CHECK(i2s_channel_enable(i2s_tx_chan));
+        i2s_tx_enabled = true;
     }
 
     if (i2s_rx_chan != NULL) {
         ESP_ERROR_CHECK(i2s_channel_init_std_mode(i2s_rx_chan, p_i2s_cfg));
         ESP_ERROR_CHECK(i2s_channel_enable(i2s_rx_chan));
+        i2s_rx_enabled = true;
     }
 
     audio_codec_i2s_cfg_t i2s_cfg = {
@@ -220,6 +226,38 @@ esp_err_t bsp_audio_init(const i2s_std_config_t *i2s_config)
     return ESP_OK;
 }
 
+static esp_err_t bsp_i2s_register_callbacks(i2s_chan_handle_t chan, bool enabled, const i2s_event_callbacks_t *cbs,
+                                            void *user_data)
+{
+    /* Callbacks are only accepted on a stopped channel */
+    if (enabled) {
+        ESP_RETURN_ON_ERROR(i2s_channel_disable(chan), TAG, "Disable I2S channel failed");
+    }
+    esp_err_t ret = i2s_channel_register_event_callback(chan, cbs, user_data);
+    if (enabled) {
+        ret |= i2s_channel_enable(chan);
+    }
+
+    return ret;
+}
+
+esp_err_t bsp_audio_register_i2s_callbacks(const i2s_event_callbacks_t *tx_cbs, const i2s_event_callbacks_t *rx_cbs,
+                                           void *user_data)
+{
+    ESP_RETURN_ON_FALSE(i2s_tx_chan && i2s_rx_chan, ESP_ERR_INVALID_STATE, TAG, "Audio not initialized");
+
+    if (tx_cbs) {
+        ESP_RETURN_ON_ERROR(bsp_i2s_register_callbacks(i2s_tx_chan, i2s_tx_enabled, tx_cbs, user_data), TAG,
+                            "Register I2S TX callbacks failed");
+    }
+    if (rx_cbs) {
+        ESP_RETURN_ON_ERROR(bsp_i2s_register_callbacks(i2s_rx_chan, i2s_rx_enabled, rx_cbs, user_data), TAG,
+                            "Register I2S RX callbacks failed");
+    }
+
+    return ESP_OK;
+}
+
 esp_codec_dev_handle_t bsp_audio_codec_speaker_init(void)
 {
     if (i2s_data_if == NULL) {
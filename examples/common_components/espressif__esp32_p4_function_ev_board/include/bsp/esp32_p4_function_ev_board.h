@@ -168,6 +168,22 @@ esp_codec_dev_handle_t bsp_audio_codec_speaker_init(void);
  */
 esp_codec_dev_handle_t bsp_audio_codec_microphone_init(void);
 
+/**
+ * @brief Register event callbacks on the I2S channels of the audio codec
+ *
+ * Channels enabled by `bsp_audio_init` are stopped for the registration and started again.
+ * Must be called before the codec devices are opened, they take over the channel state.
+ *
+ * @param[in] tx_cbs Playback channel callbacks, may be NULL
+ * @param[in] rx_cbs Recording channel callbacks, may be NULL
+ * @param[in] user_data Passed to the callbacks
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_STATE Audio not initialized
+ */
+esp_err_t bsp_audio_register_i2s_callbacks(const i2s_event_callbacks_t *tx_cbs, const i2s_event_callbacks_t *rx_cbs,
+                                           void *user_data);
+
 /**************************************************************************************************
  *
  * SPIFFS
@@ -1,6 +1,12 @@
 #include "app_echo.hpp"
 
 #include "bsp_board_extra.h"
+#include "app_echo_engine.h"
+
+#define ECHO_SAMPLE_RATE        (16000)
+#define ECHO_VOLUME             (60)
+#define ECHO_TASK_PRIORITY      (10)    // Above the LVGL and audio player tasks
+#define ECHO_STATS_PERIOD_MS    (500)
 
 // 声明外部图像资源
 LV_IMG_DECLARE(img_app_music_player);
@@ -12,9 +18,11 @@ AppEcho::AppEcho():
     _screen(nullptr),
     _button(nullptr),
     _label_button(nullptr),
+    _label_stats(nullptr),
+    _stats_timer(nullptr),
     _file(nullptr),
     _is_running(false),
-    _task_handle(NULL)
+    _session(nullptr)
 {
 
 }
@@ -44,6 +52,14 @@ bool AppEcho::run(void)
     lv_obj_set_style_text_color(_label_button, lv_color_hex(0xffffff), LV_PART_MAIN);
     lv_obj_center(_label_button);
 
+    _label_stats = lv_label_create(_screen);
+    lv_label_set_text(_label_stats, "");
+    lv_obj_set_style_text_color(_label_stats, lv_color_hex(0xffffff), LV_PART_MAIN);
+    lv_obj_set_style_text_align(_label_stats, LV_TEXT_ALIGN_CENTER, LV_PART_MAIN);
+    lv_obj_align_to(_label_stats, _button, LV_ALIGN_OUT_BOTTOM_MID, 0, 30);
+
+    _stats_timer = lv_timer_create(_stats_timer_cb, ECHO_STATS_PERIOD_MS, this);
+
     return true;
 }
 
@@ -59,48 +75,100 @@ bool AppEcho::back(void)
 }
 bool AppEcho::close(void)
 {
-    bsp_extra_codec_mute_set(true);
-    ESP_ERROR_CHECK(bsp_extra_codec_dev_stop());
+    stop();
+    if (_stats_timer) {
+        lv_timer_del(_stats_timer);
+        _stats_timer = nullptr;
+    }
+    _label_stats = nullptr;
     return true;
 }
 
+void AppEcho::start(void)
+{
+    // Takes the codec at our own format, the mixer pauses meanwhile
+    const bsp_extra_codec_session_cfg_t session_cfg = {
+        .name = "echo",
+        .rate = ECHO_SAMPLE_RATE,
+        .bits_cfg = CODEC_DEFAULT_BIT_WIDTH,
+        .ch = I2S_SLOT_MODE_MONO,
+        .flags = BSP_EXTRA_CODEC_SESSION_PLAYBACK | BSP_EXTRA_CODEC_SESSION_CAPTURE,
+        .priority = BSP_EXTRA_CODEC_PRIORITY_CAPTURE,
+        .cb = NULL,
+        .user_ctx = NULL,
+    };
+    if (bsp_extra_codec_session_open(&session_cfg, &_session) != ESP_OK) {
+        ESP_LOGE(TAG, "Open codec session failed");
+        return;
+    }
+    if (!bsp_extra_codec_session_is_granted(_session)) {
+        ESP_LOGE(TAG, "Codec busy at another format");
+        bsp_extra_codec_session_close(_session);
+        _session = nullptr;
+        return;
+    }
+    bsp_extra_codec_volume_set(ECHO_VOLUME, NULL);
+
+    const app_echo_engine_cfg_t cfg = {
+        .sample_rate = ECHO_SAMPLE_RATE,
+        .task_priority = ECHO_TASK_PRIORITY,
+        .task_core = tskNO_AFFINITY,
+        .measure_latency = true,
+    };
+    if (app_echo_engine_start(&cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "Start echo failed");
+        bsp_extra_codec_session_close(_session);
+        _session = nullptr;
+        return;
+    }
+    lv_label_set_text(_label_button, "Stop");
+    _is_running = true;
+}
+
+void AppEcho::stop(void)
+{
+    if (!_is_running) {
+        return;
+    }
+
+    if (app_echo_engine_stop() != ESP_OK) {
+        ESP_LOGE(TAG, "Stop echo failed");
+    }
+    bsp_extra_codec_session_close(_session);
+    _session = nullptr;
+    if (_label_button) {
+        lv_label_set_text(_label_button, "Start");
+    }
+    _is_running = false;
+}
+
 void AppEcho::_button_cb(lv_event_t *e)
 {
     AppEcho *instance = static_cast<AppEcho *>(lv_event_get_user_data(e));
     if(instance) {
-        // instance->app_task(instance)
         if(instance->_is_running) {
-            lv_label_set_text(instance->_label_button, "Start");
-            instance->_is_running = false;
-            bsp_extra_codec_mute_set(true);
-            vTaskDelete(instance->_task_handle);
-            instance->_task_handle = NULL;
+            instance->stop();
         } else {
-            lv_label_set_text(instance->_label_button, "Stop");
-            bsp_extra_codec_mute_set(false);
-            bsp_extra_codec_set_fs(CODEC_DEFAULT_SAMPLE_RATE, CODEC_DEFAULT_BIT_WIDTH, I2S_SLOT_MODE_MONO);
-            xTaskCreate(instance->app_task, "app_task", 4096, instance, 5, &instance->_task_handle);
-            instance->_is_running = true;
+            instance->start();
         }
     }
 }
 
-void AppEcho::app_task(void *data)
+void AppEcho::_stats_timer_cb(lv_timer_t *timer)
 {
-    AppEcho *instance = static_cast<AppEcho *>(data);
-    bsp_extra_codec_volume_set(60, NULL);
-
-    uint8_t *buff = (uint8_t *)malloc(256);
-    size_t bytes_read = 0;
-    while (1) {
-        esp_err_t err = bsp_extra_i2s_read(buff, 256, &bytes_read, 1000);
-        if(err != ESP_OK) {
-            ESP_LOGI("TAG", "I2S read error");
-            vTaskDelete(instance->_task_handle);
-        }
-        bsp_extra_i2s_write(buff, 256, &bytes_read, 1000);
+    AppEcho *instance = static_cast<AppEcho *>(timer->user_data);
+    app_echo_engine_stats_t stats;
+
+    if (!instance->_label_stats || (app_echo_engine_get_stats(&stats) != ESP_OK) || !stats.period_us) {
+        return;
+    }
 
-        vTaskDelay(pdTICKS_TO_MS(8));
+    char latency[16];
+    if (stats.latency_us >= 0) {
+        snprintf(latency, sizeof(latency), "%.1f ms", stats.latency_us / 1000.0f);
+    } else {
+        snprintf(latency, sizeof(latency), "-");
     }
-    
+    lv_label_set_text_fmt(instance->_label_stats, "Latency: %s\nUnderruns: %lu  Overruns: %lu", latency,
+                          (unsigned long)stats.underruns, (unsigned long)stats.overruns);
 }
@@ -5,6 +5,7 @@
 #include "lvgl.h"
 #include "file_iterator.h"
 #include "esp_brookesia.hpp"
+#include "bsp_extra_codec_session.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -24,12 +25,17 @@ class AppEcho: public ESP_Brookesia_PhoneApp {
         lv_obj_t *_screen;
         lv_obj_t *_button;
         lv_obj_t *_label_button;
+        lv_obj_t *_label_stats;
+        lv_timer_t *_stats_timer;
 
         FILE *_file;
         bool _is_running;
-        TaskHandle_t _task_handle;
+        bsp_extra_codec_session_handle_t _session;
+
+        void start(void);
+        void stop(void);
 
         static void _button_cb(lv_event_t *e);
-        static void app_task(void *arg);
+        static void _stats_timer_cb(lv_timer_t *timer);
 
 };
\ No newline at end of file
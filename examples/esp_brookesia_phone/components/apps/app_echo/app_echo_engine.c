@@ -0,0 +1,282 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bsp_board_extra.h"
+#include "app_echo_engine.h"
+
+#define ECHO_TASK_STACK_SIZE        (4 * 1024)
+#define ECHO_STOP_TIMEOUT_MS        (1000)
+#define ECHO_LOG_PERIOD_US          (5 * 1000 * 1000)
+#define MEASURE_TIMEOUT_US          (300 * 1000)
+#define MEASURE_CLICK_US            (2000)
+#define MEASURE_CLICK_LEVEL         (12000)
+#define MEASURE_THRESHOLD_MIN       (2000)
+
+typedef struct {
+    app_echo_engine_cfg_t cfg;
+    volatile bool running;
+    SemaphoreHandle_t exit_sem;
+    int16_t *buf;
+    uint32_t period_frames;
+    uint32_t period_num;                // DMA periods in the TX ring
+    portMUX_TYPE stats_lock;
+    app_echo_engine_stats_t stats;
+    bsp_extra_i2s_stats_t i2s_base;     // I2S counters when the loop started
+    bsp_extra_i2s_stats_t i2s_end;      // and when it stopped, they keep counting while idle
+} echo_engine_t;
+
+static const char *TAG = "app_echo_engine";
+
+static echo_engine_t engine = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static esp_err_t echo_read_period(void)
+{
+    size_t bytes = 0;
+    return bsp_extra_i2s_read(engine.buf, engine.period_frames * sizeof(int16_t), &bytes, portMAX_DELAY);
+}
+
+static esp_err_t echo_write_period(void)
+{
+    size_t bytes = 0;
+    return bsp_extra_i2s_write(engine.buf, engine.period_frames * sizeof(int16_t), &bytes, portMAX_DELAY);
+}
+
+static int echo_peak(void)
+{
+    int peak = 0;
+    for (uint32_t i = 0; i < engine.period_frames; i++) {
+        peak = MAX(peak, abs(engine.buf[i]));
+    }
+
+    return peak;
+}
+
+/*
+ * The I2S driver queues the TX DMA buffers that finished playing, oldest first, up to one less than the ring, and
+ * each write fills the oldest. Writing one period per read keeps the depth of that queue constant, so it sets the
+ * latency: a loop that starts writing with the queue empty waits behind the whole ring. Reading without writing
+ * until the queue is full makes each write land in the buffer played next, one period after the read returns.
+ * The microphone noise floor is learned meanwhile.
+ */
+static esp_err_t echo_prime(int *noise)
+{
+    *noise = 0;
+    for (uint32_t i = 0; (i + 1 < engine.period_num) && engine.running; i++) {
+        ESP_RETURN_ON_ERROR(echo_read_period(), TAG, "I2S read failed");
+        *noise = MAX(*noise, echo_peak());
+    }
+
+    return ESP_OK;
+}
+
+/*
+ * Play a click through the loop and time its return through the microphone. The click takes the path of echoed
+ * audio: it is written right after a read, plays once the buffers queued before it have, and comes back through the
+ * codec and the air. Echoed audio also waits for its whole period to be recorded before it is read, which is added
+ * as one period.
+ */
+static int32_t echo_measure_latency(int noise)
+{
+    const uint32_t period_us = engine.stats.period_us;
+    const int threshold = MAX(noise * 4, MEASURE_THRESHOLD_MIN);
+
+    // A burst of square wave at 1/4 of the sample rate
+    memset(engine.buf, 0, engine.period_frames * sizeof(int16_t));
+    uint32_t click_frames = MIN(engine.cfg.sample_rate * MEASURE_CLICK_US / 1000000, engine.period_frames);
+    for (uint32_t i = 0; i < click_frames; i++) {
+        engine.buf[i] = (i & 2) ? MEASURE_CLICK_LEVEL : -MEASURE_CLICK_LEVEL;
+    }
+    int64_t click_us = esp_timer_get_time();
+    if (echo_write_period() != ESP_OK) {
+        return -1;
+    }
+
+    int32_t latency_us = -1;
+    bool timed_out = false;
+    while (engine.running && (latency_us < 0) && !timed_out) {
+        if (echo_read_period() != ESP_OK) {
+            return -1;
+        }
+        int64_t read_us = esp_timer_get_time();
+
+        for (uint32_t i = 0; i < engine.period_frames; i++) {
+            if (abs(engine.buf[i]) >= threshold) {
+                // The sample was recorded this long before the read returned
+                int64_t heard_us = read_us - (int64_t)(engine.period_frames - i) * 1000000 / engine.cfg.sample_rate;
+                latency_us = (int32_t)(heard_us - click_us + period_us);
+                break;
+            }
+        }
+        if ((latency_us < 0) && (read_us - click_us > MEASURE_TIMEOUT_US)) {
+            ESP_LOGW(TAG, "Click not heard, noise peak %d", noise);
+            timed_out = true;
+        }
+
+        // Every read is followed by a write, or the next one would wait behind one more buffer
+        memset(engine.buf, 0, engine.period_frames * sizeof(int16_t));
+        if (echo_write_period() != ESP_OK) {
+            return -1;
+        }
+    }
+
+    return latency_us;
+}
+
+static void echo_log_stats(void)
+{
+    app_echo_engine_stats_t stats;
+    app_echo_engine_get_stats(&stats);
+    ESP_LOGI(TAG, "Latency %" PRId32 " us, periods %" PRIu32 ", underruns %" PRIu32 ", overruns %" PRIu32
+             ", max loop %" PRIu32 " us", stats.latency_us, stats.periods, stats.underruns, stats.overruns,
+             stats.max_loop_us);
+}
+
+static void echo_task(void *arg)
+{
+    int noise = 0;
+    if (echo_prime(&noise) != ESP_OK) {
+        engine.running = false;
+    }
+    if (engine.running && engine.cfg.measure_latency) {
+        int32_t latency_us = echo_measure_latency(noise);
+        portENTER_CRITICAL(&engine.stats_lock);
+        engine.stats.latency_us = latency_us;
+        portEXIT_CRITICAL(&engine.stats_lock);
+        ESP_LOGI(TAG, "Mic-to-speaker latency: %" PRId32 " us", latency_us);
+    }
+
+    bool first = true;
+    int64_t log_us = esp_timer_get_time();
+    while (engine.running) {
+        // The driver wakes this task when a DMA period has been recorded
+        if (echo_read_period() != ESP_OK) {
+            ESP_LOGE(TAG, "I2S read failed");
+            break;
+        }
+        int64_t read_us = esp_timer_get_time();
+        if (echo_write_period() != ESP_OK) {
+            ESP_LOGE(TAG, "I2S write failed");
+            break;
+        }
+        uint32_t loop_us = (uint32_t)(esp_timer_get_time() - read_us);
+
+        if (first) {
+            // The counters ran while the speaker and the microphone were idle
+            bsp_extra_i2s_get_stats(&engine.i2s_base);
+            first = false;
+        }
+        portENTER_CRITICAL(&engine.stats_lock);
+        engine.stats.periods++;
+        engine.stats.max_loop_us = MAX(engine.stats.max_loop_us, loop_us);
+        portEXIT_CRITICAL(&engine.stats_lock);
+
+        if (read_us - log_us >= ECHO_LOG_PERIOD_US) {
+            echo_log_stats();
+            log_us = read_us;
+        }
+    }
+
+    portENTER_CRITICAL(&engine.stats_lock);
+    bsp_extra_i2s_get_stats(&engine.i2s_end);
+    engine.running = false;
+    portEXIT_CRITICAL(&engine.stats_lock);
+    echo_log_stats();
+    xSemaphoreGive(engine.exit_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_echo_engine_start(const app_echo_engine_cfg_t *cfg)
+{
+    ESP_RETURN_ON_FALSE(cfg && cfg->sample_rate, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(!engine.running, ESP_ERR_INVALID_STATE, TAG, "Already running");
+
+    if (!engine.exit_sem) {
+        engine.exit_sem = xSemaphoreCreateBinary();
+        ESP_RETURN_ON_FALSE(engine.exit_sem, ESP_ERR_NO_MEM, TAG, "Create exit semaphore failed");
+    }
+    // Given by a task that stopped on an error
+    xSemaphoreTake(engine.exit_sem, 0);
+
+    engine.cfg = *cfg;
+    engine.period_frames = bsp_extra_i2s_get_period_frames();
+    engine.period_num = bsp_extra_i2s_get_period_num();
+    free(engine.buf);
+    engine.buf = heap_caps_malloc(engine.period_frames * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    ESP_RETURN_ON_FALSE(engine.buf, ESP_ERR_NO_MEM, TAG, "No memory for echo buffer");
+
+    memset(&engine.stats, 0, sizeof(engine.stats));
+    engine.stats.period_us = engine.period_frames * 1000000 / cfg->sample_rate;
+    engine.stats.latency_us = -1;
+    bsp_extra_i2s_get_stats(&engine.i2s_base);
+
+    engine.running = true;
+    if (xTaskCreatePinnedToCore(echo_task, "echo", ECHO_TASK_STACK_SIZE, NULL, cfg->task_priority, NULL,
+                                cfg->task_core) != pdPASS) {
+        engine.running = false;
+        ESP_LOGE(TAG, "Create echo task failed");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Started, period %" PRIu32 " frames (%" PRIu32 " us)", engine.period_frames,
+             engine.stats.period_us);
+
+    return ESP_OK;
+}
+
+esp_err_t app_echo_engine_stop(void)
+{
+    if (!engine.running) {
+        return ESP_OK;
+    }
+
+    // The task notices within one period
+    engine.running = false;
+    ESP_RETURN_ON_FALSE(xSemaphoreTake(engine.exit_sem, pdMS_TO_TICKS(ECHO_STOP_TIMEOUT_MS)) == pdTRUE, ESP_ERR_TIMEOUT,
+                        TAG, "Echo task stop timeout");
+    free(engine.buf);
+    engine.buf = NULL;
+
+    return ESP_OK;
+}
+
+bool app_echo_engine_is_running(void)
+{
+    return engine.running;
+}
+
+esp_err_t app_echo_engine_get_stats(app_echo_engine_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    bsp_extra_i2s_stats_t i2s_stats;
+
+    portENTER_CRITICAL(&engine.stats_lock);
+    if (engine.running) {
+        bsp_extra_i2s_get_stats(&i2s_stats);
+    } else {
+        i2s_stats = engine.i2s_end;
+    }
+    *stats = engine.stats;
+    if (stats->periods) {
+        stats->underruns = i2s_stats.tx_underruns - engine.i2s_base.tx_underruns;
+        stats->overruns = i2s_stats.rx_overruns - engine.i2s_base.rx_overruns;
+    }
+    portEXIT_CRITICAL(&engine.stats_lock);
+
+    return ESP_OK;
+}
@@ -0,0 +1,67 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Echo engine configuration.
+ */
+typedef struct {
+    uint32_t sample_rate;               /*!< Mono 16-bit sample rate, the codec must already use it. */
+    uint32_t task_priority;             /*!< Priority of the loopback task, above everything it must not wait for. */
+    int task_core;                      /*!< Core of the loopback task, tskNO_AFFINITY for any. */
+    bool measure_latency;               /*!< Play a click at start and time it back through the microphone. */
+} app_echo_engine_cfg_t;
+
+/**
+ * @brief Echo engine statistics, since the engine started.
+ */
+typedef struct {
+    uint32_t period_us;                 /*!< One I2S DMA period, the loop moves audio one period at a time. */
+    int32_t latency_us;                 /*!< Mic-to-speaker latency, -1 if not measured or the click was not heard. */
+    uint32_t periods;                   /*!< Periods looped back. */
+    uint32_t underruns;                 /*!< Periods the speaker played as silence. */
+    uint32_t overruns;                  /*!< Microphone periods lost. */
+    uint32_t max_loop_us;               /*!< Longest time from the end of a read to the end of its write. */
+} app_echo_engine_stats_t;
+
+/**
+ * @brief Start looping the microphone back to the speaker.
+ *
+ * A task blocks on the I2S read of one DMA period, so the driver wakes it once per DMA interrupt, and writes the
+ * period straight back. It first reads the periods of the TX DMA ring without writing them, so that each period is then
+ * written to the DMA buffer played next and waits for one period instead of the whole ring.
+ *
+ * @param cfg Engine configuration.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already running, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_echo_engine_start(const app_echo_engine_cfg_t *cfg);
+
+/**
+ * @brief Stop the loopback, waits for the task to exit.
+ */
+esp_err_t app_echo_engine_stop(void);
+
+/**
+ * @brief Check whether the loopback runs.
+ */
+bool app_echo_engine_is_running(void);
+
+/**
+ * @brief Get the statistics of the running or last engine.
+ */
+esp_err_t app_echo_engine_get_stats(app_echo_engine_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
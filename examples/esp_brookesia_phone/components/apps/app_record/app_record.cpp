@@ -2,7 +2,17 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "bsp/esp-bsp.h"
 #include "bsp_board_extra.h"
+#include "app_recorder.h"
+
+#define RECORD_SAMPLE_RATE          (16000)
+#define RECORD_FILE_PATH            BSP_SD_MOUNT_POINT "/music/record.wav"
+#define RECORD_WRITE_SIZE           (64 * 1024)     // The SD card allocation unit
+#define RECORD_CAPTURE_PRIORITY     (10)            // Above the LVGL and audio player tasks
+#define RECORD_WRITER_PRIORITY      (5)
+#define RECORD_STATS_PERIOD_MS      (500)
+#define RECORD_SYNC_PERIOD_MS       (10 * 1000)     // Audio lost at most on a power cut
 
 // 声明外部图像资源
 LV_IMG_DECLARE(img_app_music_player);
@@ -14,7 +24,10 @@ AppRecord::AppRecord():
     _screen(nullptr),
     _button(nullptr),
     _label_button(nullptr),
-    _file(nullptr)
+    _label_stats(nullptr),
+    _stats_timer(nullptr),
+    _is_running(false),
+    _session(nullptr)
 {
 
 }
@@ -44,6 +57,14 @@ bool AppRecord::run(void)
     lv_obj_set_style_text_color(_label_button, lv_color_hex(0xffffff), LV_PART_MAIN);
     lv_obj_center(_label_button);
 
+    _label_stats = lv_label_create(_screen);
+    lv_label_set_text(_label_stats, "");
+    lv_obj_set_style_text_color(_label_stats, lv_color_hex(0xffffff), LV_PART_MAIN);
+    lv_obj_set_style_text_align(_label_stats, LV_TEXT_ALIGN_CENTER, LV_PART_MAIN);
+    lv_obj_align_to(_label_stats, _button, LV_ALIGN_OUT_BOTTOM_MID, 0, 30);
+
+    _stats_timer = lv_timer_create(_stats_timer_cb, RECORD_STATS_PERIOD_MS, this);
+
     return true;
 }
 
@@ -59,85 +80,106 @@ bool AppRecord::back(void)
 }
 bool AppRecord::close(void)
 {
-    ESP_ERROR_CHECK(bsp_extra_codec_dev_stop());
+    stop();
+    if (_stats_timer) {
+        lv_timer_del(_stats_timer);
+        _stats_timer = nullptr;
+    }
+    _label_stats = nullptr;
     return true;
 }
 
-void AppRecord::_button_cb(lv_event_t *e)
+void AppRecord::start(void)
 {
-    AppRecord *instance = static_cast<AppRecord *>(lv_event_get_user_data(e));
-    if(instance && !lv_obj_has_state(instance->_button, LV_STATE_DISABLED)) {
-        // instance->app_task(instance)
-        bsp_extra_codec_mute_set(false);
-        ESP_ERROR_CHECK(bsp_extra_codec_set_fs(CODEC_DEFAULT_SAMPLE_RATE, CODEC_DEFAULT_BIT_WIDTH, I2S_SLOT_MODE_MONO));
-        xTaskCreate(instance->app_task, "app_task", 4096, instance, 5, NULL);
+    // Takes the codec at our own format, the mixer pauses meanwhile
+    const bsp_extra_codec_session_cfg_t session_cfg = {
+        .name = "record",
+        .rate = RECORD_SAMPLE_RATE,
+        .bits_cfg = CODEC_DEFAULT_BIT_WIDTH,
+        .ch = I2S_SLOT_MODE_MONO,
+        .flags = BSP_EXTRA_CODEC_SESSION_CAPTURE,
+        .priority = BSP_EXTRA_CODEC_PRIORITY_CAPTURE,
+        .cb = NULL,
+        .user_ctx = NULL,
+    };
+    if (bsp_extra_codec_session_open(&session_cfg, &_session) != ESP_OK) {
+        ESP_LOGE(TAG, "Open codec session failed");
+        return;
     }
+    if (!bsp_extra_codec_session_is_granted(_session)) {
+        ESP_LOGE(TAG, "Codec busy at another format");
+        bsp_extra_codec_session_close(_session);
+        _session = nullptr;
+        return;
+    }
+
+    const app_recorder_cfg_t cfg = {
+        .path = RECORD_FILE_PATH,
+        .sample_rate = RECORD_SAMPLE_RATE,
+        .ring_size = CONFIG_EXAMPLE_RECORDER_RING_KB * 1024,
+        .write_size = RECORD_WRITE_SIZE,
+        .prealloc_size = CONFIG_EXAMPLE_RECORDER_PREALLOC_MB * 1024 * 1024,
+        .capture_priority = RECORD_CAPTURE_PRIORITY,
+        .writer_priority = RECORD_WRITER_PRIORITY,
+        .sync_period_ms = RECORD_SYNC_PERIOD_MS,
+    };
+    if (app_recorder_start(&cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "Start recording failed");
+        lv_label_set_text(_label_stats, "Cannot record to the SD card");
+        bsp_extra_codec_session_close(_session);
+        _session = nullptr;
+        return;
+    }
+    lv_label_set_text(_label_button, "Stop");
+    _is_running = true;
 }
 
-void AppRecord::app_task(void *data)
+void AppRecord::stop(void)
 {
-    AppRecord *instance = static_cast<AppRecord *>(data);
-    lv_obj_add_state(instance->_button, LV_STATE_DISABLED);
-    instance->_file = fopen("/sdcard/music/record.wav", "wb");
-    if(instance->_file == NULL) {
-        vTaskDelete(NULL);
-        return ;
+    if (!_is_running) {
+        return;
     }
-    int bytes_recorded = 0;
-    const int byte_rate = 16000 * 1 * 16 / 8;
-    const int total_bytes = 10 * byte_rate;
-    uint8_t *buffer = (uint8_t *)malloc(1024);
-    if(buffer == NULL) {
-        fclose(instance->_file);
-        vTaskDelete(NULL);
-        return ;
+
+    if (app_recorder_stop() != ESP_OK) {
+        ESP_LOGE(TAG, "Stop recording failed");
+    }
+    bsp_extra_codec_session_close(_session);
+    _session = nullptr;
+    if (_label_button) {
+        lv_label_set_text(_label_button, "Start");
     }
+    _is_running = false;
+}
 
-    // 写入WAV文件头
-    uint8_t wav_header[44] = {0};
-    memcpy(wav_header, "RIFF", 4);
-    // 文件大小占位符，稍后填写
-    memcpy(wav_header + 8, "WAVE", 4);
-    memcpy(wav_header + 12, "fmt ", 4);
-    *(uint32_t*)(wav_header + 16) = 16; // fmt块大小
-    *(uint16_t*)(wav_header + 20) = 1;  // 音频格式 (PCM)
-    *(uint16_t*)(wav_header + 22) = 1; // 声道数
-    *(uint32_t*)(wav_header + 24) = 16000; // 采样率
-    *(uint32_t*)(wav_header + 28) = byte_rate; // 字节率
-    *(uint16_t*)(wav_header + 32) = 2; // 块对齐
-    *(uint16_t*)(wav_header + 34) = 16; // 位深度
-    memcpy(wav_header + 36, "data", 4);
-
-    fwrite(wav_header, 1, 44, instance->_file);
-
-    lv_label_set_text(instance->_label_button, "Recording");
-
-    while(bytes_recorded < total_bytes) {
-        size_t bytes_read = 0;
-        if(ESP_OK != bsp_extra_i2s_read(buffer, 1024, &bytes_read, 1000)) {
-            ESP_LOGE(TAG, "Error reading I2S data");
-            break;
-        }
-        fwrite(buffer, 1, bytes_read, instance->_file);
-        bytes_recorded += bytes_read;
-        if(bytes_recorded % byte_rate == 0) {
-            ESP_LOGI(TAG, "Recorded %d bytes", bytes_recorded);
+void AppRecord::_button_cb(lv_event_t *e)
+{
+    AppRecord *instance = static_cast<AppRecord *>(lv_event_get_user_data(e));
+    if(instance) {
+        if(instance->_is_running) {
+            instance->stop();
+        } else {
+            instance->start();
         }
-        vTaskDelay(pdMS_TO_TICKS(30));
     }
-    lv_label_set_text(instance->_label_button, "Start");
-    ESP_LOGI(TAG, "Finished recording %d bytes", bytes_recorded);
-    uint32_t file_size = bytes_recorded + 36;
-    uint32_t data_size = bytes_recorded;
-    fseek(instance->_file, 4, SEEK_SET);
-    fwrite(&file_size, 1, 4, instance->_file);
-    fseek(instance->_file, 40, SEEK_SET);
-    fwrite(&data_size, 1, 4, instance->_file);
-
-    free(buffer);
-    fclose(instance->_file);
-    bsp_extra_codec_dev_stop();
-
-    vTaskDelete(NULL);
-    
+}
+
+void AppRecord::_stats_timer_cb(lv_timer_t *timer)
+{
+    AppRecord *instance = static_cast<AppRecord *>(timer->user_data);
+    app_recorder_stats_t stats;
+
+    if (!instance->_label_stats || !instance->_is_running || (app_recorder_get_stats(&stats) != ESP_OK)) {
+        return;
+    }
+    // The recorder stops by itself on a file error, e.g. a full card, or at the file size limit
+    if (!app_recorder_is_running()) {
+        instance->stop();
+    }
+
+    uint32_t seconds = stats.recorded_bytes / (RECORD_SAMPLE_RATE * sizeof(int16_t));
+    lv_label_set_text_fmt(instance->_label_stats, "%s %02lu:%02lu\nDropped: %lu ms  Overruns: %lu\nMax write: %lu ms",
+                          stats.write_error ? "Write error" : (stats.size_limit ? "Size limit" : "Recorded"),
+                          (unsigned long)(seconds / 60), (unsigned long)(seconds % 60),
+                          (unsigned long)(stats.dropped_bytes * 1000 / (RECORD_SAMPLE_RATE * sizeof(int16_t))),
+                          (unsigned long)stats.rx_overruns, (unsigned long)(stats.write_max_us / 1000));
 }
@@ -0,0 +1,405 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_dma_utils.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bsp_board_extra.h"
+#include "bsp_extra_pcm_ring.h"
+#include "app_recorder.h"
+
+#define CAPTURE_TASK_STACK_SIZE     (3 * 1024)
+#define WRITER_TASK_STACK_SIZE      (4 * 1024)
+#define WRITER_POLL_MS              (1000)
+#define CAPTURE_STOP_TIMEOUT_MS     (1000)
+#define WRITER_STOP_TIMEOUT_MS      (10 * 1000)     // The writer empties the ring first
+#define WAV_DATA_OFFSET             (512)           // The header fills one sector, so PCM writes stay sector aligned
+// newlib `off_t` is 32-bit: the last byte must sit below INT32_MAX, the data stays whole 4-byte frames
+#define WAV_MAX_FILE_SIZE           (WAV_DATA_OFFSET + ((INT32_MAX - WAV_DATA_OFFSET) & ~3UL))
+
+typedef struct __attribute__((packed)) {
+    char riff[4];
+    uint32_t riff_size;
+    char wave[4];
+    char fmt[4];
+    uint32_t fmt_size;
+    uint16_t format;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    char junk[4];                       // Padding chunk, skipped by WAV readers
+    uint32_t junk_size;
+    uint8_t junk_data[WAV_DATA_OFFSET - 52];
+    char data[4];
+    uint32_t data_size;
+} wav_header_t;
+
+_Static_assert(sizeof(wav_header_t) == WAV_DATA_OFFSET, "WAV header must fill the space before the data");
+
+typedef struct {
+    app_recorder_cfg_t cfg;
+    bool active;                        // Tasks started, resources held until `app_recorder_stop`
+    volatile bool running;              // Cleared to stop the capture
+    atomic_bool capture_done;           // The capture task put its last period in the ring
+    bsp_extra_pcm_ring_handle_t ring;
+    int16_t *capture_buf;
+    size_t period_size;
+    uint8_t *write_buf;
+    TaskHandle_t writer_task;
+    SemaphoreHandle_t capture_exit_sem;
+    SemaphoreHandle_t writer_exit_sem;
+    int fd;
+    wav_header_t header;
+    uint64_t file_offset;               // End of the recorded data
+    uint64_t allocated;                 // File size, data and the space reserved ahead
+    int64_t last_sync_us;               // Last time the header was updated and the file synced
+    portMUX_TYPE stats_lock;
+    app_recorder_stats_t stats;
+    bsp_extra_i2s_stats_t i2s_base;     // I2S counters when the capture started
+    bsp_extra_i2s_stats_t i2s_end;      // and when it stopped, they keep counting while idle
+} recorder_t;
+
+static const char *TAG = "app_recorder";
+
+static recorder_t rec = {
+    .fd = -1,
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void recorder_header_init(uint32_t sample_rate)
+{
+    wav_header_t *header = &rec.header;
+
+    memset(header, 0, sizeof(wav_header_t));
+    memcpy(header->riff, "RIFF", 4);
+    memcpy(header->wave, "WAVE", 4);
+    memcpy(header->fmt, "fmt ", 4);
+    header->fmt_size = 16;
+    header->format = 1;                 // PCM
+    header->channels = 1;
+    header->sample_rate = sample_rate;
+    header->bits_per_sample = 16;
+    header->block_align = header->channels * header->bits_per_sample / 8;
+    header->byte_rate = sample_rate * header->block_align;
+    memcpy(header->junk, "JUNK", 4);
+    header->junk_size = sizeof(header->junk_data);
+    memcpy(header->data, "data", 4);
+}
+
+static esp_err_t recorder_header_write(void)
+{
+    uint32_t data_size = (uint32_t)(rec.file_offset - WAV_DATA_OFFSET);
+
+    rec.header.data_size = data_size;
+    rec.header.riff_size = WAV_DATA_OFFSET - 8 + data_size;
+    ESP_RETURN_ON_FALSE(pwrite(rec.fd, &rec.header, sizeof(wav_header_t), 0) == sizeof(wav_header_t), ESP_FAIL, TAG,
+                        "Write WAV header failed");
+
+    return ESP_OK;
+}
+
+// Grow the file ahead of the data, so the clusters are not allocated in the middle of the writes
+static esp_err_t recorder_reserve(uint64_t end)
+{
+    if (end <= rec.allocated) {
+        return ESP_OK;
+    }
+
+    uint64_t size = MIN(MAX(end, rec.allocated + rec.cfg.prealloc_size), WAV_MAX_FILE_SIZE);
+    // FAT allocates the whole chain when a file open for writing is written past its end
+    const uint8_t zero = 0;
+    ESP_RETURN_ON_FALSE(pwrite(rec.fd, &zero, 1, size - 1) == 1, ESP_FAIL, TAG, "Extend file to %" PRIu64 " failed",
+                        size);
+    rec.allocated = size;
+
+    return ESP_OK;
+}
+
+static esp_err_t recorder_write(size_t len)
+{
+    ESP_RETURN_ON_FALSE(rec.file_offset + len <= WAV_MAX_FILE_SIZE, ESP_ERR_INVALID_SIZE, TAG, "File size limit");
+    ESP_RETURN_ON_ERROR(recorder_reserve(rec.file_offset + len), TAG, "Reserve file space failed");
+
+    int64_t start_us = esp_timer_get_time();
+    ssize_t written = pwrite(rec.fd, rec.write_buf, len, rec.file_offset);
+    uint32_t write_us = (uint32_t)(esp_timer_get_time() - start_us);
+    ESP_RETURN_ON_FALSE(written == len, ESP_FAIL, TAG, "Write %zu bytes failed", len);
+    rec.file_offset += len;
+
+    portENTER_CRITICAL(&rec.stats_lock);
+    rec.stats.recorded_bytes += len;
+    rec.stats.write_count++;
+    rec.stats.write_total_us += write_us;
+    rec.stats.write_max_us = MAX(rec.stats.write_max_us, write_us);
+    portEXIT_CRITICAL(&rec.stats_lock);
+
+    // Keep the file playable if the recording is cut short, at the cost of a header write and a FAT update
+    int64_t now_us = esp_timer_get_time();
+    if (rec.cfg.sync_period_ms && (now_us - rec.last_sync_us >= rec.cfg.sync_period_ms * 1000LL)) {
+        ESP_RETURN_ON_ERROR(recorder_header_write(), TAG, "Update WAV header failed");
+        ESP_RETURN_ON_FALSE(fsync(rec.fd) == 0, ESP_FAIL, TAG, "Sync file failed");
+        rec.last_sync_us = now_us;
+    }
+
+    return ESP_OK;
+}
+
+static void recorder_close_file(void)
+{
+    // Give back the space reserved ahead of the data
+    if (ftruncate(rec.fd, rec.file_offset) != 0) {
+        ESP_LOGW(TAG, "Truncate file failed");
+    }
+    recorder_header_write();
+    close(rec.fd);
+    rec.fd = -1;
+}
+
+static void capture_task(void *arg)
+{
+    bool first = true;
+
+    while (rec.running) {
+        size_t bytes = 0;
+        // The driver wakes this task when a DMA period has been recorded
+        if (bsp_extra_i2s_read(rec.capture_buf, rec.period_size, &bytes, portMAX_DELAY) != ESP_OK) {
+            ESP_LOGE(TAG, "I2S read failed");
+            break;
+        }
+        if (first) {
+            // The counters ran while the microphone was idle
+            bsp_extra_i2s_get_stats(&rec.i2s_base);
+            first = false;
+        }
+
+        // A period that does not fit is dropped whole, the writer is stalled
+        bool dropped = true;
+        if (bsp_extra_pcm_ring_get_free(rec.ring) >= rec.period_size) {
+            bsp_extra_pcm_ring_write(rec.ring, rec.capture_buf, rec.period_size);
+            dropped = false;
+        }
+        size_t filled = bsp_extra_pcm_ring_get_filled(rec.ring);
+
+        portENTER_CRITICAL(&rec.stats_lock);
+        if (dropped) {
+            rec.stats.dropped_bytes += rec.period_size;
+        }
+        rec.stats.ring_peak = MAX(rec.stats.ring_peak, filled);
+        portEXIT_CRITICAL(&rec.stats_lock);
+
+        if (filled >= rec.cfg.write_size) {
+            xTaskNotifyGive(rec.writer_task);
+        }
+    }
+
+    portENTER_CRITICAL(&rec.stats_lock);
+    bsp_extra_i2s_get_stats(&rec.i2s_end);
+    portEXIT_CRITICAL(&rec.stats_lock);
+    rec.running = false;
+    atomic_store(&rec.capture_done, true);
+    xTaskNotifyGive(rec.writer_task);
+
+    xSemaphoreGive(rec.capture_exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void writer_task(void *arg)
+{
+    // The first write completes the cluster holding the header, the next ones start on cluster boundaries
+    size_t chunk = rec.cfg.write_size - WAV_DATA_OFFSET;
+    bool failed = false;
+    bool full = false;
+
+    // Runs until the capture task is done, it notifies this task until then
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WRITER_POLL_MS));
+        // Read before the fill, so the last period is seen
+        bool done = atomic_load(&rec.capture_done);
+
+        size_t filled;
+        while (((filled = bsp_extra_pcm_ring_get_filled(rec.ring)) >= chunk) || (done && filled)) {
+            size_t len = bsp_extra_pcm_ring_read(rec.ring, rec.write_buf, MIN(chunk, filled));
+            // After a write error or at the size limit the data is dropped until the capture stops
+            if (full || failed) {
+                continue;
+            }
+            // The data that fits ends the file
+            size_t room = (size_t)(WAV_MAX_FILE_SIZE - rec.file_offset);
+            if (len >= room) {
+                len = room;
+                full = true;
+            }
+            if (len && (recorder_write(len) != ESP_OK)) {
+                failed = true;
+                portENTER_CRITICAL(&rec.stats_lock);
+                rec.stats.write_error = true;
+                portEXIT_CRITICAL(&rec.stats_lock);
+                rec.running = false;
+            } else if (full) {
+                ESP_LOGW(TAG, "File size limit reached, stopping");
+                portENTER_CRITICAL(&rec.stats_lock);
+                rec.stats.size_limit = true;
+                portEXIT_CRITICAL(&rec.stats_lock);
+                rec.running = false;
+            }
+            chunk = rec.cfg.write_size;
+        }
+        if (done) {
+            break;
+        }
+    }
+
+    recorder_close_file();
+    ESP_LOGI(TAG, "Recorded %" PRIu64 " bytes", rec.file_offset - WAV_DATA_OFFSET);
+
+    xSemaphoreGive(rec.writer_exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void recorder_free(void)
+{
+    if (rec.fd >= 0) {
+        close(rec.fd);
+        rec.fd = -1;
+    }
+    bsp_extra_pcm_ring_del(rec.ring);
+    rec.ring = NULL;
+    free(rec.capture_buf);
+    rec.capture_buf = NULL;
+    free(rec.write_buf);
+    rec.write_buf = NULL;
+}
+
+esp_err_t app_recorder_start(const app_recorder_cfg_t *cfg)
+{
+    ESP_RETURN_ON_FALSE(cfg && cfg->path && cfg->sample_rate && (cfg->write_size > WAV_DATA_OFFSET) &&
+                        (cfg->ring_size >= cfg->write_size), ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(!rec.active, ESP_ERR_INVALID_STATE, TAG, "Already recording");
+
+    if (!rec.capture_exit_sem) {
+        rec.capture_exit_sem = xSemaphoreCreateBinary();
+        ESP_RETURN_ON_FALSE(rec.capture_exit_sem, ESP_ERR_NO_MEM, TAG, "Create semaphore failed");
+    }
+    if (!rec.writer_exit_sem) {
+        rec.writer_exit_sem = xSemaphoreCreateBinary();
+        ESP_RETURN_ON_FALSE(rec.writer_exit_sem, ESP_ERR_NO_MEM, TAG, "Create semaphore failed");
+    }
+
+    esp_err_t ret = ESP_OK;
+    rec.cfg = *cfg;
+    rec.period_size = bsp_extra_i2s_get_period_frames() * sizeof(int16_t);
+    ESP_GOTO_ON_ERROR(bsp_extra_pcm_ring_new(cfg->ring_size, MALLOC_CAP_SPIRAM, &rec.ring), err, TAG,
+                      "Create ring failed");
+    rec.capture_buf = heap_caps_malloc(rec.period_size, MALLOC_CAP_INTERNAL);
+    ESP_GOTO_ON_FALSE(rec.capture_buf, ESP_ERR_NO_MEM, err, TAG, "No memory for capture buffer");
+    esp_dma_mem_info_t dma_mem_info = {
+        .extra_heap_caps = MALLOC_CAP_SPIRAM,
+        .dma_alignment_bytes = 4,
+    };
+    ESP_GOTO_ON_ERROR(esp_dma_capable_malloc(cfg->write_size, &dma_mem_info, (void **)&rec.write_buf, NULL), err, TAG,
+                      "No memory for write buffer");
+
+    rec.fd = open(cfg->path, O_WRONLY | O_CREAT | O_TRUNC);
+    ESP_GOTO_ON_FALSE(rec.fd >= 0, ESP_FAIL, err, TAG, "Open %s failed", cfg->path);
+    rec.file_offset = WAV_DATA_OFFSET;
+    rec.allocated = 0;
+    recorder_header_init(cfg->sample_rate);
+    ESP_GOTO_ON_ERROR(recorder_header_write(), err, TAG, "Write WAV header failed");
+    ESP_GOTO_ON_ERROR(recorder_reserve(rec.file_offset), err, TAG, "Reserve file space failed");
+    rec.last_sync_us = esp_timer_get_time();
+
+    memset(&rec.stats, 0, sizeof(rec.stats));
+    bsp_extra_i2s_get_stats(&rec.i2s_base);
+    atomic_store(&rec.capture_done, false);
+    xSemaphoreTake(rec.capture_exit_sem, 0);
+    xSemaphoreTake(rec.writer_exit_sem, 0);
+    rec.running = true;
+
+    ESP_GOTO_ON_FALSE(xTaskCreate(writer_task, "rec_writer", WRITER_TASK_STACK_SIZE, NULL, cfg->writer_priority,
+                                  &rec.writer_task) == pdPASS, ESP_ERR_NO_MEM, err, TAG, "Create writer task failed");
+    if (xTaskCreate(capture_task, "rec_capture", CAPTURE_TASK_STACK_SIZE, NULL, cfg->capture_priority, NULL) != pdPASS) {
+        // The writer sees the capture done, closes the file and exits
+        rec.running = false;
+        atomic_store(&rec.capture_done, true);
+        xTaskNotifyGive(rec.writer_task);
+        xSemaphoreTake(rec.writer_exit_sem, portMAX_DELAY);
+        recorder_free();
+        ESP_LOGE(TAG, "Create capture task failed");
+        return ESP_ERR_NO_MEM;
+    }
+    rec.active = true;
+    ESP_LOGI(TAG, "Recording %s, period %zu bytes, ring %zu KB", cfg->path, rec.period_size, cfg->ring_size / 1024);
+
+    return ESP_OK;
+
+err:
+    rec.running = false;
+    recorder_free();
+    return ret;
+}
+
+esp_err_t app_recorder_stop(void)
+{
+    if (!rec.active) {
+        return ESP_OK;
+    }
+
+    rec.running = false;
+    ESP_RETURN_ON_FALSE(xSemaphoreTake(rec.capture_exit_sem, pdMS_TO_TICKS(CAPTURE_STOP_TIMEOUT_MS)) == pdTRUE,
+                        ESP_ERR_TIMEOUT, TAG, "Capture task stop timeout");
+    ESP_RETURN_ON_FALSE(xSemaphoreTake(rec.writer_exit_sem, pdMS_TO_TICKS(WRITER_STOP_TIMEOUT_MS)) == pdTRUE,
+                        ESP_ERR_TIMEOUT, TAG, "Writer task stop timeout");
+    recorder_free();
+    rec.active = false;
+
+    app_recorder_stats_t stats;
+    app_recorder_get_stats(&stats);
+    ESP_LOGI(TAG, "Stopped: dropped %" PRIu64 " bytes, %" PRIu32 " I2S overruns, %" PRIu32 " writes, max %" PRIu32
+             " us, avg %" PRIu64 " us, ring peak %zu", stats.dropped_bytes, stats.rx_overruns, stats.write_count,
+             stats.write_max_us, stats.write_count ? stats.write_total_us / stats.write_count : 0, stats.ring_peak);
+
+    return ESP_OK;
+}
+
+bool app_recorder_is_running(void)
+{
+    return rec.active && rec.running;
+}
+
+esp_err_t app_recorder_get_stats(app_recorder_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    bsp_extra_i2s_stats_t i2s_stats;
+
+    portENTER_CRITICAL(&rec.stats_lock);
+    if (atomic_load(&rec.capture_done)) {
+        i2s_stats = rec.i2s_end;
+    } else if (rec.active) {
+        bsp_extra_i2s_get_stats(&i2s_stats);
+    } else {
+        i2s_stats = rec.i2s_base;       // Never started
+    }
+    *stats = rec.stats;
+    stats->rx_overruns = i2s_stats.rx_overruns - rec.i2s_base.rx_overruns;
+    portEXIT_CRITICAL(&rec.stats_lock);
+
+    return ESP_OK;
+}
@@ -0,0 +1,75 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Recorder configuration.
+ */
+typedef struct {
+    const char *path;                   /*!< WAV file to write, replaced if it exists. */
+    uint32_t sample_rate;               /*!< Mono 16-bit sample rate, the codec must already use it. */
+    size_t ring_size;                   /*!< Capture ring, absorbs the SD card write stalls. */
+    size_t write_size;                  /*!< Bytes per file write, best the FAT cluster size. */
+    size_t prealloc_size;               /*!< File space allocated ahead of the recorded data. */
+    uint32_t capture_priority;          /*!< Priority of the I2S capture task. */
+    uint32_t writer_priority;           /*!< Priority of the file writer task, below the capture task. */
+    uint32_t sync_period_ms;            /*!< Period of the WAV header updates and file syncs, 0 to only do it at stop. */
+} app_recorder_cfg_t;
+
+/**
+ * @brief Recorder statistics, since the recording started.
+ */
+typedef struct {
+    uint64_t recorded_bytes;            /*!< PCM bytes written to the file. */
+    uint64_t dropped_bytes;             /*!< Captured bytes lost because the ring was full. */
+    uint32_t rx_overruns;               /*!< I2S DMA periods lost before they were captured. */
+    uint32_t write_count;               /*!< File writes. */
+    uint32_t write_max_us;              /*!< Longest file write. */
+    uint64_t write_total_us;            /*!< Time spent in file writes. */
+    size_t ring_peak;                   /*!< Highest ring fill. */
+    bool write_error;                   /*!< The recording stopped on a file error, e.g. a full card. */
+    bool size_limit;                    /*!< The recording stopped at the 2 GB file size limit. */
+} app_recorder_stats_t;
+
+/**
+ * @brief Start recording the microphone to a WAV file, until `app_recorder_stop`.
+ *
+ * A capture task reads the I2S one DMA period at a time into a lock-free ring. A writer task writes the ring to
+ * the file in `write_size` blocks at cluster-aligned offsets, extends the file ahead of the data, and updates the
+ * WAV header and syncs the file every `sync_period_ms`, so a recording cut short stays playable up to the last sync.
+ *
+ * @param cfg Recorder configuration.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already recording, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_recorder_start(const app_recorder_cfg_t *cfg);
+
+/**
+ * @brief Stop recording, write what is left in the ring and close the file.
+ */
+esp_err_t app_recorder_stop(void);
+
+/**
+ * @brief Check whether the recorder runs, it stops by itself on a file error or at the file size limit.
+ */
+bool app_recorder_is_running(void);
+
+/**
+ * @brief Get the statistics of the running or last recording.
+ */
+esp_err_t app_recorder_get_stats(app_recorder_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,6 +5,8 @@
  */
 
 #include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_check.h"
@@ -18,7 +20,6 @@
 #include "esp_timer.h"
 #include "esp_check.h"
 #include "esp_heap_caps.h"
-#include "driver/ppa.h"
 
 #include "bsp/esp-bsp.h"
 
@@ -28,17 +29,50 @@
 #include "app_pedestrian_detect.h"
 #include "app_humanface_detect.h"
 #include "app_camera_pipeline.hpp"
+#include "app_frame_scaler.h"
+#include "app_latency_stats.h"
+#include "app_overlay.h"
+#include "app_tracker.hpp"
+#include "app_model_cache.h"
+#include "app_detect_scheduler.h"
+#include "video_player/app_thumbnail.h"
 #include "Camera.hpp"
 #include "ui/ui.h"
 
 #define ALIGN_UP_BY(num, align) (((num) + ((align) - 1)) & ~((align) - 1))
 
 #define CAMERA_INIT_TASK_WAIT_MS            (1000)
-#define DETECT_NUM_MAX                      (10)
-#define FPS_PRINT                           (1)
+#define DETECT_INTERVAL_MAX                 (30)
+#define DETECT_BOX_THICKNESS                (3)
+#define DETECT_BOX_COLOR                    APP_OVERLAY_RGB(255, 0, 0)
+#define DETECT_FACE_BOX_COLOR               APP_OVERLAY_RGB(255, 255, 0)
+#define DETECT_KEYPOINT_RADIUS              (3)
+#define DETECT_KEYPOINT_COLOR               APP_OVERLAY_RGB(0, 255, 0)
+#define DETECT_LABEL_SCALE                  (2)
+#define DETECT_LABEL_COLOR                  APP_OVERLAY_RGB(255, 255, 255)
+#define FACE_WORKER_TASK_PRIORITY           (2)     // Below the video stream task, which shares core 0
+#define FACE_ROI_MIN_SIZE                   (32)
+#define FACE_ROI_MARGIN                     (8)
+#define FACE_ROI_FULL_FRAME_PERCENT         (70)    // Larger ROIs are not worth a copy
+#define DETECT_OUTPUT_PEDESTRIAN            (0)     // Scaler outputs held by every feed element
+#define DETECT_OUTPUT_FRAME                 (1)
 
 using namespace std;
 
+typedef struct {
+    const uint16_t *frame;                          // Detection frame, `detect_width` x `detect_height`
+    int roi[4];                                     // Region to analyse, in detection frame coordinates
+    bool exit;
+    TaskHandle_t waiter;
+} face_job_t;
+
+typedef struct {
+    uint32_t frame_count;
+    uint64_t wall_us;
+    uint64_t pedestrian_us;
+    uint64_t face_us;
+} combined_detect_stats_t;
+
 typedef enum {
     CAMERA_EVENT_TASK_RUN = BIT(0),
     CAMERA_EVENT_DELETE = BIT(1),
@@ -51,25 +85,46 @@ static const char *TAG = "Camera";
 
 // AI detection variables
 // static void **detect_buf;
-static vector<vector<int>> detect_bound;
-static vector<vector<int>> detect_keypoints;
-static std::list<dl::detect::result_t> detect_results;
 static PedestrianDetect *ped_detect = NULL;
 static HumanFaceDetect *hum_detect = NULL;
 static pipeline_handle_t feed_pipeline;
-static pipeline_handle_t detect_pipeline;
+static app_detect_exchange_handle_t detect_exchange = NULL;
+static app_tracker_handle_t detect_tracker = NULL;
+static app_detect_result_t tracked_result;
+static app_detect_scheduler_handle_t detect_scheduler = NULL;
+static app_frame_scaler_handle_t detect_scaler = NULL;
+static camera_pipeline_buffer_element *detect_spare_input = NULL;
+static uint32_t detect_width = 0;
+static uint32_t detect_height = 0;
+static size_t detect_frame_offset = 0;              // Detection frame in a feed element
+static bool pedestrian_input_valid = false;         // Feed elements also hold the pedestrian model input
+static app_frame_scaler_output_t pedestrian_input;
+static int display_frame_index = -1;
+
+// Face detection worker for the combined mode, runs on the other core
+static TaskHandle_t face_worker_handle = NULL;
+static face_job_t face_job;
+static app_detect_result_t face_result;
+static uint32_t face_inference_us = 0;
+static uint16_t *face_crop_buffer = NULL;
+static int pedestrian_roi[4] = {0, 0, -1, -1};
+static bool pedestrian_roi_valid = false;           // Without a valid ROI faces are searched in the whole frame
+static combined_detect_stats_t combined_stats;
 
 // Other variables
 static lv_obj_t *btn_label = NULL;
 static size_t data_cache_line_size = 0;
-static ppa_client_handle_t ppa_client_srm_handle = NULL;
 static EventGroupHandle_t camera_event_group;
 
 static void camera_video_frame_operation(uint8_t *camera_buf, uint8_t camera_buf_index, 
                                        uint32_t camera_buf_hes, uint32_t camera_buf_ves, 
                                        size_t camera_buf_len);
 
-static bool ppa_trans_done_cb(ppa_client_handle_t ppa_client, ppa_event_data_t *event_data, void *user_data);
+static void detect_scaler_done_cb(void *user_data);
+static void face_worker_task(void *arg);
+static void feed_recycle_cb(camera_pipeline_buffer_element *element, void *user_ctx);
+static void detect_latency_hook(int64_t preprocess_us, int64_t forward_us, int64_t postprocess_us);
+static void display_frame_release(void);
 
 Camera::Camera(uint16_t hor_res, uint16_t ver_res):
     ESP_Brookesia_PhoneApp("Camera", &img_app_camera, false),  // auto_resize_visual_area
@@ -104,13 +159,23 @@ bool Camera::run(void)
         _camera_init_sem = NULL;
     }
 
-    ped_detect = get_pedestrian_detect();
+    // Resident models come back right away, others are loaded here
+    ped_detect = (PedestrianDetect *)app_model_cache_acquire(APP_MODEL_PEDESTRIAN);
     assert(ped_detect != NULL);
-    
-    hum_detect = get_humanface_detect();
+
+    hum_detect = (HumanFaceDetect *)app_model_cache_acquire(APP_MODEL_FACE);
     assert(hum_detect != NULL);
+    human_face_detect::set_latency_hook(detect_latency_hook);
+
+    app_latency_reset();
+
+    // The first combined frame searches faces in the whole frame
+    pedestrian_roi_valid = false;
+    memset(&combined_stats, 0, sizeof(combined_stats));
 
     xTaskCreatePinnedToCore((TaskFunction_t)camera_dectect_task, "Camera Detect", 1024 * 8, this, 5, &_detect_task_handle, 1);
+    xTaskCreatePinnedToCore(face_worker_task, "Camera Face", 1024 * 8, NULL, FACE_WORKER_TASK_PRIORITY,
+                            &face_worker_handle, 0);
 
     xEventGroupSetBits(camera_event_group, CAMERA_EVENT_TASK_RUN);
     xEventGroupClearBits(camera_event_group, CAMERA_EVENT_DELETE);
@@ -169,8 +234,18 @@ bool Camera::run(void)
     lv_obj_align(mode_switch_btn, LV_ALIGN_TOP_RIGHT, -150, 0);
     lv_obj_add_event_cb(mode_switch_btn, [](lv_event_t *e) {
         Camera *camera = (Camera *)e->user_data;
+        EventBits_t bits = xEventGroupGetBits(camera_event_group);
 
-        if (xEventGroupGetBits(camera_event_group) & CAMERA_EVENT_PED_DETECT) {
+        // Normal -> Pedestrian -> Face -> Pedestrian + Face -> Normal
+        if ((bits & CAMERA_EVENT_PED_DETECT) && (bits & CAMERA_EVENT_HUMAN_DETECT)) {
+            xEventGroupClearBits(camera_event_group, CAMERA_EVENT_PED_DETECT | CAMERA_EVENT_HUMAN_DETECT);
+            lv_label_set_text(btn_label, "  Normal \n   Detect");
+
+            lv_obj_clear_flag(ui_ButtonCameraShotBtn, LV_OBJ_FLAG_HIDDEN);
+            lv_obj_clear_flag(ui_PanelCameraShotControlBg, LV_OBJ_FLAG_HIDDEN);
+            lv_obj_clear_flag(camera->_img_album, LV_OBJ_FLAG_HIDDEN);
+            camera->_screen_index = SCREEN_CAMERA_SHOT;
+        } else if (bits & CAMERA_EVENT_PED_DETECT) {
             xEventGroupClearBits(camera_event_group, CAMERA_EVENT_PED_DETECT);
             xEventGroupSetBits(camera_event_group, CAMERA_EVENT_HUMAN_DETECT);
             lv_label_set_text(btn_label, "    Face \n   Detect");
@@ -179,14 +254,9 @@ bool Camera::run(void)
             lv_obj_add_flag(ui_PanelCameraShotControlBg, LV_OBJ_FLAG_HIDDEN);
             lv_obj_add_flag(camera->_img_album, LV_OBJ_FLAG_HIDDEN);
             camera->_screen_index = SCREEN_CAMERA_AI;
-        } else if (xEventGroupGetBits(camera_event_group) & CAMERA_EVENT_HUMAN_DETECT) {
-            xEventGroupClearBits(camera_event_group, CAMERA_EVENT_HUMAN_DETECT);
-            lv_label_set_text(btn_label, "  Normal \n   Detect");
-
-            lv_obj_clear_flag(ui_ButtonCameraShotBtn, LV_OBJ_FLAG_HIDDEN);
-            lv_obj_clear_flag(ui_PanelCameraShotControlBg, LV_OBJ_FLAG_HIDDEN);
-            lv_obj_clear_flag(camera->_img_album, LV_OBJ_FLAG_HIDDEN);
-            camera->_screen_index = SCREEN_CAMERA_SHOT;
+        } else if (bits & CAMERA_EVENT_HUMAN_DETECT) {
+            xEventGroupSetBits(camera_event_group, CAMERA_EVENT_PED_DETECT);
+            lv_label_set_text(btn_label, "Pedestrian \n   + Face");
         } else {
             xEventGroupSetBits(camera_event_group, CAMERA_EVENT_PED_DETECT);
             lv_label_set_text(btn_label, "Pedestrian \n   Detect");
@@ -237,6 +307,41 @@ bool Camera::close(void)
     
     app_video_stream_task_stop(_camera_ctlr_handle);
     app_video_stream_wait_stop();
+    display_frame_release();
+
+    // The detect task only wakes up for frames, kick it so it sees the delete event
+    camera_pipeline_wakeup_recv(feed_pipeline);
+
+    if (combined_stats.frame_count) {
+        // Wall time of the parallel run against the time both models would take one after the other
+        ESP_LOGI(TAG, "combined detect: %" PRIu32 " frames, %" PRIu32 " us per frame in parallel, %" PRIu32
+                 " us sequential (pedestrian %" PRIu32 " + face %" PRIu32 ")", combined_stats.frame_count,
+                 (uint32_t)(combined_stats.wall_us / combined_stats.frame_count),
+                 (uint32_t)((combined_stats.pedestrian_us + combined_stats.face_us) / combined_stats.frame_count),
+                 (uint32_t)(combined_stats.pedestrian_us / combined_stats.frame_count),
+                 (uint32_t)(combined_stats.face_us / combined_stats.frame_count));
+    }
+
+    app_detect_scheduler_stats_t sched_stats;
+    if (app_detect_scheduler_get_stats(detect_scheduler, &sched_stats) == ESP_OK) {
+        ESP_LOGI(TAG, "detect scheduler: fed %" PRIu32 ", busy skip %" PRIu32 ", interval skip %" PRIu32
+                 ", interval %" PRIu32 ", inference %" PRIu32 " us, latency %" PRIu32 " us",
+                 sched_stats.fed_count, sched_stats.busy_skip_count, sched_stats.interval_skip_count,
+                 sched_stats.interval, sched_stats.inference_avg_us, sched_stats.latency_avg_us);
+    }
+
+    camera_pipeline_stats_t stats;
+    if (camera_pipeline_get_stats(feed_pipeline, &stats) == ESP_OK) {
+        ESP_LOGI(TAG, "feed pipeline: done %" PRIu32 ", recv %" PRIu32 ", drop %" PRIu32 ", overwrite %" PRIu32,
+                 stats.done_count, stats.recv_count, stats.drop_count, stats.overwrite_count);
+    }
+    app_video_stats_t video_stats;
+    if (app_video_get_stats(&video_stats) == ESP_OK) {
+        ESP_LOGI(TAG, "video: frames %" PRIu32 ", deferred release %" PRIu32 ", max held %" PRIu32,
+                 video_stats.frame_count, video_stats.deferred_count, video_stats.held_max);
+    }
+    ESP_LOGI(TAG, "PSRAM free %u, minimum free %u", heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+             heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
 
     if (_img_album_buffer) {
         heap_caps_free(_img_album_buffer);
@@ -295,38 +400,120 @@ bool Camera::init(void)
 
     memcpy(&_img_refresh_dsc, &img_dsc, sizeof(lv_img_dsc_t));
 
-    size_t detect_buf_size = ALIGN_UP_BY(_hor_res * _ver_res * BSP_LCD_BITS_PER_PIXEL / 8, data_cache_line_size);
+    camera_pipeline_cfg_t PPA_feed_cfg;
+    detect_width = _hor_res;
+    detect_height = _ver_res;
+    if (CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE > 1) {
+        // Detectors get their own frames, scaled from the capture buffer by the PPA. The pedestrian model reads its
+        // input as is. The face detector crops its candidates from a downscaled frame, so that one keeps the
+        // capture format and aspect.
+        app_frame_scaler_cfg_t scaler_cfg = {
+            .src_width = _hor_res,
+            .src_height = _ver_res,
+            .outputs = {
+                {   // DETECT_OUTPUT_PEDESTRIAN
+                    .width = EXAMPLE_DETECT_RES,
+                    .height = EXAMPLE_DETECT_RES,
+                    .format = APP_FRAME_SCALER_FMT_RGB888,
+                    .byte_swap = APP_PEDESTRIAN_RGB565_BIG_ENDIAN,
+                    .rgb_swap = false,
+                },
+                {   // DETECT_OUTPUT_FRAME
+                    .width = (uint32_t)_hor_res / CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE,
+                    .height = (uint32_t)_ver_res / CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE,
+                    .format = APP_FRAME_SCALER_FMT_RGB565,
+                    .byte_swap = false,     // The face detector is configured for the capture byte order
+                    .rgb_swap = false,
+                },
+            },
+            .output_num = 2,
+#if CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE_USE_PPA
+            .use_ppa = true,
+#else
+            .use_ppa = false,
+#endif
+            .done_cb = detect_scaler_done_cb,
+        };
+        ESP_ERROR_CHECK(app_frame_scaler_new(&scaler_cfg, &detect_scaler));
+        app_frame_scaler_output_t detect_frame;
+        ESP_ERROR_CHECK(app_frame_scaler_get_output(detect_scaler, DETECT_OUTPUT_FRAME, &detect_frame));
+        ESP_ERROR_CHECK(app_frame_scaler_get_output(detect_scaler, DETECT_OUTPUT_PEDESTRIAN, &pedestrian_input));
+        detect_width = detect_frame.width;
+        detect_height = detect_frame.height;
+        detect_frame_offset = detect_frame.offset;
+        pedestrian_input_valid = true;
+        size_t detect_buf_size = app_frame_scaler_get_output_size(detect_scaler);
+
+        PPA_feed_cfg = {
+            .elem_num = 3,
+            .elements = NULL,
+            .align_size = data_cache_line_size,
+            .caps = MALLOC_CAP_SPIRAM,
+            .buffer_size = ALIGN_UP_BY(detect_buf_size, data_cache_line_size),
+            .mode = CAMERA_PIPELINE_MODE_LATEST,
+            .recycle_cb = NULL,
+            .recycle_ctx = NULL,
+        };
+    } else {
+        // Feed elements only reference the capture buffers, frames are shared with the display by refcount.
+        // A frame handed to the detect task is never drawn into, nor shown, see `camera_video_frame_operation`.
+        PPA_feed_cfg = {
+            .elem_num = EXAMPLE_CAM_BUF_NUM,
+            .elements = (void **)_cam_buffer,
+            .align_size = 1,
+            .caps = MALLOC_CAP_SPIRAM,
+            .buffer_size = _cam_buffer_size[0],
+            .mode = CAMERA_PIPELINE_MODE_LATEST,
+            .recycle_cb = feed_recycle_cb,
+            .recycle_ctx = NULL,
+        };
+    }
+
+    camera_element_pipeline_new(&PPA_feed_cfg, &feed_pipeline);
 
-    ppa_client_config_t srm_config =  {
-        .oper_type = PPA_OPERATION_SRM,
+    ESP_ERROR_CHECK(app_detect_exchange_new(&detect_exchange));
+#if CONFIG_EXAMPLE_CAMERA_DETECT_FACE_IN_PEDESTRIAN_ROI
+    face_crop_buffer = (uint16_t *)heap_caps_aligned_alloc(data_cache_line_size, detect_width * detect_height * sizeof(uint16_t),
+                                                           MALLOC_CAP_SPIRAM);
+    if (face_crop_buffer == NULL) {
+        ESP_LOGE(TAG, "Allocate memory for face crop buffer failed");
+        return false;
+    }
+#endif
+    app_detect_scheduler_cfg_t sched_cfg = {
+        .min_interval = CONFIG_EXAMPLE_CAMERA_DETECT_INTERVAL,
+        .max_interval = DETECT_INTERVAL_MAX,
+        .target_latency_ms = CONFIG_EXAMPLE_CAMERA_DETECT_TARGET_LATENCY_MS,
     };
-    ESP_ERROR_CHECK(ppa_register_client(&srm_config, &ppa_client_srm_handle));
+    ESP_ERROR_CHECK(app_detect_scheduler_new(&sched_cfg, &detect_scheduler));
+#if CONFIG_EXAMPLE_CAMERA_DETECT_TRACKER
+    app_tracker_cfg_t tracker_cfg = APP_TRACKER_DEFAULT_CONFIG();
+    ESP_ERROR_CHECK(app_tracker_new(&tracker_cfg, &detect_tracker));
+#endif
 
-    ppa_event_callbacks_t cbs = {
-        .on_trans_done = ppa_trans_done_cb,
+    ESP_ERROR_CHECK(app_model_cache_init(CONFIG_EXAMPLE_CAMERA_MODEL_CACHE_BUDGET_KB * 1024));
+    const app_model_desc_t pedestrian_desc = {
+        .name = "pedestrian",
+        .load = []() -> void * { return get_pedestrian_detect(); },
+        .unload = delete_pedestrian_detect,
     };
-    ppa_client_register_event_callbacks(ppa_client_srm_handle, &cbs);
-
-    camera_pipeline_cfg_t PPA_feed_cfg = {
-        .elem_num = 4,
-        .elements = NULL,
-        .align_size = 1,
-        .caps = MALLOC_CAP_SPIRAM,
-        .buffer_size = detect_buf_size,
+    const app_model_desc_t face_desc = {
+        .name = "face",
+        .load = []() -> void * { return get_humanface_detect(); },
+        .unload = delete_humanface_detect,
     };
+    ESP_ERROR_CHECK(app_model_cache_register(APP_MODEL_PEDESTRIAN, &pedestrian_desc));
+    ESP_ERROR_CHECK(app_model_cache_register(APP_MODEL_FACE, &face_desc));
+#if CONFIG_EXAMPLE_CAMERA_MODEL_PREWARM
+    ESP_ERROR_CHECK(app_model_cache_prewarm(CONFIG_EXAMPLE_CAMERA_MODEL_PREWARM_DELAY_MS));
+#endif
 
-    camera_element_pipeline_new(&PPA_feed_cfg, &feed_pipeline);
-
-    camera_pipeline_cfg_t detect_feed_cfg = {
-        .elem_num = 4,
-        .elements = NULL,
-        .align_size = 1,
-        .caps = MALLOC_CAP_SPIRAM,
-        .buffer_size = 20 * sizeof(int),
-    };
-    camera_element_pipeline_new(&detect_feed_cfg, &detect_pipeline);
+    ESP_LOGI(TAG, "PSRAM free after camera init: %u", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
 
-#ifndef CONFIG_EXAMPLE_ENABLE_SD_CARD
+#if CONFIG_EXAMPLE_ENABLE_SD_CARD
+    const app_thumbnail_cfg_t thumb_cfg = APP_THUMBNAIL_DEFAULT_CONFIG(BSP_SD_MOUNT_POINT APP_THUMBNAIL_CACHE_NAME);
+    ESP_ERROR_CHECK(app_thumbnail_init(&thumb_cfg));
+#else
     ESP_LOGW(TAG, "SD card is not enabled, camera screenshot is not supported");
 #endif
 
@@ -385,172 +572,417 @@ void Camera::onScreenCameraShotBtnClick(lv_event_t *e)
         return ;
     }
     ESP_LOGI(TAG, "Screenshot saved to %s", filename);
+
+    // Screenshot names restart from 0 at boot, an older thumbnail of the same name must not be shown
+    app_thumbnail_invalidate(filename);
+    lv_img_dsc_t thumb;
+    if (app_thumbnail_acquire(filename, &thumb, NULL, NULL) == ESP_OK) {
+        app_thumbnail_release(filename);
+    }
 #endif
 }
 
-static bool ppa_trans_done_cb(ppa_client_handle_t ppa_client, ppa_event_data_t *event_data, void *user_data)
+static void display_frame_release(void)
 {
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    if (display_frame_index >= 0) {
+        app_video_frame_unref(display_frame_index);
+        display_frame_index = -1;
+    }
+}
 
+static void detect_scaler_done_cb(void *user_data)
+{
+    // Called from the PPA ISR, the pipeline is lock-free
     camera_pipeline_buffer_element *p = (camera_pipeline_buffer_element *)user_data;
     camera_pipeline_done_element(feed_pipeline, p);
-
-    return (xHigherPriorityTaskWoken == pdTRUE);
 }
 
-#if FPS_PRINT
-typedef struct {
-    int64_t start;
-    int64_t acc;
-    char str1[15];
-    char str2[15];
-} PerfCounter;
-static PerfCounter perf_counters[1] = {0};
-
-static void perfmon_start(int ctr, const char *fmt1, const char *fmt2, ...)
+static void feed_recycle_cb(camera_pipeline_buffer_element *element, void *user_ctx)
 {
-    va_list args;
-    va_start(args, fmt2);
-    vsnprintf(perf_counters[ctr].str1, sizeof(perf_counters[ctr].str1), fmt1, args);
-    vsnprintf(perf_counters[ctr].str2, sizeof(perf_counters[ctr].str2), fmt2, args);
-    va_end(args);
+    // The frame was never seen by the detector, give it back to the driver right away
+    if (element->frame_index >= 0) {
+        app_video_frame_unref(element->frame_index);
+        element->frame_index = -1;
+    }
+}
 
-    perf_counters[ctr].start = esp_timer_get_time();
+static void detect_latency_hook(int64_t preprocess_us, int64_t forward_us, int64_t postprocess_us)
+{
+    app_latency_record(APP_LATENCY_STAGE_DETECT_PRE, (uint32_t)preprocess_us);
+    app_latency_record(APP_LATENCY_STAGE_DETECT_FORWARD, (uint32_t)forward_us);
+    app_latency_record(APP_LATENCY_STAGE_DETECT_POST, (uint32_t)postprocess_us);
 }
 
-static void perfmon_end(int ctr, int count)
+static void face_worker_task(void *arg)
 {
-    int64_t time_diff = esp_timer_get_time() - perf_counters[ctr].start;
-    float time_in_sec = (float)time_diff / 1000000;
-    float frequency = count / time_in_sec;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (face_job.exit) {
+            break;
+        }
 
-    printf("Perf ctr[%d], [%15s][%15s]: %.2f FPS (%.2f ms per operation)\n",
-           ctr, perf_counters[ctr].str1, perf_counters[ctr].str2, frequency, time_in_sec * 1000 / count);
+        int64_t start_us = esp_timer_get_time();
+        int x1 = face_job.roi[0];
+        int y1 = face_job.roi[1];
+        int roi_w = face_job.roi[2] - x1 + 1;
+        int roi_h = face_job.roi[3] - y1 + 1;
+
+        face_result.count = 0;
+        if ((roi_w == (int)detect_width) && (roi_h == (int)detect_height)) {
+            app_humanface_detect((uint16_t *)face_job.frame, detect_width, detect_height,
+                                 CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE, &face_result);
+        } else if (face_crop_buffer && (roi_w >= FACE_ROI_MIN_SIZE) && (roi_h >= FACE_ROI_MIN_SIZE)) {
+            // The model takes a packed frame, copy the region into the preallocated crop buffer
+            for (int y = 0; y < roi_h; y++) {
+                memcpy(face_crop_buffer + y * roi_w, face_job.frame + (y1 + y) * detect_width + x1, roi_w * sizeof(uint16_t));
+            }
+            app_humanface_detect_region(face_crop_buffer, x1, y1, roi_w, roi_h, detect_width, detect_height,
+                                        CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE, &face_result);
+        }
+        face_inference_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+        xTaskNotifyGive(face_job.waiter);
+    }
+
+    xTaskNotifyGive(face_job.waiter);
+    vTaskDelete(NULL);
 }
+
+// Region where faces are searched in the combined mode, from the pedestrians found in the previous frame
+static void update_pedestrian_roi(const app_detect_result_t *result)
+{
+#if CONFIG_EXAMPLE_CAMERA_DETECT_FACE_IN_PEDESTRIAN_ROI
+    const int scale = CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE;
+    int roi[4] = {INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN};
+    bool found = false;
+
+    pedestrian_roi_valid = false;
+    for (uint32_t i = 0; i < result->count; i++) {
+        const app_detect_object_t *obj = &result->objects[i];
+        if (obj->model != APP_DETECT_MODEL_PEDESTRIAN) {
+            continue;
+        }
+        // Heads are in the upper half of a pedestrian box
+        roi[0] = MIN(roi[0], obj->box[0] / scale - FACE_ROI_MARGIN);
+        roi[1] = MIN(roi[1], obj->box[1] / scale - FACE_ROI_MARGIN);
+        roi[2] = MAX(roi[2], obj->box[2] / scale + FACE_ROI_MARGIN);
+        roi[3] = MAX(roi[3], (obj->box[1] + obj->box[3]) / 2 / scale + FACE_ROI_MARGIN);
+        found = true;
+    }
+    // No pedestrian: a face close to the camera is usually not seen as one, search the whole frame
+    if (!found) {
+        return;
+    }
+
+    roi[0] = MAX(roi[0], 0);
+    roi[1] = MAX(roi[1], 0);
+    roi[2] = MIN(roi[2], (int)detect_width - 1);
+    roi[3] = MIN(roi[3], (int)detect_height - 1);
+    if ((roi[2] < roi[0]) || (roi[3] < roi[1])) {
+        return;
+    }
+    int roi_area = (roi[2] - roi[0] + 1) * (roi[3] - roi[1] + 1);
+    if (roi_area * 100 > (int)(detect_width * detect_height) * FACE_ROI_FULL_FRAME_PERCENT) {
+        return;
+    }
+
+    memcpy(pedestrian_roi, roi, sizeof(pedestrian_roi));
+    pedestrian_roi_valid = true;
+#else
+    pedestrian_roi_valid = false;
 #endif
+}
+
+// Frame the face detector and the pedestrian ROI work on, `detect_width` x `detect_height`
+static uint16_t *get_detect_frame(const camera_pipeline_buffer_element *p)
+{
+    return (uint16_t *)((uint8_t *)p->buffer + detect_frame_offset);
+}
+
+static void run_pedestrian_detect(const camera_pipeline_buffer_element *p, app_detect_result_t *result)
+{
+    if (!pedestrian_input_valid) {
+        app_pedestrian_detect(get_detect_frame(p), detect_width, detect_height, CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE,
+                              result);
+        return;
+    }
+
+    // Already at the model input size and format, the boxes are mapped back through the scaled block
+    const app_detect_map_t map = {
+        .offset_x = (int)pedestrian_input.block.x,
+        .offset_y = (int)pedestrian_input.block.y,
+        .num_x = (int)pedestrian_input.block.width,
+        .den_x = (int)pedestrian_input.width,
+        .num_y = (int)pedestrian_input.block.height,
+        .den_y = (int)pedestrian_input.height,
+    };
+    app_pedestrian_detect_input((uint8_t *)p->buffer + pedestrian_input.offset, &map, result);
+}
+
+// Pedestrian on this core, face on the other one, over the same frame
+static void run_combined_detect(const camera_pipeline_buffer_element *p, app_detect_result_t *result)
+{
+    int64_t start_us = esp_timer_get_time();
+
+    if (pedestrian_roi_valid) {
+        memcpy(face_job.roi, pedestrian_roi, sizeof(face_job.roi));
+    } else {
+        face_job.roi[0] = 0;
+        face_job.roi[1] = 0;
+        face_job.roi[2] = detect_width - 1;
+        face_job.roi[3] = detect_height - 1;
+    }
+    face_job.frame = get_detect_frame(p);
+    face_job.waiter = xTaskGetCurrentTaskHandle();
+    xTaskNotifyGive(face_worker_handle);
+
+    run_pedestrian_detect(p, result);
+    uint32_t pedestrian_us = (uint32_t)(esp_timer_get_time() - start_us);
+    update_pedestrian_roi(result);
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    app_detect_result_append(result, &face_result, face_job.roi[0] * CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE,
+                             face_job.roi[1] * CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE);
+
+    combined_stats.frame_count++;
+    combined_stats.wall_us += esp_timer_get_time() - start_us;
+    combined_stats.pedestrian_us += pedestrian_us;
+    combined_stats.face_us += face_inference_us;
+}
 
 void Camera::camera_dectect_task(Camera *app)
 {
-    int res = 0;
-    while (1) {
-        xEventGroupWaitBits(camera_event_group, CAMERA_EVENT_TASK_RUN, pdFALSE, pdTRUE, portMAX_DELAY);
-        
-        if (xEventGroupGetBits(camera_event_group) & (CAMERA_EVENT_PED_DETECT | CAMERA_EVENT_HUMAN_DETECT)) {
-            camera_pipeline_buffer_element *p = camera_pipeline_recv_element(feed_pipeline, portMAX_DELAY);
-            if (p) {
-                if (xEventGroupGetBits(camera_event_group) & CAMERA_EVENT_PED_DETECT) {
-                    detect_results = app_pedestrian_detect((uint16_t *)p->buffer, app->_hor_res, app->_ver_res);
-                }  else {
-                    detect_results = app_humanface_detect((uint16_t *)p->buffer, app->_hor_res, app->_ver_res);
-                }
+    EventBits_t last_detect_bits = 0;
 
+    while (1) {
+        // Sleeps until the frame callback hands over a frame or `close` kicks the pipeline, no polling
+        camera_pipeline_buffer_element *p = camera_pipeline_recv_element(feed_pipeline, portMAX_DELAY);
+        EventBits_t bits = xEventGroupGetBits(camera_event_group);
+
+        if (bits & CAMERA_EVENT_DELETE) {
+            // Release frames still waiting for detection
+            while (p || (p = camera_pipeline_get_done_element(feed_pipeline))) {
+                feed_recycle_cb(p, NULL);
                 camera_pipeline_queue_element_index(feed_pipeline, p->index);
+                app_detect_scheduler_cancel(detect_scheduler);
+                p = NULL;
+            }
+            break;
+        }
+        if (!p) {
+            continue;
+        }
 
-                camera_pipeline_buffer_element *element = camera_pipeline_get_queued_element(detect_pipeline);
-                if (element) {
-                    element->detect_results = &detect_results;
+        // The mode is sampled once per frame, switching it does not restart the task
+        EventBits_t detect_bits = bits & (CAMERA_EVENT_PED_DETECT | CAMERA_EVENT_HUMAN_DETECT);
+        if (detect_bits != last_detect_bits) {
+            // The pedestrians of the previous mode say nothing about this frame
+            pedestrian_roi_valid = false;
+            last_detect_bits = detect_bits;
+        }
 
-                    camera_pipeline_done_element(detect_pipeline, element);
-                }
+        uint32_t inference_us = 0;
+        if (bits & (CAMERA_EVENT_PED_DETECT | CAMERA_EVENT_HUMAN_DETECT)) {
+            // Results are written straight into the buffer owned by this task, no allocation
+            app_detect_result_t *result = app_detect_exchange_get_write_buffer(detect_exchange);
+            int64_t detect_start_us = esp_timer_get_time();
+            if ((bits & CAMERA_EVENT_PED_DETECT) && (bits & CAMERA_EVENT_HUMAN_DETECT)) {
+                run_combined_detect(p, result);
+            } else if (bits & CAMERA_EVENT_PED_DETECT) {
+                run_pedestrian_detect(p, result);
+            }  else {
+                app_humanface_detect(get_detect_frame(p), detect_width, detect_height,
+                                     CONFIG_EXAMPLE_CAMERA_DETECT_DOWNSCALE, result);
             }
-            vTaskDelay(pdMS_TO_TICKS(5));
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(50));
+            inference_us = (uint32_t)(esp_timer_get_time() - detect_start_us);
+            app_latency_record(APP_LATENCY_STAGE_DETECT_TOTAL, inference_us);
+
+            result->frame_seq = p->frame_seq;
+            result->timestamp_us = p->timestamp_us;
+            app_detect_exchange_publish(detect_exchange);
         }
 
-        if (xEventGroupGetBits(camera_event_group) & CAMERA_EVENT_DELETE) {
-            delete_pedestrian_detect();
-            delete_humanface_detect();
+        int64_t capture_us = p->timestamp_us;
+        feed_recycle_cb(p, NULL);
+        camera_pipeline_queue_element_index(feed_pipeline, p->index);
 
-            ESP_LOGI(TAG, "Camera detect task exit");
-            vTaskDelete(NULL);
-        }
+        // Ready for the next frame
+        app_detect_scheduler_done(detect_scheduler, capture_us, inference_us);
     }
+
+    // Stop the face worker before its model goes away
+    face_job.exit = true;
+    face_job.waiter = xTaskGetCurrentTaskHandle();
+    xTaskNotifyGive(face_worker_handle);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    face_job.exit = false;
+    face_worker_handle = NULL;
+
+    // Models stay resident for the next launch as long as the cache budget allows it
+    app_model_cache_release(APP_MODEL_PEDESTRIAN);
+    app_model_cache_release(APP_MODEL_FACE);
+    app_model_cache_log_stats();
+
+    ESP_LOGI(TAG, "Camera detect task exit");
+    vTaskDelete(NULL);
 }
 
 static void camera_video_frame_operation(uint8_t *camera_buf, uint8_t camera_buf_index, 
                                        uint32_t camera_buf_hes, uint32_t camera_buf_ves, 
                                        size_t camera_buf_len)
 {
-    // Wait for task run event
-    xEventGroupWaitBits(camera_event_group, CAMERA_EVENT_TASK_RUN, pdFALSE, pdTRUE, portMAX_DELAY);
+    // Never block the stream task: while paused, frames go straight back to the driver
+    EventBits_t current_bits = xEventGroupGetBits(camera_event_group);
+    if (!(current_bits & CAMERA_EVENT_TASK_RUN)) {
+        return;
+    }
 
     // Check if AI detection is needed
-    EventBits_t current_bits = xEventGroupGetBits(camera_event_group);
-    bool is_detect_mode = current_bits & (CAMERA_EVENT_PED_DETECT | CAMERA_EVENT_HUMAN_DETECT);
-    
+    EventBits_t detect_bits = current_bits & (CAMERA_EVENT_PED_DETECT | CAMERA_EVENT_HUMAN_DETECT);
+    bool is_detect_mode = (detect_bits != 0);
+
+    static uint32_t frame_seq = 0;
+    static EventBits_t last_detect_bits = 0;
+    frame_seq++;
+
+    // Results of the previous mode must not be drawn
+    if (detect_bits != last_detect_bits) {
+        app_detect_exchange_clear(detect_exchange);
+        if (detect_tracker) {
+            app_tracker_reset(detect_tracker);
+        }
+        app_detect_scheduler_reset(detect_scheduler);
+        last_detect_bits = detect_bits;
+    }
+
+    bool scale_pending = false;
+    bool show_frame = true;
     if (is_detect_mode) {
         // Process input frame
-        camera_pipeline_buffer_element *input_element = camera_pipeline_get_queued_element(feed_pipeline);
+        camera_pipeline_buffer_element *input_element = NULL;
+        if (app_detect_scheduler_frame_ready(detect_scheduler)) {
+            // Other frames are not analysed, the tracker predicts their boxes
+            input_element = detect_spare_input ? detect_spare_input : camera_pipeline_get_queued_element(feed_pipeline);
+            detect_spare_input = NULL;
+            if (!input_element) {
+                app_detect_scheduler_cancel(detect_scheduler);
+            }
+        }
         if (input_element) {
-            input_element->buffer = reinterpret_cast<uint16_t*>(camera_buf);
-            camera_pipeline_done_element(feed_pipeline, input_element);
+            input_element->frame_seq = frame_seq;
+            input_element->timestamp_us = app_video_get_frame_timestamp(camera_buf_index);
+        }
+        if (input_element && detect_scaler) {
+            // Downscale asynchronously, the element is published from the scaler done callback
+            if (app_frame_scaler_submit(detect_scaler, camera_buf, input_element->buffer, input_element->valid_size,
+                                        input_element) == ESP_OK) {
+                scale_pending = true;
+            } else {
+                detect_spare_input = input_element;
+                app_detect_scheduler_cancel(detect_scheduler);
+            }
+        } else if (input_element) {
+            // Share the capture buffer with the detect task, it is re-queued once both sides released it
+            if (app_video_frame_ref(camera_buf_index) == ESP_OK) {
+                input_element->buffer = reinterpret_cast<uint16_t*>(camera_buf);
+                input_element->frame_index = camera_buf_index;
+                camera_pipeline_done_element(feed_pipeline, input_element);
+
+                // The detect task reads this frame from now on, the overlay must not be drawn into it. The
+                // previous frame stays on the canvas instead, one shown frame less per analysed one.
+                show_frame = false;
+            } else {
+                detect_spare_input = input_element;
+                app_detect_scheduler_cancel(detect_scheduler);
+            }
         }
 
-        // Get detection results
-        camera_pipeline_buffer_element *detect_element = camera_pipeline_recv_element(detect_pipeline, 0);
-        if (detect_element) {
-            // Process detection results
-            detect_keypoints.clear();
-            detect_bound.clear();
-            
-            for (const auto& res : *(detect_element->detect_results)) {
-                const auto& box = res.box;
-                // Check if bounding box is valid
-                if (box.size() >= 4 && std::any_of(box.begin(), box.end(), [](int v) { return v != 0; })) {
-                    detect_bound.push_back(box);
-
-                    // Process keypoints only in face detection mode
-                    if ((current_bits & CAMERA_EVENT_HUMAN_DETECT) && 
-                        res.keypoint.size() >= 10 && 
-                        std::any_of(res.keypoint.begin(), res.keypoint.end(), [](int v) { return v != 0; })) {
-                        detect_keypoints.push_back(res.keypoint);
-                    }
-                }
+        bool result_updated = false;
+        const app_detect_result_t *result = app_detect_exchange_read(detect_exchange, &result_updated);
+        if (detect_tracker) {
+            if (result_updated) {
+                app_tracker_update(detect_tracker, result);
             }
+            app_tracker_predict(detect_tracker, app_video_get_frame_timestamp(camera_buf_index), &tracked_result);
+            result = &tracked_result;
+        }
 
-            camera_pipeline_queue_element_index(detect_pipeline, detect_element->index);
+        // The scaler must have read the frame before the overlay is drawn into it
+        if (scale_pending && (app_frame_scaler_wait(detect_scaler, 100) != ESP_OK)) {
+            ESP_LOGW(TAG, "Detection frame scaling timeout");
         }
 
         // Draw detection results
-        uint16_t *rgb_buf = reinterpret_cast<uint16_t*>(camera_buf);
-        for (size_t i = 0; i < detect_bound.size(); i++) {
-            const auto& bound = detect_bound[i];
-            // Check if current bounding box is valid
-            if (bound.size() >= 4 && std::any_of(bound.begin(), bound.end(), [](int v) { return v != 0; })) {
-                // Draw bounding box
-                draw_rectangle_rgb(rgb_buf, camera_buf_hes, camera_buf_ves,
-                                 bound[0], bound[1], bound[2], bound[3],
-                                 0, 0, 255, 0, 0, 3);
-
-                // Draw keypoints in face detection mode
-                if ((current_bits & CAMERA_EVENT_HUMAN_DETECT) && 
-                    i < detect_keypoints.size() && 
-                    detect_keypoints[i].size() >= 10) {
-                    draw_green_points(rgb_buf, detect_keypoints[i]);
+        if (show_frame) {
+            int64_t overlay_start_us = esp_timer_get_time();
+            app_overlay_canvas_t canvas = {
+                .buffer = camera_buf,
+                .width = (int)camera_buf_hes,
+                .height = (int)camera_buf_ves,
+                .stride = 0,
+                .format = APP_OVERLAY_FMT_RGB565,
+                .swap_bytes = false,
+            };
+            for (uint32_t i = 0; i < result->count; i++) {
+                const app_detect_object_t *obj = &result->objects[i];
+                uint32_t box_color = (obj->model == APP_DETECT_MODEL_FACE) ? DETECT_FACE_BOX_COLOR : DETECT_BOX_COLOR;
+                app_overlay_draw_box(&canvas, obj->box[0], obj->box[1], obj->box[2], obj->box[3], DETECT_BOX_THICKNESS,
+                                     box_color);
+
+                // Score label on a box-colored background, above the box when there is room
+                char label[16];
+                int label_w, label_h;
+                if (obj->track_id) {
+                    snprintf(label, sizeof(label), "#%u %u%%", obj->track_id, obj->score);
+                } else {
+                    snprintf(label, sizeof(label), "%u%%", obj->score);
+                }
+                app_overlay_get_text_size(label, DETECT_LABEL_SCALE, &label_w, &label_h);
+                int label_x = obj->box[0];
+                int label_y = (obj->box[1] >= label_h + 4) ? (obj->box[1] - label_h - 4) : obj->box[1];
+                app_overlay_fill_rect(&canvas, label_x, label_y, label_x + label_w + 3, label_y + label_h + 3,
+                                      box_color);
+                app_overlay_draw_text(&canvas, label_x + 2, label_y + 2, label, DETECT_LABEL_SCALE, DETECT_LABEL_COLOR);
+
+                for (uint32_t k = 0; k < obj->keypoint_num; k++) {
+                    app_overlay_draw_point(&canvas, obj->keypoint[2 * k], obj->keypoint[2 * k + 1],
+                                           DETECT_KEYPOINT_RADIUS, DETECT_KEYPOINT_COLOR);
                 }
             }
+            app_latency_record(APP_LATENCY_STAGE_OVERLAY, (uint32_t)(esp_timer_get_time() - overlay_start_us));
         }
     }
 
     // Update display if not in delete state
-    if (!(current_bits & CAMERA_EVENT_DELETE) && bsp_display_lock(100)) {
-        if (ui_ImageCameraShotImage) {
-            lv_canvas_set_buffer(ui_ImageCameraShotImage, camera_buf, 
-                               camera_buf_hes, camera_buf_ves, 
-                               LV_IMG_CF_TRUE_COLOR);
+    if (show_frame && !(current_bits & CAMERA_EVENT_DELETE)) {
+        int64_t lock_start_us = esp_timer_get_time();
+        if (bsp_display_lock(100)) {
+            int64_t refresh_start_us = esp_timer_get_time();
+            app_latency_record(APP_LATENCY_STAGE_DISPLAY_LOCK, (uint32_t)(refresh_start_us - lock_start_us));
+            // LVGL may redraw the canvas until the next frame replaces it, so the shown capture buffer stays held
+            bool display_ref = (app_video_frame_ref(camera_buf_index) == ESP_OK);
+            if (ui_ImageCameraShotImage) {
+                lv_canvas_set_buffer(ui_ImageCameraShotImage, camera_buf, 
+                                   camera_buf_hes, camera_buf_ves, 
+                                   LV_IMG_CF_TRUE_COLOR);
+            }
+            lv_refr_now(NULL);
+            bsp_display_unlock();
+
+            // The previous frame is no longer on the canvas
+            display_frame_release();
+            if (display_ref) {
+                display_frame_index = camera_buf_index;
+            }
+
+            int64_t refresh_end_us = esp_timer_get_time();
+            app_latency_record(APP_LATENCY_STAGE_REFRESH, (uint32_t)(refresh_end_us - refresh_start_us));
+            app_latency_record(APP_LATENCY_STAGE_END_TO_END,
+                               (uint32_t)(refresh_end_us - app_video_get_frame_timestamp(camera_buf_index)));
         }
-        lv_refr_now(NULL);
-        bsp_display_unlock();
     }
 
-#if FPS_PRINT
-    static int count = 0;
-    if (count % 10 == 0) {
-        perfmon_start(0, "PFS", "camera");
-    } else if (count % 10 == 9) {
-        perfmon_end(0, 10);
-    }
-    count++;
+#if CONFIG_EXAMPLE_ENABLE_PRINT_FPS_RATE_VALUE
+    app_latency_log_periodic(CONFIG_EXAMPLE_CAMERA_LATENCY_LOG_PERIOD_MS);
 #endif
 }
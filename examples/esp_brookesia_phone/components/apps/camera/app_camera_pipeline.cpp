@@ -1,66 +1,157 @@
 #include <inttypes.h>
+#include <atomic>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include <string.h>
-#include <fcntl.h>
-#include <sys/ioctl.h>
-#include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/errno.h>
 #include "esp_err.h"
 #include "esp_log.h"
-#include "esp_timer.h"
 #include "esp_check.h"
-#include "linux/videodev2.h"
-#include "esp_video_init.h"
+#include "esp_heap_caps.h"
 
-#include "app_video.h"
 #include "app_camera_pipeline.hpp"
 
 #define ELEMENT_GET_BY_INDEX(vb, i)         (&(vb)->element[i])
-#define ELEMENT_SET_FREE(e)                 { (e)->free = true; }
-#define ELEMENT_SET_ALLOCATED(e)            { (e)->free = false; }
-#define ELEMENT_IS_FREE(e)                  ((e)->free == true)
+#define ELEMENT_INDEX_NONE                  (-1)
 
 static const char *TAG = "app_camera_pipeline";
 
+/**
+ * Single-producer/single-consumer ring of element indices.
+ *
+ * `head` is only written by the producer and `tail` only by the consumer, so no lock is needed.
+ * Both counters run freely and are masked on access, the capacity is a power of two.
+ */
+struct camera_pipeline_ring {
+    std::atomic<uint32_t> head;             /*!< Next slot to be written by the producer. */
+    std::atomic<uint32_t> tail;             /*!< Next slot to be read by the consumer. */
+    uint32_t mask;                          /*!< Capacity - 1. */
+    int16_t *slots;                         /*!< Element indices. */
+};
+
 struct camera_pipeline_stream {
-    bool started;                           /*!< Indicates whether the video stream has been started. */
+    camera_pipeline_mode_t mode;            /*!< Delivery mode of done elements. */
     int elem_num;                           /*!< The number of element available for the stream. */
 
-    camera_pipeline_buffer_list_t queued_list; /*!< List of buffer elements that are currently queued for processing. */
-    camera_pipeline_buffer_list_t done_list;   /*!< List of buffer elements that have been processed and are done. */
+    camera_pipeline_ring queued_ring;       /*!< Elements available to the producer, filled by the consumer. */
+    camera_pipeline_ring done_ring;         /*!< Elements published to the consumer (FIFO mode). */
+    camera_pipeline_ring recycle_ring;      /*!< Elements replaced before being consumed (LATEST mode). */
+    std::atomic<int32_t> latest;            /*!< Newest published element index (LATEST mode). */
+    camera_pipeline_recycle_cb_t recycle_cb;
+    void *recycle_ctx;
+
+    std::atomic<uint32_t> done_count;
+    std::atomic<uint32_t> recv_count;
+    std::atomic<uint32_t> drop_count;
+    std::atomic<uint32_t> overwrite_count;
 
     struct camera_pipeline_buffer_element *element; /*!< Pointer to the array of buffer elements used for storing image data. */
 
-    portMUX_TYPE stream_lock;              /*!< Mutex used for synchronizing access to the video stream's data structures. */
     SemaphoreHandle_t ready_sem;           /*!< Semaphore used for signaling when buffer elements are ready for processing. */
 };
 
+static inline __attribute__((always_inline)) void ring_init(camera_pipeline_ring *ring, int16_t *slots, uint32_t capacity)
+{
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+    ring->mask = capacity - 1;
+    ring->slots = slots;
+}
+
+static inline __attribute__((always_inline)) bool ring_push(camera_pipeline_ring *ring, int16_t index)
+{
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    uint32_t tail = ring->tail.load(std::memory_order_acquire);
+
+    if (head - tail > ring->mask) {
+        return false;
+    }
+    ring->slots[head & ring->mask] = index;
+    ring->head.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+static inline __attribute__((always_inline)) int16_t ring_pop(camera_pipeline_ring *ring)
+{
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+
+    if (head == tail) {
+        return ELEMENT_INDEX_NONE;
+    }
+    int16_t index = ring->slots[tail & ring->mask];
+    ring->tail.store(tail + 1, std::memory_order_release);
+
+    return index;
+}
+
+static uint32_t ring_capacity(int elem_num)
+{
+    uint32_t capacity = 1;
+
+    while (capacity < (uint32_t)elem_num) {
+        capacity <<= 1;
+    }
+
+    return capacity;
+}
+
+static void camera_pipeline_free(struct camera_pipeline_stream *stream)
+{
+    if (!stream) {
+        return;
+    }
+
+    if (stream->element) {
+        for (int i = 0; i < stream->elem_num; i++) {
+            if (stream->element[i].buffer && stream->element[i].internal) {
+                free(stream->element[i].buffer);
+            }
+        }
+        free(stream->element);
+    }
+
+    if (stream->ready_sem) {
+        vSemaphoreDelete(stream->ready_sem);
+    }
+    free(stream->queued_ring.slots);
+    free(stream->done_ring.slots);
+    free(stream->recycle_ring.slots);
+    free(stream);
+}
+
 esp_err_t camera_element_pipeline_new(camera_pipeline_cfg_t *cfg, pipeline_handle_t *ret_item)
 {
     esp_err_t ret = ESP_OK;
     struct camera_pipeline_stream *stream = NULL;
+    uint32_t capacity = 0;
 
-    ESP_GOTO_ON_FALSE(cfg && cfg->elem_num > 0, ESP_ERR_INVALID_ARG, err, TAG, "Invalid configuration: elem_num must be greater than 0.");
+    ESP_GOTO_ON_FALSE(cfg && cfg->elem_num > 0 && cfg->elem_num <= INT16_MAX, ESP_ERR_INVALID_ARG, err, TAG, "Invalid configuration: elem_num must be greater than 0.");
 
-    // stream = heap_caps_calloc(1, sizeof(struct camera_pipeline_stream), cfg->caps);
     stream = static_cast<camera_pipeline_stream*>(heap_caps_calloc(1, sizeof(camera_pipeline_stream), cfg->caps));
     ESP_GOTO_ON_FALSE(stream, ESP_ERR_NO_MEM, err, TAG, "Failed to allocate memory for camera_pipeline_stream.");
-    memset(stream, 0, sizeof(struct camera_pipeline_stream));
 
-    // stream->element = heap_caps_calloc(cfg->elem_num, sizeof(struct camera_pipeline_buffer_element), cfg->caps);
     stream->element = static_cast<camera_pipeline_buffer_element*>(
         heap_caps_calloc(cfg->elem_num, sizeof(camera_pipeline_buffer_element), cfg->caps)
     );
     ESP_GOTO_ON_FALSE(stream->element, ESP_ERR_NO_MEM, err, TAG, "Failed to allocate memory for camera_pipeline_buffer_element.");
 
-    SLIST_INIT(&stream->queued_list);
-    SLIST_INIT(&stream->done_list);
+    /* Ring slots are touched from the PPA ISR, keep them in internal RAM */
+    capacity = ring_capacity(cfg->elem_num);
+    ring_init(&stream->queued_ring, static_cast<int16_t *>(heap_caps_calloc(capacity, sizeof(int16_t), MALLOC_CAP_INTERNAL)), capacity);
+    ring_init(&stream->done_ring, static_cast<int16_t *>(heap_caps_calloc(capacity, sizeof(int16_t), MALLOC_CAP_INTERNAL)), capacity);
+    ring_init(&stream->recycle_ring, static_cast<int16_t *>(heap_caps_calloc(capacity, sizeof(int16_t), MALLOC_CAP_INTERNAL)), capacity);
+    ESP_GOTO_ON_FALSE(stream->queued_ring.slots && stream->done_ring.slots && stream->recycle_ring.slots, ESP_ERR_NO_MEM, err, TAG,
+                      "Failed to allocate memory for pipeline rings.");
 
-    portMUX_INITIALIZE(&stream->stream_lock);
+    stream->mode = cfg->mode;
+    stream->recycle_cb = cfg->recycle_cb;
+    stream->recycle_ctx = cfg->recycle_ctx;
+    stream->latest.store(ELEMENT_INDEX_NONE, std::memory_order_relaxed);
 
     stream->ready_sem = xSemaphoreCreateCounting(cfg->elem_num, 0);
     ESP_GOTO_ON_FALSE(stream->ready_sem, ESP_ERR_NO_MEM, err, TAG, "Failed to create done_sem for stream");
@@ -81,35 +172,19 @@ esp_err_t camera_element_pipeline_new(camera_pipeline_cfg_t *cfg, pipeline_handl
         }
 
         element->index = i;
+        element->frame_index = -1;
         element->valid_size = cfg->buffer_size;
-        ELEMENT_SET_FREE(element);
-        camera_pipeline_queue_element_index(stream, i);
         stream->elem_num++;
+        camera_pipeline_queue_element_index(stream, i);
         ESP_LOGI(TAG, "new elements[%d]:%p, internal:%d", i, element->buffer, element->internal);
     }
-    ESP_LOGI(TAG, "new pipeline %p, elem_num:%d", stream, stream->elem_num);
+    ESP_LOGI(TAG, "new pipeline %p, elem_num:%d, mode:%d", stream, stream->elem_num, stream->mode);
 
     *ret_item = (pipeline_handle_t)stream;
     return ESP_OK;
 
 err:
-    for (int i = 0; i < stream->elem_num; i++) {
-        if (stream->element[i].internal) {
-            free(stream->element[i].buffer);
-        }
-    }
-
-    if (stream->ready_sem) {
-        vSemaphoreDelete(stream->ready_sem);
-    }
-    portEXIT_CRITICAL(&stream->stream_lock);
-
-    if (stream->element) {
-        free(stream->element);
-    }
-    if (stream) {
-        free(stream);
-    }
+    camera_pipeline_free(stream);
     return ret;
 }
 
@@ -118,116 +193,107 @@ esp_err_t camera_element_pipeline_delete(pipeline_handle_t pipeline)
     struct camera_pipeline_stream *stream = (struct camera_pipeline_stream *)pipeline;
     ESP_RETURN_ON_FALSE(stream, ESP_ERR_INVALID_ARG, TAG, "Invalid pipeline handle");
 
-    for (int i = 0; i < stream->elem_num; i++) {
-        if (stream->element[i].buffer && stream->element[i].internal) {
-            free(stream->element[i].buffer);
-        }
-    }
-
-    if (stream->ready_sem) {
-        vSemaphoreDelete(stream->ready_sem);
-    }
-    portEXIT_CRITICAL(&stream->stream_lock);
-
-    free(stream->element);
-    free(stream);
+    camera_pipeline_free(stream);
 
     return ESP_OK;
 }
 
-esp_err_t camera_pipeline_queue_element(pipeline_handle_t pipline, struct camera_pipeline_buffer_element *element)
+esp_err_t camera_pipeline_get_stats(pipeline_handle_t pipline, camera_pipeline_stats_t *stats)
 {
     struct camera_pipeline_stream *stream = (struct camera_pipeline_stream *)pipline;
-    if (!stream) {
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    portENTER_CRITICAL_SAFE(&stream->stream_lock);
-    if (!ELEMENT_IS_FREE(element)) {
-        portEXIT_CRITICAL_SAFE(&stream->stream_lock);
-        return ESP_ERR_INVALID_ARG;
-    }
+    ESP_RETURN_ON_FALSE(stream && stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
 
-    ELEMENT_SET_ALLOCATED(element);
-    SLIST_INSERT_HEAD(&stream->queued_list, element, node);
-    portEXIT_CRITICAL_SAFE(&stream->stream_lock);
+    stats->done_count = stream->done_count.load(std::memory_order_relaxed);
+    stats->recv_count = stream->recv_count.load(std::memory_order_relaxed);
+    stats->drop_count = stream->drop_count.load(std::memory_order_relaxed);
+    stats->overwrite_count = stream->overwrite_count.load(std::memory_order_relaxed);
 
     return ESP_OK;
 }
 
 esp_err_t camera_pipeline_queue_element_index(pipeline_handle_t pipline, int index)
 {
-    esp_err_t ret;
-    struct camera_pipeline_buffer_element *element;
-
     struct camera_pipeline_stream *stream = (struct camera_pipeline_stream *)pipline;
-    if (!stream) {
+    if (!stream || index < 0 || index >= stream->elem_num) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    element = ELEMENT_GET_BY_INDEX(stream, index);
-    ret = camera_pipeline_queue_element(stream, element);
+    if (!ring_push(&stream->queued_ring, index)) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
-    return ret;
+    return ESP_OK;
 }
 
 struct camera_pipeline_buffer_element *camera_pipeline_get_queued_element(pipeline_handle_t pipline)
 {
-    struct camera_pipeline_buffer_element *element = NULL;
-
     struct camera_pipeline_stream *stream = (struct camera_pipeline_stream *)pipline;
     if (!stream) {
         return NULL;
     }
 
-    portENTER_CRITICAL_SAFE(&stream->stream_lock);
-    if (!SLIST_EMPTY(&stream->queued_list)) {
-        element = SLIST_FIRST(&stream->queued_list);
-        SLIST_REMOVE(&stream->queued_list, element, camera_pipeline_buffer_element, node);
-        ELEMENT_SET_FREE(element);
+    int16_t index = ELEMENT_INDEX_NONE;
+    if (stream->mode == CAMERA_PIPELINE_MODE_LATEST) {
+        index = ring_pop(&stream->recycle_ring);
+    }
+    if (index == ELEMENT_INDEX_NONE) {
+        index = ring_pop(&stream->queued_ring);
+    }
+    if (index == ELEMENT_INDEX_NONE) {
+        stream->drop_count.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
     }
-    portEXIT_CRITICAL_SAFE(&stream->stream_lock);
 
-    return element;
+    return ELEMENT_GET_BY_INDEX(stream, index);
 }
 
 struct camera_pipeline_buffer_element *camera_pipeline_get_done_element(pipeline_handle_t pipline)
 {
-    struct camera_pipeline_buffer_element *element = NULL;
-
     struct camera_pipeline_stream *stream = (struct camera_pipeline_stream *)pipline;
     if (!stream) {
         return NULL;
     }
 
-    portENTER_CRITICAL_SAFE(&stream->stream_lock);
-    if (!SLIST_EMPTY(&stream->done_list)) {
-        element = SLIST_FIRST(&stream->done_list);
-        SLIST_REMOVE(&stream->done_list, element, camera_pipeline_buffer_element, node);
-        ELEMENT_SET_FREE(element);
+    int32_t index;
+    if (stream->mode == CAMERA_PIPELINE_MODE_LATEST) {
+        index = stream->latest.exchange(ELEMENT_INDEX_NONE, std::memory_order_acq_rel);
+    } else {
+        index = ring_pop(&stream->done_ring);
+    }
+    if (index == ELEMENT_INDEX_NONE) {
+        return NULL;
     }
-    portEXIT_CRITICAL_SAFE(&stream->stream_lock);
+    stream->recv_count.fetch_add(1, std::memory_order_relaxed);
 
-    return element;
+    return ELEMENT_GET_BY_INDEX(stream, index);
 }
 
 esp_err_t IRAM_ATTR camera_pipeline_done_element(pipeline_handle_t pipline, struct camera_pipeline_buffer_element *element)
 {
     struct camera_pipeline_stream *stream = (struct camera_pipeline_stream *)pipline;
-    if (!stream) {
+    if (!stream || !element) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    portENTER_CRITICAL_SAFE(&stream->stream_lock);
-    if (!ELEMENT_IS_FREE(element)) {
-        portEXIT_CRITICAL_SAFE(&stream->stream_lock);
-        return ESP_ERR_INVALID_ARG;
+    if (stream->mode == CAMERA_PIPELINE_MODE_LATEST) {
+        int32_t old = stream->latest.exchange(element->index, std::memory_order_acq_rel);
+        stream->done_count.fetch_add(1, std::memory_order_relaxed);
+        if (old != ELEMENT_INDEX_NONE) {
+            /* The consumer did not pick up the previous element, hand it back to the producer side */
+            stream->overwrite_count.fetch_add(1, std::memory_order_relaxed);
+            if (stream->recycle_cb) {
+                stream->recycle_cb(ELEMENT_GET_BY_INDEX(stream, old), stream->recycle_ctx);
+            }
+            ring_push(&stream->recycle_ring, old);
+            return ESP_OK;
+        }
+    } else {
+        if (!ring_push(&stream->done_ring, element->index)) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        stream->done_count.fetch_add(1, std::memory_order_relaxed);
     }
 
-    ELEMENT_SET_ALLOCATED(element);
-    SLIST_INSERT_HEAD(&stream->done_list, element, node);
-    portEXIT_CRITICAL_SAFE(&stream->stream_lock);
-
     if (xPortInIsrContext()) {
         BaseType_t wakeup = pdFALSE;
 
@@ -261,3 +327,14 @@ struct camera_pipeline_buffer_element *camera_pipeline_recv_element(pipeline_han
 
     return element;
 }
+
+esp_err_t camera_pipeline_wakeup_recv(pipeline_handle_t pipline)
+{
+    struct camera_pipeline_stream *stream = (struct camera_pipeline_stream *)pipline;
+    ESP_RETURN_ON_FALSE(stream, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    // A full semaphore means the consumer is about to wake up anyway
+    xSemaphoreGive(stream->ready_sem);
+
+    return ESP_OK;
+}
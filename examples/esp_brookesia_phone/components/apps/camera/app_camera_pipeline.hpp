@@ -1,31 +1,35 @@
 #include <stdint.h>
 #include <stddef.h>
-#include <sys/queue.h>
 #include "esp_err.h"
+#include "esp_attr.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "pedestrian_detect.hpp"
 #include "esp_err.h"
 #include "linux/videodev2.h"
 
 /**
- * @brief Camera Image Recognition (IR) buffer element node type.
- *
- * Represents a single node in the singly linked list used for managing video buffer elements.
+ * @brief Camera Image Recognition (IR) pipeline delivery mode.
  */
-typedef SLIST_ENTRY(camera_pipeline_buffer_element) camera_pipeline_buffer_node_t;
+typedef enum {
+    CAMERA_PIPELINE_MODE_FIFO = 0,                    /*!< Done elements are received in the order they were published. */
+    CAMERA_PIPELINE_MODE_LATEST,                      /*!< Only the newest done element is kept, older unconsumed ones are recycled. */
+} camera_pipeline_mode_t;
+
+struct camera_pipeline_buffer_element;
 
 /**
- * @brief Camera Image Recognition (IR) buffer list type.
+ * @brief Callback invoked when an unconsumed element is replaced in LATEST mode.
  *
- * A singly linked list that contains all the video buffer elements.
+ * Runs in the context of `camera_pipeline_done_element` (task or ISR) before the element is
+ * recycled, so it can release resources attached to the element.
  */
-typedef SLIST_HEAD(camera_pipeline_buffer_list, camera_pipeline_buffer_element) camera_pipeline_buffer_list_t;
+typedef void (*camera_pipeline_recycle_cb_t)(struct camera_pipeline_buffer_element *element, void *user_ctx);
 
 /**
  * @brief Camera Image Recognition (IR) configuration structure.
  *
- * Holds configuration parameters for initializing the camera IR pipeline.
+ * Holds configuration parameters for initializing the camera IR pipeline. Buffers given in
+ * `elements` are only referenced; `buffer_size` bytes are allocated for the missing ones.
  */
 typedef struct {
     int elem_num;                                     /*!< Number of element available. */
@@ -33,8 +37,23 @@ typedef struct {
     uint32_t align_size;                              /*!< Buffer align size in byte */
     uint32_t caps;                                    /*!< Memory allocation capabilities (e.g., SPIRAM, DRAM). */
     uint32_t buffer_size;                             /*!< Size of each buffer in pixels. */
+    camera_pipeline_mode_t mode;                      /*!< Delivery mode of done elements. */
+    camera_pipeline_recycle_cb_t recycle_cb;          /*!< Optional callback for replaced elements (LATEST mode). */
+    void *recycle_ctx;                                /*!< User context passed to `recycle_cb`. */
 } camera_pipeline_cfg_t;
 
+/**
+ * @brief Camera Image Recognition (IR) pipeline statistics.
+ *
+ * All counters are free running and wrap around on overflow.
+ */
+typedef struct {
+    uint32_t done_count;                              /*!< Number of elements published with `camera_pipeline_done_element`. */
+    uint32_t recv_count;                              /*!< Number of done elements handed to the consumer. */
+    uint32_t drop_count;                              /*!< Number of times the producer found no queued element (frame dropped). */
+    uint32_t overwrite_count;                         /*!< Number of unconsumed elements replaced by a newer one (LATEST mode only). */
+} camera_pipeline_stats_t;
+
 /**
  * @brief Camera Image Recognition (IR) buffer element object.
  *
@@ -42,14 +61,14 @@ typedef struct {
  * used for image recognition tasks.
  */
 struct camera_pipeline_buffer_element {
-    bool free;                                        /*!< Indicates if this element is currently free and available for use. */
     bool internal;                                    /*!< Indicates if this element is malloced by internal. */
-    camera_pipeline_buffer_node_t node;               /*!< List node used to link elements in the buffer list. */
     uint32_t index;                                   /*!< The index of this buffer element in the list. */
     uint16_t *buffer;                                  /*!< Pointer to the buffer space used to store data. */
+    int frame_index;                                  /*!< Index of the capture buffer referenced by `buffer`, -1 if none. */
 
     uint32_t valid_size;                              /*!< Valid data size */
-    std::list<dl::detect::result_t> *detect_results;   /*!< List of detection results */
+    uint32_t frame_seq;                               /*!< Sequence number of the frame held by `buffer`. */
+    int64_t timestamp_us;                             /*!< Capture time of the frame held by `buffer`. */
 };
 
 /**
@@ -93,10 +112,21 @@ esp_err_t camera_element_pipeline_new(camera_pipeline_cfg_t *cfg, pipeline_handl
  */
 esp_err_t camera_element_pipeline_delete(pipeline_handle_t pipeline);
 
+/**
+ * @brief Get the statistics of a Camera Image Recognition (IR) pipeline.
+ *
+ * @param pipline Handle to the pipeline.
+ * @param stats Pointer to the structure receiving a snapshot of the counters.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if an argument is NULL.
+ */
+esp_err_t camera_pipeline_get_stats(pipeline_handle_t pipline, camera_pipeline_stats_t *stats);
+
 /**
  * @brief Queue an element index in the Camera Image Recognition (IR) pipeline.
  *
  * Queues a buffer element at the specified index for processing in the pipeline.
+ * Must only be called from the consumer side (the context receiving done elements).
  *
  * @param pipline Handle to the pipeline.
  * @param index Index of the buffer element to queue.
@@ -108,7 +138,8 @@ esp_err_t camera_pipeline_queue_element_index(pipeline_handle_t pipline, int ind
 /**
  * @brief Get a queued buffer element from the Camera Image Recognition (IR) pipeline.
  *
- * Retrieves the next queued buffer element for processing.
+ * Retrieves the next queued buffer element for processing. Queued elements are handed out
+ * in FIFO order. If none is available the drop counter is incremented.
  *
  * @param pipline Handle to the pipeline.
  *
@@ -119,7 +150,9 @@ struct camera_pipeline_buffer_element *camera_pipeline_get_queued_element(pipeli
 /**
  * @brief Mark a buffer element as done in the Camera Image Recognition (IR) pipeline.
  *
- * Marks the specified buffer element as processed and available for reuse.
+ * Publishes the specified buffer element to the consumer. This function is lock-free and
+ * may be called from ISR context (e.g. a PPA transaction done callback). In LATEST mode an
+ * unconsumed element is replaced and recycled to the producer side.
  *
  * @param pipline Handle to the pipeline.
  * @param element Pointer to the buffer element to mark as done.
@@ -150,3 +183,14 @@ struct camera_pipeline_buffer_element *camera_pipeline_get_done_element(pipeline
  * @return Pointer to the received buffer element, or NULL if the timeout expires.
  */
 struct camera_pipeline_buffer_element *camera_pipeline_recv_element(pipeline_handle_t pipline, uint32_t ticks);
+
+/**
+ * @brief Wake up a consumer blocked in `camera_pipeline_recv_element`, which then returns NULL.
+ *
+ * Used to deliver a command (mode change, exit) to a consumer that only waits for elements.
+ *
+ * @param pipline Handle to the pipeline.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the handle is NULL.
+ */
+esp_err_t camera_pipeline_wakeup_recv(pipeline_handle_t pipline);
@@ -0,0 +1,155 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <atomic>
+#include <new>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "app_detect_result.hpp"
+
+#define EXCHANGE_INDEX_MASK     (0x3)
+#define EXCHANGE_FRESH          (0x4)
+
+struct app_detect_exchange_t {
+    app_detect_result_t buffers[3];
+    std::atomic<uint32_t> middle;       // Index of the shared buffer, with EXCHANGE_FRESH once published
+    uint32_t back;                      // Owned by the writer
+    uint32_t front;                     // Owned by the reader
+};
+
+static const char *TAG = "app_detect_result";
+
+static inline int16_t clamp_coord(int value)
+{
+    return (int16_t)((value > INT16_MAX) ? INT16_MAX : ((value < INT16_MIN) ? INT16_MIN : value));
+}
+
+static inline int16_t map_coord(int value, int offset, int num, int den)
+{
+    return clamp_coord(offset + value * num / den);
+}
+
+void app_detect_result_fill(app_detect_result_t *result, const std::list<dl::detect::result_t> &list, int scale,
+                            app_detect_model_t model)
+{
+    const app_detect_map_t map = {0, 0, scale, 1, scale, 1};
+
+    app_detect_result_fill_map(result, list, &map, model);
+}
+
+void app_detect_result_fill_map(app_detect_result_t *result, const std::list<dl::detect::result_t> &list,
+                                const app_detect_map_t *map, app_detect_model_t model)
+{
+    uint32_t count = 0;
+
+    for (const auto &res : list) {
+        if (count >= APP_DETECT_RESULT_MAX) {
+            break;
+        }
+        if ((res.box.size() < 4) || !(res.box[0] | res.box[1] | res.box[2] | res.box[3])) {
+            continue;
+        }
+
+        app_detect_object_t *obj = &result->objects[count++];
+        for (int i = 0; i < 4; i += 2) {
+            obj->box[i] = map_coord(res.box[i], map->offset_x, map->num_x, map->den_x);
+            obj->box[i + 1] = map_coord(res.box[i + 1], map->offset_y, map->num_y, map->den_y);
+        }
+
+        bool has_keypoint = false;
+        size_t keypoint_num = res.keypoint.size() / 2;
+        if (keypoint_num > APP_DETECT_KEYPOINT_MAX) {
+            keypoint_num = APP_DETECT_KEYPOINT_MAX;
+        }
+        for (size_t i = 0; i < keypoint_num * 2; i += 2) {
+            obj->keypoint[i] = map_coord(res.keypoint[i], map->offset_x, map->num_x, map->den_x);
+            obj->keypoint[i + 1] = map_coord(res.keypoint[i + 1], map->offset_y, map->num_y, map->den_y);
+            has_keypoint |= (res.keypoint[i] != 0) || (res.keypoint[i + 1] != 0);
+        }
+        obj->track_id = 0;
+        obj->keypoint_num = has_keypoint ? keypoint_num : 0;
+        obj->model = (uint8_t)model;
+        obj->category = (uint8_t)res.category;
+        obj->score = (uint8_t)(res.score * 100 + 0.5f);
+    }
+    result->count = count;
+}
+
+void app_detect_result_append(app_detect_result_t *result, const app_detect_result_t *other, int offset_x, int offset_y)
+{
+    for (uint32_t i = 0; (i < other->count) && (result->count < APP_DETECT_RESULT_MAX); i++) {
+        app_detect_object_t *obj = &result->objects[result->count++];
+        *obj = other->objects[i];
+        for (int k = 0; k < 4; k += 2) {
+            obj->box[k] = clamp_coord(obj->box[k] + offset_x);
+            obj->box[k + 1] = clamp_coord(obj->box[k + 1] + offset_y);
+        }
+        for (int k = 0; k < obj->keypoint_num; k++) {
+            obj->keypoint[2 * k] = clamp_coord(obj->keypoint[2 * k] + offset_x);
+            obj->keypoint[2 * k + 1] = clamp_coord(obj->keypoint[2 * k + 1] + offset_y);
+        }
+    }
+}
+
+esp_err_t app_detect_exchange_new(app_detect_exchange_handle_t *ret_handle)
+{
+    ESP_RETURN_ON_FALSE(ret_handle, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    // Internal RAM, both cores touch it every frame
+    void *mem = heap_caps_calloc(1, sizeof(app_detect_exchange_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(mem, ESP_ERR_NO_MEM, TAG, "No memory for detect exchange");
+
+    app_detect_exchange_t *exchange = new (mem) app_detect_exchange_t();
+    exchange->back = 0;
+    exchange->middle.store(1, std::memory_order_relaxed);
+    exchange->front = 2;
+    *ret_handle = exchange;
+
+    return ESP_OK;
+}
+
+void app_detect_exchange_del(app_detect_exchange_handle_t handle)
+{
+    if (handle) {
+        handle->~app_detect_exchange_t();
+        heap_caps_free(handle);
+    }
+}
+
+app_detect_result_t *app_detect_exchange_get_write_buffer(app_detect_exchange_handle_t handle)
+{
+    return &handle->buffers[handle->back];
+}
+
+void app_detect_exchange_publish(app_detect_exchange_handle_t handle)
+{
+    // Release makes the buffer content visible to the reader acquiring it
+    uint32_t prev = handle->middle.exchange(handle->back | EXCHANGE_FRESH, std::memory_order_acq_rel);
+    handle->back = prev & EXCHANGE_INDEX_MASK;
+}
+
+const app_detect_result_t *app_detect_exchange_read(app_detect_exchange_handle_t handle, bool *updated)
+{
+    bool fresh = handle->middle.load(std::memory_order_relaxed) & EXCHANGE_FRESH;
+
+    if (fresh) {
+        uint32_t prev = handle->middle.exchange(handle->front, std::memory_order_acq_rel);
+        handle->front = prev & EXCHANGE_INDEX_MASK;
+    }
+    if (updated) {
+        *updated = fresh;
+    }
+
+    return &handle->buffers[handle->front];
+}
+
+void app_detect_exchange_clear(app_detect_exchange_handle_t handle)
+{
+    // Take the pending result, if any, and empty the reader buffer
+    app_detect_exchange_read(handle, NULL);
+    handle->buffers[handle->front].count = 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <list>
+#include "esp_err.h"
+#include "dl_detect_define.hpp"
+
+#define APP_DETECT_RESULT_MAX           (16)    /*!< Maximum number of objects kept per frame. */
+#define APP_DETECT_KEYPOINT_MAX         (5)     /*!< Maximum number of (x, y) keypoints per object. */
+
+/**
+ * @brief Model an object was detected by.
+ */
+typedef enum {
+    APP_DETECT_MODEL_PEDESTRIAN = 0,
+    APP_DETECT_MODEL_FACE,
+} app_detect_model_t;
+
+/**
+ * @brief One detected object, in capture frame coordinates.
+ */
+typedef struct {
+    int16_t box[4];                                   /*!< Bounding box: left, top, right, bottom. */
+    int16_t keypoint[APP_DETECT_KEYPOINT_MAX * 2];    /*!< Keypoints as (x, y) pairs. */
+    uint16_t track_id;                                /*!< Track identifier, 0 if the object is not tracked. */
+    uint8_t keypoint_num;                             /*!< Number of valid keypoints. */
+    uint8_t model;                                    /*!< Model that detected the object, see `app_detect_model_t`. */
+    uint8_t category;                                 /*!< Model category of the object. */
+    uint8_t score;                                    /*!< Confidence in percent. */
+} app_detect_object_t;
+
+/**
+ * @brief Detection results of one frame. Plain old data, it is never allocated on the frame path.
+ */
+typedef struct {
+    uint32_t frame_seq;                               /*!< Sequence number of the analysed frame. */
+    int64_t timestamp_us;                             /*!< Capture time of the analysed frame (`esp_timer` base). */
+    uint32_t count;                                   /*!< Number of valid entries in `objects`. */
+    app_detect_object_t objects[APP_DETECT_RESULT_MAX];   /*!< Detected objects. */
+} app_detect_result_t;
+
+/**
+ * @brief Mapping from the coordinates of an analysed frame back to the capture frame.
+ *
+ * A capture coordinate is `offset + coordinate * num / den`, on each axis.
+ */
+typedef struct {
+    int offset_x;
+    int offset_y;
+    int num_x;
+    int den_x;
+    int num_y;
+    int den_y;
+} app_detect_map_t;
+
+/**
+ * @brief Handle of a detection result exchange.
+ *
+ * Triple buffer between one writer (detect task) and one reader (frame callback): each side owns one
+ * buffer and the third one is swapped with a single atomic exchange. Neither side ever blocks, waits
+ * for the other or sees a partially written result.
+ */
+typedef struct app_detect_exchange_t *app_detect_exchange_handle_t;
+
+/**
+ * @brief Convert esp-dl detection results into a result block.
+ *
+ * Objects with an empty box are skipped and at most `APP_DETECT_RESULT_MAX` objects are kept.
+ * `frame_seq` and `timestamp_us` are left untouched.
+ *
+ * @param result Result block to fill.
+ * @param list Results returned by the detector.
+ * @param scale Factor applied to every coordinate, to map them back to the capture resolution.
+ * @param model Model the results come from.
+ */
+void app_detect_result_fill(app_detect_result_t *result, const std::list<dl::detect::result_t> &list, int scale,
+                            app_detect_model_t model);
+
+/**
+ * @brief Convert esp-dl detection results into a result block, for frames that are not a plain downscale.
+ *
+ * Same as `app_detect_result_fill`, with every coordinate mapped through `map`.
+ *
+ * @param result Result block to fill.
+ * @param list Results returned by the detector.
+ * @param map Mapping back to the capture resolution.
+ * @param model Model the results come from.
+ */
+void app_detect_result_fill_map(app_detect_result_t *result, const std::list<dl::detect::result_t> &list,
+                                const app_detect_map_t *map, app_detect_model_t model);
+
+/**
+ * @brief Append the objects of one result block to another, as long as there is room.
+ *
+ * @param result Result block to extend.
+ * @param other Objects to append.
+ * @param offset_x Added to every x coordinate of the appended objects.
+ * @param offset_y Added to every y coordinate of the appended objects.
+ */
+void app_detect_result_append(app_detect_result_t *result, const app_detect_result_t *other, int offset_x, int offset_y);
+
+/**
+ * @brief Create a detection result exchange. All buffers start empty.
+ *
+ * @param ret_handle Returned handle.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid argument, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_detect_exchange_new(app_detect_exchange_handle_t *ret_handle);
+
+/**
+ * @brief Delete a detection result exchange.
+ *
+ * @param handle Handle of the exchange, may be NULL.
+ */
+void app_detect_exchange_del(app_detect_exchange_handle_t handle);
+
+/**
+ * @brief Get the buffer owned by the writer.
+ *
+ * The buffer may hold stale data from an older frame and must be filled completely before publishing.
+ *
+ * @param handle Handle of the exchange.
+ * @return Writer buffer.
+ */
+app_detect_result_t *app_detect_exchange_get_write_buffer(app_detect_exchange_handle_t handle);
+
+/**
+ * @brief Publish the writer buffer. The writer gets a new buffer to fill.
+ *
+ * @param handle Handle of the exchange.
+ */
+void app_detect_exchange_publish(app_detect_exchange_handle_t handle);
+
+/**
+ * @brief Get the latest published result.
+ *
+ * The returned buffer is owned by the reader and stays valid until its next call.
+ *
+ * @param handle Handle of the exchange.
+ * @param updated Set to true if a new result was published since the previous call, may be NULL.
+ * @return Latest result, empty if nothing was published yet.
+ */
+const app_detect_result_t *app_detect_exchange_read(app_detect_exchange_handle_t handle, bool *updated);
+
+/**
+ * @brief Drop the published results, e.g. when the detection mode changes. Must be called by the reader.
+ *
+ * @param handle Handle of the exchange.
+ */
+void app_detect_exchange_clear(app_detect_exchange_handle_t handle);
@@ -0,0 +1,139 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "app_detect_scheduler.h"
+
+#define SCHEDULER_AVG_SHIFT         (3)     // Moving averages weight a new sample by 1/8
+
+struct app_detect_scheduler_t {
+    app_detect_scheduler_cfg_t cfg;
+    atomic_bool busy;                       // Set by the producer, cleared by the detector
+    atomic_uint interval;                   // Written by the detector, read by the producer
+    atomic_uint inference_avg_us;
+    atomic_uint latency_avg_us;
+    uint32_t frames_since_feed;             // Producer only
+    atomic_uint fed_count;
+    atomic_uint busy_skip_count;
+    atomic_uint interval_skip_count;
+};
+
+static const char *TAG = "app_detect_sched";
+
+static inline uint32_t moving_average(uint32_t avg, uint32_t sample)
+{
+    if (avg == 0) {
+        return sample;
+    }
+
+    return avg + (((int32_t)sample - (int32_t)avg) >> SCHEDULER_AVG_SHIFT);
+}
+
+esp_err_t app_detect_scheduler_new(const app_detect_scheduler_cfg_t *cfg, app_detect_scheduler_handle_t *ret_handle)
+{
+    ESP_RETURN_ON_FALSE(cfg && ret_handle, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(cfg->min_interval >= 1 && cfg->max_interval >= cfg->min_interval, ESP_ERR_INVALID_ARG, TAG,
+                        "Invalid interval range");
+
+    app_detect_scheduler_handle_t sched = calloc(1, sizeof(struct app_detect_scheduler_t));
+    ESP_RETURN_ON_FALSE(sched, ESP_ERR_NO_MEM, TAG, "No memory for detect scheduler");
+
+    sched->cfg = *cfg;
+    atomic_init(&sched->interval, cfg->min_interval);
+    // The first frame is analysed right away
+    sched->frames_since_feed = cfg->max_interval;
+    *ret_handle = sched;
+
+    return ESP_OK;
+}
+
+void app_detect_scheduler_del(app_detect_scheduler_handle_t handle)
+{
+    free(handle);
+}
+
+bool app_detect_scheduler_frame_ready(app_detect_scheduler_handle_t handle)
+{
+    if (handle->frames_since_feed < UINT32_MAX) {
+        handle->frames_since_feed++;
+    }
+    if (handle->frames_since_feed < atomic_load_explicit(&handle->interval, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&handle->interval_skip_count, 1, memory_order_relaxed);
+        return false;
+    }
+
+    bool expected = false;
+    if (!atomic_compare_exchange_strong(&handle->busy, &expected, true)) {
+        atomic_fetch_add_explicit(&handle->busy_skip_count, 1, memory_order_relaxed);
+        return false;
+    }
+
+    handle->frames_since_feed = 0;
+    atomic_fetch_add_explicit(&handle->fed_count, 1, memory_order_relaxed);
+
+    return true;
+}
+
+void app_detect_scheduler_cancel(app_detect_scheduler_handle_t handle)
+{
+    atomic_fetch_sub_explicit(&handle->fed_count, 1, memory_order_relaxed);
+    handle->frames_since_feed = handle->cfg.max_interval;
+    atomic_store(&handle->busy, false);
+}
+
+void app_detect_scheduler_done(app_detect_scheduler_handle_t handle, int64_t capture_us, uint32_t inference_us)
+{
+    int64_t latency_us = esp_timer_get_time() - capture_us;
+    if (latency_us < 0) {
+        latency_us = 0;
+    }
+
+    uint32_t inference_avg = moving_average(atomic_load_explicit(&handle->inference_avg_us, memory_order_relaxed),
+                                            inference_us);
+    uint32_t latency_avg = moving_average(atomic_load_explicit(&handle->latency_avg_us, memory_order_relaxed),
+                                          (uint32_t)latency_us);
+    atomic_store_explicit(&handle->inference_avg_us, inference_avg, memory_order_relaxed);
+    atomic_store_explicit(&handle->latency_avg_us, latency_avg, memory_order_relaxed);
+
+    // Back off fast when over the target, come back slowly
+    if (handle->cfg.target_latency_ms) {
+        uint32_t target_us = handle->cfg.target_latency_ms * 1000;
+        uint32_t interval = atomic_load_explicit(&handle->interval, memory_order_relaxed);
+        if ((latency_avg > target_us) && (interval < handle->cfg.max_interval)) {
+            interval = (interval * 2 > handle->cfg.max_interval) ? handle->cfg.max_interval : interval * 2;
+        } else if ((latency_avg < target_us / 4 * 3) && (interval > handle->cfg.min_interval)) {
+            interval--;
+        }
+        atomic_store_explicit(&handle->interval, interval, memory_order_relaxed);
+    }
+
+    atomic_store(&handle->busy, false);
+}
+
+void app_detect_scheduler_reset(app_detect_scheduler_handle_t handle)
+{
+    atomic_store_explicit(&handle->interval, handle->cfg.min_interval, memory_order_relaxed);
+    atomic_store_explicit(&handle->inference_avg_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&handle->latency_avg_us, 0, memory_order_relaxed);
+    handle->frames_since_feed = handle->cfg.max_interval;
+}
+
+esp_err_t app_detect_scheduler_get_stats(app_detect_scheduler_handle_t handle, app_detect_scheduler_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(handle && stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    stats->fed_count = atomic_load(&handle->fed_count);
+    stats->busy_skip_count = atomic_load(&handle->busy_skip_count);
+    stats->interval_skip_count = atomic_load(&handle->interval_skip_count);
+    stats->interval = atomic_load(&handle->interval);
+    stats->inference_avg_us = atomic_load(&handle->inference_avg_us);
+    stats->latency_avg_us = atomic_load(&handle->latency_avg_us);
+
+    return ESP_OK;
+}
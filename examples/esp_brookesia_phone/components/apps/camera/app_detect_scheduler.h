@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Detection scheduler configuration.
+ *
+ * A frame is handed to the detector only when the detector is idle and at least `interval` frames
+ * went by since the previous one, so frames are never queued behind a running inference. The
+ * interval starts at `min_interval`. With a target latency it doubles while the capture-to-result
+ * latency is above the target and decreases by one once it is back under 3/4 of the target.
+ */
+typedef struct {
+    uint32_t min_interval;              /*!< Smallest number of frames between two analysed frames, at least 1. */
+    uint32_t max_interval;              /*!< Largest number of frames between two analysed frames. */
+    uint32_t target_latency_ms;         /*!< Capture-to-result latency target, 0 to only follow the inference time. */
+} app_detect_scheduler_cfg_t;
+
+/**
+ * @brief Detection scheduler statistics.
+ */
+typedef struct {
+    uint32_t fed_count;                 /*!< Frames handed to the detector. */
+    uint32_t busy_skip_count;           /*!< Frames skipped because the detector was busy. */
+    uint32_t interval_skip_count;       /*!< Frames skipped because of the current interval. */
+    uint32_t interval;                  /*!< Current interval in frames. */
+    uint32_t inference_avg_us;          /*!< Moving average of the inference time. */
+    uint32_t latency_avg_us;            /*!< Moving average of the capture-to-result latency. */
+} app_detect_scheduler_stats_t;
+
+typedef struct app_detect_scheduler_t *app_detect_scheduler_handle_t;
+
+/**
+ * @brief Create a detection scheduler.
+ *
+ * @param cfg Scheduler configuration.
+ * @param ret_handle Returned handle.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid argument, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_detect_scheduler_new(const app_detect_scheduler_cfg_t *cfg, app_detect_scheduler_handle_t *ret_handle);
+
+/**
+ * @brief Delete a detection scheduler.
+ *
+ * @param handle Handle of the scheduler, may be NULL.
+ */
+void app_detect_scheduler_del(app_detect_scheduler_handle_t handle);
+
+/**
+ * @brief Decide whether a new frame goes to the detector. Called by the frame producer for every frame.
+ *
+ * On true the detector is marked busy: the frame must then be handed over, or given back with
+ * `app_detect_scheduler_cancel` if that fails.
+ *
+ * @param handle Handle of the scheduler.
+ * @return true if the frame should be analysed.
+ */
+bool app_detect_scheduler_frame_ready(app_detect_scheduler_handle_t handle);
+
+/**
+ * @brief Cancel the last accepted frame, it was not handed to the detector.
+ *
+ * @param handle Handle of the scheduler.
+ */
+void app_detect_scheduler_cancel(app_detect_scheduler_handle_t handle);
+
+/**
+ * @brief Report a finished inference. Called by the detector, marks it idle.
+ *
+ * @param handle Handle of the scheduler.
+ * @param capture_us Capture time of the analysed frame (`esp_timer` base).
+ * @param inference_us Time spent in the detector.
+ */
+void app_detect_scheduler_done(app_detect_scheduler_handle_t handle, int64_t capture_us, uint32_t inference_us);
+
+/**
+ * @brief Restart from `min_interval` and forget the averages, e.g. after a detection mode switch.
+ *
+ * @param handle Handle of the scheduler.
+ */
+void app_detect_scheduler_reset(app_detect_scheduler_handle_t handle);
+
+/**
+ * @brief Get the scheduler statistics.
+ *
+ * @param handle Handle of the scheduler.
+ * @param stats Returned statistics.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid argument.
+ */
+esp_err_t app_detect_scheduler_get_stats(app_detect_scheduler_handle_t handle, app_detect_scheduler_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,250 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_cache.h"
+#include "driver/ppa.h"
+#include "app_frame_scaler.h"
+
+#define ALIGN_UP_BY(num, align) (((num) + ((align) - 1)) & ~((align) - 1))
+
+static const char *TAG = "app_frame_scaler";
+
+typedef struct {
+    app_frame_scaler_output_t layout;
+    size_t region_size;                 // Bytes up to the next output, the PPA writes whole cache lines
+    uint32_t steps_x;                   // PPA scale in 1/16 steps
+    uint32_t steps_y;
+} scaler_output_t;
+
+struct app_frame_scaler_t {
+    app_frame_scaler_cfg_t cfg;
+    scaler_output_t outputs[APP_FRAME_SCALER_OUTPUT_MAX];
+    size_t output_size;
+    ppa_client_handle_t ppa_client;
+    SemaphoreHandle_t done_sem;
+    atomic_uint pending;                // PPA transactions of the frame in flight
+    bool failed;                        // A transaction of the frame in flight could not be queued
+    void *user_data;
+};
+
+static bool ppa_trans_done_cb(ppa_client_handle_t ppa_client, ppa_event_data_t *event_data, void *user_data)
+{
+    struct app_frame_scaler_t *scaler = (struct app_frame_scaler_t *)user_data;
+    BaseType_t need_yield = pdFALSE;
+
+    // The frame is done with its last output
+    if (atomic_fetch_sub(&scaler->pending, 1) != 1) {
+        return false;
+    }
+    if (scaler->cfg.done_cb && !scaler->failed) {
+        scaler->cfg.done_cb(scaler->user_data);
+    }
+    xSemaphoreGiveFromISR(scaler->done_sem, &need_yield);
+
+    return (need_yield == pdTRUE);
+}
+
+esp_err_t app_frame_scaler_new(const app_frame_scaler_cfg_t *cfg, app_frame_scaler_handle_t *ret_handle)
+{
+    esp_err_t ret = ESP_OK;
+    struct app_frame_scaler_t *scaler = NULL;
+
+    size_t align = 0;
+
+    ESP_RETURN_ON_FALSE(cfg && ret_handle, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(cfg->output_num > 0 && cfg->output_num <= APP_FRAME_SCALER_OUTPUT_MAX, ESP_ERR_INVALID_ARG,
+                        TAG, "Invalid output number");
+    ESP_RETURN_ON_ERROR(esp_cache_get_alignment(MALLOC_CAP_SPIRAM, &align), TAG, "Get cache alignment failed");
+
+    scaler = (struct app_frame_scaler_t *)calloc(1, sizeof(struct app_frame_scaler_t));
+    ESP_RETURN_ON_FALSE(scaler, ESP_ERR_NO_MEM, TAG, "No memory for scaler");
+
+    scaler->cfg = *cfg;
+    for (uint32_t i = 0; i < cfg->output_num; i++) {
+        const app_frame_scaler_output_cfg_t *out_cfg = &cfg->outputs[i];
+        scaler_output_t *out = &scaler->outputs[i];
+        app_frame_scaler_block_t *block = &out->layout.block;
+
+        ESP_GOTO_ON_FALSE(!out_cfg->rgb_swap || (out_cfg->format == APP_FRAME_SCALER_FMT_RGB888), ESP_ERR_INVALID_ARG,
+                          err, TAG, "RGB swap is only supported for RGB888 output");
+        ESP_GOTO_ON_FALSE(app_frame_scaler_fit(cfg->src_width, out_cfg->width, &block->x, &block->width, &out->steps_x) &&
+                          app_frame_scaler_fit(cfg->src_height, out_cfg->height, &block->y, &block->height,
+                                               &out->steps_y), ESP_ERR_INVALID_ARG, err, TAG,
+                          "Output %" PRIu32 " larger than the source", i);
+        out->layout.offset = scaler->output_size;
+        out->layout.width = out_cfg->width;
+        out->layout.height = out_cfg->height;
+        out->layout.size = out_cfg->width * out_cfg->height * ((out_cfg->format == APP_FRAME_SCALER_FMT_RGB888) ? 3 : 2);
+        out->region_size = ALIGN_UP_BY(out->layout.size, align);
+        scaler->output_size += out->region_size;
+    }
+
+    scaler->done_sem = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(scaler->done_sem, ESP_ERR_NO_MEM, err, TAG, "Create done semaphore failed");
+    xSemaphoreGive(scaler->done_sem);
+
+    if (cfg->use_ppa) {
+        ppa_client_config_t srm_config = {
+            .oper_type = PPA_OPERATION_SRM,
+            .max_pending_trans_num = cfg->output_num,
+        };
+        ESP_GOTO_ON_ERROR(ppa_register_client(&srm_config, &scaler->ppa_client), err, TAG, "Register PPA client failed");
+
+        ppa_event_callbacks_t cbs = {
+            .on_trans_done = ppa_trans_done_cb,
+        };
+        ESP_GOTO_ON_ERROR(ppa_client_register_event_callbacks(scaler->ppa_client, &cbs), err, TAG, "Register PPA callback failed");
+    }
+
+    for (uint32_t i = 0; i < cfg->output_num; i++) {
+        const app_frame_scaler_output_t *layout = &scaler->outputs[i].layout;
+        ESP_LOGI(TAG, "%" PRIu32 "x%" PRIu32 " at (%" PRIu32 ", %" PRIu32 ") -> %" PRIu32 "x%" PRIu32 " %s (%s)",
+                 layout->block.width, layout->block.height, layout->block.x, layout->block.y, layout->width,
+                 layout->height, (cfg->outputs[i].format == APP_FRAME_SCALER_FMT_RGB888) ? "RGB888" : "RGB565",
+                 cfg->use_ppa ? "PPA" : "software");
+    }
+
+    *ret_handle = scaler;
+    return ESP_OK;
+
+err:
+    app_frame_scaler_del(scaler);
+    return ret;
+}
+
+esp_err_t app_frame_scaler_del(app_frame_scaler_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle, ESP_ERR_INVALID_ARG, TAG, "Invalid handle");
+
+    if (handle->ppa_client) {
+        ppa_unregister_client(handle->ppa_client);
+    }
+    if (handle->done_sem) {
+        vSemaphoreDelete(handle->done_sem);
+    }
+    free(handle);
+
+    return ESP_OK;
+}
+
+size_t app_frame_scaler_get_output_size(app_frame_scaler_handle_t handle)
+{
+    return handle->output_size;
+}
+
+esp_err_t app_frame_scaler_get_output(app_frame_scaler_handle_t handle, uint32_t index,
+                                      app_frame_scaler_output_t *output)
+{
+    ESP_RETURN_ON_FALSE(handle && output && (index < handle->cfg.output_num), ESP_ERR_INVALID_ARG, TAG,
+                        "Invalid argument");
+
+    *output = handle->outputs[index].layout;
+
+    return ESP_OK;
+}
+
+esp_err_t app_frame_scaler_submit(app_frame_scaler_handle_t handle, const void *src, void *dst, size_t dst_size, void *user_data)
+{
+    ESP_RETURN_ON_FALSE(handle && src && dst, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(dst_size >= handle->output_size, ESP_ERR_INVALID_SIZE, TAG, "Output buffer too small");
+
+    // Only one frame in flight, the previous one must be done before its source is reused
+    ESP_RETURN_ON_FALSE(xSemaphoreTake(handle->done_sem, 0) == pdTRUE, ESP_ERR_INVALID_STATE, TAG, "Scaler busy");
+    handle->user_data = user_data;
+
+    if (!handle->ppa_client) {
+        for (uint32_t i = 0; i < handle->cfg.output_num; i++) {
+            const app_frame_scaler_output_cfg_t *out_cfg = &handle->cfg.outputs[i];
+            const app_frame_scaler_output_t *layout = &handle->outputs[i].layout;
+            app_frame_scale_sw((const uint16_t *)src, handle->cfg.src_width, &layout->block,
+                               (uint8_t *)dst + layout->offset, layout->width, layout->height, out_cfg->format,
+                               out_cfg->byte_swap, out_cfg->rgb_swap);
+        }
+        if (handle->cfg.done_cb) {
+            handle->cfg.done_cb(user_data);
+        }
+        xSemaphoreGive(handle->done_sem);
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_OK;
+    uint32_t queued = 0;
+    handle->failed = false;
+    atomic_store(&handle->pending, handle->cfg.output_num);
+    for (; queued < handle->cfg.output_num; queued++) {
+        const app_frame_scaler_output_cfg_t *out_cfg = &handle->cfg.outputs[queued];
+        const scaler_output_t *out = &handle->outputs[queued];
+        const bool rgb888 = (out_cfg->format == APP_FRAME_SCALER_FMT_RGB888);
+        ppa_srm_oper_config_t srm_config = {
+            .in = {
+                .buffer = src,
+                .pic_w = handle->cfg.src_width,
+                .pic_h = handle->cfg.src_height,
+                .block_w = out->layout.block.width,
+                .block_h = out->layout.block.height,
+                .block_offset_x = out->layout.block.x,
+                .block_offset_y = out->layout.block.y,
+                .srm_cm = PPA_SRM_COLOR_MODE_RGB565,
+            },
+            .out = {
+                .buffer = (uint8_t *)dst + out->layout.offset,
+                .buffer_size = out->region_size,
+                .pic_w = out->layout.width,
+                .pic_h = out->layout.height,
+                .block_offset_x = 0,
+                .block_offset_y = 0,
+                .srm_cm = rgb888 ? PPA_SRM_COLOR_MODE_RGB888 : PPA_SRM_COLOR_MODE_RGB565,
+            },
+            .rotation_angle = PPA_SRM_ROTATION_ANGLE_0,
+            .scale_x = (float)out->steps_x / APP_FRAME_SCALER_STEPS,
+            .scale_y = (float)out->steps_y / APP_FRAME_SCALER_STEPS,
+            .mirror_x = false,
+            .mirror_y = false,
+            // The PPA stores RGB888 as B, G, R
+            .rgb_swap = rgb888 && !out_cfg->rgb_swap,
+            .byte_swap = out_cfg->byte_swap,
+            .mode = PPA_TRANS_MODE_NON_BLOCKING,
+            .user_data = handle,
+        };
+
+        ret = ppa_do_scale_rotate_mirror(handle->ppa_client, &srm_config);
+        if (ret != ESP_OK) {
+            break;
+        }
+    }
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "PPA scale failed: %s", esp_err_to_name(ret));
+        // Outputs already queued still complete, the frame is not reported done
+        uint32_t missing = handle->cfg.output_num - queued;
+        handle->failed = true;
+        if (atomic_fetch_sub(&handle->pending, missing) == missing) {
+            xSemaphoreGive(handle->done_sem);
+        }
+    }
+
+    return ret;
+}
+
+esp_err_t app_frame_scaler_wait(app_frame_scaler_handle_t handle, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(handle, ESP_ERR_INVALID_ARG, TAG, "Invalid handle");
+
+    if (xSemaphoreTake(handle->done_sem, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreGive(handle->done_sem);
+
+    return ESP_OK;
+}
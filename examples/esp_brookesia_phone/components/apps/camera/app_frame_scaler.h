@@ -0,0 +1,131 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "app_frame_scaler_sw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Callback invoked when a frame has been scaled.
+ *
+ * Called from the PPA interrupt when the hardware path is used, or from the submitting task with
+ * the software path. Must be ISR-safe.
+ */
+typedef void (*app_frame_scaler_done_cb_t)(void *user_data);
+
+#define APP_FRAME_SCALER_OUTPUT_MAX     (2)     /*!< Frames written from one source frame. */
+
+/**
+ * @brief One frame written from the source, e.g. the input of a model.
+ */
+typedef struct {
+    uint32_t width;                     /*!< Output width, not more than the source width. */
+    uint32_t height;                    /*!< Output height, not more than the source height. */
+    app_frame_scaler_fmt_t format;      /*!< Output pixel format. */
+    bool byte_swap;                     /*!< Swap the two bytes of every source pixel, i.e. the source is big endian. */
+    bool rgb_swap;                      /*!< Write B, G, R instead of R, G, B, only for RGB888. */
+} app_frame_scaler_output_cfg_t;
+
+/**
+ * @brief Frame scaler configuration.
+ */
+typedef struct {
+    uint32_t src_width;                 /*!< Width of the source RGB565 frame. */
+    uint32_t src_height;                /*!< Height of the source RGB565 frame. */
+    app_frame_scaler_output_cfg_t outputs[APP_FRAME_SCALER_OUTPUT_MAX]; /*!< Frames to write. */
+    uint32_t output_num;                /*!< Number of valid entries in `outputs`, at least 1. */
+    bool use_ppa;                       /*!< Use the PPA SRM engine, otherwise the software scaler. */
+    app_frame_scaler_done_cb_t done_cb; /*!< Completion callback, may be NULL. */
+} app_frame_scaler_cfg_t;
+
+/**
+ * @brief Where an output frame is stored and which part of the source it shows.
+ *
+ * Source pixel coordinates are `block.x + x * block.width / width` and `block.y + y * block.height / height`.
+ * The block is the whole source unless the PPA scale grid forced a crop, see `app_frame_scaler_fit`.
+ */
+typedef struct {
+    size_t offset;                      /*!< Offset of the frame in the output buffer, cache line aligned. */
+    size_t size;                        /*!< Frame size in bytes. */
+    uint32_t width;                     /*!< Frame width. */
+    uint32_t height;                    /*!< Frame height. */
+    app_frame_scaler_block_t block;     /*!< Part of the source frame it was scaled from. */
+} app_frame_scaler_output_t;
+
+typedef struct app_frame_scaler_t *app_frame_scaler_handle_t;
+
+/**
+ * @brief Create a frame scaler.
+ *
+ * @param cfg Scaler configuration.
+ * @param ret_handle Returned scaler handle.
+ * @return
+ *      - ESP_OK: Success
+ *      - ESP_ERR_INVALID_ARG: Invalid configuration
+ *      - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t app_frame_scaler_new(const app_frame_scaler_cfg_t *cfg, app_frame_scaler_handle_t *ret_handle);
+
+/**
+ * @brief Delete a frame scaler. Pending transactions must have completed.
+ */
+esp_err_t app_frame_scaler_del(app_frame_scaler_handle_t handle);
+
+/**
+ * @brief Get the size of the buffer receiving all the output frames of a scaler.
+ *
+ * @param handle Scaler handle.
+ * @return Output buffer size in bytes.
+ */
+size_t app_frame_scaler_get_output_size(app_frame_scaler_handle_t handle);
+
+/**
+ * @brief Get the layout of one output frame.
+ *
+ * @param handle Scaler handle.
+ * @param index Index of the output in `app_frame_scaler_cfg_t::outputs`.
+ * @param output Returned layout.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid argument.
+ */
+esp_err_t app_frame_scaler_get_output(app_frame_scaler_handle_t handle, uint32_t index,
+                                      app_frame_scaler_output_t *output);
+
+/**
+ * @brief Submit a frame to be scaled.
+ *
+ * With the PPA the call returns as soon as the transactions are queued; `done_cb` is called with
+ * `user_data` from the interrupt once every output is written. The source frame must not be modified
+ * before `app_frame_scaler_wait` returns.
+ *
+ * @param handle Scaler handle.
+ * @param src Source frame.
+ * @param dst Output buffer, cache line aligned, at least `app_frame_scaler_get_output_size` bytes. Output frames
+ *            are stored at the offsets given by `app_frame_scaler_get_output`.
+ * @param dst_size Size of the output buffer in bytes.
+ * @param user_data User data passed to `done_cb`.
+ * @return ESP_OK on success.
+ */
+esp_err_t app_frame_scaler_submit(app_frame_scaler_handle_t handle, const void *src, void *dst, size_t dst_size, void *user_data);
+
+/**
+ * @brief Wait for the last submitted frame to be scaled.
+ *
+ * @param handle Scaler handle.
+ * @param timeout_ms Timeout in milliseconds.
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT on timeout.
+ */
+esp_err_t app_frame_scaler_wait(app_frame_scaler_handle_t handle, uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
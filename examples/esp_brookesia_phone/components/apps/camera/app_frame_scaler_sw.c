@@ -0,0 +1,93 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "app_frame_scaler_sw.h"
+
+bool app_frame_scaler_fit(uint32_t src_size, uint32_t dst_size, uint32_t *offset, uint32_t *size, uint32_t *steps)
+{
+    if ((dst_size == 0) || (dst_size > src_size)) {
+        return false;
+    }
+
+    // Round the ratio up to the grid, then take the fewest source pixels that still give `dst_size`
+    uint32_t fit_steps = (dst_size * APP_FRAME_SCALER_STEPS + src_size - 1) / src_size;
+    uint32_t fit_size = (dst_size * APP_FRAME_SCALER_STEPS + fit_steps - 1) / fit_steps;
+
+    *offset = (src_size - fit_size) / 2;
+    *size = fit_size;
+    *steps = fit_steps;
+
+    return true;
+}
+
+static void scale_rgb565(const uint16_t *src, uint32_t src_stride, const app_frame_scaler_block_t *block,
+                         uint16_t *dst, uint32_t dst_width, uint32_t dst_height, bool byte_swap)
+{
+    for (uint32_t y = 0; y < dst_height; y++) {
+        const uint16_t *src_row = src + (block->y + y * block->height / dst_height) * src_stride + block->x;
+        uint16_t *dst_row = dst + y * dst_width;
+
+        if (byte_swap) {
+            for (uint32_t x = 0; x < dst_width; x++) {
+                uint16_t pixel = src_row[x * block->width / dst_width];
+                dst_row[x] = (uint16_t)((pixel << 8) | (pixel >> 8));
+            }
+        } else {
+            for (uint32_t x = 0; x < dst_width; x++) {
+                dst_row[x] = src_row[x * block->width / dst_width];
+            }
+        }
+    }
+}
+
+static void scale_rgb888(const uint16_t *src, uint32_t src_stride, const app_frame_scaler_block_t *block,
+                         uint8_t *dst, uint32_t dst_width, uint32_t dst_height, bool byte_swap, bool rgb_swap)
+{
+    const int first = rgb_swap ? 2 : 0;
+    const int last = 2 - first;
+
+    for (uint32_t y = 0; y < dst_height; y++) {
+        const uint16_t *src_row = src + (block->y + y * block->height / dst_height) * src_stride + block->x;
+        uint8_t *dst_row = dst + y * dst_width * 3;
+
+        for (uint32_t x = 0; x < dst_width; x++) {
+            uint16_t pixel = src_row[x * block->width / dst_width];
+            if (byte_swap) {
+                pixel = (uint16_t)((pixel << 8) | (pixel >> 8));
+            }
+            dst_row[first] = (uint8_t)((pixel >> 8) & 0xF8);
+            dst_row[1] = (uint8_t)((pixel >> 3) & 0xFC);
+            dst_row[last] = (uint8_t)(pixel << 3);
+            dst_row += 3;
+        }
+    }
+}
+
+void app_frame_scale_sw(const uint16_t *src, uint32_t src_stride, const app_frame_scaler_block_t *block, void *dst,
+                        uint32_t dst_width, uint32_t dst_height, app_frame_scaler_fmt_t format, bool byte_swap,
+                        bool rgb_swap)
+{
+    if (format == APP_FRAME_SCALER_FMT_RGB888) {
+        scale_rgb888(src, src_stride, block, (uint8_t *)dst, dst_width, dst_height, byte_swap, rgb_swap);
+    } else {
+        scale_rgb565(src, src_stride, block, (uint16_t *)dst, dst_width, dst_height, byte_swap);
+    }
+}
+
+void app_frame_scale_rgb565_sw_stride(const uint16_t *src, uint32_t src_stride, uint32_t src_width,
+                                      uint32_t src_height, uint16_t *dst, uint32_t dst_width, uint32_t dst_height,
+                                      bool byte_swap)
+{
+    const app_frame_scaler_block_t block = {0, 0, src_width, src_height};
+
+    scale_rgb565(src, src_stride, &block, dst, dst_width, dst_height, byte_swap);
+}
+
+void app_frame_scale_rgb565_sw(const uint16_t *src, uint32_t src_width, uint32_t src_height,
+                               uint16_t *dst, uint32_t dst_width, uint32_t dst_height, bool byte_swap)
+{
+    app_frame_scale_rgb565_sw_stride(src, src_width, src_width, src_height, dst, dst_width, dst_height, byte_swap);
+}
@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_FRAME_SCALER_STEPS      (16)    /*!< The PPA SRM engine scales by steps of 1/16. */
+
+/**
+ * @brief Pixel format of a scaled frame.
+ */
+typedef enum {
+    APP_FRAME_SCALER_FMT_RGB565 = 0,    /*!< 2 bytes per pixel. */
+    APP_FRAME_SCALER_FMT_RGB888,        /*!< 3 bytes per pixel, R, G, B in memory unless swapped. */
+} app_frame_scaler_fmt_t;
+
+/**
+ * @brief Part of a source frame that is scaled, in source pixels.
+ */
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} app_frame_scaler_block_t;
+
+/**
+ * @brief Fit one axis of a source frame to an exact output size on the PPA scale grid.
+ *
+ * The PPA SRM engine scales by `steps / APP_FRAME_SCALER_STEPS` and writes `floor(block * steps / 16)` pixels,
+ * so most output sizes cannot be reached from the whole source. `steps` is the smallest step count giving at
+ * least `dst_size` pixels from `src_size`, and the source is then cropped around its center to the block that
+ * gives exactly `dst_size` pixels.
+ *
+ * @param src_size Source size in pixels.
+ * @param dst_size Output size in pixels, not more than `src_size`.
+ * @param offset Returned block start.
+ * @param size Returned block size, not more than `src_size`.
+ * @param steps Returned scale, in 1/16 steps.
+ * @return false if the output size cannot be reached.
+ */
+bool app_frame_scaler_fit(uint32_t src_size, uint32_t dst_size, uint32_t *offset, uint32_t *size, uint32_t *steps);
+
+/**
+ * @brief Scale a block of an RGB565 frame in software, to RGB565 or RGB888.
+ *
+ * Output pixel (x, y) is taken from source pixel (block x + x * block width / dst_width, block y + y * block height
+ * / dst_height). RGB888 channels are expanded the way the esp-dl preprocessor does, with the low bits cleared.
+ *
+ * @param src Source frame, rows of `src_stride` pixels.
+ * @param src_stride Source row length in pixels.
+ * @param block Part of the source to scale.
+ * @param dst Destination frame, `dst_width * dst_height` pixels of `format`.
+ * @param dst_width Destination width in pixels.
+ * @param dst_height Destination height in pixels.
+ * @param format Destination pixel format.
+ * @param byte_swap Swap the two bytes of every source pixel, i.e. the source is big endian.
+ * @param rgb_swap Write B, G, R instead of R, G, B, only for RGB888.
+ */
+void app_frame_scale_sw(const uint16_t *src, uint32_t src_stride, const app_frame_scaler_block_t *block, void *dst,
+                        uint32_t dst_width, uint32_t dst_height, app_frame_scaler_fmt_t format, bool byte_swap,
+                        bool rgb_swap);
+
+/**
+ * @brief Downscale an RGB565 frame in software.
+ *
+ * Nearest-neighbour sampling with the same integer-ratio pixel selection as the PPA SRM engine:
+ * output pixel (x, y) is taken from source pixel (x * src_width / dst_width, y * src_height / dst_height).
+ * Declared apart from `app_frame_scaler.h` and free of ESP-IDF dependencies, so it builds on a host.
+ *
+ * @param src Source frame, `src_width * src_height` pixels.
+ * @param src_width Source width in pixels.
+ * @param src_height Source height in pixels.
+ * @param dst Destination frame, `dst_width * dst_height` pixels.
+ * @param dst_width Destination width in pixels.
+ * @param dst_height Destination height in pixels.
+ * @param byte_swap Swap the two bytes of every pixel.
+ */
+void app_frame_scale_rgb565_sw(const uint16_t *src, uint32_t src_width, uint32_t src_height,
+                               uint16_t *dst, uint32_t dst_width, uint32_t dst_height, bool byte_swap);
+
+/**
+ * @brief Downscale the top-left `src_width` x `src_height` pixels of an RGB565 frame with padded rows.
+ *
+ * Same sampling as `app_frame_scale_rgb565_sw`, e.g. for decoder output whose lines are padded to whole MCUs.
+ *
+ * @param src Source frame, rows of `src_stride` pixels.
+ * @param src_stride Source row length in pixels, not less than `src_width`.
+ * @param src_width Source width in pixels.
+ * @param src_height Source height in pixels.
+ * @param dst Destination frame, `dst_width * dst_height` pixels.
+ * @param dst_width Destination width in pixels.
+ * @param dst_height Destination height in pixels.
+ * @param byte_swap Swap the two bytes of every pixel.
+ */
+void app_frame_scale_rgb565_sw_stride(const uint16_t *src, uint32_t src_stride, uint32_t src_width,
+                                      uint32_t src_height, uint16_t *dst, uint32_t dst_width, uint32_t dst_height,
+                                      bool byte_swap);
+
+#ifdef __cplusplus
+}
+#endif
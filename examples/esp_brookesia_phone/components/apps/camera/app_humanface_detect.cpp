@@ -12,7 +12,7 @@
 
 static HumanFaceDetect *detect = NULL;
 
-std::list<dl::detect::result_t> app_humanface_detect(uint16_t *frame, int width, int height)
+void app_humanface_detect(uint16_t *frame, int width, int height, int scale, app_detect_result_t *result)
 {
     dl::image::img_t img;
     img.data = frame;
@@ -20,9 +20,18 @@ std::list<dl::detect::result_t> app_humanface_detect(uint16_t *frame, int width,
     img.height = height;
     img.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB565;
     
-    auto &detect_results = detect->run(img);
+    // The list belongs to the detector, it is converted in place without a copy
+    const auto &detect_results = detect->run(img);
+    app_detect_result_fill(result, detect_results, scale, APP_DETECT_MODEL_FACE);
+}
 
-    return detect_results;
+void app_humanface_detect_region(uint16_t *crop, int x, int y, int width, int height, int frame_width,
+                                 int frame_height, int scale, app_detect_result_t *result)
+{
+    // Lets the face seeds follow the region as it moves between frames
+    const human_face_detect::region_t region = {x, y, width, height, frame_width, frame_height};
+    detect->set_region(region);
+    app_humanface_detect(crop, width, height, scale, result);
 }
 
 HumanFaceDetect *get_humanface_detect()
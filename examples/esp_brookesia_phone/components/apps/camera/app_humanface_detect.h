@@ -6,8 +6,34 @@
 #pragma once
 
 #include "human_face_detect.hpp"
+#include "app_detect_result.hpp"
 
-std::list<dl::detect::result_t> app_humanface_detect(uint16_t *frame, int width, int height);
+/**
+ * @brief Run the detector on an RGB565 frame and store the results into a result block.
+ *
+ * @param frame Frame to analyse.
+ * @param width Frame width.
+ * @param height Frame height.
+ * @param scale Factor applied to the result coordinates.
+ * @param result Result block receiving the detected objects.
+ */
+void app_humanface_detect(uint16_t *frame, int width, int height, int scale, app_detect_result_t *result);
+
+/**
+ * @brief Run the detector on a region cropped from a larger frame, the results stay in region coordinates.
+ *
+ * @param crop Packed copy of the region.
+ * @param x Region left edge in the frame.
+ * @param y Region top edge in the frame.
+ * @param width Region width.
+ * @param height Region height.
+ * @param frame_width Width of the frame the region comes from.
+ * @param frame_height Height of the frame the region comes from.
+ * @param scale Factor applied to the result coordinates.
+ * @param result Result block receiving the detected objects.
+ */
+void app_humanface_detect_region(uint16_t *crop, int x, int y, int width, int height, int frame_width,
+                                 int frame_height, int scale, app_detect_result_t *result);
 
 #ifdef __cplusplus
 extern "C" {
@@ -0,0 +1,224 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_latency_stats.h"
+
+/*
+ * Log-linear histogram: values below 4 us get their own bucket, then every power of two is split in
+ * 4 sub-buckets. Samples are clamped to 2^24 us (~16 s).
+ */
+#define LATENCY_SUB_BUCKETS         (4)
+#define LATENCY_MAX_MSB             (24)
+#define LATENCY_BUCKET_NUM          ((LATENCY_MAX_MSB - 1) * LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS)
+#define LATENCY_LOG_LINE_SIZE       (384)
+
+typedef struct {
+    atomic_uint buckets[LATENCY_BUCKET_NUM];
+    atomic_uint count;
+    atomic_uint max;
+} latency_hist_t;
+
+static const char *TAG = "app_latency";
+
+static const char *stage_names[APP_LATENCY_STAGE_MAX] = {
+    [APP_LATENCY_STAGE_DQBUF_WAIT] = "dq",
+    [APP_LATENCY_STAGE_OVERLAY] = "ovl",
+    [APP_LATENCY_STAGE_DISPLAY_LOCK] = "lock",
+    [APP_LATENCY_STAGE_REFRESH] = "refr",
+    [APP_LATENCY_STAGE_DETECT_PRE] = "pre",
+    [APP_LATENCY_STAGE_DETECT_FORWARD] = "fwd",
+    [APP_LATENCY_STAGE_DETECT_POST] = "post",
+    [APP_LATENCY_STAGE_DETECT_TOTAL] = "det",
+    [APP_LATENCY_STAGE_END_TO_END] = "e2e",
+};
+
+/* Every sample goes to both: the totals back `app_latency_get_summary`, the windows are drained by each logged line */
+static latency_hist_t latency_hists[APP_LATENCY_STAGE_MAX];
+static latency_hist_t latency_windows[APP_LATENCY_STAGE_MAX];
+static atomic_llong last_log_time_us;
+
+static inline uint32_t bucket_index(uint32_t us)
+{
+    if (us < LATENCY_SUB_BUCKETS) {
+        return us;
+    }
+    if (us >= (1UL << LATENCY_MAX_MSB)) {
+        return LATENCY_BUCKET_NUM - 1;
+    }
+
+    uint32_t msb = 31 - __builtin_clz(us);
+    uint32_t sub = (us >> (msb - 2)) & (LATENCY_SUB_BUCKETS - 1);
+
+    return (msb - 1) * LATENCY_SUB_BUCKETS + sub;
+}
+
+static inline uint32_t bucket_upper_bound(uint32_t index)
+{
+    if (index < LATENCY_SUB_BUCKETS) {
+        return index;
+    }
+
+    uint32_t msb = index / LATENCY_SUB_BUCKETS + 1;
+    uint32_t sub = index % LATENCY_SUB_BUCKETS;
+
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+static void latency_add(latency_hist_t *hist, uint32_t index, uint32_t us)
+{
+    atomic_fetch_add_explicit(&hist->buckets[index], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+
+    unsigned int max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    while (us > max && !atomic_compare_exchange_weak_explicit(&hist->max, &max, us, memory_order_relaxed,
+                                                              memory_order_relaxed)) {
+    }
+}
+
+static void latency_clear(latency_hist_t *hist)
+{
+    for (int i = 0; i < LATENCY_BUCKET_NUM; i++) {
+        atomic_store_explicit(&hist->buckets[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&hist->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&hist->max, 0, memory_order_relaxed);
+}
+
+void app_latency_record(app_latency_stage_t stage, uint32_t us)
+{
+    if (stage >= APP_LATENCY_STAGE_MAX) {
+        return;
+    }
+
+    uint32_t index = bucket_index(us);
+    latency_add(&latency_hists[stage], index, us);
+    latency_add(&latency_windows[stage], index, us);
+}
+
+static uint32_t latency_snapshot(const latency_hist_t *hist, uint32_t buckets[LATENCY_BUCKET_NUM])
+{
+    uint32_t total = 0;
+
+    // Sum the snapshot rather than reading `count`, so percentiles stay consistent with concurrent writers
+    for (int i = 0; i < LATENCY_BUCKET_NUM; i++) {
+        buckets[i] = atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        total += buckets[i];
+    }
+
+    return total;
+}
+
+static void latency_summarize(const uint32_t buckets[LATENCY_BUCKET_NUM], uint32_t total, uint32_t max,
+                              app_latency_summary_t *summary)
+{
+    summary->count = total;
+    summary->max = max;
+    summary->p50 = summary->p95 = summary->p99 = 0;
+    if (total == 0) {
+        return;
+    }
+
+    const uint32_t rank50 = (total * 50 + 99) / 100;
+    const uint32_t rank95 = (total * 95 + 99) / 100;
+    const uint32_t rank99 = (total * 99 + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKET_NUM; i++) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+        uint32_t upper = bucket_upper_bound(i);
+        if (upper > summary->max) {
+            upper = summary->max;
+        }
+        seen += buckets[i];
+        if (summary->p50 == 0 && seen >= rank50) {
+            summary->p50 = upper;
+        }
+        if (summary->p95 == 0 && seen >= rank95) {
+            summary->p95 = upper;
+        }
+        if (seen >= rank99) {
+            summary->p99 = upper;
+            break;
+        }
+    }
+}
+
+/* Remove the samples of a snapshot, the ones recorded since it stay for the next window */
+static void latency_drain(latency_hist_t *hist, const uint32_t buckets[LATENCY_BUCKET_NUM], uint32_t total)
+{
+    for (int i = 0; i < LATENCY_BUCKET_NUM; i++) {
+        if (buckets[i]) {
+            atomic_fetch_sub_explicit(&hist->buckets[i], buckets[i], memory_order_relaxed);
+        }
+    }
+    atomic_fetch_sub_explicit(&hist->count, total, memory_order_relaxed);
+    atomic_store_explicit(&hist->max, 0, memory_order_relaxed);
+}
+
+esp_err_t app_latency_get_summary(app_latency_stage_t stage, app_latency_summary_t *summary)
+{
+    if (stage >= APP_LATENCY_STAGE_MAX || !summary) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    latency_hist_t *hist = &latency_hists[stage];
+    uint32_t buckets[LATENCY_BUCKET_NUM];
+    uint32_t total = latency_snapshot(hist, buckets);
+
+    latency_summarize(buckets, total, atomic_load_explicit(&hist->max, memory_order_relaxed), summary);
+
+    return ESP_OK;
+}
+
+void app_latency_reset(void)
+{
+    for (int stage = 0; stage < APP_LATENCY_STAGE_MAX; stage++) {
+        latency_clear(&latency_hists[stage]);
+        latency_clear(&latency_windows[stage]);
+    }
+    atomic_store(&last_log_time_us, esp_timer_get_time());
+}
+
+void app_latency_log_periodic(uint32_t period_ms)
+{
+    int64_t now = esp_timer_get_time();
+    long long last = atomic_load(&last_log_time_us);
+
+    // Only one caller wins the slot for this period
+    if ((now - last) < (int64_t)period_ms * 1000 || !atomic_compare_exchange_strong(&last_log_time_us, &last, now)) {
+        return;
+    }
+
+    // Every line covers one period: the logged samples leave the window, the totals keep them
+    char line[LATENCY_LOG_LINE_SIZE];
+    int len = 0;
+    for (int stage = 0; stage < APP_LATENCY_STAGE_MAX; stage++) {
+        latency_hist_t *hist = &latency_windows[stage];
+        uint32_t buckets[LATENCY_BUCKET_NUM];
+        uint32_t total = latency_snapshot(hist, buckets);
+        if (total == 0) {
+            continue;
+        }
+
+        app_latency_summary_t summary;
+        latency_summarize(buckets, total, atomic_load_explicit(&hist->max, memory_order_relaxed), &summary);
+        latency_drain(hist, buckets, total);
+        if (len < (int)sizeof(line)) {
+            len += snprintf(line + len, sizeof(line) - len, " %s:%" PRIu32 "/%" PRIu32 "/%" PRIu32,
+                            stage_names[stage], summary.p50, summary.p95, summary.p99);
+        }
+    }
+
+    if (len > 0) {
+        ESP_LOGI(TAG, "us p50/p95/p99%s", line);
+    }
+}
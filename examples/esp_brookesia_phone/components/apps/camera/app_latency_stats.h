@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Camera path stages with a latency histogram.
+ */
+typedef enum {
+    APP_LATENCY_STAGE_DQBUF_WAIT = 0,   /*!< Time blocked in VIDIOC_DQBUF. */
+    APP_LATENCY_STAGE_OVERLAY,          /*!< Drawing detection results into the frame. */
+    APP_LATENCY_STAGE_DISPLAY_LOCK,     /*!< Waiting for the LVGL display lock. */
+    APP_LATENCY_STAGE_REFRESH,          /*!< `lv_refr_now`. */
+    APP_LATENCY_STAGE_DETECT_PRE,       /*!< Detection preprocess. */
+    APP_LATENCY_STAGE_DETECT_FORWARD,   /*!< Detection model forward. */
+    APP_LATENCY_STAGE_DETECT_POST,      /*!< Detection postprocess. */
+    APP_LATENCY_STAGE_DETECT_TOTAL,     /*!< Whole detector run. */
+    APP_LATENCY_STAGE_END_TO_END,       /*!< Frame captured by the sensor to frame refreshed on the panel. */
+    APP_LATENCY_STAGE_MAX,
+} app_latency_stage_t;
+
+/**
+ * @brief Latency summary of one stage, in microseconds.
+ *
+ * Percentiles are the upper bound of the histogram bucket they fall in (at most 25% above the real value).
+ */
+typedef struct {
+    uint32_t count;                     /*!< Number of samples. */
+    uint32_t p50;                       /*!< 50th percentile. */
+    uint32_t p95;                       /*!< 95th percentile. */
+    uint32_t p99;                       /*!< 99th percentile. */
+    uint32_t max;                       /*!< Largest sample. */
+} app_latency_summary_t;
+
+/**
+ * @brief Record one latency sample. Lock-free, callable from any task on any core.
+ *
+ * @param stage Stage of the sample.
+ * @param us Latency in microseconds.
+ */
+void app_latency_record(app_latency_stage_t stage, uint32_t us);
+
+/**
+ * @brief Compute the summary of one stage from the samples recorded since the last reset.
+ *
+ * @param stage Stage to query.
+ * @param summary Returned summary.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid argument.
+ */
+esp_err_t app_latency_get_summary(app_latency_stage_t stage, app_latency_summary_t *summary);
+
+/**
+ * @brief Clear all histograms.
+ */
+void app_latency_reset(void);
+
+/**
+ * @brief Log one compact line with p50/p95/p99 of every stage that has samples.
+ *
+ * Does nothing until `period_ms` has elapsed since the previous line, so it can be called once per frame. Each line
+ * covers the samples of its own period, kept apart from the totals read by `app_latency_get_summary`.
+ *
+ * @param period_ms Minimum interval between two lines.
+ */
+void app_latency_log_periodic(uint32_t period_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,267 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bsp_extra_mem_pressure.h"
+#include "app_model_cache.h"
+
+#define MODEL_PREWARM_TASK_STACK_SIZE   (8 * 1024)
+#define MODEL_PREWARM_TASK_PRIORITY     (1)
+
+typedef struct {
+    app_model_desc_t desc;
+    bool registered;
+    void *model;
+    uint32_t last_use;                  // Value of `use_clock` at the last acquisition
+    app_model_stats_t stats;
+} model_entry_t;
+
+typedef struct {
+    SemaphoreHandle_t lock;
+    size_t budget;
+    size_t resident_size;
+    uint32_t use_clock;
+    uint32_t prewarm_delay_ms;
+    model_entry_t entries[APP_MODEL_NUM];
+} model_cache_t;
+
+static const char *TAG = "app_model_cache";
+
+static model_cache_t *cache = NULL;
+
+static void model_unload(model_entry_t *entry)
+{
+    entry->desc.unload();
+    entry->model = NULL;
+    entry->stats.resident = false;
+    entry->stats.evict_count++;
+    cache->resident_size -= entry->stats.size;
+    ESP_LOGI(TAG, "Evict %s (%u KB)", entry->desc.name, entry->stats.size / 1024);
+}
+
+// Least recently used resident model that nobody holds, NULL if none
+static model_entry_t *model_find_victim(void)
+{
+    model_entry_t *victim = NULL;
+
+    for (int i = 0; i < APP_MODEL_NUM; i++) {
+        model_entry_t *entry = &cache->entries[i];
+        if (entry->model && (entry->stats.ref_count == 0) && (!victim || (entry->last_use < victim->last_use))) {
+            victim = entry;
+        }
+    }
+
+    return victim;
+}
+
+// Unload idle models until `incoming` more bytes fit in the budget
+static void model_fit_budget(size_t incoming)
+{
+    while (cache->resident_size + incoming > cache->budget) {
+        model_entry_t *victim = model_find_victim();
+        if (!victim) {
+            break;
+        }
+        model_unload(victim);
+    }
+}
+
+static size_t model_cache_reclaim(size_t free_size, void *user_ctx)
+{
+    return app_model_cache_trim(free_size);
+}
+
+esp_err_t app_model_cache_init(size_t budget)
+{
+    ESP_RETURN_ON_FALSE(!cache, ESP_ERR_INVALID_STATE, TAG, "Already initialized");
+
+    cache = calloc(1, sizeof(model_cache_t));
+    ESP_RETURN_ON_FALSE(cache, ESP_ERR_NO_MEM, TAG, "No memory for model cache");
+    cache->lock = xSemaphoreCreateMutex();
+    if (!cache->lock) {
+        free(cache);
+        cache = NULL;
+        ESP_LOGE(TAG, "Create model cache lock failed");
+        return ESP_ERR_NO_MEM;
+    }
+    cache->budget = budget;
+    // Other apps reach the idle models through the memory pressure hook, the cache works without it
+    if (bsp_extra_mem_pressure_register(model_cache_reclaim, NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "Register reclaimer failed, other apps can't unload idle models");
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t app_model_cache_register(app_model_id_t id, const app_model_desc_t *desc)
+{
+    ESP_RETURN_ON_FALSE(cache, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    ESP_RETURN_ON_FALSE((id < APP_MODEL_NUM) && desc && desc->load && desc->unload, ESP_ERR_INVALID_ARG, TAG,
+                        "Invalid argument");
+
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    model_entry_t *entry = &cache->entries[id];
+    entry->desc = *desc;
+    entry->registered = true;
+    xSemaphoreGive(cache->lock);
+
+    return ESP_OK;
+}
+
+void *app_model_cache_acquire(app_model_id_t id)
+{
+    ESP_RETURN_ON_FALSE(cache && (id < APP_MODEL_NUM) && cache->entries[id].registered, NULL, TAG, "Invalid model");
+
+    int64_t start_us = esp_timer_get_time();
+    model_entry_t *entry = &cache->entries[id];
+
+    // Loads happen under the lock, a concurrent user of the same model would wait for it anyway
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    if (entry->model) {
+        entry->stats.warm_count++;
+        entry->stats.warm_load_us = (uint32_t)(esp_timer_get_time() - start_us);
+    } else {
+        // The size of the previous load is the best guess for this one
+        model_fit_budget(entry->stats.size);
+
+        size_t free_before = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+        entry->model = entry->desc.load();
+        if (!entry->model) {
+            xSemaphoreGive(cache->lock);
+            ESP_LOGE(TAG, "Load %s failed", entry->desc.name);
+            return NULL;
+        }
+        size_t free_after = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+        // Measured from the heap, other tasks allocating at the same time skew it
+        entry->stats.size = (free_before > free_after) ? (free_before - free_after) : 0;
+        entry->stats.resident = true;
+        entry->stats.cold_count++;
+        entry->stats.cold_load_us = (uint32_t)(esp_timer_get_time() - start_us);
+        cache->resident_size += entry->stats.size;
+        ESP_LOGI(TAG, "Load %s: %" PRIu32 " us, %u KB", entry->desc.name, entry->stats.cold_load_us,
+                 entry->stats.size / 1024);
+    }
+    entry->stats.ref_count++;
+    entry->last_use = ++cache->use_clock;
+    void *model = entry->model;
+    xSemaphoreGive(cache->lock);
+
+    return model;
+}
+
+void app_model_cache_release(app_model_id_t id)
+{
+    if (!cache || (id >= APP_MODEL_NUM)) {
+        return;
+    }
+
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    model_entry_t *entry = &cache->entries[id];
+    if (entry->stats.ref_count > 0) {
+        entry->stats.ref_count--;
+    }
+    model_fit_budget(0);
+    xSemaphoreGive(cache->lock);
+}
+
+size_t app_model_cache_trim(size_t free_size)
+{
+    size_t released = 0;
+
+    if (!cache) {
+        return 0;
+    }
+
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    while (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) < free_size) {
+        model_entry_t *victim = model_find_victim();
+        if (!victim) {
+            break;
+        }
+        released += victim->stats.size;
+        model_unload(victim);
+    }
+    xSemaphoreGive(cache->lock);
+
+    return released;
+}
+
+static void model_prewarm_task(void *arg)
+{
+    vTaskDelay(pdMS_TO_TICKS(cache->prewarm_delay_ms));
+
+    for (int i = 0; i < APP_MODEL_NUM; i++) {
+        model_entry_t *entry = &cache->entries[i];
+
+        xSemaphoreTake(cache->lock, portMAX_DELAY);
+        bool skip = !entry->registered || entry->model ||
+                    ((entry->stats.size > 0) && (cache->resident_size + entry->stats.size > cache->budget));
+        xSemaphoreGive(cache->lock);
+        if (skip) {
+            continue;
+        }
+
+        // Release right away: the model stays resident unless it went over the budget
+        if (app_model_cache_acquire((app_model_id_t)i)) {
+            app_model_cache_release((app_model_id_t)i);
+        }
+    }
+
+    ESP_LOGI(TAG, "Prewarm done, %u KB resident", cache->resident_size / 1024);
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_model_cache_prewarm(uint32_t delay_ms)
+{
+    ESP_RETURN_ON_FALSE(cache, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+
+    cache->prewarm_delay_ms = delay_ms;
+    BaseType_t ret = xTaskCreate(model_prewarm_task, "Model Prewarm", MODEL_PREWARM_TASK_STACK_SIZE, NULL,
+                                 MODEL_PREWARM_TASK_PRIORITY, NULL);
+    ESP_RETURN_ON_FALSE(ret == pdPASS, ESP_FAIL, TAG, "Create prewarm task failed");
+
+    return ESP_OK;
+}
+
+esp_err_t app_model_cache_get_stats(app_model_id_t id, app_model_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(cache && (id < APP_MODEL_NUM) && stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    *stats = cache->entries[id].stats;
+    xSemaphoreGive(cache->lock);
+
+    return ESP_OK;
+}
+
+void app_model_cache_log_stats(void)
+{
+    app_model_stats_t stats;
+
+    if (!cache) {
+        return;
+    }
+
+    for (int i = 0; i < APP_MODEL_NUM; i++) {
+        if (!cache->entries[i].registered || (app_model_cache_get_stats((app_model_id_t)i, &stats) != ESP_OK)) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%s: %s, %u KB, cold %" PRIu32 " (last %" PRIu32 " us), warm %" PRIu32 " (last %" PRIu32
+                 " us), evicted %" PRIu32, cache->entries[i].desc.name, stats.resident ? "resident" : "unloaded",
+                 stats.size / 1024, stats.cold_count, stats.cold_load_us, stats.warm_count, stats.warm_load_us,
+                 stats.evict_count);
+    }
+}
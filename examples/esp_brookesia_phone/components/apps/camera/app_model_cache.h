@@ -0,0 +1,121 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Models kept by the cache.
+ */
+typedef enum {
+    APP_MODEL_PEDESTRIAN = 0,
+    APP_MODEL_FACE,
+    APP_MODEL_NUM,
+} app_model_id_t;
+
+/**
+ * @brief Model description.
+ */
+typedef struct {
+    const char *name;                   /*!< Name used in logs. */
+    void *(*load)(void);                /*!< Construct the model, returns NULL on failure. */
+    void (*unload)(void);               /*!< Destroy the model. */
+} app_model_desc_t;
+
+/**
+ * @brief Statistics of one model.
+ */
+typedef struct {
+    bool resident;                      /*!< Model is loaded. */
+    uint32_t ref_count;                 /*!< Current users of the model. */
+    size_t size;                        /*!< PSRAM taken by the model, measured at its last load. */
+    uint32_t cold_count;                /*!< Acquisitions that had to load the model. */
+    uint32_t warm_count;                /*!< Acquisitions served by the resident model. */
+    uint32_t evict_count;               /*!< Evictions of the model. */
+    uint32_t cold_load_us;              /*!< Duration of the last cold acquisition. */
+    uint32_t warm_load_us;              /*!< Duration of the last warm acquisition. */
+} app_model_stats_t;
+
+/**
+ * @brief Initialize the model cache.
+ *
+ * Released models stay loaded as long as all resident models fit in the budget. Above it, the least
+ * recently used models that nobody holds are unloaded.
+ *
+ * @param budget PSRAM budget for the resident models, in bytes.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already initialized, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_model_cache_init(size_t budget);
+
+/**
+ * @brief Register a model. Nothing is loaded yet.
+ *
+ * @param id Model identifier.
+ * @param desc Model description, copied.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid argument.
+ */
+esp_err_t app_model_cache_register(app_model_id_t id, const app_model_desc_t *desc);
+
+/**
+ * @brief Get a model, loading it if it is not resident. The model stays loaded until released.
+ *
+ * @param id Model identifier.
+ * @return The model returned by `load`, NULL on failure.
+ */
+void *app_model_cache_acquire(app_model_id_t id);
+
+/**
+ * @brief Release a model. It stays resident while the cache is within budget.
+ *
+ * @param id Model identifier.
+ */
+void app_model_cache_release(app_model_id_t id);
+
+/**
+ * @brief Unload least recently used models until at least `free_size` bytes of PSRAM are free.
+ *
+ * Registered as a `bsp_extra_mem_pressure` reclaimer by `app_model_cache_init`, so the other apps reach it through
+ * `bsp_extra_mem_pressure_reclaim`. Models in use are never unloaded.
+ *
+ * @param free_size Free PSRAM wanted, in bytes.
+ * @return Number of bytes released.
+ */
+size_t app_model_cache_trim(size_t free_size);
+
+/**
+ * @brief Load the registered models in the background, on a low priority task.
+ *
+ * Models are loaded in identifier order and released right away, as long as they fit in the budget.
+ *
+ * @param delay_ms Delay before the first load, to leave the boot sequence alone.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized, ESP_FAIL if the task can't be created.
+ */
+esp_err_t app_model_cache_prewarm(uint32_t delay_ms);
+
+/**
+ * @brief Get the statistics of a model.
+ *
+ * @param id Model identifier.
+ * @param stats Returned statistics.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid argument.
+ */
+esp_err_t app_model_cache_get_stats(app_model_id_t id, app_model_stats_t *stats);
+
+/**
+ * @brief Log the statistics of every registered model.
+ */
+void app_model_cache_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
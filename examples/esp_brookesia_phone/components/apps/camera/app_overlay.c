@@ -0,0 +1,466 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "app_overlay.h"
+
+#define FONT_FIRST_CHAR     (' ')
+#define FONT_LAST_CHAR      ('Z')
+
+// Spans are written with word stores, the buffer may be of any type
+typedef uint32_t __attribute__((may_alias)) overlay_word_t;
+
+typedef struct {
+    uint8_t bytes[3];           // Pixel as stored in memory (RGB565 uses the first two bytes)
+    uint16_t pixel16;           // RGB565 pixel as a native 16-bit value
+} overlay_pixel_t;
+
+// Column-major 5x7 glyphs, bit 0 is the top row
+static const uint8_t font_5x7[FONT_LAST_CHAR - FONT_FIRST_CHAR + 1][APP_OVERLAY_FONT_WIDTH] = {
+    ['#' - FONT_FIRST_CHAR] = {0x14, 0x7F, 0x14, 0x7F, 0x14},
+    ['%' - FONT_FIRST_CHAR] = {0x23, 0x13, 0x08, 0x64, 0x62},
+    ['-' - FONT_FIRST_CHAR] = {0x08, 0x08, 0x08, 0x08, 0x08},
+    ['.' - FONT_FIRST_CHAR] = {0x00, 0x60, 0x60, 0x00, 0x00},
+    ['/' - FONT_FIRST_CHAR] = {0x20, 0x10, 0x08, 0x04, 0x02},
+    ['0' - FONT_FIRST_CHAR] = {0x3E, 0x51, 0x49, 0x45, 0x3E},
+    ['1' - FONT_FIRST_CHAR] = {0x00, 0x42, 0x7F, 0x40, 0x00},
+    ['2' - FONT_FIRST_CHAR] = {0x42, 0x61, 0x51, 0x49, 0x46},
+    ['3' - FONT_FIRST_CHAR] = {0x21, 0x41, 0x45, 0x4B, 0x31},
+    ['4' - FONT_FIRST_CHAR] = {0x18, 0x14, 0x12, 0x7F, 0x10},
+    ['5' - FONT_FIRST_CHAR] = {0x27, 0x45, 0x45, 0x45, 0x39},
+    ['6' - FONT_FIRST_CHAR] = {0x3C, 0x4A, 0x49, 0x49, 0x30},
+    ['7' - FONT_FIRST_CHAR] = {0x01, 0x71, 0x09, 0x05, 0x03},
+    ['8' - FONT_FIRST_CHAR] = {0x36, 0x49, 0x49, 0x49, 0x36},
+    ['9' - FONT_FIRST_CHAR] = {0x06, 0x49, 0x49, 0x29, 0x1E},
+    [':' - FONT_FIRST_CHAR] = {0x00, 0x36, 0x36, 0x00, 0x00},
+    ['A' - FONT_FIRST_CHAR] = {0x7E, 0x11, 0x11, 0x11, 0x7E},
+    ['B' - FONT_FIRST_CHAR] = {0x7F, 0x49, 0x49, 0x49, 0x36},
+    ['C' - FONT_FIRST_CHAR] = {0x3E, 0x41, 0x41, 0x41, 0x22},
+    ['D' - FONT_FIRST_CHAR] = {0x7F, 0x41, 0x41, 0x22, 0x1C},
+    ['E' - FONT_FIRST_CHAR] = {0x7F, 0x49, 0x49, 0x49, 0x41},
+    ['F' - FONT_FIRST_CHAR] = {0x7F, 0x09, 0x09, 0x09, 0x01},
+    ['G' - FONT_FIRST_CHAR] = {0x3E, 0x41, 0x49, 0x49, 0x7A},
+    ['H' - FONT_FIRST_CHAR] = {0x7F, 0x08, 0x08, 0x08, 0x7F},
+    ['I' - FONT_FIRST_CHAR] = {0x00, 0x41, 0x7F, 0x41, 0x00},
+    ['J' - FONT_FIRST_CHAR] = {0x20, 0x40, 0x41, 0x3F, 0x01},
+    ['K' - FONT_FIRST_CHAR] = {0x7F, 0x08, 0x14, 0x22, 0x41},
+    ['L' - FONT_FIRST_CHAR] = {0x7F, 0x40, 0x40, 0x40, 0x40},
+    ['M' - FONT_FIRST_CHAR] = {0x7F, 0x02, 0x0C, 0x02, 0x7F},
+    ['N' - FONT_FIRST_CHAR] = {0x7F, 0x04, 0x08, 0x10, 0x7F},
+    ['O' - FONT_FIRST_CHAR] = {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    ['P' - FONT_FIRST_CHAR] = {0x7F, 0x09, 0x09, 0x09, 0x06},
+    ['Q' - FONT_FIRST_CHAR] = {0x3E, 0x41, 0x51, 0x21, 0x5E},
+    ['R' - FONT_FIRST_CHAR] = {0x7F, 0x09, 0x19, 0x29, 0x46},
+    ['S' - FONT_FIRST_CHAR] = {0x46, 0x49, 0x49, 0x49, 0x31},
+    ['T' - FONT_FIRST_CHAR] = {0x01, 0x01, 0x7F, 0x01, 0x01},
+    ['U' - FONT_FIRST_CHAR] = {0x3F, 0x40, 0x40, 0x40, 0x3F},
+    ['V' - FONT_FIRST_CHAR] = {0x1F, 0x20, 0x40, 0x20, 0x1F},
+    ['W' - FONT_FIRST_CHAR] = {0x3F, 0x40, 0x38, 0x40, 0x3F},
+    ['X' - FONT_FIRST_CHAR] = {0x63, 0x14, 0x08, 0x14, 0x63},
+    ['Y' - FONT_FIRST_CHAR] = {0x07, 0x08, 0x70, 0x08, 0x07},
+    ['Z' - FONT_FIRST_CHAR] = {0x61, 0x51, 0x49, 0x45, 0x43},
+};
+
+static inline int overlay_bytes_per_pixel(const app_overlay_canvas_t *canvas)
+{
+    return (canvas->format == APP_OVERLAY_FMT_RGB888) ? 3 : 2;
+}
+
+static inline int overlay_stride(const app_overlay_canvas_t *canvas)
+{
+    return canvas->stride ? canvas->stride : canvas->width * overlay_bytes_per_pixel(canvas);
+}
+
+static overlay_pixel_t overlay_encode(const app_overlay_canvas_t *canvas, uint32_t color)
+{
+    uint8_t r = (color >> 16) & 0xFF;
+    uint8_t g = (color >> 8) & 0xFF;
+    uint8_t b = color & 0xFF;
+    overlay_pixel_t pixel = { 0 };
+
+    if (canvas->format == APP_OVERLAY_FMT_RGB888) {
+        pixel.bytes[0] = canvas->swap_bytes ? b : r;
+        pixel.bytes[1] = g;
+        pixel.bytes[2] = canvas->swap_bytes ? r : b;
+    } else {
+        uint16_t value = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+        if (canvas->swap_bytes) {
+            value = (uint16_t)((value << 8) | (value >> 8));
+        }
+        pixel.pixel16 = value;
+        memcpy(pixel.bytes, &value, sizeof(value));
+    }
+
+    return pixel;
+}
+
+static void overlay_span_rgb565(uint8_t *dst, int count, const overlay_pixel_t *pixel)
+{
+    uint16_t *dst16 = (uint16_t *)dst;
+
+    if (((uintptr_t)dst16 & 2) && (count > 0)) {
+        *dst16++ = pixel->pixel16;
+        count--;
+    }
+
+    uint32_t pair = pixel->pixel16 | ((uint32_t)pixel->pixel16 << 16);
+    overlay_word_t *dst32 = (overlay_word_t *)dst16;
+    for (; count >= 8; count -= 8) {
+        dst32[0] = pair;
+        dst32[1] = pair;
+        dst32[2] = pair;
+        dst32[3] = pair;
+        dst32 += 4;
+    }
+    for (; count >= 2; count -= 2) {
+        *dst32++ = pair;
+    }
+    if (count) {
+        *(uint16_t *)dst32 = pixel->pixel16;
+    }
+}
+
+static void overlay_span_rgb888(uint8_t *dst, int count, const overlay_pixel_t *pixel)
+{
+    // Align to a word, a pixel boundary hits every byte offset within 3 pixels
+    while ((count > 0) && ((uintptr_t)dst & 3)) {
+        dst[0] = pixel->bytes[0];
+        dst[1] = pixel->bytes[1];
+        dst[2] = pixel->bytes[2];
+        dst += 3;
+        count--;
+    }
+
+    // 4 pixels are exactly 3 words
+    if (count >= 4) {
+        uint8_t pattern[12];
+        for (int i = 0; i < 12; i++) {
+            pattern[i] = pixel->bytes[i % 3];
+        }
+        uint32_t w0, w1, w2;
+        memcpy(&w0, &pattern[0], 4);
+        memcpy(&w1, &pattern[4], 4);
+        memcpy(&w2, &pattern[8], 4);
+
+        overlay_word_t *dst32 = (overlay_word_t *)dst;
+        for (; count >= 4; count -= 4) {
+            dst32[0] = w0;
+            dst32[1] = w1;
+            dst32[2] = w2;
+            dst32 += 3;
+        }
+        dst = (uint8_t *)dst32;
+    }
+
+    for (; count > 0; count--) {
+        dst[0] = pixel->bytes[0];
+        dst[1] = pixel->bytes[1];
+        dst[2] = pixel->bytes[2];
+        dst += 3;
+    }
+}
+
+static void overlay_fill_rect_encoded(const app_overlay_canvas_t *canvas, int x1, int y1, int x2, int y2,
+                                      const overlay_pixel_t *pixel)
+{
+    if (x1 > x2) {
+        int tmp = x1;
+        x1 = x2;
+        x2 = tmp;
+    }
+    if (y1 > y2) {
+        int tmp = y1;
+        y1 = y2;
+        y2 = tmp;
+    }
+
+    // Clip once, the spans below are written without any check
+    if (x1 < 0) {
+        x1 = 0;
+    }
+    if (y1 < 0) {
+        y1 = 0;
+    }
+    if (x2 >= canvas->width) {
+        x2 = canvas->width - 1;
+    }
+    if (y2 >= canvas->height) {
+        y2 = canvas->height - 1;
+    }
+    if ((x1 > x2) || (y1 > y2)) {
+        return;
+    }
+
+    int bpp = overlay_bytes_per_pixel(canvas);
+    int stride = overlay_stride(canvas);
+    int count = x2 - x1 + 1;
+    uint8_t *line = canvas->buffer + (size_t)y1 * stride + (size_t)x1 * bpp;
+
+    if (canvas->format == APP_OVERLAY_FMT_RGB888) {
+        for (int y = y1; y <= y2; y++, line += stride) {
+            overlay_span_rgb888(line, count, pixel);
+        }
+    } else if (count == 1) {
+        for (int y = y1; y <= y2; y++, line += stride) {
+            *(uint16_t *)line = pixel->pixel16;
+        }
+    } else {
+        for (int y = y1; y <= y2; y++, line += stride) {
+            overlay_span_rgb565(line, count, pixel);
+        }
+    }
+}
+
+void app_overlay_fill_rect(const app_overlay_canvas_t *canvas, int x1, int y1, int x2, int y2, uint32_t color)
+{
+    if (!canvas || !canvas->buffer) {
+        return;
+    }
+
+    overlay_pixel_t pixel = overlay_encode(canvas, color);
+    overlay_fill_rect_encoded(canvas, x1, y1, x2, y2, &pixel);
+}
+
+void app_overlay_draw_box(const app_overlay_canvas_t *canvas, int x1, int y1, int x2, int y2, int thickness,
+                          uint32_t color)
+{
+    if (!canvas || !canvas->buffer || (thickness <= 0)) {
+        return;
+    }
+    if (x1 > x2) {
+        int tmp = x1;
+        x1 = x2;
+        x2 = tmp;
+    }
+    if (y1 > y2) {
+        int tmp = y1;
+        y1 = y2;
+        y2 = tmp;
+    }
+
+    overlay_pixel_t pixel = overlay_encode(canvas, color);
+
+    // Boxes thinner than twice the line width are filled
+    if ((x2 - x1 + 1 <= 2 * thickness) || (y2 - y1 + 1 <= 2 * thickness)) {
+        overlay_fill_rect_encoded(canvas, x1, y1, x2, y2, &pixel);
+        return;
+    }
+
+    overlay_fill_rect_encoded(canvas, x1, y1, x2, y1 + thickness - 1, &pixel);
+    overlay_fill_rect_encoded(canvas, x1, y2 - thickness + 1, x2, y2, &pixel);
+    overlay_fill_rect_encoded(canvas, x1, y1 + thickness, x1 + thickness - 1, y2 - thickness, &pixel);
+    overlay_fill_rect_encoded(canvas, x2 - thickness + 1, y1 + thickness, x2, y2 - thickness, &pixel);
+}
+
+void app_overlay_draw_point(const app_overlay_canvas_t *canvas, int x, int y, int radius, uint32_t color)
+{
+    if (radius < 0) {
+        return;
+    }
+
+    app_overlay_fill_rect(canvas, x - radius, y - radius, x + radius, y + radius, color);
+}
+
+#define CLIP_LEFT       (1 << 0)
+#define CLIP_RIGHT      (1 << 1)
+#define CLIP_TOP        (1 << 2)
+#define CLIP_BOTTOM     (1 << 3)
+
+static inline int overlay_clip_code(int x, int y, int xmin, int ymin, int xmax, int ymax)
+{
+    int code = 0;
+
+    if (x < xmin) {
+        code |= CLIP_LEFT;
+    } else if (x > xmax) {
+        code |= CLIP_RIGHT;
+    }
+    if (y < ymin) {
+        code |= CLIP_TOP;
+    } else if (y > ymax) {
+        code |= CLIP_BOTTOM;
+    }
+
+    return code;
+}
+
+// Cohen-Sutherland, returns false if the line is fully outside
+static bool overlay_clip_line(int *x0, int *y0, int *x1, int *y1, int xmin, int ymin, int xmax, int ymax)
+{
+    int code0 = overlay_clip_code(*x0, *y0, xmin, ymin, xmax, ymax);
+    int code1 = overlay_clip_code(*x1, *y1, xmin, ymin, xmax, ymax);
+
+    while (code0 | code1) {
+        if (code0 & code1) {
+            return false;
+        }
+
+        int code = code0 ? code0 : code1;
+        int64_t dx = *x1 - *x0;
+        int64_t dy = *y1 - *y0;
+        int x, y;
+
+        if (code & CLIP_TOP) {
+            x = *x0 + (int)(dx * (ymin - *y0) / dy);
+            y = ymin;
+        } else if (code & CLIP_BOTTOM) {
+            x = *x0 + (int)(dx * (ymax - *y0) / dy);
+            y = ymax;
+        } else if (code & CLIP_LEFT) {
+            y = *y0 + (int)(dy * (xmin - *x0) / dx);
+            x = xmin;
+        } else {
+            y = *y0 + (int)(dy * (xmax - *x0) / dx);
+            x = xmax;
+        }
+
+        if (code == code0) {
+            *x0 = x;
+            *y0 = y;
+            code0 = overlay_clip_code(x, y, xmin, ymin, xmax, ymax);
+        } else {
+            *x1 = x;
+            *y1 = y;
+            code1 = overlay_clip_code(x, y, xmin, ymin, xmax, ymax);
+        }
+    }
+
+    return true;
+}
+
+void app_overlay_draw_line(const app_overlay_canvas_t *canvas, int x0, int y0, int x1, int y1, int thickness,
+                           uint32_t color)
+{
+    if (!canvas || !canvas->buffer || (thickness <= 0)) {
+        return;
+    }
+
+    overlay_pixel_t pixel = overlay_encode(canvas, color);
+    int half = thickness / 2;
+
+    if (y0 == y1) {
+        overlay_fill_rect_encoded(canvas, x0, y0 - half, x1, y0 - half + thickness - 1, &pixel);
+        return;
+    }
+    if (x0 == x1) {
+        overlay_fill_rect_encoded(canvas, x0 - half, y0, x0 - half + thickness - 1, y1, &pixel);
+        return;
+    }
+
+    // Keep the points whose brush still touches the canvas
+    int margin = thickness - 1;
+    if (!overlay_clip_line(&x0, &y0, &x1, &y1, -margin, -margin,
+                           canvas->width - 1 + margin, canvas->height - 1 + margin)) {
+        return;
+    }
+
+    int dx = (x1 > x0) ? (x1 - x0) : (x0 - x1);
+    int dy = (y1 > y0) ? (y0 - y1) : (y1 - y0);
+    int sx = (x0 < x1) ? 1 : -1;
+    int sy = (y0 < y1) ? 1 : -1;
+    int err = dx + dy;
+    int bpp = overlay_bytes_per_pixel(canvas);
+    int stride = overlay_stride(canvas);
+
+    while (1) {
+        if (thickness == 1) {
+            // The clipped line lies inside the canvas
+            uint8_t *dst = canvas->buffer + (size_t)y0 * stride + (size_t)x0 * bpp;
+            if (bpp == 2) {
+                *(uint16_t *)dst = pixel.pixel16;
+            } else {
+                dst[0] = pixel.bytes[0];
+                dst[1] = pixel.bytes[1];
+                dst[2] = pixel.bytes[2];
+            }
+        } else {
+            overlay_fill_rect_encoded(canvas, x0 - half, y0 - half, x0 - half + thickness - 1,
+                                      y0 - half + thickness - 1, &pixel);
+        }
+
+        if ((x0 == x1) && (y0 == y1)) {
+            break;
+        }
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+static const uint8_t *overlay_get_glyph(char c)
+{
+    if ((c >= 'a') && (c <= 'z')) {
+        c = c - 'a' + 'A';
+    }
+    if ((c < FONT_FIRST_CHAR) || (c > FONT_LAST_CHAR)) {
+        return NULL;
+    }
+
+    return font_5x7[c - FONT_FIRST_CHAR];
+}
+
+void app_overlay_draw_text(const app_overlay_canvas_t *canvas, int x, int y, const char *text, int scale,
+                           uint32_t color)
+{
+    if (!canvas || !canvas->buffer || !text || (scale <= 0)) {
+        return;
+    }
+
+    overlay_pixel_t pixel = overlay_encode(canvas, color);
+    int advance = (APP_OVERLAY_FONT_WIDTH + APP_OVERLAY_FONT_SPACING) * scale;
+
+    for (; *text; text++, x += advance) {
+        if ((x >= canvas->width) || (y >= canvas->height) || (y + APP_OVERLAY_FONT_HEIGHT * scale <= 0)) {
+            break;
+        }
+        if (x + advance <= 0) {
+            continue;
+        }
+
+        const uint8_t *glyph = overlay_get_glyph(*text);
+        if (!glyph) {
+            continue;
+        }
+
+        // One rectangle per vertical run of set bits
+        for (int col = 0; col < APP_OVERLAY_FONT_WIDTH; col++) {
+            uint8_t bits = glyph[col];
+            int gx = x + col * scale;
+            int row = 0;
+
+            while (bits) {
+                while (!(bits & 1)) {
+                    bits >>= 1;
+                    row++;
+                }
+                int start = row;
+                while (bits & 1) {
+                    bits >>= 1;
+                    row++;
+                }
+                overlay_fill_rect_encoded(canvas, gx, y + start * scale, gx + scale - 1, y + row * scale - 1, &pixel);
+            }
+        }
+    }
+}
+
+void app_overlay_get_text_size(const char *text, int scale, int *width, int *height)
+{
+    int len = text ? (int)strlen(text) : 0;
+
+    if (width) {
+        *width = (len > 0) ? (len * (APP_OVERLAY_FONT_WIDTH + APP_OVERLAY_FONT_SPACING) - APP_OVERLAY_FONT_SPACING) * scale : 0;
+    }
+    if (height) {
+        *height = APP_OVERLAY_FONT_HEIGHT * scale;
+    }
+}
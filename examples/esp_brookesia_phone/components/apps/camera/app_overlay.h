@@ -0,0 +1,127 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Build an overlay color from 8-bit components.
+ */
+#define APP_OVERLAY_RGB(r, g, b)    ((((uint32_t)(r) & 0xFF) << 16) | (((uint32_t)(g) & 0xFF) << 8) | ((uint32_t)(b) & 0xFF))
+
+#define APP_OVERLAY_FONT_WIDTH      (5)     /*!< Glyph width of the built-in font, in pixels at scale 1. */
+#define APP_OVERLAY_FONT_HEIGHT     (7)     /*!< Glyph height of the built-in font, in pixels at scale 1. */
+#define APP_OVERLAY_FONT_SPACING    (1)     /*!< Gap between two glyphs, in pixels at scale 1. */
+
+/**
+ * @brief Pixel format of an overlay canvas.
+ */
+typedef enum {
+    APP_OVERLAY_FMT_RGB565 = 0,         /*!< 16-bit pixels, native endian (R in the high bits). */
+    APP_OVERLAY_FMT_RGB888,             /*!< 24-bit pixels, bytes R, G, B in memory order. */
+} app_overlay_fmt_t;
+
+/**
+ * @brief Frame buffer the overlay primitives draw into.
+ */
+typedef struct {
+    uint8_t *buffer;                    /*!< First pixel of the frame. */
+    int width;                          /*!< Width in pixels. */
+    int height;                         /*!< Height in pixels. */
+    int stride;                         /*!< Distance between two lines in bytes, 0 for packed lines. */
+    app_overlay_fmt_t format;           /*!< Pixel format. */
+    bool swap_bytes;                    /*!< RGB565: swap the two bytes of a pixel. RGB888: store B, G, R. */
+} app_overlay_canvas_t;
+
+/**
+ * @brief Fill a rectangle.
+ *
+ * The rectangle is clipped to the canvas once, then every line is written as one span.
+ *
+ * @param canvas Target canvas.
+ * @param x1 Left edge, inclusive.
+ * @param y1 Top edge, inclusive.
+ * @param x2 Right edge, inclusive.
+ * @param y2 Bottom edge, inclusive.
+ * @param color Color built with `APP_OVERLAY_RGB`.
+ */
+void app_overlay_fill_rect(const app_overlay_canvas_t *canvas, int x1, int y1, int x2, int y2, uint32_t color);
+
+/**
+ * @brief Draw the outline of a box, growing inwards with the thickness.
+ *
+ * @param canvas Target canvas.
+ * @param x1 Left edge, inclusive.
+ * @param y1 Top edge, inclusive.
+ * @param x2 Right edge, inclusive.
+ * @param y2 Bottom edge, inclusive.
+ * @param thickness Line thickness in pixels.
+ * @param color Color built with `APP_OVERLAY_RGB`.
+ */
+void app_overlay_draw_box(const app_overlay_canvas_t *canvas, int x1, int y1, int x2, int y2, int thickness,
+                          uint32_t color);
+
+/**
+ * @brief Draw a square point centered on (x, y).
+ *
+ * @param canvas Target canvas.
+ * @param x Center x.
+ * @param y Center y.
+ * @param radius Half size, the point covers `2 * radius + 1` pixels per side.
+ * @param color Color built with `APP_OVERLAY_RGB`.
+ */
+void app_overlay_draw_point(const app_overlay_canvas_t *canvas, int x, int y, int radius, uint32_t color);
+
+/**
+ * @brief Draw a line between two points.
+ *
+ * Horizontal and vertical lines are drawn as rectangles. Other lines are clipped to the canvas
+ * (enlarged by the thickness) before being rasterized.
+ *
+ * @param canvas Target canvas.
+ * @param x0 Start x.
+ * @param y0 Start y.
+ * @param x1 End x.
+ * @param y1 End y.
+ * @param thickness Line thickness in pixels.
+ * @param color Color built with `APP_OVERLAY_RGB`.
+ */
+void app_overlay_draw_line(const app_overlay_canvas_t *canvas, int x0, int y0, int x1, int y1, int thickness,
+                           uint32_t color);
+
+/**
+ * @brief Draw a text with the built-in 5x7 font.
+ *
+ * Supports digits, letters (drawn upper case), space and `%.:-/#`. Other characters are left blank.
+ *
+ * @param canvas Target canvas.
+ * @param x Left edge of the first glyph.
+ * @param y Top edge of the glyphs.
+ * @param text NUL-terminated text.
+ * @param scale Integer glyph magnification, at least 1.
+ * @param color Color built with `APP_OVERLAY_RGB`.
+ */
+void app_overlay_draw_text(const app_overlay_canvas_t *canvas, int x, int y, const char *text, int scale,
+                           uint32_t color);
+
+/**
+ * @brief Get the size covered by a text drawn with `app_overlay_draw_text`.
+ *
+ * @param text NUL-terminated text.
+ * @param scale Integer glyph magnification, at least 1.
+ * @param width Returned width in pixels, may be NULL.
+ * @param height Returned height in pixels, may be NULL.
+ */
+void app_overlay_get_text_size(const char *text, int scale, int *width, int *height);
+
+#ifdef __cplusplus
+}
+#endif
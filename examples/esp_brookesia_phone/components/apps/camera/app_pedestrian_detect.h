@@ -6,11 +6,38 @@
 #pragma once
 
 #include "pedestrian_detect.hpp"
+#include "app_detect_result.hpp"
 
 #define EXAMPLE_DETECT_RES                   (224)
 #define EXAMPLE_DETECT_PX_FORMAT             (24)
 
-std::list<dl::detect::result_t> app_pedestrian_detect(uint16_t *frame, int width, int height);
+/* The model preprocessor reads RGB565 as big endian on the ESP32-P4, a frame converted for it must match */
+#if CONFIG_IDF_TARGET_ESP32P4
+#define APP_PEDESTRIAN_RGB565_BIG_ENDIAN     (true)
+#else
+#define APP_PEDESTRIAN_RGB565_BIG_ENDIAN     (false)
+#endif
+
+/**
+ * @brief Run the detector on an RGB565 frame and store the results into a result block.
+ *
+ * @param frame Frame to analyse.
+ * @param width Frame width.
+ * @param height Frame height.
+ * @param scale Factor applied to the result coordinates.
+ * @param result Result block receiving the detected objects.
+ */
+void app_pedestrian_detect(uint16_t *frame, int width, int height, int scale, app_detect_result_t *result);
+
+/**
+ * @brief Run the detector on a frame already at the model input size and format, so that the preprocessor
+ *        neither resizes nor converts it.
+ *
+ * @param input `EXAMPLE_DETECT_RES` x `EXAMPLE_DETECT_RES` RGB888 frame, R, G, B in memory.
+ * @param map Mapping of the input coordinates back to the capture frame.
+ * @param result Result block receiving the detected objects.
+ */
+void app_pedestrian_detect_input(uint8_t *input, const app_detect_map_t *map, app_detect_result_t *result);
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,10 +46,6 @@ extern "C" {
 PedestrianDetect *get_pedestrian_detect();
 void delete_pedestrian_detect();
 
-void draw_rectangle_rgb(uint16_t *buffer, int width, int height, int x1, int y1, int x2, int y2, int x_offset, int y_offset, uint8_t r, uint8_t g, uint8_t b, int thickness);
-
-void draw_green_points(uint16_t *buffer, const std::vector<int> &landmarks);
-
 #ifdef __cplusplus
 }
 #endif
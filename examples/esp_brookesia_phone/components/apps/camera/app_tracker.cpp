@@ -0,0 +1,313 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "app_tracker.hpp"
+
+#define US_PER_S                (1000000.0f)
+
+typedef struct {
+    uint16_t id;                        // 0 for a free slot
+    uint8_t model;
+    uint8_t category;
+    uint8_t score;
+    uint8_t hits;
+    int64_t timestamp_us;               // Time of the last correction
+    float cx, cy, w, h;                 // Box center and size at `timestamp_us`
+    float vx, vy;                       // Center velocity in pixels per second
+    uint8_t keypoint_num;
+    int16_t keypoint[APP_DETECT_KEYPOINT_MAX * 2];  // Keypoints at `timestamp_us`
+} tracker_track_t;
+
+struct app_tracker_t {
+    app_tracker_cfg_t cfg;
+    tracker_track_t tracks[APP_TRACKER_TRACK_MAX];
+    float iou[APP_TRACKER_TRACK_MAX][APP_DETECT_RESULT_MAX];   // Scratch, kept off the caller's stack
+    uint16_t next_id;
+    app_tracker_stats_t stats;
+};
+
+static const char *TAG = "app_tracker";
+
+static inline int16_t to_coord(float value)
+{
+    if (value > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (value < INT16_MIN) {
+        return INT16_MIN;
+    }
+
+    return (int16_t)(value + (value >= 0 ? 0.5f : -0.5f));
+}
+
+static inline float tracker_horizon_s(const app_tracker_t *tracker, const tracker_track_t *track, int64_t timestamp_us)
+{
+    int64_t dt = timestamp_us - track->timestamp_us;
+
+    if (dt <= 0) {
+        return 0;
+    }
+    if (dt > tracker->cfg.max_predict_us) {
+        dt = tracker->cfg.max_predict_us;
+    }
+
+    return dt / US_PER_S;
+}
+
+static float tracker_iou(float ax1, float ay1, float ax2, float ay2, const int16_t *box)
+{
+    float ix1 = ax1 > box[0] ? ax1 : box[0];
+    float iy1 = ay1 > box[1] ? ay1 : box[1];
+    float ix2 = ax2 < box[2] ? ax2 : box[2];
+    float iy2 = ay2 < box[3] ? ay2 : box[3];
+
+    if ((ix2 <= ix1) || (iy2 <= iy1)) {
+        return 0;
+    }
+
+    float inter = (ix2 - ix1) * (iy2 - iy1);
+    float area_a = (ax2 - ax1) * (ay2 - ay1);
+    float area_b = (float)(box[2] - box[0]) * (box[3] - box[1]);
+
+    return inter / (area_a + area_b - inter);
+}
+
+static uint16_t tracker_alloc_id(app_tracker_t *tracker)
+{
+    uint16_t id = tracker->next_id++;
+    if (tracker->next_id == 0) {
+        tracker->next_id = 1;
+    }
+
+    return id;
+}
+
+static void tracker_start_track(app_tracker_t *tracker, const app_detect_object_t *obj, int64_t timestamp_us)
+{
+    tracker_track_t *track = NULL;
+    for (int i = 0; i < APP_TRACKER_TRACK_MAX; i++) {
+        if (tracker->tracks[i].id == 0) {
+            track = &tracker->tracks[i];
+            break;
+        }
+    }
+    if (!track) {
+        return;
+    }
+
+    track->id = tracker_alloc_id(tracker);
+    track->model = obj->model;
+    track->category = obj->category;
+    track->score = obj->score;
+    track->hits = 1;
+    track->timestamp_us = timestamp_us;
+    track->cx = (obj->box[0] + obj->box[2]) * 0.5f;
+    track->cy = (obj->box[1] + obj->box[3]) * 0.5f;
+    track->w = obj->box[2] - obj->box[0];
+    track->h = obj->box[3] - obj->box[1];
+    track->vx = 0;
+    track->vy = 0;
+    track->keypoint_num = obj->keypoint_num;
+    memcpy(track->keypoint, obj->keypoint, sizeof(track->keypoint));
+    tracker->stats.created_count++;
+}
+
+static void tracker_correct_track(const app_tracker_t *tracker, tracker_track_t *track, const app_detect_object_t *obj,
+                                  int64_t timestamp_us)
+{
+    float alpha = tracker->cfg.position_gain;
+    float beta = tracker->cfg.velocity_gain;
+    float dt = tracker_horizon_s(tracker, track, timestamp_us);
+
+    float pred_cx = track->cx + track->vx * dt;
+    float pred_cy = track->cy + track->vy * dt;
+    float rx = (obj->box[0] + obj->box[2]) * 0.5f - pred_cx;
+    float ry = (obj->box[1] + obj->box[3]) * 0.5f - pred_cy;
+
+    track->cx = pred_cx + alpha * rx;
+    track->cy = pred_cy + alpha * ry;
+    if ((dt > 0) && (track->hits == 1)) {
+        // Second detection: take the measured displacement as the initial velocity
+        track->vx = rx / dt;
+        track->vy = ry / dt;
+    } else if (dt > 0) {
+        track->vx += beta * rx / dt;
+        track->vy += beta * ry / dt;
+    }
+    track->w += alpha * ((obj->box[2] - obj->box[0]) - track->w);
+    track->h += alpha * ((obj->box[3] - obj->box[1]) - track->h);
+    track->score = obj->score;
+    track->timestamp_us = timestamp_us;
+    if (track->hits < UINT8_MAX) {
+        track->hits++;
+    }
+
+    // Keypoints follow the detection, shifted by the filtered center offset
+    int16_t dx = to_coord(track->cx - (obj->box[0] + obj->box[2]) * 0.5f);
+    int16_t dy = to_coord(track->cy - (obj->box[1] + obj->box[3]) * 0.5f);
+    track->keypoint_num = obj->keypoint_num;
+    for (int k = 0; k < obj->keypoint_num; k++) {
+        track->keypoint[2 * k] = obj->keypoint[2 * k] + dx;
+        track->keypoint[2 * k + 1] = obj->keypoint[2 * k + 1] + dy;
+    }
+}
+
+esp_err_t app_tracker_new(const app_tracker_cfg_t *cfg, app_tracker_handle_t *ret_handle)
+{
+    ESP_RETURN_ON_FALSE(cfg && ret_handle, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE((cfg->position_gain > 0) && (cfg->position_gain <= 1) && (cfg->velocity_gain >= 0) &&
+                        (cfg->velocity_gain < 1), ESP_ERR_INVALID_ARG, TAG, "Invalid filter gains");
+
+    app_tracker_t *tracker = (app_tracker_t *)heap_caps_calloc(1, sizeof(app_tracker_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(tracker, ESP_ERR_NO_MEM, TAG, "No memory for tracker");
+
+    tracker->cfg = *cfg;
+    tracker->next_id = 1;
+    *ret_handle = tracker;
+
+    return ESP_OK;
+}
+
+void app_tracker_del(app_tracker_handle_t handle)
+{
+    if (handle) {
+        heap_caps_free(handle);
+    }
+}
+
+void app_tracker_reset(app_tracker_handle_t handle)
+{
+    memset(handle->tracks, 0, sizeof(handle->tracks));
+    handle->stats.live_count = 0;
+}
+
+void app_tracker_update(app_tracker_handle_t handle, const app_detect_result_t *detections)
+{
+    app_tracker_t *tracker = handle;
+    int64_t timestamp_us = detections->timestamp_us;
+    float (*iou)[APP_DETECT_RESULT_MAX] = tracker->iou;
+    bool track_matched[APP_TRACKER_TRACK_MAX] = { 0 };
+    bool det_matched[APP_DETECT_RESULT_MAX] = { 0 };
+    uint32_t det_num = detections->count;
+
+    tracker->stats.update_count++;
+
+    // IoU between the tracks predicted at the detection time and the detections
+    for (int t = 0; t < APP_TRACKER_TRACK_MAX; t++) {
+        const tracker_track_t *track = &tracker->tracks[t];
+        if (track->id == 0) {
+            continue;
+        }
+        float dt = tracker_horizon_s(tracker, track, timestamp_us);
+        float cx = track->cx + track->vx * dt;
+        float cy = track->cy + track->vy * dt;
+        for (uint32_t d = 0; d < det_num; d++) {
+            const app_detect_object_t *obj = &detections->objects[d];
+            iou[t][d] = ((obj->model == track->model) && (obj->category == track->category)) ?
+                        tracker_iou(cx - track->w * 0.5f, cy - track->h * 0.5f, cx + track->w * 0.5f,
+                                    cy + track->h * 0.5f, obj->box) : 0;
+        }
+    }
+
+    // Greedy assignment by decreasing IoU, ties go to the lowest indexes so the result is deterministic
+    while (1) {
+        float best = tracker->cfg.iou_threshold;
+        int best_t = -1;
+        int best_d = -1;
+        for (int t = 0; t < APP_TRACKER_TRACK_MAX; t++) {
+            if ((tracker->tracks[t].id == 0) || track_matched[t]) {
+                continue;
+            }
+            for (uint32_t d = 0; d < det_num; d++) {
+                if (!det_matched[d] && (iou[t][d] > best)) {
+                    best = iou[t][d];
+                    best_t = t;
+                    best_d = d;
+                }
+            }
+        }
+        if (best_t < 0) {
+            break;
+        }
+
+        track_matched[best_t] = true;
+        det_matched[best_d] = true;
+        tracker_correct_track(tracker, &tracker->tracks[best_t], &detections->objects[best_d], timestamp_us);
+        tracker->stats.matched_count++;
+    }
+
+    // Drop tracks not seen for too long
+    for (int t = 0; t < APP_TRACKER_TRACK_MAX; t++) {
+        tracker_track_t *track = &tracker->tracks[t];
+        if ((track->id != 0) && !track_matched[t] && (timestamp_us - track->timestamp_us > tracker->cfg.max_age_us)) {
+            track->id = 0;
+            tracker->stats.dropped_count++;
+        }
+    }
+
+    for (uint32_t d = 0; d < det_num; d++) {
+        if (!det_matched[d]) {
+            tracker_start_track(tracker, &detections->objects[d], timestamp_us);
+        }
+    }
+
+    uint32_t live = 0;
+    for (int t = 0; t < APP_TRACKER_TRACK_MAX; t++) {
+        live += (tracker->tracks[t].id != 0);
+    }
+    tracker->stats.live_count = live;
+}
+
+void app_tracker_predict(app_tracker_handle_t handle, int64_t timestamp_us, app_detect_result_t *result)
+{
+    const app_tracker_t *tracker = handle;
+    uint32_t count = 0;
+
+    for (int t = 0; (t < APP_TRACKER_TRACK_MAX) && (count < APP_DETECT_RESULT_MAX); t++) {
+        const tracker_track_t *track = &tracker->tracks[t];
+        if ((track->id == 0) || (track->hits < tracker->cfg.min_hits) ||
+                (timestamp_us - track->timestamp_us > tracker->cfg.max_age_us)) {
+            continue;
+        }
+
+        float dt = tracker_horizon_s(tracker, track, timestamp_us);
+        float dx = track->vx * dt;
+        float dy = track->vy * dt;
+        float cx = track->cx + dx;
+        float cy = track->cy + dy;
+
+        app_detect_object_t *obj = &result->objects[count++];
+        obj->box[0] = to_coord(cx - track->w * 0.5f);
+        obj->box[1] = to_coord(cy - track->h * 0.5f);
+        obj->box[2] = to_coord(cx + track->w * 0.5f);
+        obj->box[3] = to_coord(cy + track->h * 0.5f);
+        obj->track_id = track->id;
+        obj->model = track->model;
+        obj->category = track->category;
+        obj->score = track->score;
+        obj->keypoint_num = track->keypoint_num;
+        int16_t kdx = to_coord(dx);
+        int16_t kdy = to_coord(dy);
+        for (int k = 0; k < track->keypoint_num; k++) {
+            obj->keypoint[2 * k] = track->keypoint[2 * k] + kdx;
+            obj->keypoint[2 * k + 1] = track->keypoint[2 * k + 1] + kdy;
+        }
+    }
+    result->count = count;
+    result->timestamp_us = timestamp_us;
+}
+
+esp_err_t app_tracker_get_stats(app_tracker_handle_t handle, app_tracker_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(handle && stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    *stats = handle->stats;
+
+    return ESP_OK;
+}
@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "app_detect_result.hpp"
+
+#define APP_TRACKER_TRACK_MAX           (16)    /*!< Maximum number of live tracks. */
+
+/**
+ * @brief Tracker configuration.
+ *
+ * Every track runs an alpha-beta filter (a fixed-gain Kalman filter) on its box center, with a
+ * constant velocity model, and low-pass filters its box size.
+ */
+typedef struct {
+    float position_gain;                /*!< Alpha, weight of a new detection on the position and size (0, 1]. */
+    float velocity_gain;                /*!< Beta, weight of a new detection on the velocity [0, 1). */
+    float iou_threshold;                /*!< Minimum IoU between a predicted box and a detection to match them. */
+    uint32_t max_age_us;                /*!< A track without detection for longer than this is dropped. */
+    uint32_t max_predict_us;            /*!< Boxes are not extrapolated further than this after the last detection. */
+    uint8_t min_hits;                   /*!< Number of detections before a track is reported. */
+} app_tracker_cfg_t;
+
+#define APP_TRACKER_DEFAULT_CONFIG() \
+    {                                \
+        .position_gain = 0.6f,       \
+        .velocity_gain = 0.25f,      \
+        .iou_threshold = 0.1f,       \
+        .max_age_us = 600000,        \
+        .max_predict_us = 300000,    \
+        .min_hits = 1,               \
+    }
+
+/**
+ * @brief Tracker statistics.
+ */
+typedef struct {
+    uint32_t update_count;              /*!< Number of detection results fed to the tracker. */
+    uint32_t matched_count;             /*!< Number of detections matched to an existing track. */
+    uint32_t created_count;             /*!< Number of tracks created. */
+    uint32_t dropped_count;             /*!< Number of tracks dropped after `max_age_us`. */
+    uint32_t live_count;                /*!< Number of live tracks. */
+} app_tracker_stats_t;
+
+typedef struct app_tracker_t *app_tracker_handle_t;
+
+/**
+ * @brief Create a tracker.
+ *
+ * The tracker only depends on its inputs: the same detection sequence with the same timestamps
+ * always produces the same tracks and identifiers.
+ *
+ * @param cfg Tracker configuration.
+ * @param ret_handle Returned handle.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid argument, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_tracker_new(const app_tracker_cfg_t *cfg, app_tracker_handle_t *ret_handle);
+
+/**
+ * @brief Delete a tracker.
+ *
+ * @param handle Handle of the tracker, may be NULL.
+ */
+void app_tracker_del(app_tracker_handle_t handle);
+
+/**
+ * @brief Drop all tracks. Identifiers keep increasing.
+ *
+ * @param handle Handle of the tracker.
+ */
+void app_tracker_reset(app_tracker_handle_t handle);
+
+/**
+ * @brief Correct the tracks with the detections of one frame.
+ *
+ * Tracks are predicted to `detections->timestamp_us`, matched greedily by decreasing IoU with
+ * detections of the same model and category, then corrected. Unmatched detections start new tracks.
+ *
+ * @param handle Handle of the tracker.
+ * @param detections Detections of one frame, timestamps must not decrease between calls.
+ */
+void app_tracker_update(app_tracker_handle_t handle, const app_detect_result_t *detections);
+
+/**
+ * @brief Predict the tracked boxes at a given time.
+ *
+ * @param handle Handle of the tracker.
+ * @param timestamp_us Time of the frame the boxes are drawn on.
+ * @param result Returned boxes, with `track_id` set. `frame_seq` is left untouched.
+ */
+void app_tracker_predict(app_tracker_handle_t handle, int64_t timestamp_us, app_detect_result_t *result);
+
+/**
+ * @brief Get the tracker statistics.
+ *
+ * @param handle Handle of the tracker.
+ * @param stats Returned statistics.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid argument.
+ */
+esp_err_t app_tracker_get_stats(app_tracker_handle_t handle, app_tracker_stats_t *stats);
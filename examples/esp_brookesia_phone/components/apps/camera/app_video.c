@@ -7,6 +7,7 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include <string.h>
+#include <stdatomic.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
@@ -14,9 +15,11 @@
 #include <sys/errno.h>
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "linux/videodev2.h"
 #include "esp_video_init.h"
 #include "app_video.h"
+#include "app_latency_stats.h"
 
 static const char *TAG = "app_video";
 
@@ -35,8 +38,16 @@ typedef struct {
     size_t camera_buf_size;
     uint32_t camera_buf_hes;
     uint32_t camera_buf_ves;
-    struct v4l2_buffer v4l2_buf;
+    struct v4l2_buffer v4l2_buf[MAX_BUFFER_COUNT];
+    atomic_int buf_refcount[MAX_BUFFER_COUNT];
+    int64_t capture_time_us[MAX_BUFFER_COUNT];
+    atomic_int buf_held;
+    atomic_bool streaming;
+    int video_fd;
     uint8_t camera_mem_mode;
+    uint32_t frame_count;
+    atomic_uint deferred_count;
+    uint32_t held_max;
     app_video_frame_operation_cb_t user_camera_video_frame_operation_cb;
     TaskHandle_t video_stream_task_handle;
     EventGroupHandle_t video_event_group;
@@ -255,17 +266,41 @@ uint32_t app_video_get_buf_size(void)
     return buf_size;
 }
 
-static inline esp_err_t video_receive_video_frame(int video_fd)
+static inline esp_err_t video_receive_video_frame(int video_fd, uint8_t *buf_index)
 {
-    memset(&app_camera_video.v4l2_buf, 0, sizeof(app_camera_video.v4l2_buf));
-    app_camera_video.v4l2_buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    app_camera_video.v4l2_buf.memory = app_camera_video.camera_mem_mode;
+    struct v4l2_buffer buf;
 
-    int res = ioctl(video_fd, VIDIOC_DQBUF, &(app_camera_video.v4l2_buf));
-    if (res != 0) {
+    memset(&buf, 0, sizeof(buf));
+    buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = app_camera_video.camera_mem_mode;
+
+    int64_t wait_start_us = esp_timer_get_time();
+    int res = ioctl(video_fd, VIDIOC_DQBUF, &buf);
+    int64_t dequeue_us = esp_timer_get_time();
+    if (res != 0 || buf.index >= MAX_BUFFER_COUNT) {
         ESP_LOGE(TAG, "failed to receive video frame");
         goto errout;
     }
+    app_latency_record(APP_LATENCY_STAGE_DQBUF_WAIT, (uint32_t)(dequeue_us - wait_start_us));
+
+    // Prefer the driver timestamp, fall back to the dequeue time if it is missing or not on the esp_timer base
+    int64_t capture_us = (int64_t)buf.timestamp.tv_sec * 1000000 + buf.timestamp.tv_usec;
+    if (capture_us <= 0 || capture_us > dequeue_us || dequeue_us - capture_us > 1000000) {
+        capture_us = dequeue_us;
+    }
+    app_camera_video.capture_time_us[buf.index] = capture_us;
+
+    buf.m.userptr = (unsigned long)app_camera_video.camera_buffer[buf.index];
+    buf.length = app_camera_video.camera_buf_size;
+    app_camera_video.v4l2_buf[buf.index] = buf;
+    atomic_store(&app_camera_video.buf_refcount[buf.index], 1);
+
+    int held = atomic_fetch_add(&app_camera_video.buf_held, 1) + 1;
+    if (held > app_camera_video.held_max) {
+        app_camera_video.held_max = held;
+    }
+    app_camera_video.frame_count++;
+    *buf_index = buf.index;
 
     return ESP_OK;
 
@@ -273,13 +308,8 @@ errout:
     return ESP_FAIL;
 }
 
-static inline void video_operation_video_frame(int video_fd)
+static inline void video_operation_video_frame(int video_fd, uint8_t buf_index)
 {
-    app_camera_video.v4l2_buf.m.userptr = (unsigned long)app_camera_video.camera_buffer[app_camera_video.v4l2_buf.index];
-    app_camera_video.v4l2_buf.length = app_camera_video.camera_buf_size;
-
-    uint8_t buf_index = app_camera_video.v4l2_buf.index;
-
     app_camera_video.user_camera_video_frame_operation_cb(
                         app_camera_video.camera_buffer[buf_index],
                         buf_index,
@@ -289,9 +319,16 @@ static inline void video_operation_video_frame(int video_fd)
                     );
 }
 
-static inline esp_err_t video_free_video_frame(int video_fd)
+static inline esp_err_t video_free_video_frame(int video_fd, uint8_t buf_index)
 {
-    if (ioctl(video_fd, VIDIOC_QBUF, &(app_camera_video.v4l2_buf)) != 0) {
+    atomic_fetch_sub(&app_camera_video.buf_held, 1);
+
+    /* Buffers released after STREAMOFF are re-queued by the next VIDIOC_REQBUFS */
+    if (!atomic_load(&app_camera_video.streaming)) {
+        return ESP_OK;
+    }
+
+    if (ioctl(video_fd, VIDIOC_QBUF, &app_camera_video.v4l2_buf[buf_index]) != 0) {
         ESP_LOGE(TAG, "failed to free video frame");
         goto errout;
     }
@@ -311,6 +348,12 @@ static inline esp_err_t video_stream_start(int video_fd)
         ESP_LOGE(TAG, "failed to start stream");
         goto errout;
     }
+    app_camera_video.video_fd = video_fd;
+    for (int i = 0; i < MAX_BUFFER_COUNT; i++) {
+        atomic_store(&app_camera_video.buf_refcount[i], 0);
+    }
+    atomic_store(&app_camera_video.buf_held, 0);
+    atomic_store(&app_camera_video.streaming, true);
 
     struct v4l2_format format = {0};
     format.type = type;
@@ -330,6 +373,7 @@ static inline esp_err_t video_stream_stop(int video_fd)
     ESP_LOGI(TAG, "Video Stream Stop");
 
     int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    atomic_store(&app_camera_video.streaming, false);
     if (ioctl(video_fd, VIDIOC_STREAMOFF, &type)) {
         ESP_LOGE(TAG, "failed to stop stream");
         goto errout;
@@ -345,14 +389,18 @@ errout:
 
 static void video_stream_task(void *arg)
 {
-    int video_fd = *((int *)arg);
+    int video_fd = app_camera_video.video_fd;
 
     while (1) {
-        ESP_ERROR_CHECK(video_receive_video_frame(video_fd));
+        uint8_t buf_index = 0;
+        ESP_ERROR_CHECK(video_receive_video_frame(video_fd, &buf_index));
 
-        video_operation_video_frame(video_fd);
+        video_operation_video_frame(video_fd, buf_index);
 
-        ESP_ERROR_CHECK(video_free_video_frame(video_fd));
+        /* Drop the stream task reference, the buffer goes back to the driver once unused */
+        if (atomic_fetch_sub(&app_camera_video.buf_refcount[buf_index], 1) == 1) {
+            ESP_ERROR_CHECK(video_free_video_frame(video_fd, buf_index));
+        }
 
         if(xEventGroupGetBits(app_camera_video.video_event_group) & VIDEO_TASK_DELETE) {
             xEventGroupClearBits(app_camera_video.video_event_group, VIDEO_TASK_DELETE);
@@ -372,7 +420,7 @@ esp_err_t app_video_stream_task_start(int video_fd, int core_id)
 
     video_stream_start(video_fd);
 
-    BaseType_t result = xTaskCreatePinnedToCore(video_stream_task, "video stream task", VIDEO_TASK_STACK_SIZE, &video_fd, VIDEO_TASK_PRIORITY, &app_camera_video.video_stream_task_handle, core_id);
+    BaseType_t result = xTaskCreatePinnedToCore(video_stream_task, "video stream task", VIDEO_TASK_STACK_SIZE, NULL, VIDEO_TASK_PRIORITY, &app_camera_video.video_stream_task_handle, core_id);
 
     if (result != pdPASS) {
         ESP_LOGE(TAG, "failed to create video stream task");
@@ -400,6 +448,65 @@ esp_err_t app_video_register_frame_operation_cb(app_video_frame_operation_cb_t o
     return ESP_OK;
 }
 
+esp_err_t app_video_frame_ref(uint8_t buf_index)
+{
+    if (buf_index >= MAX_BUFFER_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int refcount = atomic_load(&app_camera_video.buf_refcount[buf_index]);
+    do {
+        if (refcount <= 0) {
+            ESP_LOGE(TAG, "frame buffer %d is not held", buf_index);
+            return ESP_ERR_INVALID_STATE;
+        }
+    } while (!atomic_compare_exchange_weak(&app_camera_video.buf_refcount[buf_index], &refcount, refcount + 1));
+
+    return ESP_OK;
+}
+
+esp_err_t app_video_frame_unref(uint8_t buf_index)
+{
+    if (buf_index >= MAX_BUFFER_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int refcount = atomic_fetch_sub(&app_camera_video.buf_refcount[buf_index], 1);
+    if (refcount <= 0) {
+        atomic_fetch_add(&app_camera_video.buf_refcount[buf_index], 1);
+        ESP_LOGE(TAG, "frame buffer %d released too many times", buf_index);
+        return ESP_ERR_INVALID_STATE;
+    } else if (refcount > 1) {
+        return ESP_OK;
+    }
+
+    atomic_fetch_add(&app_camera_video.deferred_count, 1);
+
+    return video_free_video_frame(app_camera_video.video_fd, buf_index);
+}
+
+int64_t app_video_get_frame_timestamp(uint8_t buf_index)
+{
+    if (buf_index >= MAX_BUFFER_COUNT) {
+        return 0;
+    }
+
+    return app_camera_video.capture_time_us[buf_index];
+}
+
+esp_err_t app_video_get_stats(app_video_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    stats->frame_count = app_camera_video.frame_count;
+    stats->deferred_count = atomic_load(&app_camera_video.deferred_count);
+    stats->held_max = app_camera_video.held_max;
+
+    return ESP_OK;
+}
+
 esp_err_t app_video_stream_wait_stop(void)
 {
     xEventGroupWaitBits(app_camera_video.video_event_group, VIDEO_TASK_DELETE_DONE, pdTRUE, pdTRUE, portMAX_DELAY);
@@ -26,7 +26,7 @@ typedef enum {
 } video_fmt_t;
 
 #define EXAMPLE_CAM_DEV_PATH                (ESP_VIDEO_MIPI_CSI_DEVICE_NAME)
-#define EXAMPLE_CAM_BUF_NUM                 (4)
+#define EXAMPLE_CAM_BUF_NUM                 (4)     // Stream, display and detect references, plus one queued
 
 #if CONFIG_BSP_LCD_COLOR_FORMAT_RGB565
 #define APP_VIDEO_FMT              (APP_VIDEO_FMT_RGB565)
@@ -34,6 +34,15 @@ typedef enum {
 #define APP_VIDEO_FMT              (APP_VIDEO_FMT_RGB888)
 #endif
 
+/**
+ * @brief Video stream statistics.
+ */
+typedef struct {
+    uint32_t frame_count;           /*!< Number of frames dequeued from the driver. */
+    uint32_t deferred_count;        /*!< Number of frames returned to the driver after the frame callback, by another owner. */
+    uint32_t held_max;              /*!< Maximum number of buffers held by the application at the same time. */
+} app_video_stats_t;
+
 typedef void (*app_video_frame_operation_cb_t)(uint8_t *camera_buf, uint8_t camera_buf_index, uint32_t camera_buf_hes, uint32_t camera_buf_ves, size_t camera_buf_len);
 
 /**
@@ -135,6 +144,47 @@ esp_err_t app_video_stream_task_stop(int video_fd);
  */
 esp_err_t app_video_register_frame_operation_cb(app_video_frame_operation_cb_t operation_cb);
 
+/**
+ * @brief Take an additional reference on a captured frame buffer.
+ *
+ * A frame is owned by the stream task while the frame operation callback runs. Any consumer that
+ * keeps using the buffer after the callback returns (e.g. a detection task) must take a reference
+ * from inside the callback and drop it with `app_video_frame_unref` once done. The buffer is
+ * re-queued to the driver only when the last reference is dropped.
+ *
+ * @param buf_index Index of the frame buffer, as passed to the frame operation callback.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG / ESP_ERR_INVALID_STATE if the buffer is not held.
+ */
+esp_err_t app_video_frame_ref(uint8_t buf_index);
+
+/**
+ * @brief Drop a reference on a captured frame buffer.
+ *
+ * Re-queues the buffer to the driver when the last reference is dropped. Must not be called from ISR.
+ *
+ * @param buf_index Index of the frame buffer.
+ * @return ESP_OK on success, ESP_FAIL if re-queueing the buffer failed.
+ */
+esp_err_t app_video_frame_unref(uint8_t buf_index);
+
+/**
+ * @brief Get the capture time of a frame buffer.
+ *
+ * Uses the driver timestamp when it is on the `esp_timer` time base, otherwise the time the frame was dequeued.
+ *
+ * @param buf_index Index of the frame buffer, as passed to the frame operation callback.
+ * @return Capture time in microseconds (`esp_timer_get_time` base), 0 if the index is invalid.
+ */
+int64_t app_video_get_frame_timestamp(uint8_t buf_index);
+
+/**
+ * @brief Get the video stream statistics.
+ *
+ * @param stats Pointer to the structure receiving a snapshot of the counters.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL.
+ */
+esp_err_t app_video_get_stats(app_video_stats_t *stats);
+
 /**
  * @brief Wait for the video stream to stop.
  *
@@ -4,6 +4,7 @@
 #include "bsp/esp-bsp.h"
 #include "Game_2048.hpp"
 #include "esp_log.h"
+#include "bsp_extra_sound.h"
 
 #define ENABLE_CELL_DEBUG       (0)
 
@@ -310,8 +311,9 @@ bool Game2048::init(void)
     ESP_Brookesia_PhoneManager& manager = phone->getManager();
     _gesture = manager.getGesture();
 
-    if (bsp_extra_player_init() != ESP_OK) {
-        ESP_LOGE(TAG, "Play init with SPIFFS failed");
+    // The emoji sounds play over the music player, through their own mixer stream
+    if (bsp_extra_sound_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Sound init failed");
         return false;
     }
 
@@ -384,21 +386,21 @@ void Game2048::showEmojiScore(int score)
     } else if (score == 0) {
         index = 1;
         lv_label_set_text_fmt(_emoji_label, "Score[%d]: Weak...", score);
-        bsp_extra_player_play_file(MUSIC_WEAK);
+        bsp_extra_sound_play_file(MUSIC_WEAK);
     } else if (score < EMOJI_SCORE_NORMAL) {
         index = 2;
         lv_label_set_text_fmt(_emoji_label, "Score[%d]: Normal.", score);
-        bsp_extra_player_play_file(MUSIC_NORM);
+        bsp_extra_sound_play_file(MUSIC_NORM);
     }
     else if (score < EMOJI_SCORE_GOOD) {
         index = 3;
         lv_label_set_text_fmt(_emoji_label, "Score[%d]: Good!", score);
-        bsp_extra_player_play_file(MUSIC_GOOD);
+        bsp_extra_sound_play_file(MUSIC_GOOD);
     }
     else {
         index = 4;
         lv_label_set_text_fmt(_emoji_label, "Score[%d]: Excellent!", score);
-        bsp_extra_player_play_file(MUSIC_EXCL);
+        bsp_extra_sound_play_file(MUSIC_EXCL);
     }
 
     for (int i = 0; i < 6; i++) {
@@ -11,12 +11,17 @@
 
 #include "gui_music/lv_demo_music.h"
 #include "gui_music/lv_demo_music_main.h"
+#include "app_spectrum.h"
+#include "app_playlist.h"
+#include "app_library.h"
 #include "MusicPlayer.hpp"
 
 #if CONFIG_EXAMPLE_ENABLE_SD_CARD
 #define MUSIC_DIR   BSP_SD_MOUNT_POINT "/music"
+#define MUSIC_INDEX BSP_SD_MOUNT_POINT "/music.idx"
 #else
 #define MUSIC_DIR   BSP_SPIFFS_MOUNT_POINT "/music"
+#define MUSIC_INDEX BSP_SPIFFS_MOUNT_POINT "/music.idx"
 #endif
 
 using namespace std;
@@ -37,8 +42,16 @@ MusicPlayer::~MusicPlayer()
 
 bool MusicPlayer::run(void)
 {
+    if (app_playlist_start(_file_iterator) != ESP_OK) {
+        ESP_LOGW(TAG, "Playlist not started");
+    }
+
     lv_demo_music(lv_scr_act(), _file_iterator);
 
+    if (app_spectrum_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Spectrum analyzer not started");
+    }
+
     return true;
 }
 
@@ -58,6 +71,9 @@ bool MusicPlayer::back(void)
 
 bool MusicPlayer::close(void)
 {
+    app_spectrum_stop();
+    app_playlist_stop();
+
     if (audio_player_pause() != ESP_OK) {
         ESP_LOGE(TAG, "audio_player_pause failed");
         return false;
@@ -78,5 +94,10 @@ bool MusicPlayer::init(void)
         return false;
     }
 
+    // Track metadata from the index of the last boot, the changed files are parsed in the background
+    if (app_library_start(_file_iterator, MUSIC_INDEX) != ESP_OK) {
+        ESP_LOGW(TAG, "Music library not started, the tracks are shown by file name");
+    }
+
     return true;
 }
@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "app_fft.h"
+
+#define Q15_ONE     (32767)
+
+static const char *TAG = "app_fft";
+
+esp_err_t app_fft_init(app_fft_t *fft, uint32_t size)
+{
+    ESP_RETURN_ON_FALSE(fft && (size >= APP_FFT_SIZE_MIN) && (size <= APP_FFT_SIZE_MAX) && !(size & (size - 1)),
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    // The tables are read for every bin of every frame
+    fft->twiddle = heap_caps_malloc(size * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    fft->window = heap_caps_malloc(size * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    if (!fft->twiddle || !fft->window) {
+        app_fft_deinit(fft);
+        ESP_LOGE(TAG, "No memory for %" PRIu32 " points tables", size);
+        return ESP_ERR_NO_MEM;
+    }
+    fft->size = size;
+
+    for (uint32_t k = 0; k < size / 2; k++) {
+        float phase = 2.0f * (float)M_PI * k / size;
+        fft->twiddle[2 * k] = (int16_t)lroundf(cosf(phase) * Q15_ONE);
+        fft->twiddle[2 * k + 1] = (int16_t)lroundf(sinf(phase) * Q15_ONE);
+    }
+    for (uint32_t n = 0; n < size; n++) {
+        fft->window[n] = (int16_t)lroundf(0.5f * (1.0f - cosf(2.0f * (float)M_PI * n / size)) * Q15_ONE);
+    }
+
+    return ESP_OK;
+}
+
+void app_fft_deinit(app_fft_t *fft)
+{
+    if (fft) {
+        free(fft->twiddle);
+        free(fft->window);
+        fft->twiddle = NULL;
+        fft->window = NULL;
+        fft->size = 0;
+    }
+}
+
+void app_fft_window(const app_fft_t *fft, int16_t *data)
+{
+    for (uint32_t n = 0; n < fft->size; n++) {
+        data[n] = (int16_t)(((int32_t)data[n] * fft->window[n]) >> 16);
+    }
+}
+
+static void fft_bit_reverse(uint32_t *x, uint32_t m)
+{
+    for (uint32_t i = 1, j = 0; i < m; i++) {
+        uint32_t bit = m >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            // One re/im pair per word
+            uint32_t tmp = x[i];
+            x[i] = x[j];
+            x[j] = tmp;
+        }
+    }
+}
+
+/*
+ * Radix-2 decimation in time on `m` complex points. Each butterfly halves its outputs, which keeps every value within
+ * the magnitude of the input.
+ */
+static void fft_complex(const app_fft_t *fft, int16_t *x, uint32_t m)
+{
+    fft_bit_reverse((uint32_t *)x, m);
+
+    // First stage, all the twiddles are 1
+    for (uint32_t i = 0; i < 2 * m; i += 4) {
+        int32_t ar = x[i], ai = x[i + 1];
+        int32_t br = x[i + 2], bi = x[i + 3];
+        x[i] = (int16_t)((ar + br) >> 1);
+        x[i + 1] = (int16_t)((ai + bi) >> 1);
+        x[i + 2] = (int16_t)((ar - br) >> 1);
+        x[i + 3] = (int16_t)((ai - bi) >> 1);
+    }
+
+    for (uint32_t len = 4; len <= m; len <<= 1) {
+        uint32_t half = len / 2;
+        // W_len^j is W_size^(j * size / len)
+        uint32_t step = fft->size / len;
+        for (uint32_t j = 0; j < half; j++) {
+            int32_t wr = fft->twiddle[2 * j * step];
+            int32_t wi = fft->twiddle[2 * j * step + 1];
+            for (uint32_t i = j; i < m; i += len) {
+                int16_t *a = &x[2 * i];
+                int16_t *b = &x[2 * (i + half)];
+                // b * (cos - j sin)
+                int32_t tr = (wr * b[0] + wi * b[1]) >> 15;
+                int32_t ti = (wr * b[1] - wi * b[0]) >> 15;
+                int32_t ar = a[0], ai = a[1];
+                a[0] = (int16_t)((ar + tr) >> 1);
+                a[1] = (int16_t)((ai + ti) >> 1);
+                b[0] = (int16_t)((ar - tr) >> 1);
+                b[1] = (int16_t)((ai - ti) >> 1);
+            }
+        }
+    }
+}
+
+void app_fft_real(const app_fft_t *fft, int16_t *data)
+{
+    const uint32_t m = fft->size / 2;
+
+    // Even samples as the real part, odd samples as the imaginary part
+    fft_complex(fft, data, m);
+
+    /*
+     * Split Z, the transform of the packed samples, into X, the transform of the real samples:
+     *   E = (Z[k] + conj(Z[m - k])) / 2, O = -j (Z[k] - conj(Z[m - k])) / 2
+     *   X[k] = E + W^k O, X[m - k] = conj(E - W^k O)
+     * halved once more, so X stays within the range of Z.
+     */
+    int32_t z0r = data[0], z0i = data[1];
+    data[0] = (int16_t)((z0r + z0i) >> 1);
+    data[1] = (int16_t)((z0r - z0i) >> 1);
+
+    for (uint32_t k = 1; k <= m / 2; k++) {
+        int16_t *a = &data[2 * k];
+        int16_t *b = &data[2 * (m - k)];
+        int32_t er = a[0] + b[0];       // 2 E
+        int32_t ei = a[1] - b[1];
+        int32_t dr = a[0] - b[0];       // 2 (Z[k] - conj(Z[m - k]))
+        int32_t di = a[1] + b[1];
+        // 2 O = (di, -dr), times W^k = cos - j sin
+        int32_t wr = fft->twiddle[2 * k];
+        int32_t wi = fft->twiddle[2 * k + 1];
+        int32_t tr = (wr * di - wi * dr) >> 15;
+        int32_t ti = (-wr * dr - wi * di) >> 15;
+        a[0] = (int16_t)((er + tr) >> 2);
+        a[1] = (int16_t)((ei + ti) >> 2);
+        if (b != a) {
+            b[0] = (int16_t)((er - tr) >> 2);
+            b[1] = (int16_t)(-((ei - ti) >> 2));
+        }
+    }
+}
+
+void app_fft_power(const app_fft_t *fft, const int16_t *data, uint32_t *power)
+{
+    power[0] = (uint32_t)((int32_t)data[0] * data[0]);
+    for (uint32_t k = 1; k < fft->size / 2; k++) {
+        int32_t re = data[2 * k];
+        int32_t im = data[2 * k + 1];
+        power[k] = (uint32_t)(re * re) + (uint32_t)(im * im);
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_FFT_SIZE_MIN    (16)
+#define APP_FFT_SIZE_MAX    (4096)
+
+/**
+ * @brief Fixed-point real FFT, Q15 in and out.
+ *
+ * The real input is transformed as a complex FFT of half its size followed by a split step, every stage scaled by
+ * 1/2 so nothing saturates: the output is the DFT divided by `size`.
+ */
+typedef struct {
+    uint32_t size;                      /*!< Real input length, a power of two. */
+    int16_t *twiddle;                   /*!< cos and sin of the `size / 2` first roots, Q15. */
+    int16_t *window;                    /*!< Hann window of `size` points, Q15. */
+} app_fft_t;
+
+/**
+ * @brief Allocate the tables of one FFT size.
+ *
+ * @param fft FFT to initialize.
+ * @param size Real input length, a power of two between APP_FFT_SIZE_MIN and APP_FFT_SIZE_MAX.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad size, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_fft_init(app_fft_t *fft, uint32_t size);
+
+/**
+ * @brief Free the tables.
+ */
+void app_fft_deinit(app_fft_t *fft);
+
+/**
+ * @brief Apply the Hann window and halve the samples, the input range `app_fft_real` needs.
+ *
+ * @param fft FFT.
+ * @param data `size` samples, in place.
+ */
+void app_fft_window(const app_fft_t *fft, int16_t *data);
+
+/**
+ * @brief Transform `size` real samples in place.
+ *
+ * The samples must stay within half of the Q15 range, `app_fft_window` does it. On return `data` holds the bins 0 to
+ * `size / 2 - 1` as re/im pairs, except that bin 0 holds the real DC term followed by the real Nyquist term.
+ *
+ * @param fft FFT.
+ * @param data `size` samples in, `size / 2` bins out.
+ */
+void app_fft_real(const app_fft_t *fft, int16_t *data);
+
+/**
+ * @brief Get the power of each bin of `app_fft_real`.
+ *
+ * @param fft FFT.
+ * @param data Bins from `app_fft_real`.
+ * @param power `size / 2` powers, re^2 + im^2. The Nyquist term is left out.
+ */
+void app_fft_power(const app_fft_t *fft, const int16_t *data, uint32_t *power);
+
+#ifdef __cplusplus
+}
+#endif
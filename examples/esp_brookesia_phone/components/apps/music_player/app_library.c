@@ -0,0 +1,734 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_library.h"
+
+#define LIBRARY_INDEX_MAGIC         (0x3142494C)    // "LIB1"
+#define LIBRARY_INDEX_VERSION       (2)
+#define LIBRARY_TRACK_MAX           (16384)         // An index claiming more is corrupted
+#define LIBRARY_TAG_READ_MAX        (16 * 1024)     // Text frames come first, the cover art after them is not read
+#define LIBRARY_AUDIO_READ_SIZE     (4 * 1024)      // First MP3 frame with its Xing or VBRI header, or the WAV chunks
+#define LIBRARY_ID3V1_SIZE          (128)
+#define LIBRARY_PATH_SIZE           (128)
+#define LIBRARY_TASK_PRIORITY       (1)             // Below the audio and LVGL tasks, the scan is not urgent
+#define LIBRARY_TASK_STACK_SIZE     (4 * 1024)
+#define LIBRARY_STOP_TIMEOUT_MS     (2000)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;               // Changes with the metadata layout, an index of another size is rebuilt
+    uint32_t count;
+} library_header_t;
+
+// One track in the index file
+typedef struct {
+    char path[LIBRARY_PATH_SIZE];       // The hash only sorts the records, two paths may share it
+    uint32_t path_hash;
+    uint32_t size;
+    uint32_t mtime;
+    app_library_track_t track;
+} library_record_t;
+
+typedef struct {
+    volatile bool running;
+    SemaphoreHandle_t exit_sem;
+    file_iterator_instance_t *iterator;
+    char index_path[LIBRARY_PATH_SIZE];
+    uint32_t count;
+    library_record_t *records;          // One per track, in the iterator order, saved as the next index
+    library_record_t *cache;            // Read from the index file, sorted by path hash
+    uint32_t cache_count;
+    _Atomic(const app_library_track_t *) *tracks;   // Metadata shown for each track, from `cache` or `records`
+    uint8_t *buf;                       // File reads of the parser
+    portMUX_TYPE stats_lock;
+    app_library_stats_t stats;
+} library_t;
+
+static const char *TAG = "app_library";
+
+static library_t library = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static const uint16_t mp3_kbps[2][3][15] = {
+    {   // MPEG 1, layers I to III
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+    },
+    {   // MPEG 2 and 2.5
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+    },
+};
+
+static const uint32_t mp3_rates[3] = {44100, 48000, 32000};
+
+static uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+// ID3v2 sizes, 7 bits per byte
+static uint32_t syncsafe32(const uint8_t *p)
+{
+    return ((uint32_t)(p[0] & 0x7F) << 21) | ((uint32_t)(p[1] & 0x7F) << 14) | ((uint32_t)(p[2] & 0x7F) << 7) |
+           (p[3] & 0x7F);
+}
+
+// FNV-1a
+static uint32_t path_hash(const char *path)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*path) {
+        hash = (hash ^ (uint8_t)*path++) * 16777619u;
+    }
+
+    return hash;
+}
+
+static int record_cmp(const void *a, const void *b)
+{
+    uint32_t ha = ((const library_record_t *)a)->path_hash;
+    uint32_t hb = ((const library_record_t *)b)->path_hash;
+
+    return (ha > hb) - (ha < hb);
+}
+
+static const library_record_t *cache_find(uint32_t hash, const char *path)
+{
+    uint32_t lo = 0;
+    uint32_t hi = library.cache_count;
+
+    // First record of the hash, then the one of the path among those sharing it
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (library.cache[mid].path_hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (; (lo < library.cache_count) && (library.cache[lo].path_hash == hash); lo++) {
+        if (!strcmp(library.cache[lo].path, path)) {
+            return &library.cache[lo];
+        }
+    }
+
+    return NULL;
+}
+
+/**************************************************************************************************
+ * Metadata parsing
+ **************************************************************************************************/
+// Decode an ID3 text, the encoding byte first, into a UTF-8 string cut at a character boundary
+static void id3_text(char *dst, size_t size, const uint8_t *src, size_t len)
+{
+    size_t out = 0;
+
+    if (len) {
+        const uint8_t enc = src[0];
+        bool be = (enc == 2);
+        size_t i = 1;
+
+        if ((enc == 1) && (len >= 3)) {
+            be = (src[1] == 0xFE) && (src[2] == 0xFF);
+            i = ((src[1] == 0xFE) || (src[1] == 0xFF)) ? 3 : 1;
+        }
+        while (i < len) {
+            uint32_t cp;
+            size_t n;
+
+            if (enc == 3) {
+                // UTF-8 already, whole sequences are copied
+                cp = src[i];
+                n = (cp < 0x80) ? 1 : ((cp >> 5) == 0x6) ? 2 : ((cp >> 4) == 0xE) ? 3 : ((cp >> 3) == 0x1E) ? 4 : 0;
+                if (!cp || !n || (i + n > len) || (out + n >= size)) {
+                    break;
+                }
+                memcpy(dst + out, src + i, n);
+                out += n;
+                i += n;
+                continue;
+            }
+            if (enc == 0) {
+                cp = src[i++];
+            } else {
+                if (i + 1 >= len) {
+                    break;
+                }
+                cp = be ? ((src[i] << 8) | src[i + 1]) : ((src[i + 1] << 8) | src[i]);
+                i += 2;
+                if ((cp >= 0xD800) && (cp < 0xE000)) {
+                    uint32_t lo = (i + 1 < len) ? (be ? ((src[i] << 8) | src[i + 1]) : ((src[i + 1] << 8) | src[i])) :
+                                  0;
+                    if ((cp < 0xDC00) && (lo >= 0xDC00) && (lo < 0xE000)) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        i += 2;
+                    } else {
+                        cp = '?';
+                    }
+                }
+            }
+            if (!cp) {
+                break;
+            }
+
+            n = (cp < 0x80) ? 1 : (cp < 0x800) ? 2 : (cp < 0x10000) ? 3 : 4;
+            if (out + n >= size) {
+                break;
+            }
+            if (n == 1) {
+                dst[out] = cp;
+            } else {
+                for (size_t k = n - 1; k > 0; k--) {
+                    dst[out + k] = 0x80 | (cp & 0x3F);
+                    cp >>= 6;
+                }
+                dst[out] = (0xF00 >> n) | cp;
+            }
+            out += n;
+        }
+    }
+
+    while (out && (dst[out - 1] == ' ')) {
+        out--;
+    }
+    dst[out] = '\0';
+}
+
+// Drop the ID3v1 genre references, "(17)" or "(17)Rock", the numbers are not mapped to names
+static void genre_clean(char *genre)
+{
+    char *p = genre;
+
+    while ((p[0] == '(') && isdigit((unsigned char)p[1])) {
+        char *end = strchr(p, ')');
+        if (!end) {
+            break;
+        }
+        p = end + 1;
+    }
+    memmove(genre, p, strlen(p) + 1);
+
+    for (p = genre; isdigit((unsigned char)*p); p++) {
+    }
+    if (!*p) {
+        genre[0] = '\0';
+    }
+}
+
+static void id3v2_parse_frames(const uint8_t *tag, size_t len, uint8_t version, app_library_track_t *track,
+                               uint32_t *tlen_ms)
+{
+    const size_t hdr_size = (version == 2) ? 6 : 10;
+    size_t pos = 0;
+
+    while (pos + hdr_size <= len) {
+        const uint8_t *f = tag + pos;
+        char id[5] = {0};
+        uint32_t size;
+        uint16_t flags = 0;
+
+        if (!f[0]) {
+            // Padding
+            break;
+        }
+        if (version == 2) {
+            memcpy(id, f, 3);
+            size = (f[3] << 16) | (f[4] << 8) | f[5];
+        } else {
+            memcpy(id, f, 4);
+            size = (version == 4) ? syncsafe32(f + 4) : be32(f + 4);
+            flags = (f[8] << 8) | f[9];
+        }
+        pos += hdr_size;
+        if (size > len - pos) {
+            // Cut by the read limit
+            break;
+        }
+
+        const uint8_t *data = tag + pos;
+        size_t data_len = size;
+        pos += size;
+        if (((version == 3) && (flags & 0x00C0)) || ((version == 4) && (flags & 0x000E))) {
+            // Compressed, encrypted or unsynchronised
+            continue;
+        }
+        if ((version == 4) && (flags & 0x0001)) {
+            // Data length indicator
+            if (data_len < 4) {
+                continue;
+            }
+            data += 4;
+            data_len -= 4;
+        }
+
+        if (!strcmp(id, "TIT2") || !strcmp(id, "TT2")) {
+            id3_text(track->title, sizeof(track->title), data, data_len);
+        } else if (!strcmp(id, "TPE1") || !strcmp(id, "TP1")) {
+            id3_text(track->artist, sizeof(track->artist), data, data_len);
+        } else if (!strcmp(id, "TCON") || !strcmp(id, "TCO")) {
+            id3_text(track->genre, sizeof(track->genre), data, data_len);
+            genre_clean(track->genre);
+        } else if (!strcmp(id, "TLEN") || !strcmp(id, "TLE")) {
+            char ms[16];
+            id3_text(ms, sizeof(ms), data, data_len);
+            *tlen_ms = strtoul(ms, NULL, 10);
+        }
+    }
+}
+
+// Read the ID3v2 tag at the beginning of the file, return where the audio starts
+static size_t id3v2_parse(FILE *fp, app_library_track_t *track, uint32_t *tlen_ms)
+{
+    uint8_t *buf = library.buf;
+
+    if ((fread(buf, 1, 10, fp) != 10) || memcmp(buf, "ID3", 3) || ((buf[6] | buf[7] | buf[8] | buf[9]) & 0x80)) {
+        return 0;
+    }
+
+    const uint8_t version = buf[3];
+    const uint8_t flags = buf[5];
+    const uint32_t body = syncsafe32(buf + 6);
+    const size_t audio_start = 10 + body + ((flags & 0x10) ? 10 : 0);
+    if ((version < 2) || (version > 4) || ((version == 2) && (flags & 0x40))) {
+        // Unknown version, or compressed
+        return audio_start;
+    }
+
+    size_t len = fread(buf, 1, MIN(body, LIBRARY_TAG_READ_MAX), fp);
+    if ((version < 4) && (flags & 0x80)) {
+        // Unsynchronised, 0xFF 0x00 stands for 0xFF
+        size_t out = 0;
+        for (size_t i = 0; i < len; i++) {
+            buf[out++] = buf[i];
+            if ((buf[i] == 0xFF) && (i + 1 < len) && (buf[i + 1] == 0x00)) {
+                i++;
+            }
+        }
+        len = out;
+    }
+
+    size_t ext = 0;
+    if ((version > 2) && (flags & 0x40) && (len >= 4)) {
+        ext = (version == 4) ? syncsafe32(buf) : be32(buf) + 4;
+    }
+    if (ext < len) {
+        id3v2_parse_frames(buf + ext, len - ext, version, track, tlen_ms);
+    }
+
+    return audio_start;
+}
+
+// Fill what the ID3v2 tag left empty from an ID3v1 tag, return its size
+static size_t id3v1_parse(FILE *fp, uint32_t file_size, app_library_track_t *track)
+{
+    uint8_t *buf = library.buf;
+    uint8_t field[1 + 30] = {0};        // Latin-1, the encoding byte in front makes it an ID3v2 text
+
+    if ((file_size < LIBRARY_ID3V1_SIZE) || fseek(fp, -LIBRARY_ID3V1_SIZE, SEEK_END) ||
+            (fread(buf, 1, LIBRARY_ID3V1_SIZE, fp) != LIBRARY_ID3V1_SIZE) || memcmp(buf, "TAG", 3)) {
+        return 0;
+    }
+
+    if (!track->title[0]) {
+        memcpy(field + 1, buf + 3, 30);
+        id3_text(track->title, sizeof(track->title), field, sizeof(field));
+    }
+    if (!track->artist[0]) {
+        memcpy(field + 1, buf + 33, 30);
+        id3_text(track->artist, sizeof(track->artist), field, sizeof(field));
+    }
+
+    return LIBRARY_ID3V1_SIZE;
+}
+
+// Duration from the first MP3 frame: its Xing or VBRI frame count, else the bitrate
+static uint32_t mp3_duration_s(const uint8_t *buf, size_t len, uint32_t audio_bytes)
+{
+    for (size_t i = 0; i + 4 <= len; i++) {
+        if ((buf[i] != 0xFF) || ((buf[i + 1] & 0xE0) != 0xE0)) {
+            continue;
+        }
+
+        const uint32_t version = (buf[i + 1] >> 3) & 0x3;   // 3: MPEG 1, 2: MPEG 2, 0: MPEG 2.5
+        const uint32_t layer = 4 - ((buf[i + 1] >> 1) & 0x3);
+        const uint32_t kbps_index = buf[i + 2] >> 4;
+        const uint32_t rate_index = (buf[i + 2] >> 2) & 0x3;
+        if ((version == 1) || (layer == 4) || !kbps_index || (kbps_index == 15) || (rate_index == 3)) {
+            continue;
+        }
+
+        const bool lsf = (version != 3);
+        const bool mono = ((buf[i + 3] >> 6) == 3);
+        const uint32_t rate = mp3_rates[rate_index] >> ((version == 3) ? 0 : (version == 2) ? 1 : 2);
+        const uint32_t kbps = mp3_kbps[lsf][layer - 1][kbps_index];
+        const uint32_t frame_samples = (layer == 1) ? 384 : ((layer == 3) && lsf) ? 576 : 1152;
+
+        if (layer == 3) {
+            // After the side information
+            size_t xing = i + 4 + (lsf ? (mono ? 9 : 17) : (mono ? 17 : 32));
+            if ((xing + 12 <= len) && (!memcmp(buf + xing, "Xing", 4) || !memcmp(buf + xing, "Info", 4)) &&
+                    (buf[xing + 7] & 0x1)) {
+                return (uint64_t)be32(buf + xing + 8) * frame_samples / rate;
+            }
+            size_t vbri = i + 4 + 32;
+            if ((vbri + 18 <= len) && !memcmp(buf + vbri, "VBRI", 4)) {
+                return (uint64_t)be32(buf + vbri + 14) * frame_samples / rate;
+            }
+        }
+
+        return (audio_bytes > i) ? (uint64_t)(audio_bytes - i) * 8 / (kbps * 1000) : 0;
+    }
+
+    return 0;
+}
+
+static uint32_t wav_duration_s(const uint8_t *buf, size_t len, uint32_t audio_bytes)
+{
+    uint32_t byte_rate = 0;
+    size_t pos = 12;
+
+    if ((len < 12) || memcmp(buf, "RIFF", 4) || memcmp(buf + 8, "WAVE", 4)) {
+        return 0;
+    }
+
+    while (pos + 8 <= len) {
+        const uint32_t size = le32(buf + pos + 4);
+        if (!memcmp(buf + pos, "fmt ", 4) && (pos + 8 + 12 <= len)) {
+            byte_rate = le32(buf + pos + 8 + 8);
+        } else if (!memcmp(buf + pos, "data", 4)) {
+            uint32_t data = MIN(size, (audio_bytes > pos + 8) ? audio_bytes - pos - 8 : 0);
+            return byte_rate ? data / byte_rate : 0;
+        }
+        pos += 8 + size + (size & 1);
+    }
+
+    return 0;
+}
+
+static void library_parse(const char *path, uint32_t file_size, app_library_track_t *track)
+{
+    uint32_t tlen_ms = 0;
+
+    memset(track, 0, sizeof(app_library_track_t));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        ESP_LOGW(TAG, "Open '%s' failed", path);
+        return;
+    }
+
+    size_t audio_start = id3v2_parse(fp, track, &tlen_ms);
+    size_t audio_end = file_size - id3v1_parse(fp, file_size, track);
+    uint32_t audio_bytes = (audio_end > audio_start) ? audio_end - audio_start : 0;
+
+    if (tlen_ms) {
+        track->duration_s = tlen_ms / 1000;
+    } else if (!fseek(fp, audio_start, SEEK_SET)) {
+        size_t len = fread(library.buf, 1, LIBRARY_AUDIO_READ_SIZE, fp);
+        track->duration_s = wav_duration_s(library.buf, len, audio_bytes);
+        if (!track->duration_s) {
+            track->duration_s = mp3_duration_s(library.buf, len, audio_bytes);
+        }
+    }
+    fclose(fp);
+}
+
+/**************************************************************************************************
+ * Index
+ **************************************************************************************************/
+// The index path with another extension. Only the extension changes, so an 8.3 index name gives an 8.3 name, FAT
+// may be built without long file names
+static void library_index_sibling(char *path, const char *ext)
+{
+    strcpy(path, library.index_path);
+    char *dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/')) {
+        dot = path + strlen(path);
+    }
+    strcpy(dot, ext);
+}
+
+static void library_load(void)
+{
+    library_header_t hdr;
+    char bak_path[LIBRARY_PATH_SIZE + 4];
+
+    // Without the index, a save was cut between its renames and the previous index is the backup
+    FILE *fp = fopen(library.index_path, "rb");
+    if (!fp) {
+        library_index_sibling(bak_path, ".bak");
+        fp = fopen(bak_path, "rb");
+    }
+    if (!fp) {
+        ESP_LOGI(TAG, "No index at '%s' yet", library.index_path);
+        return;
+    }
+
+    if ((fread(&hdr, sizeof(hdr), 1, fp) != 1) || (hdr.magic != LIBRARY_INDEX_MAGIC) ||
+            (hdr.version != LIBRARY_INDEX_VERSION) || (hdr.record_size != sizeof(library_record_t)) ||
+            (hdr.count > LIBRARY_TRACK_MAX)) {
+        ESP_LOGW(TAG, "Index '%s' not valid, rebuilt", library.index_path);
+        goto out;
+    }
+
+    library.cache = heap_caps_malloc(MAX(hdr.count, 1) * sizeof(library_record_t), MALLOC_CAP_SPIRAM);
+    if (!library.cache) {
+        ESP_LOGE(TAG, "No memory for %" PRIu32 " indexed tracks", hdr.count);
+        goto out;
+    }
+    if (fread(library.cache, sizeof(library_record_t), hdr.count, fp) != hdr.count) {
+        ESP_LOGW(TAG, "Index '%s' truncated, rebuilt", library.index_path);
+        free(library.cache);
+        library.cache = NULL;
+        goto out;
+    }
+
+    for (uint32_t i = 0; i < hdr.count; i++) {
+        app_library_track_t *track = &library.cache[i].track;
+        library.cache[i].path[sizeof(library.cache[i].path) - 1] = '\0';
+        track->title[sizeof(track->title) - 1] = '\0';
+        track->artist[sizeof(track->artist) - 1] = '\0';
+        track->genre[sizeof(track->genre) - 1] = '\0';
+    }
+    qsort(library.cache, hdr.count, sizeof(library_record_t), record_cmp);
+    library.cache_count = hdr.count;
+
+out:
+    fclose(fp);
+}
+
+static esp_err_t library_save(uint32_t count)
+{
+    char tmp_path[LIBRARY_PATH_SIZE + 4];
+    char bak_path[LIBRARY_PATH_SIZE + 4];
+    const library_header_t hdr = {
+        .magic = LIBRARY_INDEX_MAGIC,
+        .version = LIBRARY_INDEX_VERSION,
+        .record_size = sizeof(library_record_t),
+        .count = count,
+    };
+
+    // Written aside, the index is replaced once complete
+    library_index_sibling(tmp_path, ".tmp");
+    library_index_sibling(bak_path, ".bak");
+    FILE *fp = fopen(tmp_path, "wb");
+    ESP_RETURN_ON_FALSE(fp, ESP_FAIL, TAG, "Create '%s' failed", tmp_path);
+    bool written = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1) &&
+                   (fwrite(library.records, sizeof(library_record_t), count, fp) == count);
+    written = (fclose(fp) == 0) && written;
+    if (!written) {
+        unlink(tmp_path);
+        ESP_LOGE(TAG, "Write '%s' failed", tmp_path);
+        return ESP_FAIL;
+    }
+
+    // FAT does not rename over an existing file: the old index stays as the backup until the new one is in place,
+    // so there is always one to load after a power loss
+    unlink(bak_path);
+    if ((rename(library.index_path, bak_path) != 0) && (access(library.index_path, F_OK) == 0)) {
+        unlink(tmp_path);
+        ESP_LOGE(TAG, "Back up '%s' failed", library.index_path);
+        return ESP_FAIL;
+    }
+    ESP_RETURN_ON_FALSE(rename(tmp_path, library.index_path) == 0, ESP_FAIL, TAG, "Rename '%s' failed", tmp_path);
+    unlink(bak_path);
+
+    return ESP_OK;
+}
+
+static void library_publish(uint32_t index, const app_library_track_t *track)
+{
+    atomic_store_explicit(&library.tracks[index], track, memory_order_release);
+}
+
+static void library_task(void *arg)
+{
+    char path[LIBRARY_PATH_SIZE];
+    int64_t start = esp_timer_get_time();
+    uint32_t indexed = 0;
+    uint32_t parsed = 0;
+
+    // The tracks known from the last boot are shown at once, their files are checked below
+    library_load();
+    for (uint32_t i = 0; (i < library.count) && library.running; i++) {
+        file_iterator_get_full_path_from_index(library.iterator, i, path, sizeof(path));
+        strlcpy(library.records[i].path, path, sizeof(library.records[i].path));
+        library.records[i].path_hash = path_hash(path);
+        const library_record_t *cached = cache_find(library.records[i].path_hash, library.records[i].path);
+        if (cached) {
+            library_publish(i, &cached->track);
+            indexed++;
+        }
+    }
+
+    int64_t loaded = esp_timer_get_time();
+    portENTER_CRITICAL(&library.stats_lock);
+    library.stats.indexed = indexed;
+    library.stats.load_us = (uint32_t)(loaded - start);
+    portEXIT_CRITICAL(&library.stats_lock);
+
+    uint32_t checked = 0;
+    for (; (checked < library.count) && library.running; checked++) {
+        library_record_t *record = &library.records[checked];
+        struct stat st = {0};
+
+        file_iterator_get_full_path_from_index(library.iterator, checked, path, sizeof(path));
+        stat(path, &st);
+        record->size = st.st_size;
+        record->mtime = st.st_mtime;
+
+        const library_record_t *cached = cache_find(record->path_hash, record->path);
+        if (cached && (cached->size == record->size) && (cached->mtime == record->mtime)) {
+            record->track = cached->track;
+            continue;
+        }
+
+        // Not shown from `records` before, so written in place
+        library_parse(path, record->size, &record->track);
+        library_publish(checked, &record->track);
+        parsed++;
+
+        portENTER_CRITICAL(&library.stats_lock);
+        library.stats.parsed = parsed;
+        portEXIT_CRITICAL(&library.stats_lock);
+    }
+
+    // New, changed or removed tracks
+    if ((checked == library.count) && (parsed || (library.cache_count != library.count))) {
+        if (library_save(library.count) == ESP_OK) {
+            ESP_LOGI(TAG, "Index saved, %" PRIu32 " tracks", library.count);
+        }
+    }
+
+    if (checked == library.count) {
+        uint32_t scan_us = (uint32_t)(esp_timer_get_time() - loaded);
+        portENTER_CRITICAL(&library.stats_lock);
+        library.stats.scan_us = scan_us;
+        library.stats.ready = true;
+        portEXIT_CRITICAL(&library.stats_lock);
+        ESP_LOGI(TAG, "%" PRIu32 " tracks: %" PRIu32 " from the index in %" PRIu32 " us, %" PRIu32
+                 " parsed, checked in %" PRIu32 " us", library.count, indexed, (uint32_t)(loaded - start), parsed,
+                 scan_us);
+    }
+
+    library.running = false;
+    xSemaphoreGive(library.exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void library_free(void)
+{
+    free(library.tracks);
+    library.tracks = NULL;
+    free(library.records);
+    library.records = NULL;
+    free(library.cache);
+    library.cache = NULL;
+    library.cache_count = 0;
+    free(library.buf);
+    library.buf = NULL;
+    library.count = 0;
+}
+
+esp_err_t app_library_start(file_iterator_instance_t *iterator, const char *index_path)
+{
+    ESP_RETURN_ON_FALSE(iterator && index_path && (strlen(index_path) < LIBRARY_PATH_SIZE), ESP_ERR_INVALID_ARG, TAG,
+                        "Invalid argument");
+    if (library.tracks) {
+        return ESP_OK;
+    }
+
+    if (!library.exit_sem) {
+        library.exit_sem = xSemaphoreCreateBinary();
+        ESP_RETURN_ON_FALSE(library.exit_sem, ESP_ERR_NO_MEM, TAG, "Create exit semaphore failed");
+    }
+    xSemaphoreTake(library.exit_sem, 0);
+
+    esp_err_t ret = ESP_OK;
+    const uint32_t count = file_iterator_get_count(iterator);
+    library.iterator = iterator;
+    strcpy(library.index_path, index_path);
+    library.count = count;
+    library.tracks = calloc(MAX(count, 1), sizeof(library.tracks[0]));
+    library.records = heap_caps_calloc(MAX(count, 1), sizeof(library_record_t), MALLOC_CAP_SPIRAM);
+    library.buf = heap_caps_malloc(LIBRARY_TAG_READ_MAX, MALLOC_CAP_SPIRAM);
+    ESP_GOTO_ON_FALSE(library.tracks && library.records && library.buf, ESP_ERR_NO_MEM, err, TAG,
+                      "No memory for %" PRIu32 " tracks", count);
+    memset(&library.stats, 0, sizeof(library.stats));
+    library.stats.tracks = count;
+
+    library.running = true;
+    ESP_GOTO_ON_FALSE(xTaskCreate(library_task, "library", LIBRARY_TASK_STACK_SIZE, NULL, LIBRARY_TASK_PRIORITY,
+                                  NULL) == pdPASS, ESP_ERR_NO_MEM, err, TAG, "Create library task failed");
+
+    return ESP_OK;
+
+err:
+    library.running = false;
+    library_free();
+    return ret;
+}
+
+esp_err_t app_library_stop(void)
+{
+    if (!library.tracks) {
+        return ESP_OK;
+    }
+
+    // The task clears `running` when done
+    library.running = false;
+    ESP_RETURN_ON_FALSE(xSemaphoreTake(library.exit_sem, pdMS_TO_TICKS(LIBRARY_STOP_TIMEOUT_MS)) == pdTRUE,
+                        ESP_ERR_TIMEOUT, TAG, "Library task stop timeout");
+    library_free();
+
+    return ESP_OK;
+}
+
+const app_library_track_t *app_library_get(uint32_t index)
+{
+    if (!library.tracks || (index >= library.count)) {
+        return NULL;
+    }
+
+    return atomic_load_explicit(&library.tracks[index], memory_order_acquire);
+}
+
+esp_err_t app_library_get_stats(app_library_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    portENTER_CRITICAL(&library.stats_lock);
+    *stats = library.stats;
+    portEXIT_CRITICAL(&library.stats_lock);
+
+    return ESP_OK;
+}
@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "file_iterator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_LIBRARY_TITLE_SIZE      (64)
+#define APP_LIBRARY_ARTIST_SIZE     (48)
+#define APP_LIBRARY_GENRE_SIZE      (32)
+
+/**
+ * @brief Metadata of a track, UTF-8 strings, empty when the file does not tell.
+ */
+typedef struct {
+    char title[APP_LIBRARY_TITLE_SIZE];
+    char artist[APP_LIBRARY_ARTIST_SIZE];
+    char genre[APP_LIBRARY_GENRE_SIZE];
+    uint32_t duration_s;                /*!< 0 if unknown. */
+} app_library_track_t;
+
+/**
+ * @brief Library statistics, since it started.
+ */
+typedef struct {
+    uint32_t tracks;                    /*!< Files in the iterator. */
+    uint32_t indexed;                   /*!< Tracks found in the index file, still to be checked against the file. */
+    uint32_t parsed;                    /*!< Tracks whose file was new or changed, parsed again. */
+    uint32_t load_us;                   /*!< Time to read the index file and show its tracks. */
+    uint32_t scan_us;                   /*!< Time to check every file, parse the changed ones and save the index. */
+    bool ready;                         /*!< Every track checked. */
+} app_library_stats_t;
+
+/**
+ * @brief Start indexing the tracks of an iterator, in the background.
+ *
+ * The metadata (ID3v2 and ID3v1 tags, MP3 or WAV duration) is kept in an index file, keyed by the path, size and
+ * modification time of each track. A low priority task first reads the whole index at once, so the tracks known from
+ * the last boot have their metadata right away. It then checks each file and only parses the new or changed ones,
+ * and saves the index again if anything changed. Starting twice is harmless.
+ *
+ * @param iterator Tracks to index, kept by reference.
+ * @param index_path Index file, outside the iterator folder. It is saved through files of the same name with the
+ *                   `.tmp` and `.bak` extensions, so a name in the 8.3 format works on FAT without long file names.
+ *                   The `.bak` file is the previous index, loaded if a save was cut before the new one was in place.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid argument, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_library_start(file_iterator_instance_t *iterator, const char *index_path);
+
+/**
+ * @brief Stop indexing and free the metadata.
+ */
+esp_err_t app_library_stop(void);
+
+/**
+ * @brief Get the metadata of a track, without locking or I/O.
+ *
+ * The metadata stays valid until `app_library_stop`.
+ *
+ * @param index Index of the track in the iterator.
+ *
+ * @return The metadata, NULL if the track is not indexed yet.
+ */
+const app_library_track_t *app_library_get(uint32_t index);
+
+/**
+ * @brief Get the library statistics.
+ */
+esp_err_t app_library_get_stats(app_library_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
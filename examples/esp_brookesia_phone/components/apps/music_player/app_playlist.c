@@ -0,0 +1,484 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define _GNU_SOURCE                     // fopencookie()
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "bsp_board_extra.h"
+#include "bsp_extra_mixer.h"
+#include "app_playlist.h"
+
+#define PLAYLIST_PREFETCH_SIZE      (64 * 1024)     // Audio read ahead, seconds of MP3 at the usual bitrates
+#define PLAYLIST_PREFETCH_MAX       (512 * 1024)    // With the ID3 tag, which may hold the cover art
+#define PLAYLIST_FILE_BUF_SIZE      (4 * 1024)      // Reads past the prefetched data go to the card in such chunks
+#define PLAYLIST_PATH_SIZE          (128)
+#define PLAYLIST_SETTLE_MS          (200)           // Past the stream ring, the next track is prepared after it
+#define PLAYLIST_TASK_PRIORITY      (6)             // Above LVGL, below the audio player and the mixer
+#define PLAYLIST_TASK_STACK_SIZE    (4 * 1024)
+#define PLAYLIST_STOP_TIMEOUT_MS    (1000)
+
+#define PLAYLIST_EVENT_PLAY         (1 << 0)        // `requested` is to be played
+#define PLAYLIST_EVENT_END          (1 << 1)        // The player reached the end of the current track
+#define PLAYLIST_EVENT_STOP         (1 << 2)
+
+// A file whose beginning is served from memory, behind a FILE for the player
+typedef struct {
+    int fd;
+    uint8_t *head;                      // First `head_len` bytes of the file
+    size_t head_len;
+    off_t size;
+    off_t pos;                          // Position of the reader
+    off_t fd_pos;                       // Position of `fd`
+} prefetch_file_t;
+
+typedef struct {
+    int index;
+    FILE *fp;
+} prepared_t;
+
+typedef struct {
+    TaskHandle_t task;
+    SemaphoreHandle_t exit_sem;
+    file_iterator_instance_t *iterator;
+    atomic_int requested;
+    atomic_int current;
+    int64_t request_us;                 // When the pending switch was asked for, 0 once measured
+    uint32_t starved_at_switch;
+    bool owned;                         // The player plays our track, not a file started by someone else
+    bool own_play;                      // Our play request is on its way to the player
+    uint32_t failures;                  // Tracks that did not open or ended without playing, in a row
+    prepared_t next;
+    portMUX_TYPE lock;                  // Fields above shared with the player callback, and the stats
+    app_playlist_stats_t stats;
+} playlist_t;
+
+static const char *TAG = "app_playlist";
+
+static playlist_t playlist = {
+    .requested = -1,
+    .current = -1,
+    .next = {.index = -1},
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static ssize_t prefetch_read(void *cookie, char *buf, size_t size)
+{
+    prefetch_file_t *f = cookie;
+    size_t done = 0;
+
+    if (f->pos < f->head_len) {
+        done = MIN(size, f->head_len - f->pos);
+        memcpy(buf, f->head + f->pos, done);
+        f->pos += done;
+    }
+    if (done < size) {
+        if ((f->fd_pos != f->pos) && (lseek(f->fd, f->pos, SEEK_SET) < 0)) {
+            return done ? (ssize_t)done : -1;
+        }
+        f->fd_pos = f->pos;
+
+        ssize_t n = read(f->fd, buf + done, size - done);
+        if (n < 0) {
+            return done ? (ssize_t)done : -1;
+        }
+        f->pos += n;
+        f->fd_pos += n;
+        done += n;
+    }
+
+    return done;
+}
+
+static int prefetch_seek(void *cookie, off_t *offset, int whence)
+{
+    prefetch_file_t *f = cookie;
+    off_t pos;
+
+    switch (whence) {
+    case SEEK_SET:
+        pos = *offset;
+        break;
+    case SEEK_CUR:
+        pos = f->pos + *offset;
+        break;
+    case SEEK_END:
+        pos = f->size + *offset;
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+    if (pos < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    // The file is only moved on the next read past the prefetched data
+    f->pos = pos;
+    *offset = pos;
+
+    return 0;
+}
+
+static int prefetch_close(void *cookie)
+{
+    prefetch_file_t *f = cookie;
+
+    int ret = close(f->fd);
+    free(f->head);
+    free(f);
+
+    return ret;
+}
+
+// Size of the ID3v2 tag at the beginning of a file, 0 if none
+static size_t id3_tag_size(const uint8_t *hdr, size_t len)
+{
+    if ((len < 10) || memcmp(hdr, "ID3", 3) || ((hdr[6] | hdr[7] | hdr[8] | hdr[9]) & 0x80)) {
+        return 0;
+    }
+
+    // Syncsafe integer, 7 bits per byte, then the header and the optional footer
+    size_t size = ((size_t)hdr[6] << 21) | ((size_t)hdr[7] << 14) | ((size_t)hdr[8] << 7) | hdr[9];
+
+    return size + 10 + ((hdr[5] & 0x10) ? 10 : 0);
+}
+
+// Open a track with its beginning already in memory, so the player starts it without waiting on the card
+static esp_err_t playlist_open(int index, FILE **ret_fp)
+{
+    esp_err_t ret = ESP_OK;
+    char path[PLAYLIST_PATH_SIZE];
+
+    ESP_RETURN_ON_FALSE(file_iterator_get_full_path_from_index(playlist.iterator, index, path, sizeof(path)) != 0,
+                        ESP_ERR_NOT_FOUND, TAG, "No file at index %d", index);
+
+    prefetch_file_t *f = calloc(1, sizeof(prefetch_file_t));
+    ESP_RETURN_ON_FALSE(f, ESP_ERR_NO_MEM, TAG, "No memory for file");
+    struct stat st;
+
+    f->fd = open(path, O_RDONLY);
+    ESP_GOTO_ON_FALSE(f->fd >= 0, ESP_ERR_NOT_FOUND, err, TAG, "Open '%s' failed", path);
+    ESP_GOTO_ON_FALSE(fstat(f->fd, &st) == 0, ESP_FAIL, err_fd, TAG, "Stat '%s' failed", path);
+    f->size = st.st_size;
+
+    // The ID3 tag is read ahead too, the decoder goes through it before the first frame
+    uint8_t hdr[10];
+    ssize_t hdr_len = read(f->fd, hdr, sizeof(hdr));
+    hdr_len = MAX(hdr_len, 0);
+    size_t head_size = MIN(id3_tag_size(hdr, hdr_len) + PLAYLIST_PREFETCH_SIZE, PLAYLIST_PREFETCH_MAX);
+    head_size = MAX(MIN(head_size, (size_t)f->size), (size_t)hdr_len);
+    f->head = heap_caps_malloc(MAX(head_size, 1), MALLOC_CAP_SPIRAM);
+    ESP_GOTO_ON_FALSE(f->head, ESP_ERR_NO_MEM, err_fd, TAG, "No memory for prefetch");
+
+    memcpy(f->head, hdr, hdr_len);
+    f->head_len = hdr_len;
+    while (f->head_len < head_size) {
+        ssize_t n = read(f->fd, f->head + f->head_len, head_size - f->head_len);
+        if (n <= 0) {
+            break;
+        }
+        f->head_len += n;
+    }
+    f->fd_pos = f->head_len;
+
+    const cookie_io_functions_t io = {
+        .read = prefetch_read,
+        .seek = prefetch_seek,
+        .close = prefetch_close,
+    };
+    FILE *fp = fopencookie(f, "rb", io);
+    ESP_GOTO_ON_FALSE(fp, ESP_ERR_NO_MEM, err_head, TAG, "Wrap '%s' failed", path);
+    setvbuf(fp, NULL, _IOFBF, PLAYLIST_FILE_BUF_SIZE);
+    ESP_LOGD(TAG, "Opened '%s', %u bytes ahead", path, (unsigned)f->head_len);
+    *ret_fp = fp;
+
+    return ESP_OK;
+
+err_head:
+    free(f->head);
+err_fd:
+    close(f->fd);
+err:
+    free(f);
+    return ret;
+}
+
+static void playlist_prepared_free(void)
+{
+    if (playlist.next.fp) {
+        fclose(playlist.next.fp);
+    }
+    playlist.next.fp = NULL;
+    playlist.next.index = -1;
+}
+
+static int playlist_next_index(int index)
+{
+    return (index + 1) % file_iterator_get_count(playlist.iterator);
+}
+
+static void playlist_start_track(int index, bool advance)
+{
+    FILE *fp = NULL;
+    bool hit = (playlist.next.index == index) && playlist.next.fp;
+
+    if (hit) {
+        fp = playlist.next.fp;
+        playlist.next.fp = NULL;
+        playlist.next.index = -1;
+    } else {
+        playlist_prepared_free();
+        // A file removed or unreadable since the scan fails like a track that does not play, the next one is tried
+        uint32_t count = file_iterator_get_count(playlist.iterator);
+        while (playlist_open(index, &fp) != ESP_OK) {
+            portENTER_CRITICAL(&playlist.lock);
+            bool give_up = ++playlist.failures >= count;
+            if (give_up) {
+                playlist.request_us = 0;
+            }
+            portEXIT_CRITICAL(&playlist.lock);
+            if (give_up) {
+                ESP_LOGE(TAG, "No track could be opened");
+                return;
+            }
+            index = playlist_next_index(index);
+        }
+    }
+
+    bsp_extra_mixer_stats_t mixer_stats;
+    bsp_extra_mixer_get_stats(&mixer_stats);
+
+    portENTER_CRITICAL(&playlist.lock);
+    playlist.owned = true;
+    playlist.own_play = true;
+    playlist.starved_at_switch = mixer_stats.starved;
+    playlist.stats.tracks++;
+    playlist.stats.advances += advance;
+    playlist.stats.prepared_hits += hit;
+    portEXIT_CRITICAL(&playlist.lock);
+
+    file_iterator_set_index(playlist.iterator, index);
+    atomic_store(&playlist.current, index);
+    // The clock gives the position in the new file, and times its first write
+    bsp_extra_audio_clock_reset();
+    if (audio_player_play(fp) != ESP_OK) {
+        ESP_LOGE(TAG, "Play track %d failed", index);
+        fclose(fp);
+        portENTER_CRITICAL(&playlist.lock);
+        playlist.owned = false;
+        playlist.own_play = false;
+        playlist.request_us = 0;
+        portEXIT_CRITICAL(&playlist.lock);
+        return;
+    }
+    ESP_LOGI(TAG, "Track %d started%s%s", index, advance ? " at the end of the previous one" : "",
+             hit ? ", prepared" : "");
+}
+
+// Once the switch is over: account for it, then open the track after the current one
+static void playlist_settle(void)
+{
+    int64_t first_write_us = bsp_extra_player_get_first_write_us();
+    bsp_extra_mixer_stats_t mixer_stats;
+    bsp_extra_mixer_get_stats(&mixer_stats);
+
+    portENTER_CRITICAL(&playlist.lock);
+    if (playlist.request_us && (first_write_us > playlist.request_us)) {
+        uint32_t elapsed_us = (uint32_t)(first_write_us - playlist.request_us);
+        playlist.stats.switch_count++;
+        playlist.stats.switch_us_last = elapsed_us;
+        playlist.stats.switch_us_max = MAX(playlist.stats.switch_us_max, elapsed_us);
+        playlist.stats.switch_us_total += elapsed_us;
+    }
+    playlist.request_us = 0;
+    playlist.stats.starved += mixer_stats.starved - playlist.starved_at_switch;
+    portEXIT_CRITICAL(&playlist.lock);
+
+    int current = atomic_load(&playlist.current);
+    int next = playlist_next_index(current);
+    if ((current >= 0) && (playlist.next.index != next)) {
+        playlist_prepared_free();
+        if (playlist_open(next, &playlist.next.fp) == ESP_OK) {
+            playlist.next.index = next;
+        }
+    }
+}
+
+// Called from the audio player task
+static void playlist_player_cb(audio_player_cb_ctx_t *ctx)
+{
+    bool end = false;
+    int64_t now = esp_timer_get_time();
+    uint32_t count = file_iterator_get_count(playlist.iterator);
+    // A track that ends before writing any audio failed to play
+    bool failed = (ctx->audio_event == AUDIO_PLAYER_CALLBACK_EVENT_IDLE) && !bsp_extra_player_get_first_write_us();
+
+    portENTER_CRITICAL(&playlist.lock);
+    switch (ctx->audio_event) {
+    case AUDIO_PLAYER_CALLBACK_EVENT_PLAYING:
+        playlist.own_play = false;
+        break;
+    case AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT:
+        // Our request cut the track short, or a file we did not start did, e.g. a game sound
+        playlist.owned = playlist.own_play;
+        playlist.own_play = false;
+        break;
+    case AUDIO_PLAYER_CALLBACK_EVENT_IDLE:
+        if (playlist.owned) {
+            playlist.own_play = false;
+            // Do not loop over a playlist of files that cannot be played
+            playlist.failures = failed ? playlist.failures + 1 : 0;
+            end = playlist.failures < count;
+            playlist.request_us = end ? now : 0;
+        }
+        break;
+    default:
+        break;
+    }
+    portEXIT_CRITICAL(&playlist.lock);
+
+    if (end && playlist.task) {
+        xTaskNotify(playlist.task, PLAYLIST_EVENT_END, eSetBits);
+    }
+}
+
+static void playlist_task(void *arg)
+{
+    bool settling = false;
+
+    while (true) {
+        uint32_t events = 0;
+        TickType_t wait = settling ? pdMS_TO_TICKS(PLAYLIST_SETTLE_MS) : portMAX_DELAY;
+        if (xTaskNotifyWait(0, UINT32_MAX, &events, wait) == pdFALSE) {
+            settling = false;
+            playlist_settle();
+            continue;
+        }
+
+        if (events & PLAYLIST_EVENT_STOP) {
+            break;
+        }
+        if (events & PLAYLIST_EVENT_PLAY) {
+            // A request from the user wins over the end of a track
+            playlist_start_track(atomic_load(&playlist.requested), false);
+            settling = true;
+        } else if (events & PLAYLIST_EVENT_END) {
+            playlist_start_track(playlist_next_index(atomic_load(&playlist.current)), true);
+            settling = true;
+        }
+    }
+
+    playlist_prepared_free();
+    xSemaphoreGive(playlist.exit_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_playlist_start(file_iterator_instance_t *iterator)
+{
+    ESP_RETURN_ON_FALSE(iterator && (file_iterator_get_count(iterator) > 0), ESP_ERR_INVALID_ARG, TAG,
+                        "Invalid argument");
+    if (playlist.task) {
+        return ESP_OK;
+    }
+
+    if (!playlist.exit_sem) {
+        playlist.exit_sem = xSemaphoreCreateBinary();
+        ESP_RETURN_ON_FALSE(playlist.exit_sem, ESP_ERR_NO_MEM, TAG, "Create exit semaphore failed");
+    }
+    xSemaphoreTake(playlist.exit_sem, 0);
+
+    playlist.iterator = iterator;
+    atomic_store(&playlist.requested, -1);
+    atomic_store(&playlist.current, -1);
+    playlist.request_us = 0;
+    playlist.owned = false;
+    playlist.own_play = false;
+    playlist.failures = 0;
+    memset(&playlist.stats, 0, sizeof(playlist.stats));
+    // Buffering counters of this session, to tune the player buffer against the apps run meanwhile
+    bsp_extra_player_reset_buffer_stats();
+
+    ESP_RETURN_ON_FALSE(xTaskCreate(playlist_task, "playlist", PLAYLIST_TASK_STACK_SIZE, NULL, PLAYLIST_TASK_PRIORITY,
+                                    &playlist.task) == pdPASS, ESP_ERR_NO_MEM, TAG, "Create playlist task failed");
+    bsp_extra_player_register_callback(playlist_player_cb, NULL);
+
+    return ESP_OK;
+}
+
+esp_err_t app_playlist_stop(void)
+{
+    if (!playlist.task) {
+        return ESP_OK;
+    }
+
+    bsp_extra_player_register_callback(NULL, NULL);
+    xTaskNotify(playlist.task, PLAYLIST_EVENT_STOP, eSetBits);
+    ESP_RETURN_ON_FALSE(xSemaphoreTake(playlist.exit_sem, pdMS_TO_TICKS(PLAYLIST_STOP_TIMEOUT_MS)) == pdTRUE,
+                        ESP_ERR_TIMEOUT, TAG, "Playlist task stop timeout");
+    playlist.task = NULL;
+
+    app_playlist_stats_t stats;
+    app_playlist_get_stats(&stats);
+    ESP_LOGI(TAG, "Stopped: %" PRIu32 " tracks, %" PRIu32 " prepared, switch %" PRIu32 " us avg, %" PRIu32
+             " us max, %" PRIu32 " starved blocks", stats.tracks, stats.prepared_hits,
+             stats.switch_count ? (uint32_t)(stats.switch_us_total / stats.switch_count) : 0, stats.switch_us_max,
+             stats.starved);
+
+    bsp_extra_mixer_stream_stats_t buffer_stats;
+    if (bsp_extra_player_get_buffer_stats(&buffer_stats) == ESP_OK) {
+        ESP_LOGI(TAG, "Player buffer: %u bytes, %u min filled, %" PRIu32 " underruns, refill %" PRIu32 " us max, %"
+                 PRIu32 " ms dropped", (unsigned int)buffer_stats.size, (unsigned int)buffer_stats.filled_min,
+                 buffer_stats.underruns, buffer_stats.refill_us_max, buffer_stats.dropped_ms);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t app_playlist_play(int index)
+{
+    ESP_RETURN_ON_FALSE(playlist.task, ESP_ERR_INVALID_STATE, TAG, "Playlist not started");
+    ESP_RETURN_ON_FALSE((index >= 0) && (index < file_iterator_get_count(playlist.iterator)), ESP_ERR_INVALID_ARG,
+                        TAG, "Invalid index %d", index);
+
+    portENTER_CRITICAL(&playlist.lock);
+    playlist.request_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&playlist.lock);
+    atomic_store(&playlist.requested, index);
+    xTaskNotify(playlist.task, PLAYLIST_EVENT_PLAY, eSetBits);
+
+    return ESP_OK;
+}
+
+int app_playlist_get_index(void)
+{
+    return atomic_load(&playlist.current);
+}
+
+esp_err_t app_playlist_get_stats(app_playlist_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    portENTER_CRITICAL(&playlist.lock);
+    *stats = playlist.stats;
+    portEXIT_CRITICAL(&playlist.lock);
+
+    return ESP_OK;
+}
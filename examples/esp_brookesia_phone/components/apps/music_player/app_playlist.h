@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "file_iterator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Playlist statistics, since it started.
+ */
+typedef struct {
+    uint32_t tracks;                    /*!< Tracks started. */
+    uint32_t advances;                  /*!< Tracks started at the end of the previous one. */
+    uint32_t prepared_hits;             /*!< Tracks started from a file opened and prefetched ahead. */
+    uint32_t switch_count;              /*!< Switches measured, see `switch_us_last`. */
+    uint32_t switch_us_last;            /*!< From the end of a track, or a request, to the next one written. */
+    uint32_t switch_us_max;
+    uint64_t switch_us_total;
+    uint32_t starved;                   /*!< Mixer blocks short of audio around the switches, heard as gaps. */
+} app_playlist_stats_t;
+
+/**
+ * @brief Start playing the files of an iterator as a playlist.
+ *
+ * While a track plays, a task opens the next one and reads its beginning, ID3 tag included, into PSRAM. When the
+ * player reaches the end of a track, the prepared file is handed to it at once: the end of the track is still in the
+ * mixer stream ring while the next one starts decoding, so the tracks follow each other without a gap when they share
+ * the sample rate. The playlist takes the player callback, see `bsp_extra_player_register_callback`. Starting twice is
+ * harmless.
+ *
+ * @param iterator Files to play, in order, looping at the end.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an empty iterator, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_playlist_start(file_iterator_instance_t *iterator);
+
+/**
+ * @brief Stop following the player, the track being played is left to it.
+ */
+esp_err_t app_playlist_stop(void);
+
+/**
+ * @brief Play a track, from its beginning, without waiting for it to start.
+ *
+ * @param index Index of the track in the iterator.
+ */
+esp_err_t app_playlist_play(int index);
+
+/**
+ * @brief Get the index of the track started last, including the ones started at the end of a track.
+ *
+ * @return The track index, -1 before the first one.
+ */
+int app_playlist_get_index(void);
+
+/**
+ * @brief Get the playlist statistics.
+ */
+esp_err_t app_playlist_get_stats(app_playlist_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,285 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "bsp_board_extra.h"
+#include "app_fft.h"
+#include "app_spectrum.h"
+
+#define SPECTRUM_FFT_SIZE           (1024)          // 43 Hz bins at 44.1 kHz
+#define SPECTRUM_RING_SIZE          (32 * 1024)     // Several player buffers, about 180 ms of 44.1 kHz stereo
+#define SPECTRUM_READ_SIZE          (2048)
+#define SPECTRUM_TASK_PRIORITY      (1)             // Below the audio player and LVGL tasks
+#define SPECTRUM_TASK_CORE          (portNUM_PROCESSORS - 1)    // Pinned, the cycle counters are per core
+#define SPECTRUM_TASK_STACK_SIZE    (3 * 1024)
+#define SPECTRUM_STOP_TIMEOUT_MS    (500)
+#define SPECTRUM_LOG2_TOP_Q4        (25 * 16)       // Band power of a full scale sine, log2 in 1/16 steps
+#define SPECTRUM_LOG2_RANGE_Q4      (16 * 16)       // 48 dB shown
+#define SPECTRUM_DECAY              (4)             // Levels fall by this much per frame, and rise at once
+
+typedef struct {
+    volatile bool running;
+    SemaphoreHandle_t exit_sem;
+    bsp_extra_pcm_ring_handle_t ring;   // Kept once created, see `bsp_extra_i2s_set_tap`
+    app_fft_t fft;
+    int16_t *history;                   // Last `SPECTRUM_FFT_SIZE` mono samples, circular
+    uint32_t history_pos;
+    int16_t *fft_buf;
+    uint32_t *power;
+    uint8_t *read_buf;
+    uint16_t levels[APP_SPECTRUM_BAND_NUM];
+    atomic_uint published;              // One level per byte, lowest band in the low byte
+    portMUX_TYPE stats_lock;
+    app_spectrum_stats_t stats;
+} spectrum_t;
+
+static const char *TAG = "app_spectrum";
+
+static const uint32_t band_edges_hz[APP_SPECTRUM_BAND_NUM + 1] = {20, 250, 2000, 6000, 16000};
+
+static spectrum_t spectrum = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static uint32_t log2_q4(uint64_t x)
+{
+    if (!x) {
+        return 0;
+    }
+
+    uint32_t e = 63 - __builtin_clzll(x);
+    // The 4 bits below the leading one, a linear guess of the fraction
+    uint32_t frac = (e >= 4) ? (uint32_t)(x >> (e - 4)) & 0xF : (uint32_t)(x << (4 - e)) & 0xF;
+
+    return e * 16 + frac;
+}
+
+// Move the new audio from the ring into the history, mixed down to mono
+static bool spectrum_pull(uint32_t bits, uint32_t channels)
+{
+    const uint32_t frame_bytes = bits / 8 * channels;
+    const bool supported = ((bits == 16) || (bits == 32)) && channels;
+    bool pulled = false;
+    size_t filled;
+
+    while (frame_bytes && ((filled = bsp_extra_pcm_ring_get_filled(spectrum.ring)) >= frame_bytes)) {
+        size_t len = MIN(filled, SPECTRUM_READ_SIZE / frame_bytes * frame_bytes);
+        bsp_extra_pcm_ring_read(spectrum.ring, spectrum.read_buf, len);
+        if (!supported) {
+            continue;
+        }
+
+        for (size_t ofs = 0; ofs < len; ofs += frame_bytes) {
+            int32_t sum = 0;
+            for (uint32_t c = 0; c < channels; c++) {
+                if (bits == 16) {
+                    sum += ((const int16_t *)(spectrum.read_buf + ofs))[c];
+                } else {
+                    sum += ((const int32_t *)(spectrum.read_buf + ofs))[c] >> 16;
+                }
+            }
+            spectrum.history[spectrum.history_pos] = (int16_t)(sum / (int32_t)channels);
+            spectrum.history_pos = (spectrum.history_pos + 1) % SPECTRUM_FFT_SIZE;
+        }
+        pulled = true;
+    }
+
+    return pulled;
+}
+
+static void spectrum_compute(uint32_t rate)
+{
+    const uint32_t n = SPECTRUM_FFT_SIZE;
+
+    // Oldest sample first
+    uint32_t tail = n - spectrum.history_pos;
+    memcpy(spectrum.fft_buf, spectrum.history + spectrum.history_pos, tail * sizeof(int16_t));
+    memcpy(spectrum.fft_buf + tail, spectrum.history, spectrum.history_pos * sizeof(int16_t));
+
+    app_fft_window(&spectrum.fft, spectrum.fft_buf);
+    app_fft_real(&spectrum.fft, spectrum.fft_buf);
+    app_fft_power(&spectrum.fft, spectrum.fft_buf, spectrum.power);
+
+    for (int b = 0; b < APP_SPECTRUM_BAND_NUM; b++) {
+        uint32_t lo = MAX((uint64_t)band_edges_hz[b] * n / rate, 1);
+        uint32_t hi = MIN((uint64_t)band_edges_hz[b + 1] * n / rate, n / 2);
+        uint64_t power = 0;
+        for (uint32_t k = lo; k < hi; k++) {
+            power += spectrum.power[k];
+        }
+
+        int32_t level = ((int32_t)log2_q4(power) - (SPECTRUM_LOG2_TOP_Q4 - SPECTRUM_LOG2_RANGE_Q4)) *
+                        APP_SPECTRUM_LEVEL_MAX / SPECTRUM_LOG2_RANGE_Q4;
+        level = MIN(MAX(level, 0), APP_SPECTRUM_LEVEL_MAX);
+        spectrum.levels[b] = MAX(level, (int32_t)spectrum.levels[b] - SPECTRUM_DECAY);
+    }
+}
+
+static void spectrum_decay(void)
+{
+    for (int b = 0; b < APP_SPECTRUM_BAND_NUM; b++) {
+        spectrum.levels[b] = MAX((int32_t)spectrum.levels[b] - SPECTRUM_DECAY, 0);
+    }
+}
+
+static void spectrum_publish(void)
+{
+    uint32_t packed = 0;
+    for (int b = 0; b < APP_SPECTRUM_BAND_NUM; b++) {
+        packed |= (uint32_t)spectrum.levels[b] << (8 * b);
+    }
+    atomic_store_explicit(&spectrum.published, packed, memory_order_release);
+}
+
+static void spectrum_task(void *arg)
+{
+    TickType_t wake = xTaskGetTickCount();
+
+    while (spectrum.running) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(APP_SPECTRUM_FRAME_MS));
+
+        uint32_t rate = 0, bits = 0, channels = 0;
+        bsp_extra_codec_get_fs(&rate, &bits, &channels);
+
+        uint32_t cycles = 0;
+        bool fresh = spectrum_pull(bits, channels) && rate;
+        if (fresh) {
+            uint32_t start = esp_cpu_get_cycle_count();
+            spectrum_compute(rate);
+            cycles = esp_cpu_get_cycle_count() - start;
+        } else {
+            // Paused or stopped
+            spectrum_decay();
+        }
+        spectrum_publish();
+
+        portENTER_CRITICAL(&spectrum.stats_lock);
+        spectrum.stats.frames++;
+        if (fresh) {
+            spectrum.stats.fft_count++;
+            spectrum.stats.fft_cycles_last = cycles;
+            spectrum.stats.fft_cycles_max = MAX(spectrum.stats.fft_cycles_max, cycles);
+            spectrum.stats.fft_cycles_total += cycles;
+        }
+        portEXIT_CRITICAL(&spectrum.stats_lock);
+    }
+
+    xSemaphoreGive(spectrum.exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void spectrum_free(void)
+{
+    app_fft_deinit(&spectrum.fft);
+    free(spectrum.history);
+    spectrum.history = NULL;
+    free(spectrum.fft_buf);
+    spectrum.fft_buf = NULL;
+    free(spectrum.power);
+    spectrum.power = NULL;
+    free(spectrum.read_buf);
+    spectrum.read_buf = NULL;
+}
+
+esp_err_t app_spectrum_start(void)
+{
+    if (spectrum.running) {
+        return ESP_OK;
+    }
+
+    if (!spectrum.exit_sem) {
+        spectrum.exit_sem = xSemaphoreCreateBinary();
+        ESP_RETURN_ON_FALSE(spectrum.exit_sem, ESP_ERR_NO_MEM, TAG, "Create exit semaphore failed");
+    }
+    if (!spectrum.ring) {
+        ESP_RETURN_ON_ERROR(bsp_extra_pcm_ring_new(SPECTRUM_RING_SIZE, MALLOC_CAP_SPIRAM, &spectrum.ring), TAG,
+                            "Create tap ring failed");
+    }
+
+    esp_err_t ret = ESP_OK;
+    ESP_GOTO_ON_ERROR(app_fft_init(&spectrum.fft, SPECTRUM_FFT_SIZE), err, TAG, "Init FFT failed");
+    spectrum.history = heap_caps_calloc(SPECTRUM_FFT_SIZE, sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    spectrum.fft_buf = heap_caps_malloc(SPECTRUM_FFT_SIZE * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    spectrum.power = heap_caps_malloc(SPECTRUM_FFT_SIZE / 2 * sizeof(uint32_t), MALLOC_CAP_INTERNAL);
+    spectrum.read_buf = heap_caps_malloc(SPECTRUM_READ_SIZE, MALLOC_CAP_INTERNAL);
+    ESP_GOTO_ON_FALSE(spectrum.history && spectrum.fft_buf && spectrum.power && spectrum.read_buf, ESP_ERR_NO_MEM,
+                      err, TAG, "No memory for spectrum buffers");
+    spectrum.history_pos = 0;
+    memset(spectrum.levels, 0, sizeof(spectrum.levels));
+    memset(&spectrum.stats, 0, sizeof(spectrum.stats));
+
+    // Audio left from the last run, the player is not writing yet
+    size_t stale = bsp_extra_pcm_ring_get_filled(spectrum.ring);
+    while (stale) {
+        stale -= bsp_extra_pcm_ring_read(spectrum.ring, spectrum.read_buf, MIN(stale, SPECTRUM_READ_SIZE));
+    }
+    xSemaphoreTake(spectrum.exit_sem, 0);
+
+    spectrum.running = true;
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(spectrum_task, "spectrum", SPECTRUM_TASK_STACK_SIZE, NULL,
+                                              SPECTRUM_TASK_PRIORITY, NULL, SPECTRUM_TASK_CORE) == pdPASS,
+                      ESP_ERR_NO_MEM, err, TAG, "Create spectrum task failed");
+    bsp_extra_i2s_set_tap(spectrum.ring);
+
+    return ESP_OK;
+
+err:
+    spectrum.running = false;
+    spectrum_free();
+    return ret;
+}
+
+esp_err_t app_spectrum_stop(void)
+{
+    if (!spectrum.running) {
+        return ESP_OK;
+    }
+
+    bsp_extra_i2s_set_tap(NULL);
+    spectrum.running = false;
+    ESP_RETURN_ON_FALSE(xSemaphoreTake(spectrum.exit_sem, pdMS_TO_TICKS(SPECTRUM_STOP_TIMEOUT_MS)) == pdTRUE,
+                        ESP_ERR_TIMEOUT, TAG, "Spectrum task stop timeout");
+    spectrum_free();
+    atomic_store(&spectrum.published, 0);
+
+    app_spectrum_stats_t stats;
+    app_spectrum_get_stats(&stats);
+    ESP_LOGI(TAG, "Stopped: %" PRIu32 " FFT, %" PRIu32 " cycles avg, %" PRIu32 " max", stats.fft_count,
+             stats.fft_count ? (uint32_t)(stats.fft_cycles_total / stats.fft_count) : 0, stats.fft_cycles_max);
+
+    return ESP_OK;
+}
+
+void app_spectrum_get_levels(uint16_t levels[APP_SPECTRUM_BAND_NUM])
+{
+    uint32_t packed = atomic_load_explicit(&spectrum.published, memory_order_acquire);
+
+    for (int b = 0; b < APP_SPECTRUM_BAND_NUM; b++) {
+        levels[b] = (packed >> (8 * b)) & 0xFF;
+    }
+}
+
+esp_err_t app_spectrum_get_stats(app_spectrum_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    portENTER_CRITICAL(&spectrum.stats_lock);
+    *stats = spectrum.stats;
+    portEXIT_CRITICAL(&spectrum.stats_lock);
+
+    return ESP_OK;
+}
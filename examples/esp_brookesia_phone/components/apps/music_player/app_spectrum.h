@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_SPECTRUM_BAND_NUM       (4)     /*!< Bass, low mid, high mid, treble */
+#define APP_SPECTRUM_LEVEL_MAX      (64)
+#define APP_SPECTRUM_FRAME_MS       (33)    /*!< One spectrum per display frame, 30 FPS */
+
+/**
+ * @brief Spectrum analyzer statistics, since it started.
+ */
+typedef struct {
+    uint32_t frames;                    /*!< Spectrums published. */
+    uint32_t fft_count;                 /*!< Spectrums computed from new audio. */
+    uint32_t fft_cycles_last;           /*!< CPU cycles of the last window, FFT and bands. */
+    uint32_t fft_cycles_max;            /*!< Most CPU cycles taken by one spectrum. */
+    uint64_t fft_cycles_total;          /*!< CPU cycles taken by all the spectrums. */
+} app_spectrum_stats_t;
+
+/**
+ * @brief Start analyzing the audio written to the player.
+ *
+ * A low priority task takes the played audio from a tap on `bsp_extra_i2s_write` once per display frame, and
+ * publishes the level of each band from a 1024 points fixed-point FFT. The player never waits for it: audio that does
+ * not fit in the tap ring is left out of the spectrum. Starting twice is harmless.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_spectrum_start(void);
+
+/**
+ * @brief Stop the analyzer, the bands drop to 0.
+ */
+esp_err_t app_spectrum_stop(void);
+
+/**
+ * @brief Get the latest band levels, without locking.
+ *
+ * @param levels `APP_SPECTRUM_BAND_NUM` levels from 0 to `APP_SPECTRUM_LEVEL_MAX`, lowest band first.
+ */
+void app_spectrum_get_levels(uint16_t levels[APP_SPECTRUM_BAND_NUM]);
+
+/**
+ * @brief Get the analyzer statistics.
+ */
+esp_err_t app_spectrum_get_stats(app_spectrum_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,1025 +0,0 @@
-const uint16_t spectrum_3[][4] = {
-{ 0, 0, 0, 0, },
-{ 0, 0, 0, 0, },
-{ 0, 0, 0, 0, },
-{ 0, 1, 1, 0, },
-{ 0, 1, 1, 0, },
-{ 0, 1, 1, 0, },
-{ 0, 2, 2, 0, },
-{ 0, 2, 2, 0, },
-{ 0, 2, 3, 0, },
-{ 0, 3, 3, 0, },
-{ 0, 3, 3, 0, },
-{ 0, 4, 3, 0, },
-{ 0, 4, 4, 0, },
-{ 0, 4, 5, 0, },
-{ 0, 4, 5, 0, },
-{ 1, 4, 6, 0, },
-{ 1, 4, 6, 1, },
-{ 1, 4, 6, 1, },
-{ 1, 6, 7, 1, },
-{ 1, 7, 7, 1, },
-{ 1, 7, 7, 1, },
-{ 1, 8, 9, 1, },
-{ 1, 8, 11, 1, },
-{ 1, 7, 9, 1, },
-{ 1, 6, 10, 1, },
-{ 1, 7, 10, 1, },
-{ 1, 9, 11, 1, },
-{ 0, 10, 13, 1, },
-{ 0, 12, 12, 1, },
-{ 0, 12, 13, 2, },
-{ 0, 12, 23, 5, },
-{ 0, 23, 65, 20, },
-{ 0, 49, 56, 16, },
-{ 2, 53, 11, 1, },
-{ 5, 37, 25, 4, },
-{ 13, 25, 25, 3, },
-{ 16, 14, 8, 0, },
-{ 11, 11, 11, 1, },
-{ 5, 12, 14, 2, },
-{ 2, 8, 8, 0, },
-{ 2, 14, 38, 7, },
-{ 1, 28, 51, 9, },
-{ 5, 20, 20, 2, },
-{ 7, 16, 45, 15, },
-{ 4, 40, 68, 21, },
-{ 2, 56, 25, 6, },
-{ 3, 39, 5, 0, },
-{ 9, 22, 9, 1, },
-{ 13, 11, 5, 0, },
-{ 11, 9, 25, 5, },
-{ 5, 24, 51, 9, },
-{ 4, 24, 27, 4, },
-{ 7, 13, 6, 1, },
-{ 5, 14, 13, 2, },
-{ 3, 10, 9, 1, },
-{ 3, 6, 23, 8, },
-{ 2, 25, 68, 22, },
-{ 1, 54, 48, 14, },
-{ 3, 48, 7, 1, },
-{ 7, 33, 25, 4, },
-{ 13, 24, 20, 3, },
-{ 15, 13, 4, 0, },
-{ 10, 11, 12, 2, },
-{ 4, 11, 11, 1, },
-{ 2, 6, 7, 1, },
-{ 2, 16, 43, 8, },
-{ 2, 27, 46, 8, },
-{ 6, 18, 12, 2, },
-{ 6, 18, 52, 17, },
-{ 4, 44, 64, 19, },
-{ 2, 53, 16, 4, },
-{ 4, 34, 5, 0, },
-{ 10, 19, 7, 1, },
-{ 13, 10, 3, 0, },
-{ 10, 11, 31, 6, },
-{ 4, 26, 50, 9, },
-{ 5, 21, 21, 3, },
-{ 7, 14, 12, 2, },
-{ 5, 17, 22, 3, },
-{ 3, 14, 11, 1, },
-{ 4, 9, 31, 11, },
-{ 3, 31, 70, 22, },
-{ 1, 54, 38, 11, },
-{ 3, 43, 10, 2, },
-{ 8, 31, 26, 5, },
-{ 14, 22, 17, 3, },
-{ 15, 12, 5, 0, },
-{ 9, 11, 12, 2, },
-{ 3, 10, 9, 1, },
-{ 3, 6, 12, 2, },
-{ 2, 19, 47, 9, },
-{ 3, 26, 40, 7, },
-{ 6, 16, 14, 4, },
-{ 6, 21, 59, 19, },
-{ 3, 50, 58, 17, },
-{ 2, 54, 9, 2, },
-{ 5, 33, 6, 1, },
-{ 11, 17, 7, 1, },
-{ 13, 9, 4, 0, },
-{ 9, 14, 37, 7, },
-{ 3, 27, 48, 9, },
-{ 6, 19, 15, 2, },
-{ 7, 13, 9, 1, },
-{ 5, 13, 13, 2, },
-{ 3, 8, 5, 0, },
-{ 3, 9, 41, 14, },
-{ 2, 36, 69, 22, },
-{ 1, 56, 29, 8, },
-{ 3, 41, 3, 0, },
-{ 8, 23, 7, 1, },
-{ 13, 11, 4, 0, },
-{ 11, 9, 21, 4, },
-{ 5, 23, 50, 10, },
-{ 4, 24, 30, 5, },
-{ 7, 14, 6, 1, },
-{ 5, 13, 13, 2, },
-{ 3, 11, 9, 1, },
-{ 3, 6, 19, 7, },
-{ 2, 22, 66, 21, },
-{ 1, 47, 51, 15, },
-{ 1, 43, 4, 0, },
-{ 6, 25, 2, 0, },
-{ 11, 13, 2, 0, },
-{ 12, 7, 4, 0, },
-{ 7, 8, 15, 2, },
-{ 1, 11, 18, 2, },
-{ 2, 10, 14, 2, },
-{ 2, 11, 25, 4, },
-{ 2, 18, 32, 4, },
-{ 3, 18, 30, 5, },
-{ 3, 19, 53, 16, },
-{ 3, 43, 68, 20, },
-{ 1, 57, 23, 5, },
-{ 4, 41, 19, 3, },
-{ 10, 28, 28, 4, },
-{ 16, 17, 14, 1, },
-{ 13, 11, 9, 1, },
-{ 7, 12, 15, 2, },
-{ 2, 8, 11, 0, },
-{ 2, 9, 27, 5, },
-{ 2, 24, 53, 10, },
-{ 4, 23, 30, 4, },
-{ 7, 14, 29, 9, },
-{ 5, 30, 67, 21, },
-{ 2, 56, 40, 11, },
-{ 2, 47, 3, 0, },
-{ 7, 27, 7, 1, },
-{ 13, 14, 5, 0, },
-{ 12, 8, 13, 2, },
-{ 7, 20, 47, 9, },
-{ 3, 26, 38, 6, },
-{ 6, 15, 6, 0, },
-{ 6, 13, 12, 2, },
-{ 4, 12, 12, 1, },
-{ 3, 7, 10, 3, },
-{ 2, 16, 58, 19, },
-{ 1, 45, 61, 19, },
-{ 2, 47, 12, 3, },
-{ 5, 32, 21, 4, },
-{ 12, 27, 26, 4, },
-{ 16, 15, 8, 0, },
-{ 12, 10, 9, 1, },
-{ 5, 12, 13, 2, },
-{ 2, 8, 5, 0, },
-{ 2, 10, 32, 6, },
-{ 1, 26, 51, 10, },
-{ 5, 22, 21, 3, },
-{ 7, 14, 36, 12, },
-{ 5, 35, 68, 21, },
-{ 2, 57, 32, 8, },
-{ 3, 43, 3, 0, },
-{ 8, 24, 7, 1, },
-{ 13, 12, 5, 0, },
-{ 11, 8, 19, 4, },
-{ 6, 22, 50, 10, },
-{ 4, 25, 33, 5, },
-{ 7, 14, 8, 1, },
-{ 6, 16, 21, 3, },
-{ 3, 15, 16, 2, },
-{ 4, 9, 16, 6, },
-{ 3, 21, 64, 21, },
-{ 1, 47, 54, 16, },
-{ 1, 46, 7, 1, },
-{ 6, 31, 23, 4, },
-{ 12, 24, 22, 4, },
-{ 16, 13, 5, 0, },
-{ 11, 11, 10, 2, },
-{ 4, 11, 11, 2, },
-{ 2, 6, 5, 0, },
-{ 2, 13, 38, 7, },
-{ 1, 27, 48, 9, },
-{ 6, 19, 15, 2, },
-{ 7, 16, 45, 15, },
-{ 4, 39, 67, 20, },
-{ 2, 53, 23, 6, },
-{ 4, 36, 4, 0, },
-{ 9, 20, 7, 1, },
-{ 14, 10, 3, 0, },
-{ 11, 10, 26, 5, },
-{ 5, 24, 51, 10, },
-{ 4, 23, 26, 4, },
-{ 7, 13, 6, 1, },
-{ 5, 13, 14, 2, },
-{ 3, 10, 8, 1, },
-{ 3, 6, 24, 8, },
-{ 2, 25, 68, 21, },
-{ 2, 48, 46, 13, },
-{ 2, 42, 2, 0, },
-{ 7, 27, 7, 1, },
-{ 13, 15, 6, 0, },
-{ 13, 8, 10, 2, },
-{ 7, 18, 46, 9, },
-{ 2, 26, 41, 7, },
-{ 6, 16, 7, 0, },
-{ 6, 13, 12, 5, },
-{ 4, 12, 14, 7, },
-{ 3, 7, 9, 4, },
-{ 2, 14, 53, 18, },
-{ 1, 44, 61, 21, },
-{ 1, 56, 14, 8, },
-{ 4, 36, 7, 5, },
-{ 10, 20, 14, 8, },
-{ 13, 12, 12, 6, },
-{ 8, 8, 16, 4, },
-{ 3, 11, 25, 4, },
-{ 2, 10, 20, 2, },
-{ 2, 9, 21, 6, },
-{ 2, 16, 30, 15, },
-{ 3, 17, 26, 12, },
-{ 3, 18, 39, 13, },
-{ 3, 32, 70, 25, },
-{ 2, 56, 45, 19, },
-{ 7, 46, 24, 9, },
-{ 13, 37, 19, 5, },
-{ 10, 32, 28, 5, },
-{ 15, 21, 20, 2, },
-{ 15, 12, 8, 0, },
-{ 9, 12, 13, 2, },
-{ 3, 12, 11, 1, },
-{ 3, 8, 14, 2, },
-{ 2, 19, 48, 9, },
-{ 3, 27, 42, 7, },
-{ 6, 16, 17, 4, },
-{ 6, 21, 59, 19, },
-{ 3, 49, 57, 19, },
-{ 2, 53, 10, 7, },
-{ 5, 33, 6, 5, },
-{ 11, 17, 7, 4, },
-{ 13, 9, 5, 2, },
-{ 9, 14, 37, 7, },
-{ 3, 26, 47, 8, },
-{ 6, 19, 16, 2, },
-{ 7, 13, 10, 1, },
-{ 5, 13, 14, 2, },
-{ 3, 8, 6, 0, },
-{ 3, 9, 41, 14, },
-{ 2, 35, 69, 21, },
-{ 1, 53, 29, 8, },
-{ 3, 39, 13, 2, },
-{ 9, 30, 27, 5, },
-{ 15, 20, 15, 2, },
-{ 14, 11, 6, 1, },
-{ 8, 12, 13, 2, },
-{ 2, 9, 8, 1, },
-{ 3, 6, 18, 4, },
-{ 2, 22, 51, 10, },
-{ 4, 25, 35, 6, },
-{ 7, 14, 19, 6, },
-{ 6, 24, 64, 22, },
-{ 2, 52, 50, 17, },
-{ 2, 50, 6, 6, },
-{ 6, 29, 7, 5, },
-{ 12, 15, 7, 4, },
-{ 13, 8, 8, 2, },
-{ 8, 17, 43, 8, },
-{ 2, 27, 44, 8, },
-{ 6, 17, 10, 1, },
-{ 6, 14, 17, 3, },
-{ 4, 16, 21, 3, },
-{ 4, 11, 8, 1, },
-{ 4, 13, 49, 16, },
-{ 2, 39, 66, 20, },
-{ 2, 48, 20, 5, },
-{ 4, 34, 17, 3, },
-{ 10, 29, 27, 4, },
-{ 15, 17, 11, 1, },
-{ 13, 10, 7, 1, },
-{ 7, 11, 13, 2, },
-{ 2, 8, 7, 0, },
-{ 2, 8, 25, 5, },
-{ 2, 24, 51, 10, },
-{ 4, 24, 27, 4, },
-{ 7, 14, 28, 10, },
-{ 5, 30, 68, 23, },
-{ 2, 55, 42, 15, },
-{ 2, 47, 5, 6, },
-{ 7, 26, 8, 5, },
-{ 13, 13, 6, 3, },
-{ 12, 8, 13, 3, },
-{ 7, 19, 47, 9, },
-{ 3, 26, 39, 7, },
-{ 6, 15, 6, 0, },
-{ 6, 13, 12, 2, },
-{ 4, 12, 11, 1, },
-{ 3, 6, 9, 3, },
-{ 2, 15, 58, 19, },
-{ 1, 47, 62, 18, },
-{ 1, 55, 12, 3, },
-{ 4, 34, 5, 1, },
-{ 11, 18, 7, 1, },
-{ 13, 9, 3, 0, },
-{ 9, 13, 35, 7, },
-{ 3, 26, 49, 9, },
-{ 5, 20, 17, 2, },
-{ 7, 13, 9, 1, },
-{ 5, 13, 14, 2, },
-{ 2, 8, 6, 1, },
-{ 3, 8, 37, 13, },
-{ 2, 33, 69, 23, },
-{ 1, 56, 33, 12, },
-{ 3, 43, 3, 6, },
-{ 8, 22, 4, 5, },
-{ 13, 11, 4, 3, },
-{ 10, 6, 6, 1, },
-{ 4, 9, 17, 3, },
-{ 1, 11, 16, 2, },
-{ 2, 9, 14, 3, },
-{ 2, 13, 30, 9, },
-{ 2, 17, 28, 9, },
-{ 3, 17, 28, 8, },
-{ 2, 23, 65, 21, },
-{ 2, 50, 55, 16, },
-{ 2, 53, 9, 1, },
-{ 6, 36, 25, 4, },
-{ 13, 25, 25, 3, },
-{ 16, 14, 9, 0, },
-{ 11, 11, 13, 1, },
-{ 4, 12, 14, 1, },
-{ 2, 7, 9, 1, },
-{ 2, 14, 39, 7, },
-{ 1, 28, 49, 8, },
-{ 6, 19, 17, 2, },
-{ 7, 16, 46, 15, },
-{ 4, 40, 66, 21, },
-{ 2, 55, 23, 10, },
-{ 4, 39, 6, 5, },
-{ 9, 21, 8, 4, },
-{ 13, 11, 5, 2, },
-{ 11, 9, 26, 5, },
-{ 5, 24, 51, 9, },
-{ 4, 23, 26, 4, },
-{ 7, 13, 7, 1, },
-{ 5, 13, 15, 2, },
-{ 3, 10, 10, 1, },
-{ 3, 6, 24, 9, },
-{ 2, 25, 68, 22, },
-{ 1, 52, 45, 13, },
-{ 2, 46, 8, 1, },
-{ 7, 32, 25, 4, },
-{ 14, 23, 20, 3, },
-{ 15, 13, 5, 0, },
-{ 10, 11, 12, 2, },
-{ 4, 10, 12, 1, },
-{ 2, 5, 8, 1, },
-{ 2, 17, 43, 9, },
-{ 2, 27, 44, 8, },
-{ 6, 17, 12, 2, },
-{ 6, 18, 53, 18, },
-{ 4, 46, 62, 20, },
-{ 2, 55, 15, 7, },
-{ 4, 35, 7, 5, },
-{ 10, 19, 10, 4, },
-{ 14, 10, 5, 2, },
-{ 10, 12, 32, 6, },
-{ 4, 26, 49, 9, },
-{ 5, 21, 19, 3, },
-{ 7, 14, 12, 2, },
-{ 5, 17, 22, 3, },
-{ 3, 13, 10, 1, },
-{ 4, 9, 33, 11, },
-{ 3, 32, 69, 21, },
-{ 1, 57, 37, 9, },
-{ 2, 46, 11, 2, },
-{ 8, 32, 26, 5, },
-{ 15, 21, 17, 2, },
-{ 15, 12, 5, 0, },
-{ 9, 11, 12, 2, },
-{ 3, 10, 9, 1, },
-{ 3, 6, 13, 3, },
-{ 2, 20, 49, 9, },
-{ 3, 27, 40, 7, },
-{ 6, 15, 15, 4, },
-{ 6, 21, 60, 20, },
-{ 3, 49, 56, 18, },
-{ 2, 53, 9, 6, },
-{ 5, 31, 7, 5, },
-{ 11, 17, 7, 4, },
-{ 13, 9, 5, 2, },
-{ 9, 14, 39, 7, },
-{ 3, 26, 48, 8, },
-{ 6, 18, 14, 1, },
-{ 7, 13, 9, 1, },
-{ 5, 13, 13, 2, },
-{ 3, 8, 5, 0, },
-{ 2, 9, 42, 15, },
-{ 2, 36, 68, 21, },
-{ 1, 52, 27, 7, },
-{ 3, 37, 5, 0, },
-{ 9, 22, 10, 1, },
-{ 13, 12, 6, 0, },
-{ 11, 9, 23, 5, },
-{ 5, 23, 50, 10, },
-{ 4, 24, 28, 4, },
-{ 7, 14, 6, 1, },
-{ 5, 13, 12, 2, },
-{ 3, 11, 8, 2, },
-{ 3, 6, 20, 7, },
-{ 2, 23, 66, 22, },
-{ 1, 53, 50, 17, },
-{ 2, 50, 6, 6, },
-{ 6, 28, 4, 5, },
-{ 12, 13, 4, 3, },
-{ 11, 7, 3, 1, },
-{ 6, 4, 2, 0, },
-{ 1, 2, 1, 0, },
-{ 0, 1, 1, 0, },
-{ 0, 1, 4, 0, },
-{ 0, 1, 5, 0, },
-{ 0, 1, 6, 2, },
-{ 0, 10, 52, 18, },
-{ 0, 43, 67, 20, },
-{ 1, 58, 21, 4, },
-{ 4, 42, 21, 3, },
-{ 11, 30, 29, 4, },
-{ 16, 20, 13, 1, },
-{ 13, 12, 12, 1, },
-{ 6, 12, 19, 1, },
-{ 2, 9, 13, 0, },
-{ 2, 9, 27, 5, },
-{ 2, 26, 50, 10, },
-{ 4, 24, 27, 4, },
-{ 7, 14, 30, 10, },
-{ 5, 31, 68, 22, },
-{ 2, 55, 39, 14, },
-{ 2, 47, 6, 6, },
-{ 7, 26, 11, 5, },
-{ 13, 14, 9, 3, },
-{ 12, 8, 15, 3, },
-{ 7, 20, 48, 9, },
-{ 3, 26, 38, 6, },
-{ 7, 15, 7, 0, },
-{ 6, 13, 13, 2, },
-{ 4, 12, 12, 1, },
-{ 3, 7, 11, 4, },
-{ 2, 16, 59, 20, },
-{ 1, 48, 62, 18, },
-{ 1, 55, 13, 2, },
-{ 5, 37, 22, 4, },
-{ 11, 27, 25, 4, },
-{ 15, 15, 7, 0, },
-{ 12, 11, 10, 1, },
-{ 5, 12, 13, 2, },
-{ 2, 8, 6, 0, },
-{ 2, 11, 34, 7, },
-{ 1, 26, 52, 9, },
-{ 5, 22, 21, 3, },
-{ 7, 14, 39, 13, },
-{ 4, 35, 68, 22, },
-{ 2, 55, 31, 11, },
-{ 3, 42, 8, 5, },
-{ 8, 24, 11, 4, },
-{ 12, 13, 7, 3, },
-{ 11, 9, 22, 4, },
-{ 5, 23, 53, 10, },
-{ 3, 25, 33, 5, },
-{ 6, 14, 10, 1, },
-{ 5, 16, 22, 3, },
-{ 3, 15, 16, 2, },
-{ 4, 8, 19, 6, },
-{ 3, 22, 64, 20, },
-{ 1, 51, 51, 14, },
-{ 1, 51, 9, 1, },
-{ 5, 34, 24, 3, },
-{ 11, 24, 25, 3, },
-{ 13, 14, 9, 0, },
-{ 10, 11, 12, 2, },
-{ 4, 11, 13, 2, },
-{ 2, 7, 9, 1, },
-{ 2, 13, 40, 8, },
-{ 1, 26, 48, 9, },
-{ 4, 18, 16, 2, },
-{ 5, 15, 46, 15, },
-{ 3, 40, 65, 21, },
-{ 1, 54, 24, 9, },
-{ 2, 36, 10, 5, },
-{ 7, 19, 11, 4, },
-{ 10, 9, 9, 3, },
-{ 8, 9, 28, 5, },
-{ 3, 23, 50, 9, },
-{ 2, 22, 25, 4, },
-{ 4, 12, 11, 1, },
-{ 3, 12, 19, 2, },
-{ 1, 9, 14, 2, },
-{ 1, 6, 28, 9, },
-{ 1, 25, 68, 21, },
-{ 0, 50, 44, 12, },
-{ 1, 41, 9, 1, },
-{ 3, 22, 11, 1, },
-{ 6, 11, 11, 1, },
-{ 6, 6, 15, 2, },
-{ 3, 17, 46, 8, },
-{ 1, 23, 40, 7, },
-{ 2, 14, 13, 1, },
-{ 2, 11, 14, 2, },
-{ 1, 10, 13, 2, },
-{ 1, 5, 14, 3, },
-{ 1, 12, 58, 18, },
-{ 0, 38, 64, 20, },
-{ 0, 42, 17, 7, },
-{ 1, 22, 14, 5, },
-{ 3, 9, 16, 5, },
-{ 4, 4, 13, 3, },
-{ 2, 5, 16, 2, },
-{ 0, 10, 21, 3, },
-{ 0, 8, 19, 2, },
-{ 0, 8, 21, 5, },
-{ 0, 13, 32, 9, },
-{ 0, 14, 31, 7, },
-{ 0, 13, 42, 11, },
-{ 0, 25, 70, 19, },
-{ 0, 37, 37, 8, },
-{ 0, 23, 18, 2, },
-{ 1, 16, 30, 4, },
-{ 2, 12, 22, 3, },
-{ 2, 6, 16, 2, },
-{ 1, 6, 20, 3, },
-{ 0, 6, 20, 3, },
-{ 0, 6, 21, 3, },
-{ 0, 14, 50, 7, },
-{ 0, 18, 42, 5, },
-{ 0, 9, 24, 5, },
-{ 0, 13, 64, 17, },
-{ 0, 27, 57, 14, },
-{ 0, 20, 17, 5, },
-{ 0, 8, 16, 4, },
-{ 1, 5, 17, 4, },
-{ 1, 2, 16, 3, },
-{ 0, 8, 40, 6, },
-{ 0, 15, 46, 7, },
-{ 0, 9, 20, 4, },
-{ 0, 5, 18, 4, },
-{ 0, 5, 19, 4, },
-{ 0, 3, 16, 3, },
-{ 0, 4, 46, 10, },
-{ 0, 16, 69, 13, },
-{ 0, 17, 28, 6, },
-{ 0, 7, 20, 4, },
-{ 0, 8, 29, 5, },
-{ 0, 6, 21, 5, },
-{ 0, 2, 17, 5, },
-{ 0, 3, 20, 5, },
-{ 0, 3, 18, 6, },
-{ 0, 2, 23, 6, },
-{ 0, 8, 45, 7, },
-{ 0, 9, 32, 6, },
-{ 0, 4, 25, 7, },
-{ 0, 8, 59, 12, },
-{ 0, 12, 44, 10, },
-{ 0, 6, 17, 7, },
-{ 0, 2, 17, 8, },
-{ 0, 1, 17, 7, },
-{ 0, 1, 18, 7, },
-{ 0, 4, 41, 7, },
-{ 0, 7, 40, 8, },
-{ 0, 3, 18, 9, },
-{ 0, 2, 20, 9, },
-{ 0, 3, 22, 10, },
-{ 0, 2, 17, 10, },
-{ 0, 2, 43, 10, },
-{ 0, 6, 52, 10, },
-{ 0, 5, 21, 11, },
-{ 0, 2, 21, 11, },
-{ 0, 2, 25, 11, },
-{ 0, 2, 16, 11, },
-{ 0, 0, 14, 11, },
-{ 0, 1, 15, 11, },
-{ 0, 0, 14, 12, },
-{ 0, 1, 23, 12, },
-{ 0, 3, 37, 13, },
-{ 0, 2, 22, 13, },
-{ 0, 1, 22, 14, },
-{ 0, 3, 43, 14, },
-{ 0, 3, 26, 13, },
-{ 0, 1, 11, 13, },
-{ 0, 0, 12, 15, },
-{ 0, 0, 11, 16, },
-{ 0, 0, 13, 17, },
-{ 0, 1, 27, 17, },
-{ 0, 2, 21, 17, },
-{ 0, 0, 10, 16, },
-{ 0, 0, 11, 16, },
-{ 0, 0, 11, 18, },
-{ 0, 0, 10, 18, },
-{ 0, 0, 26, 18, },
-{ 0, 1, 26, 19, },
-{ 0, 1, 11, 19, },
-{ 0, 0, 9, 19, },
-{ 0, 0, 8, 18, },
-{ 0, 0, 8, 18, },
-{ 0, 0, 13, 18, },
-{ 0, 1, 15, 18, },
-{ 0, 0, 8, 18, },
-{ 0, 0, 8, 16, },
-{ 0, 0, 9, 16, },
-{ 0, 0, 8, 16, },
-{ 0, 0, 11, 16, },
-{ 0, 1, 16, 15, },
-{ 0, 1, 10, 14, },
-{ 0, 0, 9, 14, },
-{ 0, 0, 10, 14, },
-{ 0, 0, 9, 14, },
-{ 0, 0, 9, 14, },
-{ 0, 0, 10, 15, },
-{ 0, 0, 10, 17, },
-{ 0, 0, 11, 17, },
-{ 0, 0, 12, 16, },
-{ 0, 0, 13, 15, },
-{ 0, 0, 13, 16, },
-{ 0, 3, 11, 14, },
-{ 1, 4, 11, 12, },
-{ 2, 3, 12, 13, },
-{ 3, 2, 14, 12, },
-{ 3, 2, 12, 11, },
-{ 3, 2, 10, 9, },
-{ 3, 2, 8, 7, },
-{ 3, 2, 8, 7, },
-{ 3, 2, 8, 6, },
-{ 3, 2, 9, 6, },
-{ 3, 2, 10, 6, },
-{ 3, 2, 10, 7, },
-{ 3, 2, 8, 6, },
-{ 3, 2, 7, 6, },
-{ 3, 2, 9, 5, },
-{ 3, 2, 9, 6, },
-{ 3, 2, 10, 6, },
-{ 3, 2, 10, 7, },
-{ 3, 2, 13, 8, },
-{ 3, 2, 18, 11, },
-{ 3, 2, 18, 12, },
-{ 3, 2, 17, 11, },
-{ 3, 3, 17, 11, },
-{ 3, 3, 18, 11, },
-{ 3, 3, 18, 8, },
-{ 3, 3, 14, 5, },
-{ 3, 3, 15, 6, },
-{ 3, 3, 14, 6, },
-{ 2, 3, 13, 8, },
-{ 2, 3, 13, 9, },
-{ 2, 2, 11, 10, },
-{ 2, 2, 15, 12, },
-{ 2, 2, 17, 13, },
-{ 2, 2, 14, 11, },
-{ 2, 2, 14, 11, },
-{ 2, 2, 17, 12, },
-{ 2, 2, 15, 13, },
-{ 2, 2, 15, 10, },
-{ 2, 2, 14, 8, },
-{ 2, 2, 12, 9, },
-{ 2, 2, 12, 10, },
-{ 2, 2, 14, 11, },
-{ 2, 2, 16, 12, },
-{ 2, 2, 18, 10, },
-{ 1, 3, 20, 10, },
-{ 2, 3, 18, 12, },
-{ 1, 3, 17, 13, },
-{ 2, 3, 20, 13, },
-{ 2, 3, 20, 13, },
-{ 2, 3, 17, 11, },
-{ 2, 4, 12, 10, },
-{ 2, 3, 12, 11, },
-{ 3, 3, 13, 10, },
-{ 3, 3, 13, 10, },
-{ 3, 3, 13, 9, },
-{ 3, 3, 13, 9, },
-{ 3, 3, 17, 10, },
-{ 3, 3, 21, 10, },
-{ 3, 3, 16, 11, },
-{ 3, 3, 13, 10, },
-{ 3, 3, 11, 8, },
-{ 3, 3, 10, 9, },
-{ 3, 3, 8, 10, },
-{ 3, 3, 7, 8, },
-{ 3, 3, 7, 8, },
-{ 2, 3, 12, 8, },
-{ 2, 2, 16, 11, },
-{ 2, 2, 18, 14, },
-{ 2, 2, 20, 17, },
-{ 2, 2, 19, 18, },
-{ 2, 3, 23, 19, },
-{ 2, 3, 22, 18, },
-{ 2, 3, 18, 15, },
-{ 2, 3, 16, 14, },
-{ 2, 3, 15, 13, },
-{ 2, 3, 15, 12, },
-{ 2, 3, 13, 10, },
-{ 2, 3, 10, 10, },
-{ 2, 3, 9, 10, },
-{ 2, 3, 10, 11, },
-{ 2, 3, 10, 12, },
-{ 2, 3, 10, 14, },
-{ 1, 3, 12, 15, },
-{ 1, 3, 17, 17, },
-{ 1, 2, 21, 16, },
-{ 1, 2, 18, 16, },
-{ 1, 2, 13, 15, },
-{ 1, 2, 11, 13, },
-{ 1, 2, 12, 13, },
-{ 1, 2, 11, 14, },
-{ 1, 2, 11, 14, },
-{ 1, 3, 12, 16, },
-{ 1, 3, 11, 17, },
-{ 1, 3, 13, 19, },
-{ 1, 4, 14, 20, },
-{ 1, 4, 13, 20, },
-{ 1, 4, 13, 24, },
-{ 1, 4, 14, 25, },
-{ 1, 3, 13, 22, },
-{ 1, 3, 12, 17, },
-{ 1, 4, 12, 17, },
-{ 2, 5, 10, 19, },
-{ 3, 4, 9, 20, },
-{ 3, 4, 10, 21, },
-{ 3, 3, 13, 22, },
-{ 3, 3, 15, 19, },
-{ 3, 3, 16, 18, },
-{ 3, 3, 15, 19, },
-{ 3, 3, 13, 18, },
-{ 3, 3, 15, 18, },
-{ 3, 3, 18, 20, },
-{ 3, 3, 17, 23, },
-{ 3, 3, 11, 21, },
-{ 3, 3, 9, 21, },
-{ 3, 3, 10, 21, },
-{ 3, 3, 10, 19, },
-{ 3, 3, 10, 19, },
-{ 3, 3, 11, 18, },
-{ 3, 4, 11, 18, },
-{ 3, 4, 13, 21, },
-{ 3, 5, 14, 22, },
-{ 3, 5, 13, 20, },
-{ 2, 5, 11, 19, },
-{ 2, 5, 11, 20, },
-{ 2, 5, 11, 19, },
-{ 2, 5, 10, 19, },
-{ 2, 5, 10, 19, },
-{ 2, 5, 13, 20, },
-{ 2, 4, 14, 21, },
-{ 2, 4, 12, 22, },
-{ 2, 4, 13, 23, },
-{ 2, 4, 14, 22, },
-{ 2, 4, 14, 21, },
-{ 2, 4, 15, 22, },
-{ 2, 4, 16, 23, },
-{ 2, 4, 17, 23, },
-{ 2, 4, 17, 23, },
-{ 2, 4, 13, 21, },
-{ 2, 4, 11, 22, },
-{ 2, 4, 12, 24, },
-{ 2, 4, 10, 24, },
-{ 2, 4, 9, 25, },
-{ 2, 4, 10, 25, },
-{ 2, 4, 12, 27, },
-{ 2, 4, 12, 30, },
-{ 2, 4, 12, 33, },
-{ 2, 4, 14, 31, },
-{ 2, 4, 16, 29, },
-{ 2, 4, 15, 30, },
-{ 2, 4, 13, 29, },
-{ 2, 4, 12, 32, },
-{ 2, 4, 13, 31, },
-{ 2, 4, 11, 29, },
-{ 2, 4, 12, 28, },
-{ 2, 4, 11, 27, },
-{ 2, 4, 11, 25, },
-{ 2, 4, 15, 23, },
-{ 2, 4, 17, 25, },
-{ 2, 4, 18, 25, },
-{ 2, 4, 18, 24, },
-{ 2, 4, 17, 26, },
-{ 2, 4, 15, 24, },
-{ 2, 4, 14, 23, },
-{ 2, 4, 14, 24, },
-{ 1, 5, 14, 27, },
-{ 1, 5, 16, 27, },
-{ 1, 4, 18, 25, },
-{ 1, 4, 16, 26, },
-{ 1, 3, 16, 25, },
-{ 1, 3, 17, 26, },
-{ 1, 3, 18, 24, },
-{ 1, 2, 18, 25, },
-{ 1, 2, 17, 27, },
-{ 1, 2, 15, 24, },
-{ 1, 2, 14, 23, },
-{ 1, 2, 16, 23, },
-{ 1, 2, 15, 24, },
-{ 1, 2, 14, 24, },
-{ 1, 3, 13, 24, },
-{ 1, 3, 14, 23, },
-{ 1, 3, 15, 23, },
-{ 1, 3, 16, 22, },
-{ 1, 3, 18, 23, },
-{ 1, 3, 18, 25, },
-{ 1, 3, 18, 32, },
-{ 1, 4, 18, 29, },
-{ 1, 4, 16, 22, },
-{ 1, 4, 18, 20, },
-{ 1, 3, 17, 20, },
-{ 1, 3, 15, 20, },
-{ 1, 2, 16, 18, },
-{ 1, 2, 16, 17, },
-{ 1, 2, 16, 17, },
-{ 1, 2, 19, 17, },
-{ 1, 2, 22, 17, },
-{ 1, 2, 24, 18, },
-{ 1, 2, 22, 18, },
-{ 1, 2, 21, 17, },
-{ 1, 2, 20, 16, },
-{ 1, 4, 18, 15, },
-{ 1, 4, 16, 14, },
-{ 3, 3, 15, 15, },
-{ 3, 2, 16, 16, },
-{ 3, 2, 17, 17, },
-{ 3, 3, 15, 17, },
-{ 3, 3, 17, 18, },
-{ 3, 2, 18, 17, },
-{ 3, 2, 19, 16, },
-{ 3, 3, 22, 15, },
-{ 3, 2, 23, 16, },
-{ 3, 2, 22, 20, },
-{ 3, 2, 22, 18, },
-{ 3, 2, 22, 16, },
-{ 3, 2, 21, 15, },
-{ 3, 2, 22, 17, },
-{ 3, 2, 23, 17, },
-{ 3, 2, 20, 16, },
-{ 3, 2, 20, 17, },
-{ 3, 2, 25, 17, },
-{ 3, 2, 29, 16, },
-{ 3, 3, 29, 15, },
-{ 3, 3, 27, 14, },
-{ 3, 3, 25, 15, },
-{ 3, 3, 26, 15, },
-{ 3, 3, 27, 13, },
-{ 3, 3, 27, 13, },
-{ 2, 3, 27, 13, },
-{ 2, 2, 27, 14, },
-{ 2, 2, 28, 13, },
-{ 2, 2, 26, 13, },
-{ 2, 2, 32, 16, },
-{ 2, 2, 33, 15, },
-{ 2, 2, 31, 13, },
-{ 2, 2, 25, 13, },
-{ 2, 2, 27, 15, },
-{ 2, 2, 28, 16, },
-{ 2, 2, 27, 13, },
-{ 2, 2, 25, 11, },
-{ 2, 2, 23, 11, },
-{ 2, 2, 22, 12, },
-{ 2, 2, 23, 11, },
-{ 2, 3, 25, 11, },
-{ 2, 3, 23, 14, },
-{ 2, 3, 22, 14, },
-{ 2, 3, 25, 15, },
-{ 2, 3, 27, 15, },
-{ 2, 3, 24, 14, },
-{ 2, 3, 23, 12, },
-{ 2, 4, 22, 10, },
-{ 2, 4, 20, 9, },
-{ 2, 3, 20, 9, },
-{ 3, 3, 18, 8, },
-{ 3, 3, 18, 8, },
-{ 3, 3, 19, 8, },
-{ 3, 3, 19, 9, },
-{ 3, 3, 21, 9, },
-{ 3, 3, 22, 9, },
-{ 3, 3, 23, 10, },
-{ 3, 3, 23, 11, },
-{ 3, 3, 22, 11, },
-{ 3, 3, 19, 11, },
-{ 3, 3, 18, 10, },
-{ 3, 3, 18, 9, },
-{ 3, 3, 20, 11, },
-{ 2, 3, 22, 14, },
-{ 2, 2, 20, 13, },
-{ 2, 2, 19, 11, },
-{ 2, 2, 21, 11, },
-{ 2, 2, 23, 13, },
-{ 2, 3, 20, 12, },
-{ 2, 3, 19, 10, },
-{ 2, 3, 20, 10, },
-{ 2, 3, 20, 9, },
-{ 2, 3, 19, 9, },
-{ 2, 3, 19, 10, },
-{ 2, 3, 18, 9, },
-{ 2, 3, 18, 7, },
-{ 2, 3, 19, 7, },
-{ 2, 3, 19, 7, },
-{ 2, 3, 19, 9, },
-{ 2, 3, 21, 10, },
-{ 2, 3, 21, 9, },
-{ 1, 3, 20, 8, },
-{ 1, 2, 19, 7, },
-{ 1, 2, 16, 6, },
-{ 1, 2, 15, 6, },
-{ 1, 2, 16, 6, },
-{ 1, 2, 16, 5, },
-{ 1, 2, 16, 5, },
-{ 1, 3, 20, 7, },
-{ 1, 3, 24, 10, },
-{ 1, 3, 25, 13, },
-{ 1, 4, 23, 12, },
-{ 1, 4, 24, 12, },
-{ 1, 4, 23, 10, },
-{ 1, 4, 23, 8, },
-{ 1, 3, 21, 8, },
-{ 1, 3, 17, 7, },
-{ 1, 3, 16, 5, },
-{ 1, 5, 16, 5, },
-{ 3, 5, 16, 5, },
-{ 3, 4, 19, 6, },
-{ 3, 4, 19, 7, },
-{ 3, 4, 18, 7, },
-{ 3, 3, 18, 7, },
-{ 3, 3, 22, 7, },
-{ 3, 3, 21, 6, },
-{ 3, 3, 21, 6, },
-{ 3, 3, 20, 7, },
-{ 3, 3, 19, 6, },
-{ 3, 3, 19, 6, },
-{ 3, 3, 20, 6, },
-{ 3, 3, 19, 7, },
-{ 3, 3, 17, 8, },
-{ 3, 3, 20, 9, },
-{ 3, 3, 19, 8, },
-{ 3, 3, 18, 10, },
-{ 3, 3, 24, 14, },
-{ 3, 4, 26, 11, },
-{ 3, 4, 22, 9, },
-{ 3, 5, 17, 8, },
-{ 2, 5, 16, 8, },
-{ 2, 5, 13, 7, },
-{ 2, 5, 12, 5, },
-{ 2, 5, 11, 4, },
-{ 2, 5, 10, 3, },
-{ 2, 4, 10, 3, },
-{ 2, 4, 11, 4, },
-{ 2, 4, 13, 5, },
-{ 2, 4, 15, 6, },
-{ 2, 4, 14, 6, },
-{ 2, 3, 15, 6, },
-{ 2, 3, 13, 5, },
-{ 2, 3, 13, 4, },
-{ 1, 3, 11, 4, },
-{ 1, 3, 10, 4, },
-{ 1, 3, 10, 4, },
-{ 1, 3, 11, 4, },
-{ 1, 3, 11, 4, },
-{ 1, 4, 11, 5, },
-{ 1, 4, 11, 6, },
-{ 1, 3, 13, 5, },
-{ 1, 3, 14, 7, },
-{ 1, 3, 13, 6, },
-{ 1, 3, 9, 4, },
-{ 1, 3, 8, 3, },
-{ 1, 3, 8, 2, },
-{ 1, 3, 7, 2, },
-{ 1, 3, 5, 2, },
-{ 1, 3, 5, 2, },
-{ 1, 3, 5, 2, },
-{ 1, 2, 6, 2, },
-{ 1, 3, 7, 2, },
-{ 1, 2, 6, 2, },
-{ 1, 2, 6, 2, },
-{ 1, 2, 7, 2, },
-{ 1, 2, 8, 2, },
-{ 1, 2, 6, 2, },
-{ 1, 2, 6, 2, },
-{ 1, 2, 7, 1, },
-{ 1, 2, 5, 1, },
-{ 1, 2, 5, 1, },
-{ 0, 2, 5, 1, },
-{ 0, 2, 4, 1, },
-{ 0, 2, 4, 1, },
-{ 0, 2, 5, 1, },
-{ 0, 1, 4, 1, },
-{ 0, 1, 4, 1, },
-{ 0, 1, 4, 1, },
-{ 0, 1, 5, 1, },
-{ 0, 1, 4, 1, },
-{ 0, 1, 4, 1, },
-{ 0, 0, 3, 1, },
-{ 0, 0, 3, 0, },
-{ 0, 0, 2, 0, },
-{ 0, 0, 2, 0, },
-{ 0, 0, 2, 0, },
-{ 0, 0, 2, 0, },
-{ 0, 0, 2, 0, },
-{ 0, 0, 2, 0, },
-{ 0, 0, 1, 0, },
-{ 0, 0, 1, 0, },
-{ 0, 0, 1, 0, },
-{ 0, 0, 1, 0, },
-{ 0, 0, 1, 0, },
-{ 0, 0, 1, 0, },
-{ 0, 0, 0, 0, },
-{ 0, 0, 0, 0, },
-{ 0, 0, 0, 0, },
-{ 0, 0, 0, 0, },
-{ 0, 0, 0, 0, },
-{ 0, 0, 0, 0, },
-{ 0, 0, 0, 0, },
-{ 0, 0, 0, 0, },
-{ 0, 0, 0, 0, },
-};
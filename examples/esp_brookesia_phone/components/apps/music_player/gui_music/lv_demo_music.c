@@ -12,6 +12,7 @@
 
 #include "lv_demo_music_main.h"
 #include "lv_demo_music_list.h"
+#include "music_player/app_library.h"
 
 /*********************
  *      DEFINES
@@ -34,69 +35,13 @@
 static lv_obj_t * ctrl;
 static lv_obj_t * list;
 
-static const char * title_list[] = {
-    "Why now?",
-    "Never Look Back",
-    "It happened Yesterday",
-    "Feeling so High",
-    "Go Deeper",
-    "Find You There",
-    "Until the End",
-    "Unknown",
-    "Unknown",
-    "Unknown",
-    "Unknown",
-};
-
-static const char * artist_list[] = {
-    "Unknown artist",
-    "Unknown artist",
-    "Unknown artist",
-    "Unknown artist",
-    "Unknown artist",
-    "Unknown artist",
-    "Unknown artist",
-    "Unknown artist",
-    "Unknown artist",
-    "Unknown artist",
-    "Unknown artist",
-};
-
-static const char * genre_list[] = {
-    "Metal - 2015",
-    "Metal - 2015",
-    "Metal - 2015",
-    "Metal - 2015",
-    "Metal - 2015",
-    "Metal - 2015",
-    "Metal - 2015",
-    "Metal - 2015",
-    "Metal - 2015",
-    "Metal - 2015",
-    "Metal - 2015",
-};
-
-static const uint32_t time_list[] = {
-    1 * 60 + 14,
-    2 * 60 + 26,
-    1 * 60 + 54,
-    2 * 60 + 24,
-    2 * 60 + 37,
-    3 * 60 + 33,
-    1 * 60 + 56,
-    3 * 60 + 31,
-    2 * 60 + 20,
-    2 * 60 + 19,
-    2 * 60 + 20,
-};
-
 #if APP_DEMO_MUSIC_AUTO_PLAY
     static lv_timer_t * auto_step_timer;
 #endif
 
 static lv_color_t original_screen_bg_color;
 
-static uint32_t active_track_cnt = 5;
+static uint32_t active_track_cnt = 0;
 static file_iterator_instance_t *_file_iterator = NULL;
 static const char * artist_list_name = "Unknown Artist";
 static const char * genre_list_name = "Unknown Genre";
@@ -143,31 +88,31 @@ void lv_demo_music_close(void)
     lv_obj_set_style_bg_color(lv_scr_act(), original_screen_bg_color, 0);
 }
 
+uint32_t _lv_demo_music_get_track_count(void)
+{
+    return active_track_cnt;
+}
+
 const char * _lv_demo_music_get_title(uint32_t track_id)
 {
-    if (_file_iterator == NULL) {
+    if (_file_iterator == NULL || track_id >= active_track_cnt) {
         return NULL;
     }
 
-    if (track_id < active_track_cnt) {
-        return file_iterator_get_name_from_index(_file_iterator, track_id);
-    } else if (track_id < active_track_cnt + sizeof(title_list) / sizeof(title_list[0])) {
-        return title_list[track_id - active_track_cnt];
+    /*The file name until the library has read the tags*/
+    const app_library_track_t * track = app_library_get(track_id);
+    if (track && track->title[0]) {
+        return track->title;
     }
 
-    return NULL;
+    return file_iterator_get_name_from_index(_file_iterator, track_id);
 }
 
 const char * _lv_demo_music_get_artist(uint32_t track_id)
 {
-    if (_file_iterator == NULL) {
-        return artist_list_name;
-    }
-
-    if (track_id < active_track_cnt) {
-        return artist_list_name;
-    } else if (track_id < active_track_cnt + sizeof(artist_list) / sizeof(artist_list[0])) {
-        return artist_list[track_id - active_track_cnt];
+    const app_library_track_t * track = app_library_get(track_id);
+    if (track && track->artist[0]) {
+        return track->artist;
     }
 
     return artist_list_name;
@@ -175,14 +120,9 @@ const char * _lv_demo_music_get_artist(uint32_t track_id)
 
 const char * _lv_demo_music_get_genre(uint32_t track_id)
 {
-    if (_file_iterator == NULL) {
-        return genre_list_name;
-    }
-
-    if (track_id < active_track_cnt) {
-    return genre_list_name;
-    } else if (track_id < active_track_cnt + sizeof(genre_list) / sizeof(genre_list[0])) {
-        return genre_list[track_id - active_track_cnt];
+    const app_library_track_t * track = app_library_get(track_id);
+    if (track && track->genre[0]) {
+        return track->genre;
     }
 
     return genre_list_name;
@@ -190,14 +130,9 @@ const char * _lv_demo_music_get_genre(uint32_t track_id)
 
 uint32_t _lv_demo_music_get_track_length(uint32_t track_id)
 {
-    if (_file_iterator == NULL) {
-        return time_list_num;
-    }
-
-    if (track_id < active_track_cnt) {
-    return time_list_num;
-    } else if (track_id < active_track_cnt + sizeof(time_list) / sizeof(time_list[0])) {
-        return time_list[track_id - active_track_cnt];
+    const app_library_track_t * track = app_library_get(track_id);
+    if (track && track->duration_s) {
+        return track->duration_s;
     }
 
     return time_list_num;
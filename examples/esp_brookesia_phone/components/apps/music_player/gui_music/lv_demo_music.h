@@ -46,6 +46,7 @@ const char * _lv_demo_music_get_title(uint32_t track_id);
 const char * _lv_demo_music_get_artist(uint32_t track_id);
 const char * _lv_demo_music_get_genre(uint32_t track_id);
 uint32_t _lv_demo_music_get_track_length(uint32_t track_id);
+uint32_t _lv_demo_music_get_track_count(void);
 
 /**********************
  *      MACROS
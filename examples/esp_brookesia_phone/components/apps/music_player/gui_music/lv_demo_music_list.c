@@ -16,6 +16,8 @@
 /*********************
  *      DEFINES
  *********************/
+#define LIST_FILL_BATCH     16      /*Buttons created at once, the list opens at once with thousands of tracks*/
+#define LIST_FILL_PERIOD    20
 
 /**********************
  *      TYPEDEFS
@@ -26,6 +28,8 @@
  **********************/
 static lv_obj_t * add_list_btn(lv_obj_t * parent, uint32_t track_id);
 static void btn_click_event_cb(lv_event_t * e);
+static void list_fill(uint32_t cnt);
+static void list_fill_timer_cb(lv_timer_t * t);
 
 /**********************
  *  STATIC VARIABLES
@@ -41,6 +45,11 @@ static lv_style_t style_btn_dis;
 static lv_style_t style_title;
 static lv_style_t style_artist;
 static lv_style_t style_time;
+static lv_timer_t * list_fill_timer;
+static uint32_t list_fill_id;           /*Next track to get a button*/
+static uint32_t list_fill_start;
+static bool list_checked;
+static uint32_t list_checked_id;        /*Checked before its button was created*/
 LV_IMG_DECLARE(img_lv_demo_music_btn_list_play);
 LV_IMG_DECLARE(img_lv_demo_music_btn_list_pause);
 
@@ -118,10 +127,16 @@ lv_obj_t * _lv_demo_music_list_create(lv_obj_t * parent)
     lv_obj_add_style(list, &style_scrollbar, LV_PART_SCROLLBAR);
     lv_obj_set_flex_flow(list, LV_FLEX_FLOW_COLUMN);
 
-    uint32_t track_id;
-    for(track_id = 0; _lv_demo_music_get_title(track_id); track_id++) {
-        add_list_btn(list,  track_id);
+    /*The other buttons are added in the background*/
+    list_fill_start = lv_tick_get();
+    list_fill_id = 0;
+    list_checked = false;
+    list_fill(LIST_FILL_BATCH);
+    if(list_fill_id < _lv_demo_music_get_track_count()) {
+        list_fill_timer = lv_timer_create(list_fill_timer_cb, LIST_FILL_PERIOD, NULL);
     }
+    LV_LOG_USER("list: %"LV_PRIu32" of %"LV_PRIu32" tracks in %"LV_PRIu32" ms", list_fill_id,
+                _lv_demo_music_get_track_count(), lv_tick_elaps(list_fill_start));
 
 #if APP_DEMO_MUSIC_SQUARE || APP_DEMO_MUSIC_ROUND
     lv_obj_set_scroll_snap_y(list, LV_SCROLL_SNAP_CENTER);
@@ -134,6 +149,10 @@ lv_obj_t * _lv_demo_music_list_create(lv_obj_t * parent)
 
 void _lv_demo_music_list_close(void)
 {
+    if(list_fill_timer) {
+        lv_timer_del(list_fill_timer);
+        list_fill_timer = NULL;
+    }
     lv_style_reset(&style_scrollbar);
     lv_style_reset(&style_btn);
     lv_style_reset(&style_btn_pr);
@@ -146,7 +165,16 @@ void _lv_demo_music_list_close(void)
 
 void _lv_demo_music_list_btn_check(uint32_t track_id, bool state)
 {
+    if(state) {
+        list_checked = true;
+        list_checked_id = track_id;
+    }
+    else if(list_checked_id == track_id) {
+        list_checked = false;
+    }
+
     lv_obj_t * btn = lv_obj_get_child(list, track_id);
+    if(btn == NULL) return;
     lv_obj_t * icon = lv_obj_get_child(btn, 0);
 
     if(state) {
@@ -186,10 +214,6 @@ static lv_obj_t * add_list_btn(lv_obj_t * parent, uint32_t track_id)
     lv_obj_add_style(btn, &style_btn_dis, LV_STATE_DISABLED);
     lv_obj_add_event_cb(btn, btn_click_event_cb, LV_EVENT_CLICKED, NULL);
 
-    if(track_id >= ACTIVE_TRACK_CNT) {
-        lv_obj_add_state(btn, LV_STATE_DISABLED);
-    }
-
     lv_obj_t * icon = lv_img_create(btn);
     lv_img_set_src(icon, &img_lv_demo_music_btn_list_play);
     lv_obj_set_grid_cell(icon, LV_GRID_ALIGN_START, 0, 1, LV_GRID_ALIGN_CENTER, 0, 2);
@@ -219,6 +243,28 @@ static lv_obj_t * add_list_btn(lv_obj_t * parent, uint32_t track_id)
     return btn;
 }
 
+static void list_fill(uint32_t cnt)
+{
+    uint32_t track_cnt = _lv_demo_music_get_track_count();
+
+    for(; cnt && list_fill_id < track_cnt; cnt--, list_fill_id++) {
+        add_list_btn(list, list_fill_id);
+        if(list_checked && list_checked_id == list_fill_id) {
+            _lv_demo_music_list_btn_check(list_fill_id, true);
+        }
+    }
+}
+
+static void list_fill_timer_cb(lv_timer_t * t)
+{
+    list_fill(LIST_FILL_BATCH);
+    if(list_fill_id >= _lv_demo_music_get_track_count()) {
+        LV_LOG_USER("list: %"LV_PRIu32" tracks in %"LV_PRIu32" ms", list_fill_id, lv_tick_elaps(list_fill_start));
+        lv_timer_del(t);
+        list_fill_timer = NULL;
+    }
+}
+
 static void btn_click_event_cb(lv_event_t * e)
 {
     lv_obj_t * btn = lv_event_get_target(e);
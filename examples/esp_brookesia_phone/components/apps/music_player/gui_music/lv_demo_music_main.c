@@ -10,14 +10,13 @@
 #if APP_DEMO_MUSIC_ENABLE
 
 #include "lv_demo_music_list.h"
-#include "assets/spectrum_1.h"
-#include "assets/spectrum_2.h"
-#include "assets/spectrum_3.h"
 
 #include "lv_demo_music.h"
 #include "esp_log.h"
 #include "bsp_board_extra.h"
 #include "audio_player.h"
+#include "music_player/app_spectrum.h"
+#include "music_player/app_playlist.h"
 
 /*********************
  *      DEFINES
@@ -54,7 +53,7 @@ static lv_obj_t * create_spectrum_obj(lv_obj_t * parent);
 static lv_obj_t * create_ctrl_box(lv_obj_t * parent);
 static lv_obj_t * create_handle(lv_obj_t * parent);
 
-static void spectrum_anim_cb(void * a, int32_t v);
+static void spectrum_timer_cb(lv_timer_t * t);
 static void start_anim_cb(void * a, int32_t v);
 static void spectrum_draw_event_cb(lv_event_t * e);
 static lv_obj_t * album_img_create(lv_obj_t * parent);
@@ -65,7 +64,6 @@ static void next_click_event_cb(lv_event_t * e);
 static void timer_cb(lv_timer_t * t);
 static void track_load(uint32_t id);
 static void stop_start_anim_timer_cb(lv_timer_t * t);
-static void spectrum_end_cb(lv_anim_t * a);
 static void album_fade_anim_cb(void * var, int32_t v);
 static int32_t get_cos(int32_t deg, int32_t a);
 static int32_t get_sin(int32_t deg, int32_t a);
@@ -89,6 +87,7 @@ static uint32_t bar_rot = 0;
 static uint32_t time_act;
 static lv_timer_t  * sec_counter_timer;
 static lv_timer_t * stop_start_anim_timer;
+static lv_timer_t * spectrum_timer;
 static const lv_font_t * font_small;
 static const lv_font_t * font_large;
 static uint32_t track_id;
@@ -96,8 +95,8 @@ static bool playing;
 static bool start_anim;
 static lv_coord_t start_anim_values[40];
 static lv_obj_t * play_obj;
-static const uint16_t (* spectrum)[4];
-static uint32_t spectrum_len;
+static uint16_t spectrum[APP_SPECTRUM_BAND_NUM];    /*Band levels of the audio being played*/
+static uint32_t playlist_advances;    /*Tracks the playlist started on its own, followed by the UI*/
 static const uint16_t rnd_array[30] = {994, 285, 553, 11, 792, 707, 966, 641, 852, 827, 44, 352, 146, 581, 490, 80, 729, 58, 695, 940, 724, 561, 124, 653, 27, 292, 557, 506, 382, 199};
 
 static file_iterator_instance_t *file_iterator;
@@ -143,7 +142,8 @@ lv_obj_t * _lv_demo_music_main_create(lv_obj_t * parent, file_iterator_instance_
     time_act = 0;
     track_id = 0;
     start_anim = false;
-    spectrum_len = 0;
+    playlist_advances = 0;
+    lv_memset_00(spectrum, sizeof(spectrum));
 
 #if APP_DEMO_MUSIC_LARGE
     font_small = &lv_font_montserrat_22;
@@ -249,6 +249,10 @@ lv_obj_t * _lv_demo_music_main_create(lv_obj_t * parent, file_iterator_instance_
     sec_counter_timer = lv_timer_create(timer_cb, 1000, NULL);
     lv_timer_pause(sec_counter_timer);
 
+    /*Follow the played audio once per frame*/
+    spectrum_timer = lv_timer_create(spectrum_timer_cb, APP_SPECTRUM_FRAME_MS, spectrum_obj);
+    lv_timer_pause(spectrum_timer);
+
     /*Animate in the content after the intro time*/
     lv_anim_t a;
 
@@ -318,20 +322,26 @@ void _lv_demo_music_main_close(void)
 {
     if(stop_start_anim_timer) lv_timer_del(stop_start_anim_timer);
     lv_timer_del(sec_counter_timer);
+    lv_timer_del(spectrum_timer);
 }
 
 void _lv_demo_music_album_next(bool next)
 {
     uint32_t id = track_id;
+    uint32_t track_cnt = _lv_demo_music_get_track_count();
+
+    if (track_cnt == 0) {
+        return;
+    }
 
     if (next) {
         id++;
-        if (id >= ACTIVE_TRACK_CNT) {
+        if (id >= track_cnt) {
             id = 0;
     }
     } else {
         if (id == 0) {
-            id = ACTIVE_TRACK_CNT - 1;
+            id = track_cnt - 1;
         } else {
             id--;
         }
@@ -362,18 +372,9 @@ void _lv_demo_music_play(uint32_t id)
 void _lv_demo_music_resume(void)
 {
     spectrum_i = spectrum_i_pause;
-    LV_LOG_USER("resume, [%d-%d]", spectrum_i, spectrum_len);
-
-    lv_anim_t a;
-    lv_anim_init(&a);
-    lv_anim_set_values(&a, spectrum_i, spectrum_len - 1);
-    lv_anim_set_exec_cb(&a, spectrum_anim_cb);
-    lv_anim_set_var(&a, spectrum_obj);
-    lv_anim_set_time(&a, ((spectrum_len - spectrum_i) * 1000) / 30);
-    lv_anim_set_playback_time(&a, 0);
-    lv_anim_set_ready_cb(&a, spectrum_end_cb);
-    lv_anim_start(&a);
+    LV_LOG_USER("resume, [%d]", spectrum_i);
 
+    lv_timer_resume(spectrum_timer);
     lv_timer_resume(sec_counter_timer);
     lv_slider_set_range(slider_obj, 0, _lv_demo_music_get_track_length(track_id));
 
@@ -385,7 +386,7 @@ void _lv_demo_music_resume(void)
     } else {
         pause_exit = false;
         LV_LOG_USER("Music is not playing. Start playing.");
-        bsp_extra_player_play_index(file_iterator, track_id);
+        app_playlist_play(track_id);
     }
 
     playing = true;
@@ -400,7 +401,8 @@ void _lv_demo_music_pause(void)
     pause = true;
     spectrum_i_pause = spectrum_i;
     spectrum_i = 0;
-    lv_anim_del(spectrum_obj, spectrum_anim_cb);
+    lv_timer_pause(spectrum_timer);
+    lv_memset_00(spectrum, sizeof(spectrum));
     lv_obj_invalidate(spectrum_obj);
     lv_img_set_zoom(album_img_obj, LV_IMG_ZOOM_NONE);
     lv_timer_pause(sec_counter_timer);
@@ -715,7 +717,7 @@ static void track_load(uint32_t id)
 
     if(id == track_id) return;
     bool next = false;
-    if((track_id + 1) % ACTIVE_TRACK_CNT == id) next = true;
+    if((track_id + 1) % _lv_demo_music_get_track_count() == id) next = true;
 
     _lv_demo_music_list_btn_check(track_id, false);
 
@@ -866,7 +868,7 @@ static void spectrum_draw_event_cb(lv_event_t * e)
 
             /* Add "side bars" with cosine characteristic.*/
             for(f = 0; f < band_w; f++) {
-                uint32_t ampl_main = spectrum[spectrum_i][s];
+                uint32_t ampl_main = spectrum[s];
                 int32_t ampl_mod = get_cos(f * 360 / band_w + 180, 180) + 180;
                 int32_t t = BAR_PER_BAND_CNT * s - band_w / 2 + f;
                 if(t < 0) t = BAR_CNT + t;
@@ -928,21 +930,35 @@ static void spectrum_draw_event_cb(lv_event_t * e)
     }
 }
 
-static void spectrum_anim_cb(void * a, int32_t v)
+static void spectrum_timer_cb(lv_timer_t * t)
 {
-    lv_obj_t * obj = a;
+    lv_obj_t * obj = t->user_data;
+
+    /*The playlist went on to the next track, show it*/
+    app_playlist_stats_t stats;
+    app_playlist_get_stats(&stats);
+    if(stats.advances != playlist_advances) {
+        playlist_advances = stats.advances;
+        int index = app_playlist_get_index();
+        if(playing && index >= 0) {
+            track_load(index);
+            lv_slider_set_range(slider_obj, 0, _lv_demo_music_get_track_length(track_id));
+        }
+    }
+
     if(start_anim) {
         lv_obj_invalidate(obj);
         return;
     }
 
-    spectrum_i = v;
+    spectrum_i++;
+    app_spectrum_get_levels(spectrum);
     lv_obj_invalidate(obj);
 
     static uint32_t bass_cnt = 0;
     static int32_t last_bass = -1000;
     static int32_t dir = 1;
-    if(spectrum[spectrum_i][0] > 12) {
+    if(spectrum[0] > 12) {
         if(spectrum_i - last_bass > 5) {
             bass_cnt++;
             last_bass = spectrum_i;
@@ -953,9 +969,9 @@ static void spectrum_anim_cb(void * a, int32_t v)
             }
         }
     }
-    if(spectrum[spectrum_i][0] < 4) bar_rot += dir;
+    if(spectrum[0] < 4) bar_rot += dir;
 
-    lv_img_set_zoom(album_img_obj, LV_IMG_ZOOM_NONE + spectrum[spectrum_i][0]);
+    lv_img_set_zoom(album_img_obj, LV_IMG_ZOOM_NONE + spectrum[0]);
 }
 
 static void start_anim_cb(void * a, int32_t v)
@@ -977,18 +993,12 @@ static lv_obj_t * album_img_create(lv_obj_t * parent)
     switch(track_id % 3) {
         case 0:
             lv_img_set_src(img, &img_lv_demo_music_cover_1);
-            spectrum = spectrum_1;
-            spectrum_len = sizeof(spectrum_1) / sizeof(spectrum_1[0]);
             break;
         case 1:
             lv_img_set_src(img, &img_lv_demo_music_cover_2);
-            spectrum = spectrum_2;
-            spectrum_len = sizeof(spectrum_2) / sizeof(spectrum_2[0]);
             break;
         default:
             lv_img_set_src(img, &img_lv_demo_music_cover_3);
-            spectrum = spectrum_3;
-            spectrum_len = sizeof(spectrum_3) / sizeof(spectrum_3[0]);
             break;
     }
     lv_img_set_antialias(img, false);
@@ -1041,12 +1051,6 @@ static void timer_cb(lv_timer_t * t)
     lv_slider_set_value(slider_obj, time_act, LV_ANIM_ON);
 }
 
-static void spectrum_end_cb(lv_anim_t * a)
-{
-    LV_UNUSED(a);
-    _lv_demo_music_album_next(true);
-}
-
 static void stop_start_anim_timer_cb(lv_timer_t * t)
 {
     LV_UNUSED(t);
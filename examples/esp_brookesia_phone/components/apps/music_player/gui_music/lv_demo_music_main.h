@@ -20,7 +20,6 @@ extern "C" {
 /*********************
  *      DEFINES
  *********************/
-#define ACTIVE_TRACK_CNT    5
 
 /**********************
  *      TYPEDEFS
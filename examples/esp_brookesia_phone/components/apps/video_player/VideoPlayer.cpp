@@ -10,17 +10,30 @@
 #include "esp_heap_caps.h"
 #include "bsp/esp-bsp.h"
 #include "bsp_board_extra.h"
+#include "bsp_extra_mem_pressure.h"
 #include "esp_lvgl_simple_player/media_src_storage.h"
 #include "esp_lvgl_simple_player/esp_lvgl_simple_player.h"
+#include "app_thumbnail.h"
 #include "VideoPlayer.hpp"
 
 #define APP_SUPPORT_VIDEO_FILE_EXT  ".mjpeg"
 #define APP_BGM_DIR   BSP_SPIFFS_MOUNT_POINT "/music"
-#define APP_MAX_VIDEO_NUM           (15)
 #define APP_VIDEO_FRAME_BUF_SIZE    (720 * 1280 * BSP_LCD_BITS_PER_PIXEL / 8)
 #define APP_CACHE_BUF_SIZE          (64 * 1024)
+#define APP_THUMB_BORDER            (2)
+#define APP_THUMB_TIMER_PERIOD_MS   (100)
 #define APP_BREAKING_NEWS_TEXT      "This example demonstrates the JPEG decoding capability of the ESP32-P4"
 
+#if CONFIG_EXAMPLE_VIDEO_PLAYER_SCALE_FIT
+#define APP_VIDEO_SCALE             ESP_LVGL_SIMPLE_PLAYER_SCALE_FIT
+#elif CONFIG_EXAMPLE_VIDEO_PLAYER_SCALE_FILL
+#define APP_VIDEO_SCALE             ESP_LVGL_SIMPLE_PLAYER_SCALE_FILL
+#elif CONFIG_EXAMPLE_VIDEO_PLAYER_SCALE_STRETCH
+#define APP_VIDEO_SCALE             ESP_LVGL_SIMPLE_PLAYER_SCALE_STRETCH
+#else
+#define APP_VIDEO_SCALE             ESP_LVGL_SIMPLE_PLAYER_SCALE_NONE
+#endif
+
 using namespace std;
 
 static const char *TAG = "AppVideoPlayer";
@@ -33,7 +46,10 @@ AppVideoPlayer::AppVideoPlayer():
     _video_name(NULL),
     img_breaking_news(NULL),
     row_edit(NULL),
-    lbl_breaking_news(NULL)
+    lbl_breaking_news(NULL),
+    _dd_files(NULL),
+    _thumb_timer(NULL),
+    _thumb_num(0)
 {
 }
 
@@ -43,6 +59,8 @@ AppVideoPlayer::~AppVideoPlayer()
 
 bool AppVideoPlayer::run(void)
 {
+    // Idle caches of the other apps, e.g. the detection models, give their PSRAM back to the player buffers
+    bsp_extra_mem_pressure_reclaim(APP_VIDEO_FRAME_BUF_SIZE + APP_CACHE_BUF_SIZE + CONFIG_EXAMPLE_VIDEO_PLAYER_READ_AHEAD_KB * 1024);
     app_show_ui();
 
     return true;
@@ -69,6 +87,18 @@ bool AppVideoPlayer::back(void)
 
 bool AppVideoPlayer::close(void)
 {
+    if (_thumb_timer) {
+        lv_timer_del(_thumb_timer);
+        _thumb_timer = NULL;
+    }
+    for (int i = 0; i < _thumb_num; i++) {
+        if (_thumbs[i].state == THUMB_SHOWN) {
+            app_thumbnail_release(_thumbs[i].path);
+        }
+    }
+    _thumb_num = 0;
+    _dd_files = NULL;
+
     bsp_display_unlock();
     esp_lvgl_simple_player_del();
     bsp_display_lock(100);
@@ -78,6 +108,9 @@ bool AppVideoPlayer::close(void)
 
 bool AppVideoPlayer::init(void)
 {
+    const app_thumbnail_cfg_t thumb_cfg = APP_THUMBNAIL_DEFAULT_CONFIG(BSP_SD_MOUNT_POINT APP_THUMBNAIL_CACHE_NAME);
+    ESP_RETURN_ON_FALSE(app_thumbnail_init(&thumb_cfg) == ESP_OK, false, TAG, "Init thumbnail service failed");
+
     return true;
 }
 
@@ -109,6 +142,7 @@ void AppVideoPlayer::app_show_ui(void)
 
     /* Dropdown files */
     lv_obj_t * dd = lv_dropdown_create(cont_row);
+    _dd_files = dd;
     lv_dropdown_clear_options(dd);
     lv_obj_set_width(dd, BSP_LCD_H_RES / 3);
     for (auto &it : _midea_info_vect) {
@@ -131,16 +165,24 @@ void AppVideoPlayer::app_show_ui(void)
     lv_obj_set_style_text_color(breaking_news_cb, lv_color_white(), 0);
     lv_obj_add_event_cb(breaking_news_cb, breaking_news_changed, LV_EVENT_VALUE_CHANGED, this);
 
+    /* Thumbnails of the files */
+    createThumbnails(cont_col);
+    _thumb_timer = lv_timer_create(thumbnail_timer_cb, APP_THUMB_TIMER_PERIOD_MS, this);
+
     /* Create player */
     snprintf(_video_path, sizeof(_video_path), "%s/%s", BSP_SD_MOUNT_POINT, _video_name);
+    selectThumbnail();
     esp_lvgl_simple_player_cfg_t player_cfg = {
         .video_path = _video_path,
         .screen = cont_col,
         .buff_size = APP_VIDEO_FRAME_BUF_SIZE,
         .cache_buff_size = APP_CACHE_BUF_SIZE,
         .cache_buff_in_psram = true,
+        .read_ahead_size = CONFIG_EXAMPLE_VIDEO_PLAYER_READ_AHEAD_KB * 1024,
         .screen_width = BSP_LCD_H_RES,
         .screen_height = (BSP_LCD_V_RES / 2),
+        .scale = APP_VIDEO_SCALE,
+        .fps = CONFIG_EXAMPLE_VIDEO_PLAYER_FPS,
         .flags = {
             .auto_height = true,
         },
@@ -209,6 +251,7 @@ void AppVideoPlayer::file_changed(lv_event_t * e)
         lv_dropdown_get_selected_str(obj, video_name, sizeof(video_name));
         snprintf(video_path, sizeof(app->_video_path), "%s/%s", BSP_SD_MOUNT_POINT, video_name);
         ESP_LOGI(TAG, "Selected file: %s", video_path);
+        app->selectThumbnail();
 
         for (auto &it : app->_midea_info_vect) {
             if (strcmp(it.video_name.c_str(), video_name) == 0) {
@@ -234,6 +277,104 @@ void AppVideoPlayer::file_changed(lv_event_t * e)
     }
 }
 
+// One box per file, the thumbnails are queued now: the cache file makes this cheap after the first scan of a folder
+void AppVideoPlayer::createThumbnails(lv_obj_t *parent)
+{
+    lv_obj_t *strip = lv_obj_create(parent);
+    lv_obj_set_size(strip, BSP_LCD_H_RES - 20, CONFIG_EXAMPLE_THUMBNAIL_HEIGHT + 2 * APP_THUMB_BORDER + 8);
+    lv_obj_set_flex_flow(strip, LV_FLEX_FLOW_ROW);
+    lv_obj_set_style_pad_all(strip, 4, 0);
+    lv_obj_set_style_pad_column(strip, 8, 0);
+    lv_obj_set_style_bg_color(strip, lv_color_black(), 0);
+    lv_obj_set_style_border_width(strip, 0, 0);
+    lv_obj_set_scroll_dir(strip, LV_DIR_HOR);
+    lv_obj_set_scrollbar_mode(strip, LV_SCROLLBAR_MODE_OFF);
+
+    _thumb_num = 0;
+    for (auto &it : _midea_info_vect) {
+        ThumbSlot_t *slot = &_thumbs[_thumb_num++];
+        snprintf(slot->path, sizeof(slot->path), "%s/%s", BSP_SD_MOUNT_POINT, it.video_name.c_str());
+
+        slot->btn = lv_obj_create(strip);
+        lv_obj_set_size(slot->btn, CONFIG_EXAMPLE_THUMBNAIL_WIDTH + 2 * APP_THUMB_BORDER,
+                        CONFIG_EXAMPLE_THUMBNAIL_HEIGHT + 2 * APP_THUMB_BORDER);
+        lv_obj_set_style_pad_all(slot->btn, 0, 0);
+        lv_obj_set_style_radius(slot->btn, 0, 0);
+        lv_obj_set_style_bg_color(slot->btn, lv_color_make(0x30, 0x30, 0x30), 0);
+        lv_obj_set_style_border_width(slot->btn, APP_THUMB_BORDER, 0);
+        lv_obj_set_style_border_color(slot->btn, lv_color_make(0x30, 0x30, 0x30), 0);
+        lv_obj_set_style_border_color(slot->btn, lv_palette_main(LV_PALETTE_BLUE), LV_STATE_CHECKED);
+        lv_obj_clear_flag(slot->btn, LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_event_cb(slot->btn, thumbnail_clicked, LV_EVENT_CLICKED, this);
+        slot->img = lv_img_create(slot->btn);
+        lv_obj_center(slot->img);
+
+        loadThumbnail(slot);
+    }
+}
+
+// Called with the display lock held
+void AppVideoPlayer::loadThumbnail(ThumbSlot_t *slot)
+{
+    // Set before the request, `thumbnail_ready` may run before it returns
+    slot->state = THUMB_LOADING;
+    esp_err_t err = app_thumbnail_acquire(slot->path, &slot->dsc, thumbnail_ready, slot);
+    if (err == ESP_OK) {
+        lv_img_set_src(slot->img, &slot->dsc);
+        slot->state = THUMB_SHOWN;
+    } else if (err != ESP_ERR_NOT_FINISHED) {
+        slot->state = THUMB_FAILED;
+    }
+}
+
+// Called with the display lock held
+void AppVideoPlayer::selectThumbnail(void)
+{
+    for (int i = 0; i < _thumb_num; i++) {
+        ThumbSlot_t *slot = &_thumbs[i];
+        if (strcmp(slot->path, _video_path) == 0) {
+            lv_obj_add_state(slot->btn, LV_STATE_CHECKED);
+            lv_obj_scroll_to_view(slot->btn, LV_ANIM_ON);
+        } else {
+            lv_obj_clear_state(slot->btn, LV_STATE_CHECKED);
+        }
+    }
+}
+
+// Called from the thumbnail task: the display is left to `thumbnail_timer_cb`, so the task never waits for its lock
+void AppVideoPlayer::thumbnail_ready(const char *path, esp_err_t err, void *user_data)
+{
+    ThumbSlot_t *slot = (ThumbSlot_t *)user_data;
+
+    slot->state = (err == ESP_OK) ? THUMB_READY : THUMB_FAILED;
+}
+
+void AppVideoPlayer::thumbnail_timer_cb(lv_timer_t *timer)
+{
+    AppVideoPlayer *app = static_cast<AppVideoPlayer *>(timer->user_data);
+
+    for (int i = 0; i < app->_thumb_num; i++) {
+        // Acquired and shown, or queued again if it was evicted meanwhile
+        if (app->_thumbs[i].state == THUMB_READY) {
+            app->loadThumbnail(&app->_thumbs[i]);
+        }
+    }
+}
+
+void AppVideoPlayer::thumbnail_clicked(lv_event_t * e)
+{
+    AppVideoPlayer *app = (AppVideoPlayer *)lv_event_get_user_data(e);
+    lv_obj_t *btn = lv_event_get_target(e);
+
+    for (int i = 0; i < app->_thumb_num; i++) {
+        if ((app->_thumbs[i].btn == btn) && app->_dd_files) {
+            lv_dropdown_set_selected(app->_dd_files, i);
+            lv_event_send(app->_dd_files, LV_EVENT_VALUE_CHANGED, NULL);
+            break;
+        }
+    }
+}
+
 void AppVideoPlayer::breaking_news_changed(lv_event_t * e)
 {
     AppVideoPlayer *app = (AppVideoPlayer *)lv_event_get_user_data(e);
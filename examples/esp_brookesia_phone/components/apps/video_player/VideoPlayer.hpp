@@ -5,10 +5,14 @@
  */
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include "lvgl.h"
 #include "esp_brookesia.hpp"
 #include "file_iterator.h"
+#include "app_thumbnail.h"
+
+#define APP_MAX_VIDEO_NUM           (15)
 
 class AppVideoPlayer: public ESP_Brookesia_PhoneApp {
 public:
@@ -29,9 +33,27 @@ private:
         // std::string bgm_path;
     } MideaInfo_t;
 
+    typedef enum {
+        THUMB_LOADING = 0,              // Queued, `thumbnail_ready` moves it on
+        THUMB_READY,                    // Loaded, the thumbnail timer shows it
+        THUMB_SHOWN,                    // Held and shown
+        THUMB_FAILED,
+    } ThumbState_t;
+
+    typedef struct {
+        lv_obj_t *btn;
+        lv_obj_t *img;
+        lv_img_dsc_t dsc;
+        char path[APP_THUMBNAIL_PATH_MAX];
+        std::atomic<uint8_t> state;     // Written by the thumbnail task, the rest by the LVGL task
+    } ThumbSlot_t;
+
     void app_show_ui(void);
     const char *searchDefaultBGM(const char *video_name);
     uint8_t searchMideaFiles(void);
+    void createThumbnails(lv_obj_t *parent);
+    void loadThumbnail(ThumbSlot_t *slot);
+    void selectThumbnail(void);
 
     static void file_changed(lv_event_t * e);
     static void breaking_news_changed(lv_event_t * e);
@@ -39,6 +61,9 @@ private:
     static void edit_event_cb(lv_event_t * e);
     static void save_event_cb(lv_event_t * e);
     static void audio_player_callback(audio_player_cb_ctx_t *ctx);
+    static void thumbnail_ready(const char *path, esp_err_t err, void *user_data);
+    static void thumbnail_timer_cb(lv_timer_t *timer);
+    static void thumbnail_clicked(lv_event_t * e);
 
     char _video_path[64];
     const char *_video_name;
@@ -46,5 +71,9 @@ private:
     lv_obj_t * img_breaking_news;
     lv_obj_t * row_edit;
     lv_obj_t * lbl_breaking_news;
+    lv_obj_t * _dd_files;
+    lv_timer_t * _thumb_timer;
+    ThumbSlot_t _thumbs[APP_MAX_VIDEO_NUM];
+    uint8_t _thumb_num;
     file_iterator_instance_t *_file_iterator;
 };
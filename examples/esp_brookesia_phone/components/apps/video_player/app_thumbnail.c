@@ -0,0 +1,710 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "driver/jpeg_decode.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "camera/app_frame_scaler.h"
+#include "app_thumbnail.h"
+
+#define THUMB_TASK_STACK_SIZE   (6 * 1024)
+#define THUMB_QUEUE_LEN         (64)
+#define THUMB_JPEG_MAX_SIZE     (512 * 1024)    // First frames or pictures bigger than this are not thumbnailed
+#define THUMB_READ_CHUNK        (32 * 1024)
+#define THUMB_FILE_MAGIC        (0x424d4854)    // "THMB"
+#define THUMB_FILE_VERSION      (1)
+#define THUMB_FORGET_TIMEOUT_MS (1000)
+
+#define ALIGN_UP(num, align)    (((num) + ((align) - 1)) & ~((align) - 1))
+
+/*
+ * Cache file layout: a `thumb_file_header_t`, then records of a `thumb_record_t` followed by the pixels of a full
+ * thumbnail box. Records have a fixed size, an outdated one is rewritten in place. A forgotten record has an empty
+ * path, its slot is reused by the next new thumbnail.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t box_width;
+    uint16_t box_height;
+    uint16_t reserved;
+} thumb_file_header_t;
+
+typedef struct {
+    char path[APP_THUMBNAIL_PATH_MAX];
+    uint32_t file_size;                 // Size and modification time of the source when it was decoded
+    int64_t mtime;
+    uint16_t width;
+    uint16_t height;
+    uint32_t reserved;
+} thumb_record_t;
+
+typedef struct {
+    thumb_record_t rec;
+    uint32_t offset;                    // Offset of the record in the cache file
+} disk_entry_t;
+
+/* One entry per path: a thumbnail loaded again is replaced in its entry */
+typedef struct {
+    char path[APP_THUMBNAIL_PATH_MAX];
+    uint8_t *data;                      // One thumbnail box, kept once allocated
+    uint16_t width;
+    uint16_t height;
+    uint32_t ref_count;
+    uint32_t last_use;                  // Value of `use_clock` at the last acquisition
+    bool valid;
+    bool loading;                       // Reserved by the task, not valid yet
+    bool stale;                         // Invalidated while held, reloaded or dropped at the last release
+} mem_entry_t;
+
+typedef struct {
+    char path[APP_THUMBNAIL_PATH_MAX];
+    bool forget;                        // Drop the cache file record instead of loading
+    app_thumbnail_ready_cb_t cb;
+    void *user_data;
+} thumb_job_t;
+
+typedef struct {
+    app_thumbnail_cfg_t cfg;
+    char cache_path[APP_THUMBNAIL_PATH_MAX];
+    size_t box_size;
+    SemaphoreHandle_t lock;
+    QueueHandle_t jobs;
+    jpeg_decoder_handle_t jpeg;
+    uint32_t use_clock;
+    mem_entry_t *mem;
+    // Only used by the task once started
+    uint8_t *scratch;                   // Reload of a held thumbnail, copied into its entry once done
+    disk_entry_t *disk;
+    uint32_t disk_num;
+    uint32_t disk_cap;
+    uint32_t disk_end;
+    bool disk_ok;
+    app_thumbnail_stats_t stats;
+} thumb_service_t;
+
+static const char *TAG = "app_thumbnail";
+
+static const jpeg_decode_cfg_t jpeg_decode_cfg = {
+    .output_format = JPEG_DECODE_OUT_FORMAT_RGB565,
+    .rgb_order = JPEG_DEC_RGB_ELEMENT_ORDER_BGR,
+};
+
+static thumb_service_t *svc = NULL;
+
+static inline size_t thumb_record_size(void)
+{
+    return sizeof(thumb_record_t) + svc->box_size;
+}
+
+// Entry of a path, stale or not. Called with the lock held
+static mem_entry_t *mem_lookup(const char *path)
+{
+    for (int i = 0; i < svc->cfg.mem_entries; i++) {
+        mem_entry_t *entry = &svc->mem[i];
+        if (entry->valid && (strcmp(entry->path, path) == 0)) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static mem_entry_t *mem_find(const char *path)
+{
+    mem_entry_t *entry = mem_lookup(path);
+
+    return (entry && !entry->stale) ? entry : NULL;
+}
+
+static void mem_drop(mem_entry_t *entry)
+{
+    entry->valid = false;
+    entry->stale = false;
+    entry->path[0] = '\0';
+}
+
+// Free slot, or the least recently used thumbnail that nobody holds. Called with the lock held
+static mem_entry_t *mem_reserve(void)
+{
+    mem_entry_t *victim = NULL;
+
+    for (int i = 0; i < svc->cfg.mem_entries; i++) {
+        mem_entry_t *entry = &svc->mem[i];
+        if (entry->loading || (entry->ref_count > 0)) {
+            continue;
+        }
+        if (!entry->valid) {
+            victim = entry;
+            break;
+        }
+        if (!victim || (entry->last_use < victim->last_use)) {
+            victim = entry;
+        }
+    }
+    if (!victim) {
+        return NULL;
+    }
+    if (victim->valid) {
+        svc->stats.evictions++;
+        mem_drop(victim);
+    }
+    if (!victim->data) {
+        victim->data = heap_caps_malloc(svc->box_size, MALLOC_CAP_SPIRAM);
+        if (!victim->data) {
+            return NULL;
+        }
+    }
+    victim->loading = true;
+
+    return victim;
+}
+
+// Called with the lock held
+static void mem_invalidate(const char *path)
+{
+    mem_entry_t *entry = mem_lookup(path);
+
+    if (!entry) {
+        return;
+    }
+    if ((entry->ref_count > 0) || entry->loading) {
+        entry->stale = true;
+    } else {
+        mem_drop(entry);
+    }
+}
+
+static void mem_fill_img(const mem_entry_t *entry, lv_img_dsc_t *img)
+{
+    memset(img, 0, sizeof(lv_img_dsc_t));
+    img->header.cf = LV_IMG_CF_TRUE_COLOR;
+    img->header.w = entry->width;
+    img->header.h = entry->height;
+    img->data_size = entry->width * entry->height * sizeof(uint16_t);
+    img->data = entry->data;
+}
+
+static disk_entry_t *disk_find(const char *path)
+{
+    for (int i = 0; i < svc->disk_num; i++) {
+        if (strcmp(svc->disk[i].rec.path, path) == 0) {
+            return &svc->disk[i];
+        }
+    }
+
+    return NULL;
+}
+
+static esp_err_t disk_index_add(const thumb_record_t *rec, uint32_t offset)
+{
+    if (svc->disk_num == svc->disk_cap) {
+        uint32_t cap = svc->disk_cap ? svc->disk_cap * 2 : 64;
+        disk_entry_t *disk = heap_caps_realloc(svc->disk, cap * sizeof(disk_entry_t), MALLOC_CAP_SPIRAM);
+        ESP_RETURN_ON_FALSE(disk, ESP_ERR_NO_MEM, TAG, "No memory for cache index");
+        svc->disk = disk;
+        svc->disk_cap = cap;
+    }
+    svc->disk[svc->disk_num].rec = *rec;
+    svc->disk[svc->disk_num].offset = offset;
+    svc->disk_num++;
+
+    return ESP_OK;
+}
+
+static esp_err_t disk_create(void)
+{
+    FILE *fp = fopen(svc->cache_path, "wb");
+    ESP_RETURN_ON_FALSE(fp, ESP_FAIL, TAG, "Create %s failed", svc->cache_path);
+
+    thumb_file_header_t header = {
+        .magic = THUMB_FILE_MAGIC,
+        .version = THUMB_FILE_VERSION,
+        .box_width = svc->cfg.width,
+        .box_height = svc->cfg.height,
+    };
+    size_t written = fwrite(&header, sizeof(header), 1, fp);
+    fclose(fp);
+    ESP_RETURN_ON_FALSE(written == 1, ESP_FAIL, TAG, "Write %s failed", svc->cache_path);
+    svc->disk_end = sizeof(header);
+
+    return ESP_OK;
+}
+
+// Index the records of the cache file, a file made for another box size is started again
+static esp_err_t disk_load(void)
+{
+    FILE *fp = fopen(svc->cache_path, "rb");
+    if (!fp) {
+        return disk_create();
+    }
+
+    thumb_file_header_t header = { 0 };
+    if ((fread(&header, sizeof(header), 1, fp) != 1) || (header.magic != THUMB_FILE_MAGIC) ||
+            (header.version != THUMB_FILE_VERSION) || (header.box_width != svc->cfg.width) ||
+            (header.box_height != svc->cfg.height)) {
+        fclose(fp);
+        ESP_LOGW(TAG, "Discard outdated %s", svc->cache_path);
+        return disk_create();
+    }
+
+    esp_err_t ret = ESP_OK;
+    thumb_record_t rec;
+    uint32_t offset = sizeof(header);
+    struct stat st;
+    // A record cut short by a power loss is overwritten by the next one
+    uint32_t file_size = (stat(svc->cache_path, &st) == 0) ? st.st_size : 0;
+    while ((offset + thumb_record_size() <= file_size) && (fseek(fp, offset, SEEK_SET) == 0) &&
+            (fread(&rec, sizeof(rec), 1, fp) == 1)) {
+        rec.path[APP_THUMBNAIL_PATH_MAX - 1] = '\0';
+        ESP_GOTO_ON_ERROR(disk_index_add(&rec, offset), end, TAG, "Index %s failed", svc->cache_path);
+        offset += thumb_record_size();
+    }
+end:
+    fclose(fp);
+    svc->disk_end = offset;
+    ESP_LOGI(TAG, "%s: %" PRIu32 " thumbnails", svc->cache_path, svc->disk_num);
+
+    return ret;
+}
+
+static esp_err_t disk_read(const disk_entry_t *entry, uint8_t *data)
+{
+    FILE *fp = fopen(svc->cache_path, "rb");
+    ESP_RETURN_ON_FALSE(fp, ESP_FAIL, TAG, "Open %s failed", svc->cache_path);
+
+    esp_err_t ret = ESP_OK;
+    size_t size = entry->rec.width * entry->rec.height * sizeof(uint16_t);
+    if ((fseek(fp, entry->offset + sizeof(thumb_record_t), SEEK_SET) != 0) || (fread(data, 1, size, fp) != size)) {
+        ret = ESP_FAIL;
+    }
+    fclose(fp);
+
+    return ret;
+}
+
+static esp_err_t disk_write(const thumb_record_t *rec, const uint8_t *data)
+{
+    disk_entry_t *entry = disk_find(rec->path);
+    if (!entry) {
+        entry = disk_find("");
+    }
+    uint32_t offset = entry ? entry->offset : svc->disk_end;
+
+    FILE *fp = fopen(svc->cache_path, "r+b");
+    ESP_RETURN_ON_FALSE(fp, ESP_FAIL, TAG, "Open %s failed", svc->cache_path);
+
+    // The whole box is written so records keep a fixed size
+    esp_err_t ret = ESP_OK;
+    if ((fseek(fp, offset, SEEK_SET) != 0) || (fwrite(rec, sizeof(thumb_record_t), 1, fp) != 1) ||
+            (fwrite(data, 1, svc->box_size, fp) != svc->box_size)) {
+        ret = ESP_FAIL;
+    }
+    fclose(fp);
+    ESP_RETURN_ON_ERROR(ret, TAG, "Write %s failed", svc->cache_path);
+
+    if (entry) {
+        entry->rec = *rec;
+        return ESP_OK;
+    }
+    svc->disk_end += thumb_record_size();
+
+    return disk_index_add(rec, offset);
+}
+
+// Empty the path of a record, so a new file with the same name never matches it
+static esp_err_t disk_forget(disk_entry_t *entry)
+{
+    FILE *fp = fopen(svc->cache_path, "r+b");
+    ESP_RETURN_ON_FALSE(fp, ESP_FAIL, TAG, "Open %s failed", svc->cache_path);
+
+    esp_err_t ret = ESP_OK;
+    const char empty[sizeof(entry->rec.path)] = { 0 };
+    if ((fseek(fp, entry->offset, SEEK_SET) != 0) || (fwrite(empty, sizeof(empty), 1, fp) != 1)) {
+        ret = ESP_FAIL;
+    }
+    fclose(fp);
+    ESP_RETURN_ON_ERROR(ret, TAG, "Write %s failed", svc->cache_path);
+    entry->rec.path[0] = '\0';
+
+    return ESP_OK;
+}
+
+// Read a JPEG picture, or the first frame of an MJPEG video, into a decoder input buffer
+static esp_err_t thumb_read_jpeg(const char *path, uint8_t **ret_buf, uint32_t *ret_size)
+{
+    FILE *fp = fopen(path, "rb");
+    ESP_RETURN_ON_FALSE(fp, ESP_ERR_NOT_FOUND, TAG, "Open %s failed", path);
+
+    esp_err_t ret = ESP_OK;
+    size_t buf_size = 0;
+    jpeg_decode_memory_alloc_cfg_t mem_cfg = {
+        .buffer_direction = JPEG_DEC_ALLOC_INPUT_BUFFER,
+    };
+    uint8_t *buf = (uint8_t *)jpeg_alloc_decoder_mem(THUMB_JPEG_MAX_SIZE, &mem_cfg, &buf_size);
+    ESP_GOTO_ON_FALSE(buf, ESP_ERR_NO_MEM, err, TAG, "No memory for JPEG input");
+
+    // Byte stuffing keeps FF D9 out of the entropy coded data, the first one after SOI ends the frame
+    uint32_t len = 0;
+    const uint8_t *eoi = NULL;
+    while (!eoi && (len < buf_size)) {
+        size_t n = fread(buf + len, 1, MIN(THUMB_READ_CHUNK, buf_size - len), fp);
+        if (n == 0) {
+            break;
+        }
+        uint32_t from = (len > 2) ? (len - 1) : 2;
+        len += n;
+        if (len > from) {
+            eoi = memmem(buf + from, len - from, "\xff\xd9", 2);
+        }
+    }
+    ESP_GOTO_ON_FALSE((len > 2) && (buf[0] == 0xff) && (buf[1] == 0xd8) && eoi, ESP_ERR_INVALID_SIZE, err, TAG,
+                      "No JPEG picture in the first %zu KB of %s", buf_size / 1024, path);
+    len = eoi + 2 - buf;
+    // The decoder reads the input in 16 bytes bursts
+    memset(buf + len, 0, MIN(ALIGN_UP(len, 16), buf_size) - len);
+    fclose(fp);
+
+    *ret_buf = buf;
+    *ret_size = len;
+
+    return ESP_OK;
+
+err:
+    free(buf);
+    fclose(fp);
+    return ret;
+}
+
+static esp_err_t thumb_decode(const char *path, uint8_t *data, uint16_t *ret_width, uint16_t *ret_height)
+{
+    int64_t start_us = esp_timer_get_time();
+    uint8_t *in_buf = NULL;
+    uint8_t *out_buf = NULL;
+    uint32_t in_size = 0;
+
+    ESP_RETURN_ON_ERROR(thumb_read_jpeg(path, &in_buf, &in_size), TAG, "Read %s failed", path);
+
+    esp_err_t ret = ESP_OK;
+    jpeg_decode_picture_info_t info;
+    ESP_GOTO_ON_ERROR(jpeg_decoder_get_info(in_buf, in_size, &info), end, TAG, "Parse %s failed", path);
+    ESP_GOTO_ON_FALSE((info.width > 0) && (info.height > 0), ESP_ERR_INVALID_SIZE, end, TAG, "Empty picture");
+
+    if (!svc->jpeg) {
+        jpeg_decode_engine_cfg_t engine_cfg = {
+            .intr_priority = 0,
+            .timeout_ms = -1,
+        };
+        ESP_GOTO_ON_ERROR(jpeg_new_decoder_engine(&engine_cfg, &svc->jpeg), end, TAG, "Create JPEG decoder failed");
+    }
+
+    // The decoder writes whole MCUs, and cannot scale: decode at full size, then subsample to the box
+    uint32_t width = ALIGN_UP(info.width, 16);
+    uint32_t height = ALIGN_UP(info.height, 16);
+    size_t out_size = 0;
+    jpeg_decode_memory_alloc_cfg_t mem_cfg = {
+        .buffer_direction = JPEG_DEC_ALLOC_OUTPUT_BUFFER,
+    };
+    out_buf = (uint8_t *)jpeg_alloc_decoder_mem(width * height * sizeof(uint16_t), &mem_cfg, &out_size);
+    ESP_GOTO_ON_FALSE(out_buf, ESP_ERR_NO_MEM, end, TAG, "No memory for %" PRIu32 "x%" PRIu32 " picture",
+                      width, height);
+
+    uint32_t ret_size = 0;
+    ESP_GOTO_ON_ERROR(jpeg_decoder_process(svc->jpeg, &jpeg_decode_cfg, in_buf, ALIGN_UP(in_size, 16), out_buf,
+                                           out_size, &ret_size), end, TAG, "Decode %s failed", path);
+
+    uint32_t thumb_w = svc->cfg.width;
+    uint32_t thumb_h = info.height * svc->cfg.width / info.width;
+    if (thumb_h > svc->cfg.height) {
+        thumb_h = svc->cfg.height;
+        thumb_w = info.width * svc->cfg.height / info.height;
+    }
+    thumb_w = MAX(thumb_w, 1);
+    thumb_h = MAX(thumb_h, 1);
+    // Lines are padded to whole MCUs, only the picture itself is sampled
+    app_frame_scale_rgb565_sw_stride((const uint16_t *)out_buf, width, info.width, info.height,
+                                     (uint16_t *)data, thumb_w, thumb_h, false);
+    *ret_width = thumb_w;
+    *ret_height = thumb_h;
+
+    ESP_LOGD(TAG, "Decode %s: %" PRIu32 "x%" PRIu32 ", %" PRId64 " us", path, thumb_w, thumb_h,
+             esp_timer_get_time() - start_us);
+
+end:
+    free(out_buf);
+    free(in_buf);
+    return ret;
+}
+
+static esp_err_t thumb_load(const char *path)
+{
+    xSemaphoreTake(svc->lock, portMAX_DELAY);
+    mem_entry_t *entry = mem_lookup(path);
+    // Requested again while it was queued
+    if (entry && !entry->stale) {
+        xSemaphoreGive(svc->lock);
+        return ESP_OK;
+    }
+    if (entry) {
+        // Reloaded in its own entry, which is drawn from until the new thumbnail is copied in
+        entry->loading = true;
+    } else {
+        entry = mem_reserve();
+    }
+    xSemaphoreGive(svc->lock);
+    ESP_RETURN_ON_FALSE(entry, ESP_ERR_NO_MEM, TAG, "All thumbnails are held");
+
+    esp_err_t ret = ESP_OK;
+    bool from_disk = false;
+    int64_t start_us = esp_timer_get_time();
+    uint8_t *data = entry->data;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    if (entry->valid) {
+        if (!svc->scratch) {
+            svc->scratch = heap_caps_malloc(svc->box_size, MALLOC_CAP_SPIRAM);
+        }
+        data = svc->scratch;
+        ESP_GOTO_ON_FALSE(data, ESP_ERR_NO_MEM, end, TAG, "No memory for thumbnail reload");
+    }
+    struct stat st;
+    ESP_GOTO_ON_FALSE(stat(path, &st) == 0, ESP_ERR_NOT_FOUND, end, TAG, "Stat %s failed", path);
+
+    // A cached thumbnail is used as long as its source has not changed since it was made
+    disk_entry_t *disk = svc->disk_ok ? disk_find(path) : NULL;
+    if (disk && (disk->rec.file_size == (uint32_t)st.st_size) && (disk->rec.mtime == (int64_t)st.st_mtime) &&
+            (disk_read(disk, data) == ESP_OK)) {
+        width = disk->rec.width;
+        height = disk->rec.height;
+        from_disk = true;
+    } else {
+        ESP_GOTO_ON_ERROR(thumb_decode(path, data, &width, &height), end, TAG, "Thumbnail %s failed", path);
+        if (svc->disk_ok) {
+            thumb_record_t rec = {
+                .file_size = (uint32_t)st.st_size,
+                .mtime = (int64_t)st.st_mtime,
+                .width = width,
+                .height = height,
+            };
+            strlcpy(rec.path, path, sizeof(rec.path));
+            if (disk_write(&rec, data) != ESP_OK) {
+                svc->disk_ok = false;
+                ESP_LOGW(TAG, "Cache file disabled");
+            }
+        }
+    }
+
+end:
+    xSemaphoreTake(svc->lock, portMAX_DELAY);
+    entry->loading = false;
+    if (ret == ESP_OK) {
+        // Holders of a reloaded thumbnail see the new pixels, they are told through the ready callback
+        if (data != entry->data) {
+            memcpy(entry->data, data, svc->box_size);
+        }
+        strlcpy(entry->path, path, sizeof(entry->path));
+        entry->width = width;
+        entry->height = height;
+        entry->valid = true;
+        entry->stale = false;
+        entry->last_use = ++svc->use_clock;
+        if (from_disk) {
+            svc->stats.disk_hits++;
+        } else {
+            svc->stats.decodes++;
+            svc->stats.decode_us += esp_timer_get_time() - start_us;
+        }
+    } else {
+        // A stale thumbnail nobody holds anymore goes, a held one stays stale until its last release
+        if (entry->valid && (entry->ref_count == 0)) {
+            mem_drop(entry);
+        }
+        svc->stats.failures++;
+    }
+    xSemaphoreGive(svc->lock);
+
+    return ret;
+}
+
+// Drop a thumbnail from memory and from the cache file, its file was written again
+static void thumb_forget(const char *path)
+{
+    // A load queued before the write may have brought the old thumbnail back
+    xSemaphoreTake(svc->lock, portMAX_DELAY);
+    mem_invalidate(path);
+    xSemaphoreGive(svc->lock);
+
+    disk_entry_t *disk = svc->disk_ok ? disk_find(path) : NULL;
+    if (disk && (disk_forget(disk) != ESP_OK)) {
+        svc->disk_ok = false;
+        ESP_LOGW(TAG, "Cache file disabled");
+    }
+}
+
+static void thumb_task(void *arg)
+{
+    thumb_job_t job;
+
+    if (svc->cfg.cache_path) {
+        svc->disk_ok = (disk_load() == ESP_OK);
+    }
+
+    while (xQueueReceive(svc->jobs, &job, portMAX_DELAY) == pdTRUE) {
+        if (job.forget) {
+            thumb_forget(job.path);
+            continue;
+        }
+        esp_err_t err = thumb_load(job.path);
+        if (job.cb) {
+            job.cb(job.path, err, job.user_data);
+        }
+
+        // The decoder engine holds an interrupt and DMA channels, only keep it while jobs are queued
+        if (svc->jpeg && (uxQueueMessagesWaiting(svc->jobs) == 0)) {
+            jpeg_del_decoder_engine(svc->jpeg);
+            svc->jpeg = NULL;
+        }
+    }
+
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_thumbnail_init(const app_thumbnail_cfg_t *cfg)
+{
+    ESP_RETURN_ON_FALSE(cfg && (cfg->width > 0) && (cfg->height > 0) && (cfg->mem_entries > 0), ESP_ERR_INVALID_ARG,
+                        TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(!cfg->cache_path || (strlen(cfg->cache_path) < APP_THUMBNAIL_PATH_MAX), ESP_ERR_INVALID_ARG,
+                        TAG, "Cache path too long");
+    if (svc) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_OK;
+    thumb_service_t *service = calloc(1, sizeof(thumb_service_t));
+    ESP_RETURN_ON_FALSE(service, ESP_ERR_NO_MEM, TAG, "No memory for thumbnail service");
+    service->cfg = *cfg;
+    if (cfg->cache_path) {
+        strlcpy(service->cache_path, cfg->cache_path, sizeof(service->cache_path));
+        service->cfg.cache_path = service->cache_path;
+    }
+    service->box_size = cfg->width * cfg->height * sizeof(uint16_t);
+    service->mem = heap_caps_calloc(cfg->mem_entries, sizeof(mem_entry_t), MALLOC_CAP_SPIRAM);
+    service->lock = xSemaphoreCreateMutex();
+    service->jobs = xQueueCreate(THUMB_QUEUE_LEN, sizeof(thumb_job_t));
+    ESP_GOTO_ON_FALSE(service->mem && service->lock && service->jobs, ESP_ERR_NO_MEM, err, TAG,
+                      "No memory for thumbnail service");
+
+    svc = service;
+    ESP_GOTO_ON_FALSE(xTaskCreate(thumb_task, "thumbnail", THUMB_TASK_STACK_SIZE, NULL, cfg->task_priority, NULL) ==
+                      pdPASS, ESP_ERR_NO_MEM, err, TAG, "Create thumbnail task failed");
+
+    return ESP_OK;
+
+err:
+    svc = NULL;
+    if (service->jobs) {
+        vQueueDelete(service->jobs);
+    }
+    if (service->lock) {
+        vSemaphoreDelete(service->lock);
+    }
+    free(service->mem);
+    free(service);
+    return ret;
+}
+
+esp_err_t app_thumbnail_acquire(const char *path, lv_img_dsc_t *img, app_thumbnail_ready_cb_t cb, void *user_data)
+{
+    ESP_RETURN_ON_FALSE(svc, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    ESP_RETURN_ON_FALSE(path && img && (strlen(path) < APP_THUMBNAIL_PATH_MAX), ESP_ERR_INVALID_ARG, TAG,
+                        "Invalid argument");
+
+    xSemaphoreTake(svc->lock, portMAX_DELAY);
+    mem_entry_t *entry = mem_find(path);
+    if (entry) {
+        entry->ref_count++;
+        entry->last_use = ++svc->use_clock;
+        mem_fill_img(entry, img);
+        svc->stats.mem_hits++;
+        xSemaphoreGive(svc->lock);
+        return ESP_OK;
+    }
+    xSemaphoreGive(svc->lock);
+
+    thumb_job_t job = {
+        .cb = cb,
+        .user_data = user_data,
+    };
+    strlcpy(job.path, path, sizeof(job.path));
+    if (xQueueSend(svc->jobs, &job, 0) != pdTRUE) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_ERR_NOT_FINISHED;
+}
+
+void app_thumbnail_release(const char *path)
+{
+    if (!svc || !path) {
+        return;
+    }
+
+    xSemaphoreTake(svc->lock, portMAX_DELAY);
+    mem_entry_t *entry = mem_lookup(path);
+    if (entry && (entry->ref_count > 0)) {
+        entry->ref_count--;
+        // A stale thumbnail being reloaded is kept for the task
+        if ((entry->ref_count == 0) && entry->stale && !entry->loading) {
+            mem_drop(entry);
+        }
+    }
+    xSemaphoreGive(svc->lock);
+}
+
+void app_thumbnail_invalidate(const char *path)
+{
+    if (!svc || !path || (strlen(path) >= APP_THUMBNAIL_PATH_MAX)) {
+        return;
+    }
+
+    xSemaphoreTake(svc->lock, portMAX_DELAY);
+    mem_invalidate(path);
+    xSemaphoreGive(svc->lock);
+
+    // Size and time can't tell the files apart: names repeat after a reboot, and without RTC every file has the same
+    // time. The record is dropped ahead of the queued loads
+    thumb_job_t job = {
+        .forget = true,
+    };
+    strlcpy(job.path, path, sizeof(job.path));
+    if (xQueueSendToFront(svc->jobs, &job, pdMS_TO_TICKS(THUMB_FORGET_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Forget %s failed, queue full", path);
+    }
+}
+
+esp_err_t app_thumbnail_get_stats(app_thumbnail_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(svc, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    xSemaphoreTake(svc->lock, portMAX_DELAY);
+    *stats = svc->stats;
+    xSemaphoreGive(svc->lock);
+
+    return ESP_OK;
+}
@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_THUMBNAIL_PATH_MAX          (64)
+#define APP_THUMBNAIL_TASK_PRIORITY     (1)
+#define APP_THUMBNAIL_CACHE_NAME        "/thumbs.bin"   // In the root of the SD card
+
+#define APP_THUMBNAIL_DEFAULT_CONFIG(path)                      \
+    {                                                           \
+        .cache_path = path,                                     \
+        .width = CONFIG_EXAMPLE_THUMBNAIL_WIDTH,                \
+        .height = CONFIG_EXAMPLE_THUMBNAIL_HEIGHT,              \
+        .mem_entries = CONFIG_EXAMPLE_THUMBNAIL_MEM_ENTRIES,    \
+        .task_priority = APP_THUMBNAIL_TASK_PRIORITY,           \
+    }
+
+/**
+ * @brief Thumbnail service configuration.
+ */
+typedef struct {
+    const char *cache_path;             /*!< Cache file on the SD card, NULL to keep thumbnails in memory only. */
+    uint16_t width;                     /*!< Thumbnail box, pictures are scaled to fit it with their aspect ratio. */
+    uint16_t height;
+    uint32_t mem_entries;               /*!< Thumbnails kept in PSRAM. */
+    uint32_t task_priority;             /*!< Priority of the decoding task. */
+} app_thumbnail_cfg_t;
+
+/**
+ * @brief Statistics of the thumbnail service.
+ */
+typedef struct {
+    uint32_t mem_hits;                  /*!< Acquisitions served from PSRAM. */
+    uint32_t disk_hits;                 /*!< Thumbnails read back from the cache file. */
+    uint32_t decodes;                   /*!< Thumbnails decoded from their picture or video. */
+    uint64_t decode_us;                 /*!< Time spent decoding. */
+    uint32_t evictions;                 /*!< Thumbnails dropped from PSRAM to make room. */
+    uint32_t failures;                  /*!< Files that could not be decoded. */
+} app_thumbnail_stats_t;
+
+/**
+ * @brief Called from the thumbnail task once a requested thumbnail is available, or failed.
+ *
+ * The thumbnail is not held: call `app_thumbnail_acquire` again to get it. LVGL calls need the display lock.
+ */
+typedef void (*app_thumbnail_ready_cb_t)(const char *path, esp_err_t err, void *user_data);
+
+/**
+ * @brief Start the thumbnail service. Calling it again once started does nothing.
+ *
+ * Thumbnails are the first frame of MJPEG videos, or JPEG pictures such as camera screenshots, decoded by the
+ * hardware JPEG decoder on a low priority task.
+ *
+ * @param cfg Service configuration, the cache path is copied.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid configuration, ESP_ERR_NO_MEM if out of memory.
+ */
+esp_err_t app_thumbnail_init(const app_thumbnail_cfg_t *cfg);
+
+/**
+ * @brief Get the thumbnail of a file.
+ *
+ * On success, the image stays valid until `app_thumbnail_release`. Otherwise the thumbnail is loaded in the
+ * background, from the cache file when it is up to date, and `cb` is called.
+ *
+ * @param path Path of the video or picture.
+ * @param img Returned image, RGB565.
+ * @param cb Called when the thumbnail is loaded, may be NULL to only warm the cache.
+ * @param user_data User data passed to `cb`.
+ * @return ESP_OK with `img` filled, ESP_ERR_NOT_FINISHED if queued, ESP_ERR_NO_MEM if the queue is full,
+ *         ESP_ERR_INVALID_ARG / ESP_ERR_INVALID_STATE on invalid argument or service not started.
+ */
+esp_err_t app_thumbnail_acquire(const char *path, lv_img_dsc_t *img, app_thumbnail_ready_cb_t cb, void *user_data);
+
+/**
+ * @brief Release a thumbnail got from `app_thumbnail_acquire`.
+ */
+void app_thumbnail_release(const char *path);
+
+/**
+ * @brief Forget the thumbnail of a file that was just written, it is decoded again on the next request.
+ *
+ * The record in the cache file is dropped too. A held thumbnail stays valid for its holders until it is reloaded.
+ */
+void app_thumbnail_invalidate(const char *path);
+
+/**
+ * @brief Get the statistics of the service.
+ */
+esp_err_t app_thumbnail_get_stats(app_thumbnail_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -12,20 +12,48 @@
 #include "esp_dma_utils.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include <stdatomic.h>
+#include <stdlib.h>
 #include "driver/jpeg_decode.h"
+#include "driver/ppa.h"
 #include "media_src_storage.h"
+#include "mjpeg_index.h"
 #include "bsp/esp-bsp.h"
 #include "bsp_board_extra.h"
 #include "esp_lvgl_simple_player.h"
 
 #define CACHE_BUF_ALIGN         (1024)
+#define SKIP_FRAMES             (150)   /* Frames jumped by the skip buttons */
+#define NO_SEEK                 (-1)
+
+#define IN_BUF_NUM              (3)     /* Compressed frames between the reader and the decoder */
+#define OUT_BUF_NUM             (3)     /* Decoded frames: one on screen, one ready, one being decoded */
+#define NO_BUF                  (0xff)
+#define END_FRAME               (UINT32_MAX)
+#define FRAME_FLAG_SEEK         (1 << 0)    /* First frame after a seek, shown even while paused */
+#define FRAME_FLAG_RESYNC       (1 << 1)    /* Discontinuity (seek, loop): the clock restarts from this frame */
+#define STAGE_WAIT_MS           (50)    /* Stages check the player state at least this often */
+#define STAGE_TASK_STACK_SIZE   (4 * 1024)
+#define READ_TASK_PRIORITY      (4)
+#define READ_AHEAD_BLOCK_SIZE   (64 * 1024) /* Cluster size of the cards formatted by the BSP */
+#define CONTROLS_HEIGHT         (120)   /* Slider and buttons below the video */
+#define BYTES_PER_PIXEL         (2)     /* RGB565 decoder output */
+#define PPA_SCALE_FRAG          (16)    /* The PPA scales in steps of 1/16 */
+#define DECODE_TASK_PRIORITY    (5)
+#define STATS_LOG_PERIOD_US     (5 * 1000 * 1000)
+#define AV_LATE_FRAMES          (1)     /* Decodes are skipped for frames later than this many frame durations */
+#define AV_SKIP_MAX             (4)     /* At most this many skipped decodes in a row, so the picture keeps moving */
+#define AV_EARLY_MAX_US         (1000 * 1000)   /* Frames this early mean the clock jumped back, start over from them */
 
 #define ALIGN_UP(num, align)    (((num) + ((align) - 1)) & ~((align) - 1))
 #define ALIGN_DOWN(num, align)    (((num) - ((align) + 1)) & ~((align) - 1))
 
 static const char *TAG = "esp_lvgl_player";
-static const uint16_t EOI = 0xd9ff; /* End of image */
 static BaseType_t player_task_handle = NULL;
+static portMUX_TYPE clock_lock = portMUX_INITIALIZER_UNLOCKED;
 
 typedef struct
 {
@@ -42,6 +70,11 @@ typedef struct
     uint32_t    video_height;     /* Maximum height of the video  */
 
     player_state_t  state;
+    mjpeg_index_t   index;              /* Owned by the player task */
+    atomic_uint     frame_count;        /* Frames in the index for the other tasks, 0 while it is not loaded */
+    volatile uint32_t frame_pos;        /* Last frame shown */
+    atomic_int      seek_frame;         /* Frame requested by the UI, NO_SEEK if none */
+    atomic_uint     gen;                /* Incremented by the reader for every seek, older frames are dropped */
     bool            loop;
     bool            hide_controls;
     bool            hide_slider;
@@ -50,12 +83,36 @@ typedef struct
     bool            auto_height;
 
     /* Buffers */
-    uint8_t     *in_buff;
+    uint8_t     *in_buffs[IN_BUF_NUM];
     uint32_t    in_buff_size;
-    uint8_t     *out_buff;
+    uint8_t     *out_buffs[OUT_BUF_NUM];
     uint32_t    out_buff_size;
+    uint32_t    out_width;
+    uint32_t    out_height;
+
+    /* Scaling to the player object */
+    esp_lvgl_simple_player_scale_t scale;
+    ppa_client_handle_t     ppa;        /* NULL when the decoder output is shown as is */
+    ppa_srm_oper_config_t   srm_cfg;    /* Set up once per video, only the output buffer changes */
+    uint8_t     *decode_buff;           /* Decoder output at the video size, scaled into the output buffers */
+    uint32_t    decode_buff_size;
+
+    /* Pipeline: read -> decode -> present, buffers go back through the free queues */
+    QueueHandle_t       in_free_queue;
+    QueueHandle_t       in_full_queue;
+    QueueHandle_t       out_free_queue;
+    QueueHandle_t       out_full_queue;
+    SemaphoreHandle_t   stage_exit_sem;
+    esp_lvgl_simple_player_stats_t stats;
+
+    /* Presentation clock, a frame is due when the clock reaches its timestamp. Guarded by `clock_lock` */
+    uint32_t    frame_us;           /* Frame duration from the configured frame rate, 0 when not paced */
+    bool        clock_anchored;     /* False until the next frame shown sets the offset */
+    bool        clock_audio;        /* Paced by the BGM samples rather than esp_timer */
+    int64_t     clock_offset_us;    /* Frame timestamp minus clock time */
     uint8_t     *cache_buff;
     uint32_t    cache_buff_size;
+    uint32_t    read_ahead_size;
     bool        cache_buff_in_psram;
 
     /* LVGL objects */
@@ -66,11 +123,22 @@ typedef struct
     lv_obj_t    *btn_pause;
     lv_obj_t    *btn_stop;
     lv_obj_t    *btn_repeat;
+    lv_obj_t    *btn_skip_back;
+    lv_obj_t    *btn_skip_forward;
     lv_obj_t    *img_pause;
     lv_obj_t    *img_stop;
     lv_obj_t    *controls;
 } player_ctx_t;
 
+/* A frame travelling through the pipeline */
+typedef struct {
+    uint8_t     buf;        /* Buffer of the stage the message is queued to, NO_BUF for the end marker */
+    uint8_t     flags;
+    uint32_t    frame;      /* Frame number, END_FRAME after the last frame */
+    uint32_t    gen;        /* Seek generation the frame was read in */
+    uint32_t    size;       /* Compressed size */
+} frame_msg_t;
+
 static player_ctx_t player_ctx;
 
 
@@ -129,6 +197,26 @@ static void repeat_event_cb(lv_event_t *e)
     }
 }
 
+static void slider_event_cb(lv_event_t *e)
+{
+    lv_obj_t *slider = lv_event_get_target(e);
+
+    /* Only the user moves the knob while pressed, the player task does not update it then */
+    uint32_t count = atomic_load(&player_ctx.frame_count);
+    if (lv_obj_has_state(slider, LV_STATE_PRESSED) && count) {
+        esp_lvgl_simple_player_seek((uint32_t)lv_slider_get_value(slider) * (count - 1) / 1000);
+    }
+}
+
+static void skip_event_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if (code == LV_EVENT_CLICKED) {
+        esp_lvgl_simple_player_skip((int32_t)(intptr_t)lv_event_get_user_data(e));
+    }
+}
+
 static lv_obj_t * create_lvgl_objects(lv_obj_t * screen)
 {
     bsp_display_lock(0);
@@ -149,10 +237,9 @@ static lv_obj_t * create_lvgl_objects(lv_obj_t * screen)
 
     /*Create a slider in the center of the display*/
     lv_obj_t * slider = lv_slider_create(cont_col);
-    lv_obj_set_size(slider, player_ctx.screen_width, 5);
+    lv_obj_set_size(slider, player_ctx.screen_width - 40, 10);
     lv_obj_add_state(slider, LV_STATE_DISABLED);
-    lv_obj_set_style_opa(slider, LV_OPA_TRANSP, LV_PART_KNOB);
-    lv_obj_clear_flag(slider, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(slider, slider_event_cb, LV_EVENT_VALUE_CHANGED, NULL);
     player_ctx.slider = slider;
 
     /* Buttons */
@@ -166,9 +253,16 @@ static lv_obj_t * create_lvgl_objects(lv_obj_t * screen)
     lv_obj_set_style_border_width(cont_row, 0, 0);
     player_ctx.controls = cont_row;
 
+    /* Skip back button */
+    lv_obj_t * skip_back_btn = lv_btn_create(cont_row);
+    lv_obj_t * label = lv_label_create(skip_back_btn);
+    lv_label_set_text_static(label, LV_SYMBOL_PREV);
+    lv_obj_add_event_cb(skip_back_btn, skip_event_cb, LV_EVENT_CLICKED, (void *)(intptr_t)(-SKIP_FRAMES));
+    player_ctx.btn_skip_back = skip_back_btn;
+
     /* Play button */
     lv_obj_t * play_btn = lv_btn_create(cont_row);
-    lv_obj_t * label = lv_label_create(play_btn);
+    label = lv_label_create(play_btn);
     lv_label_set_text_static(label, LV_SYMBOL_PLAY);
     lv_obj_add_event_cb(play_btn, play_event_cb, LV_EVENT_CLICKED, NULL);
     player_ctx.btn_play = play_btn;
@@ -195,6 +289,13 @@ static lv_obj_t * create_lvgl_objects(lv_obj_t * screen)
     lv_obj_add_event_cb(repeat_btn, repeat_event_cb, LV_EVENT_VALUE_CHANGED, NULL);
     player_ctx.btn_repeat = repeat_btn;
 
+    /* Skip forward button */
+    lv_obj_t * skip_forward_btn = lv_btn_create(cont_row);
+    label = lv_label_create(skip_forward_btn);
+    lv_label_set_text_static(label, LV_SYMBOL_NEXT);
+    lv_obj_add_event_cb(skip_forward_btn, skip_event_cb, LV_EVENT_CLICKED, (void *)(intptr_t)SKIP_FRAMES);
+    player_ctx.btn_skip_forward = skip_forward_btn;
+
     /* Pause image */
     lv_obj_t * img_pause = lv_label_create(player_ctx.canvas);
     lv_obj_set_style_text_font(img_pause, &lv_font_montserrat_48, 0);
@@ -279,63 +380,33 @@ static uint8_t * video_decoder_malloc(uint32_t size, bool inbuff, uint32_t * out
     return (uint8_t *)jpeg_alloc_decoder_mem(size, (inbuff ? &tx_mem_cfg : &rx_mem_cfg), (size_t*)outsize);
 }
 
-static int video_decoder_read_jpeg_image(uint32_t *file_seek_start, uint32_t *file_seek_offset)
+static int video_decoder_read_frame(uint32_t frame, uint8_t *buf)
 {
-    uint32_t read_size = 0;
-    uint32_t jpeg_image_size = 0;
-    uint8_t * match = NULL;
-    uint8_t *cache_buff = player_ctx.cache_buff;
-    uint8_t *cache_buff_offset = NULL;
-    uint32_t cache_buff_size = player_ctx.cache_buff_size;
-    uint32_t seek_pos_offset = *file_seek_offset;
-    uint32_t seek_pos_cur = *file_seek_start;
-    uint32_t seek_pos_next = 0;
-
-    // if (seek_pos_cur % CACHE_BUF_ALIGN != 0) {
-    //     ESP_LOGE(TAG, "File seek start is not aligned to %d", CACHE_BUF_ALIGN);
-    //     return 0;
-    // }
-
-    while (match == NULL) {
-        read_size = media_src_storage_read(&player_ctx.file, cache_buff, cache_buff_size) - seek_pos_offset;
-        if (read_size <= 0) {
-            break;
-        }
-
-        cache_buff_offset = cache_buff + seek_pos_offset;
-
-        /* Search for EOI. */
-        match = memmem(cache_buff_offset, read_size, &EOI, 2);
-        if(match) {
-            read_size = (uint32_t)((match + 2) - cache_buff_offset);
-        }
-
-        memcpy(player_ctx.in_buff + jpeg_image_size, cache_buff_offset, read_size);
-        jpeg_image_size += read_size;
+    const mjpeg_index_entry_t *entry = &player_ctx.index.entries[frame];
 
-        seek_pos_next = ALIGN_DOWN(seek_pos_cur + seek_pos_offset + read_size, CACHE_BUF_ALIGN);
-        seek_pos_cur = seek_pos_cur + seek_pos_offset + read_size;
-        seek_pos_offset = seek_pos_cur - seek_pos_next;
-        media_src_storage_seek(&player_ctx.file, seek_pos_next);
-        seek_pos_cur = seek_pos_next;
-
-    }
-    if (jpeg_image_size > player_ctx.in_buff_size) {
+    if (ALIGN_UP(entry->size, 16) > player_ctx.in_buff_size) {
         ESP_LOGE(TAG, "JPEG image size is bigger than input buffer size");
-        jpeg_image_size = -1;
+        return -1;
     }
-    *file_seek_start = seek_pos_next;
-    *file_seek_offset = seek_pos_offset;
 
-    // if (seek_pos_next % CACHE_BUF_ALIGN != 0) {
-    //     ESP_LOGE(TAG, "File seek next is not aligned to %d", CACHE_BUF_ALIGN);
-    //     return 0;
-    // }
+    /* The index gives the exact location, the frame is read straight into the decoder input */
+    if (media_src_storage_seek(&player_ctx.file, entry->offset) != 0) {
+        return -1;
+    }
+    uint32_t read_size = 0;
+    while (read_size < entry->size) {
+        int n = media_src_storage_read(&player_ctx.file, buf + read_size, entry->size - read_size);
+        if (n <= 0) {
+            ESP_LOGE(TAG, "Read frame %" PRIu32 " failed", frame);
+            return -1;
+        }
+        read_size += n;
+    }
 
-    return jpeg_image_size;
+    return entry->size;
 }
 
-static int video_decoder_decode(uint32_t jpeg_image_size)
+static int video_decoder_decode(const uint8_t *in_buf, uint32_t jpeg_image_size, uint8_t *out_buf, uint32_t out_size)
 {
     esp_err_t err;
     uint32_t ret_size = 0;
@@ -347,15 +418,15 @@ static int video_decoder_decode(uint32_t jpeg_image_size)
     }
 
     /* Decode JPEG */
-    ret_size = player_ctx.out_buff_size;
-    err = jpeg_decoder_process(player_ctx.jpeg, &jpeg_decode_cfg, player_ctx.in_buff, jpeg_image_size_aligned,
-                               player_ctx.out_buff, player_ctx.out_buff_size, &ret_size);
+    ret_size = out_size;
+    err = jpeg_decoder_process(player_ctx.jpeg, &jpeg_decode_cfg, in_buf, jpeg_image_size_aligned,
+                               out_buf, out_size, &ret_size);
     if(err != ESP_OK) {
         ESP_LOGE(TAG, "JPEG decode failed");
         return -1;
     }
 
-    if (ret_size > player_ctx.out_buff_size) {
+    if (ret_size > out_size) {
         ESP_LOGE(TAG, "Output buffer is too small");
         return -1;
     }
@@ -363,18 +434,538 @@ static int video_decoder_decode(uint32_t jpeg_image_size)
     return jpeg_image_size;
 }
 
+static inline float ppa_scale_floor(float scale)
+{
+    int frag = (int)(scale * PPA_SCALE_FRAG);
+
+    if (frag < 1) {
+        frag = 1;
+    } else if (frag > 16 * PPA_SCALE_FRAG - 1) {
+        frag = 16 * PPA_SCALE_FRAG - 1;
+    }
+
+    return (float)frag / PPA_SCALE_FRAG;
+}
+
+/*
+ * Work out the PPA operation bringing a decoded frame to the box the video is shown in, and the output size.
+ * Returns false when the frame can be shown as decoded.
+ */
+static bool video_scaler_setup(uint32_t width, uint32_t height, uint32_t box_width, uint32_t box_height)
+{
+    float sx = (float)box_width / width;
+    float sy = (float)box_height / height;
+    uint32_t block_w = width;
+    uint32_t block_h = height;
+
+    switch (player_ctx.scale) {
+    case ESP_LVGL_SIMPLE_PLAYER_SCALE_FIT:
+        sx = sy = ppa_scale_floor(sx < sy ? sx : sy);
+        break;
+    case ESP_LVGL_SIMPLE_PLAYER_SCALE_FILL:
+        sx = sy = ppa_scale_floor(sx > sy ? sx : sy);
+        /* Keep the middle of the video, what goes past the box is not scaled at all */
+        if (box_width / sx < block_w) {
+            block_w = (uint32_t)(box_width / sx);
+        }
+        if (box_height / sy < block_h) {
+            block_h = (uint32_t)(box_height / sy);
+        }
+        break;
+    case ESP_LVGL_SIMPLE_PLAYER_SCALE_STRETCH:
+        sx = ppa_scale_floor(sx);
+        sy = ppa_scale_floor(sy);
+        break;
+    default:
+        return false;
+    }
+    if ((sx == 1.0f) && (sy == 1.0f) && (block_w == width) && (block_h == height)) {
+        return false;
+    }
+
+    player_ctx.out_width = (uint32_t)(block_w * sx);
+    player_ctx.out_height = (uint32_t)(block_h * sy);
+    player_ctx.srm_cfg = (ppa_srm_oper_config_t) {
+        .in = {
+            .buffer = player_ctx.decode_buff,
+            .pic_w = ALIGN_UP(width, 16),
+            .pic_h = ALIGN_UP(height, 16),
+            .block_w = block_w,
+            .block_h = block_h,
+            .block_offset_x = (width - block_w) / 2,
+            .block_offset_y = (height - block_h) / 2,
+            .srm_cm = PPA_SRM_COLOR_MODE_RGB565,
+        },
+        .out = {
+            .pic_w = player_ctx.out_width,
+            .pic_h = player_ctx.out_height,
+            .block_offset_x = 0,
+            .block_offset_y = 0,
+            .srm_cm = PPA_SRM_COLOR_MODE_RGB565,
+        },
+        .rotation_angle = PPA_SRM_ROTATION_ANGLE_0,
+        .scale_x = sx,
+        .scale_y = sy,
+        .mode = PPA_TRANS_MODE_BLOCKING,
+    };
+
+    ESP_LOGI(TAG, "Scale %" PRIu32 "x%" PRIu32 " (block %" PRIu32 "x%" PRIu32 ") to %" PRIu32 "x%" PRIu32, width, height,
+             block_w, block_h, player_ctx.out_width, player_ctx.out_height);
+
+    return true;
+}
+
+static esp_err_t video_scaler_init(uint32_t width, uint32_t height)
+{
+    uint32_t box_width = player_ctx.screen_width;
+    uint32_t box_height = (player_ctx.auto_height ? lv_disp_get_ver_res(NULL) : player_ctx.screen_height) - CONTROLS_HEIGHT;
+
+    /* Without scaling, the decoder output with its padding is shown */
+    player_ctx.out_width = ALIGN_UP(width, 16);
+    player_ctx.out_height = height;
+    player_ctx.decode_buff_size = ALIGN_UP(width, 16) * ALIGN_UP(height, 16) * BYTES_PER_PIXEL;
+    if (!video_scaler_setup(width, height, box_width, box_height)) {
+        player_ctx.out_buff_size = player_ctx.decode_buff_size;
+        return ESP_OK;
+    }
+    player_ctx.out_buff_size = player_ctx.out_width * player_ctx.out_height * BYTES_PER_PIXEL;
+
+    player_ctx.decode_buff = video_decoder_malloc(player_ctx.decode_buff_size, false, &player_ctx.decode_buff_size);
+    ESP_RETURN_ON_FALSE(player_ctx.decode_buff, ESP_ERR_NO_MEM, TAG, "Allocation decode buffer failed");
+    player_ctx.srm_cfg.in.buffer = player_ctx.decode_buff;
+
+    ppa_client_config_t ppa_cfg = {
+        .oper_type = PPA_OPERATION_SRM,
+        .max_pending_trans_num = 1,
+    };
+    ESP_RETURN_ON_ERROR(ppa_register_client(&ppa_cfg, &player_ctx.ppa), TAG, "Register PPA client failed");
+
+    return ESP_OK;
+}
+
+static void video_scaler_deinit(void)
+{
+    if (player_ctx.ppa) {
+        ppa_unregister_client(player_ctx.ppa);
+        player_ctx.ppa = NULL;
+    }
+    if (player_ctx.decode_buff) {
+        heap_caps_free(player_ctx.decode_buff);
+        player_ctx.decode_buff = NULL;
+    }
+}
+
+/* Decode a frame into an output buffer, through the scaler if any */
+static int video_decode_frame(const uint8_t *in_buf, uint32_t jpeg_image_size, uint8_t out_buf)
+{
+    if (!player_ctx.ppa) {
+        return video_decoder_decode(in_buf, jpeg_image_size, player_ctx.out_buffs[out_buf], player_ctx.out_buff_size);
+    }
+
+    int processed = video_decoder_decode(in_buf, jpeg_image_size, player_ctx.decode_buff, player_ctx.decode_buff_size);
+    if (processed < 0) {
+        return processed;
+    }
+
+    player_ctx.srm_cfg.out.buffer = player_ctx.out_buffs[out_buf];
+    player_ctx.srm_cfg.out.buffer_size = player_ctx.out_buff_size;
+    if (ppa_do_scale_rotate_mirror(player_ctx.ppa, &player_ctx.srm_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "PPA scale failed");
+        return -1;
+    }
+
+    return processed;
+}
+
+static inline bool frame_is_stale(const frame_msg_t *msg)
+{
+    return msg->gen != atomic_load(&player_ctx.gen);
+}
+
+static inline int64_t frame_pts_us(uint32_t frame)
+{
+    return (int64_t)frame * player_ctx.frame_us;
+}
+
+/* Position of the clock in the video timeline, false until anchored to a frame */
+static bool clock_get_position(int64_t *pos_us)
+{
+    portENTER_CRITICAL(&clock_lock);
+    bool anchored = player_ctx.clock_anchored;
+    bool audio = player_ctx.clock_audio;
+    int64_t offset_us = player_ctx.clock_offset_us;
+    portEXIT_CRITICAL(&clock_lock);
+
+    if (anchored) {
+        *pos_us = (audio ? bsp_extra_audio_clock_get_us() : esp_timer_get_time()) + offset_us;
+    }
+
+    return anchored;
+}
+
+static void clock_anchor(uint32_t frame)
+{
+    portENTER_CRITICAL(&clock_lock);
+    bool audio = player_ctx.clock_audio;
+    portEXIT_CRITICAL(&clock_lock);
+
+    int64_t now_us = audio ? bsp_extra_audio_clock_get_us() : esp_timer_get_time();
+
+    portENTER_CRITICAL(&clock_lock);
+    player_ctx.clock_offset_us = frame_pts_us(frame) - now_us;
+    player_ctx.clock_anchored = true;
+    portEXIT_CRITICAL(&clock_lock);
+}
+
+static void clock_unanchor(void)
+{
+    portENTER_CRITICAL(&clock_lock);
+    player_ctx.clock_anchored = false;
+    portEXIT_CRITICAL(&clock_lock);
+}
+
+/* Follow the BGM while it plays, esp_timer otherwise (no BGM, BGM finished or shorter than the video) */
+static void clock_select_master(void)
+{
+    bool audio = (player_ctx.bgm_path != NULL) && (audio_player_get_state() == AUDIO_PLAYER_STATE_PLAYING);
+
+    if (audio != player_ctx.clock_audio) {
+        portENTER_CRITICAL(&clock_lock);
+        player_ctx.clock_audio = audio;
+        player_ctx.clock_anchored = false;
+        portEXIT_CRITICAL(&clock_lock);
+        ESP_LOGI(TAG, "Pacing on the %s clock", audio ? "audio" : "system");
+    }
+}
+
+/* Already late when it would come out of the decoder */
+static bool frame_is_late(const frame_msg_t *msg)
+{
+    int64_t pos_us;
+
+    if ((player_ctx.frame_us == 0) || (msg->flags & FRAME_FLAG_RESYNC) || !clock_get_position(&pos_us)) {
+        return false;
+    }
+
+    return pos_us - frame_pts_us(msg->frame) > (int64_t)player_ctx.frame_us * AV_LATE_FRAMES;
+}
+
+/* Time until the frame is due, 0 or less when it is to be shown now */
+static int64_t frame_time_to_due_us(const frame_msg_t *msg)
+{
+    int64_t pos_us;
+
+    if ((player_ctx.frame_us == 0) || (msg->flags & FRAME_FLAG_RESYNC) || !clock_get_position(&pos_us)) {
+        return 0;
+    }
+
+    int64_t wait_us = frame_pts_us(msg->frame) - pos_us;
+    if (wait_us > AV_EARLY_MAX_US) {
+        ESP_LOGW(TAG, "Frame %" PRIu32 " due in %" PRId64 " ms, clock restarted", msg->frame, wait_us / 1000);
+        clock_unanchor();
+        return 0;
+    }
+
+    return wait_us;
+}
+
+/* Measure the drift of a frame being shown, or start the clock from it */
+static void clock_on_present(const frame_msg_t *msg)
+{
+    int64_t pos_us;
+
+    if (player_ctx.frame_us == 0) {
+        return;
+    }
+    if ((msg->flags & FRAME_FLAG_RESYNC) || !clock_get_position(&pos_us)) {
+        clock_anchor(msg->frame);
+        return;
+    }
+
+    int32_t drift_us = (int32_t)(pos_us - frame_pts_us(msg->frame));
+    player_ctx.stats.drift_us = drift_us;
+    if (abs(drift_us) > abs(player_ctx.stats.max_drift_us)) {
+        player_ctx.stats.max_drift_us = drift_us;
+    }
+}
+
+/* Take a free buffer, false if the player stopped meanwhile */
+static bool stage_take_buffer(QueueHandle_t free_queue, uint8_t *buf, esp_lvgl_simple_player_stage_stats_t *stats)
+{
+    int64_t start_us = esp_timer_get_time();
+    bool ok = false;
+
+    while (!ok && (player_ctx.state != PLAYER_STATE_STOPPED)) {
+        ok = (xQueueReceive(free_queue, buf, pdMS_TO_TICKS(STAGE_WAIT_MS)) == pdTRUE);
+    }
+    stats->wait_out_us += esp_timer_get_time() - start_us;
+
+    return ok;
+}
+
+static void read_task(void *arg)
+{
+    esp_lvgl_simple_player_stage_stats_t *stats = &player_ctx.stats.read;
+    uint32_t frame_pos = 0;
+    uint32_t gen = atomic_load(&player_ctx.gen);
+    bool end_sent = false;
+    uint8_t buf;
+
+    while (stage_take_buffer(player_ctx.in_free_queue, &buf, stats)) {
+        uint8_t flags = 0;
+        int32_t seek = atomic_exchange(&player_ctx.seek_frame, NO_SEEK);
+        if (seek != NO_SEEK) {
+            /* Everything already in the pipeline belongs to the old position */
+            frame_pos = seek;
+            gen = atomic_fetch_add(&player_ctx.gen, 1) + 1;
+            flags |= FRAME_FLAG_SEEK | FRAME_FLAG_RESYNC;
+            end_sent = false;
+        }
+
+        if (frame_pos >= player_ctx.index.count) {
+            if (player_ctx.loop) {
+                frame_pos = 0;
+                flags |= FRAME_FLAG_RESYNC;
+            } else if (!end_sent) {
+                frame_msg_t msg = { .buf = buf, .flags = 0, .frame = END_FRAME, .gen = gen, .size = 0 };
+                xQueueSend(player_ctx.in_full_queue, &msg, portMAX_DELAY);
+                end_sent = true;
+                continue;
+            } else {
+                /* Nothing to read until a seek */
+                xQueueSend(player_ctx.in_free_queue, &buf, portMAX_DELAY);
+                vTaskDelay(pdMS_TO_TICKS(STAGE_WAIT_MS));
+                continue;
+            }
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        int size = video_decoder_read_frame(frame_pos, player_ctx.in_buffs[buf]);
+        stats->busy_us += esp_timer_get_time() - start_us;
+        if (size < 0) {
+            ESP_LOGE(TAG, "Read JPEG image failed. Skip frame.");
+            xQueueSend(player_ctx.in_free_queue, &buf, portMAX_DELAY);
+            frame_pos++;
+            continue;
+        }
+
+        frame_msg_t msg = { .buf = buf, .flags = flags, .frame = frame_pos, .gen = gen, .size = (uint32_t)size };
+        /* Never blocks, the queue holds every input buffer */
+        xQueueSend(player_ctx.in_full_queue, &msg, portMAX_DELAY);
+        stats->frames++;
+        frame_pos++;
+    }
+
+    xSemaphoreGive(player_ctx.stage_exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void decode_task(void *arg)
+{
+    esp_lvgl_simple_player_stage_stats_t *stats = &player_ctx.stats.decode;
+    uint32_t skipped = 0;
+    frame_msg_t msg;
+
+    while (player_ctx.state != PLAYER_STATE_STOPPED) {
+        int64_t start_us = esp_timer_get_time();
+        if (xQueueReceive(player_ctx.in_full_queue, &msg, pdMS_TO_TICKS(STAGE_WAIT_MS)) != pdTRUE) {
+            stats->wait_in_us += esp_timer_get_time() - start_us;
+            continue;
+        }
+        stats->wait_in_us += esp_timer_get_time() - start_us;
+
+        uint8_t in_buf = msg.buf;
+        if (frame_is_stale(&msg)) {
+            xQueueSend(player_ctx.in_free_queue, &in_buf, portMAX_DELAY);
+            player_ctx.stats.dropped++;
+            continue;
+        }
+        if (msg.frame == END_FRAME) {
+            xQueueSend(player_ctx.in_free_queue, &in_buf, portMAX_DELAY);
+            msg.buf = NO_BUF;
+            xQueueSend(player_ctx.out_full_queue, &msg, portMAX_DELAY);
+            continue;
+        }
+        /* Behind the clock: the decode would be wasted, the next frame is due sooner */
+        if ((skipped < AV_SKIP_MAX) && frame_is_late(&msg)) {
+            xQueueSend(player_ctx.in_free_queue, &in_buf, portMAX_DELAY);
+            player_ctx.stats.late_skipped++;
+            skipped++;
+            continue;
+        }
+        skipped = 0;
+
+        uint8_t out_buf;
+        if (!stage_take_buffer(player_ctx.out_free_queue, &out_buf, stats)) {
+            xQueueSend(player_ctx.in_free_queue, &in_buf, portMAX_DELAY);
+            break;
+        }
+
+        start_us = esp_timer_get_time();
+        int processed = video_decode_frame(player_ctx.in_buffs[in_buf], msg.size, out_buf);
+        stats->busy_us += esp_timer_get_time() - start_us;
+        xQueueSend(player_ctx.in_free_queue, &in_buf, portMAX_DELAY);
+        if (processed < 0) {
+            ESP_LOGE(TAG, "Decode JPEG image failed. Skip frame.");
+            xQueueSend(player_ctx.out_free_queue, &out_buf, portMAX_DELAY);
+            continue;
+        }
+
+        msg.buf = out_buf;
+        /* Never blocks, the queue holds every output buffer */
+        xQueueSend(player_ctx.out_full_queue, &msg, portMAX_DELAY);
+        stats->frames++;
+    }
+
+    xSemaphoreGive(player_ctx.stage_exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void log_stage_stats(const char *name, const esp_lvgl_simple_player_stage_stats_t *stats)
+{
+    uint32_t frames = stats->frames ? stats->frames : 1;
+
+    ESP_LOGI(TAG, "  %-7s %6" PRIu32 " frames, busy %5" PRIu32 " us, wait in %5" PRIu32 " us, wait out %5" PRIu32
+             " us per frame", name, stats->frames, (uint32_t)(stats->busy_us / frames),
+             (uint32_t)(stats->wait_in_us / frames), (uint32_t)(stats->wait_out_us / frames));
+}
+
+static void log_pipeline_stats(int64_t elapsed_us)
+{
+    const esp_lvgl_simple_player_stats_t *stats = &player_ctx.stats;
+
+    /* The stage with the highest busy time per frame is the bottleneck */
+    ESP_LOGI(TAG, "Pipeline: %.1f fps presented, %" PRIu32 " stale frames dropped",
+             elapsed_us > 0 ? stats->present.frames * 1000000.0f / elapsed_us : 0.0f, stats->dropped);
+    log_stage_stats("read", &stats->read);
+    log_stage_stats("decode", &stats->decode);
+    log_stage_stats("present", &stats->present);
+    media_src_storage_stats_t storage;
+    if (media_src_storage_get_stats(&player_ctx.file, &storage) == 0) {
+        ESP_LOGI(TAG, "  storage %.1f MB/s, %" PRIu32 " stalls (%" PRIu32 " ms), %" PRIu32 " seeks out of the read-ahead window",
+                 storage.device_us ? (float)storage.device_bytes / storage.device_us : 0.0f, storage.stall_count,
+                 (uint32_t)(storage.stall_us / 1000), storage.restart_count);
+    }
+    if (player_ctx.frame_us) {
+        ESP_LOGI(TAG, "  A/V     %s clock, drift %" PRId32 " ms (max %" PRId32 " ms), %" PRIu32 " late decodes skipped",
+                 player_ctx.clock_audio ? "audio" : "system", stats->drift_us / 1000, stats->max_drift_us / 1000,
+                 stats->late_skipped);
+    }
+}
+
+static void pipeline_free(void)
+{
+    for (int i = 0; i < IN_BUF_NUM; i++) {
+        if (player_ctx.in_buffs[i]) {
+            heap_caps_free(player_ctx.in_buffs[i]);
+            player_ctx.in_buffs[i] = NULL;
+        }
+    }
+    for (int i = 0; i < OUT_BUF_NUM; i++) {
+        if (player_ctx.out_buffs[i]) {
+            heap_caps_free(player_ctx.out_buffs[i]);
+            player_ctx.out_buffs[i] = NULL;
+        }
+    }
+    player_ctx.out_buff_size = 0;
+
+    if (player_ctx.in_free_queue) {
+        vQueueDelete(player_ctx.in_free_queue);
+        player_ctx.in_free_queue = NULL;
+    }
+    if (player_ctx.in_full_queue) {
+        vQueueDelete(player_ctx.in_full_queue);
+        player_ctx.in_full_queue = NULL;
+    }
+    if (player_ctx.out_free_queue) {
+        vQueueDelete(player_ctx.out_free_queue);
+        player_ctx.out_free_queue = NULL;
+    }
+    if (player_ctx.out_full_queue) {
+        vQueueDelete(player_ctx.out_full_queue);
+        player_ctx.out_full_queue = NULL;
+    }
+    if (player_ctx.stage_exit_sem) {
+        vSemaphoreDelete(player_ctx.stage_exit_sem);
+        player_ctx.stage_exit_sem = NULL;
+    }
+}
+
+static esp_err_t pipeline_alloc(void)
+{
+    /* Input buffers only need to hold the largest frame of this video */
+    player_ctx.in_buff_size = ALIGN_UP(player_ctx.index.max_frame_size, 16);
+    for (uint8_t i = 0; i < IN_BUF_NUM; i++) {
+        player_ctx.in_buffs[i] = video_decoder_malloc(player_ctx.in_buff_size, true, &player_ctx.in_buff_size);
+        ESP_RETURN_ON_FALSE(player_ctx.in_buffs[i], ESP_ERR_NO_MEM, TAG, "Allocation in_buff failed");
+    }
+    for (uint8_t i = 0; i < OUT_BUF_NUM; i++) {
+        uint32_t size = player_ctx.out_buff_size;
+        player_ctx.out_buffs[i] = video_decoder_malloc(size, false, &size);
+        ESP_RETURN_ON_FALSE(player_ctx.out_buffs[i], ESP_ERR_NO_MEM, TAG, "Allocation out_buff failed");
+        /* Rounded up to the cache line, the whole buffer can be handed to the PPA */
+        player_ctx.out_buff_size = size;
+    }
+
+    player_ctx.in_free_queue = xQueueCreate(IN_BUF_NUM, sizeof(uint8_t));
+    player_ctx.in_full_queue = xQueueCreate(IN_BUF_NUM, sizeof(frame_msg_t));
+    player_ctx.out_free_queue = xQueueCreate(OUT_BUF_NUM, sizeof(uint8_t));
+    /* One more slot for the end marker, which carries no buffer */
+    player_ctx.out_full_queue = xQueueCreate(OUT_BUF_NUM + 1, sizeof(frame_msg_t));
+    player_ctx.stage_exit_sem = xSemaphoreCreateCounting(2, 0);
+    ESP_RETURN_ON_FALSE(player_ctx.in_free_queue && player_ctx.in_full_queue && player_ctx.out_free_queue &&
+                        player_ctx.out_full_queue && player_ctx.stage_exit_sem, ESP_ERR_NO_MEM, TAG, "Create queues failed");
+
+    for (uint8_t i = 0; i < IN_BUF_NUM; i++) {
+        xQueueSend(player_ctx.in_free_queue, &i, 0);
+    }
+    /* Output buffer 0 starts on the canvas, the others are free */
+    for (uint8_t i = 1; i < OUT_BUF_NUM; i++) {
+        xQueueSend(player_ctx.out_free_queue, &i, 0);
+    }
+
+    return ESP_OK;
+}
+
+static void present_frame(const frame_msg_t *msg)
+{
+    int64_t start_us = esp_timer_get_time();
+
+    bsp_display_lock(0);
+    /* Swap the canvas to the new frame: the decoder never writes a buffer LVGL can still read */
+    lv_canvas_set_buffer(player_ctx.canvas, player_ctx.out_buffs[msg->buf], player_ctx.out_width, player_ctx.out_height,
+                         LV_IMG_CF_TRUE_COLOR);
+    lv_obj_invalidate(player_ctx.canvas);
+    /* Set slider, unless the user is dragging it */
+    if (!lv_obj_has_state(player_ctx.slider, LV_STATE_PRESSED)) {
+        lv_slider_set_value(player_ctx.slider, (int32_t)((uint64_t)msg->frame * 1000 / player_ctx.index.count), LV_ANIM_OFF);
+    }
+    bsp_display_unlock();
+
+    clock_on_present(msg);
+    player_ctx.frame_pos = msg->frame;
+    player_ctx.stats.present.busy_us += esp_timer_get_time() - start_us;
+    player_ctx.stats.present.frames++;
+}
+
 static void show_video_task(void *arg)
 {
     esp_err_t ret = ESP_OK;
-    int processed = 0;
-    int all_size = 0;
-    int file_seek_pos = 0;
-    int file_seek_offset = 0;
-    int jpeg_image_size = 0;
+    int stage_num = 0;
+    uint8_t shown_buf = 0;
+
+    memset(&player_ctx.stats, 0, sizeof(player_ctx.stats));
+    clock_unanchor();
 
     /* Open video file */
     ESP_LOGI(TAG, "Opening video file %s ...", player_ctx.video_path);
-    ESP_GOTO_ON_FALSE(media_src_storage_open(&player_ctx.file) == 0, ESP_ERR_NO_MEM, err, TAG, "Storage open failed");
+    media_src_storage_cfg_t storage_cfg = {
+        .block_size = READ_AHEAD_BLOCK_SIZE,
+        .block_num = player_ctx.read_ahead_size / READ_AHEAD_BLOCK_SIZE,
+        .task_priority = READ_TASK_PRIORITY,
+        .task_core = tskNO_AFFINITY,
+    };
+    ESP_GOTO_ON_FALSE(media_src_storage_open_with_cfg(&player_ctx.file, &storage_cfg) == 0, ESP_ERR_NO_MEM, err, TAG, "Storage open failed");
     ESP_GOTO_ON_FALSE(media_src_storage_connect(&player_ctx.file, player_ctx.video_path) == 0, ESP_ERR_NO_MEM, err, TAG, "Storage connect failed");
 
     if (player_ctx.bgm_path != NULL) {
@@ -384,9 +975,13 @@ static void show_video_task(void *arg)
     /* Get file size */
     ESP_GOTO_ON_FALSE(media_src_storage_get_size(&player_ctx.file, &player_ctx.filesize) == 0, ESP_ERR_NO_MEM, err, TAG, "Get file size failed");
 
-    /* Create input buffer */
-    player_ctx.in_buff = video_decoder_malloc(player_ctx.in_buff_size, true, &player_ctx.in_buff_size);
-    ESP_GOTO_ON_FALSE(player_ctx.in_buff, ESP_ERR_NO_MEM, err, TAG, "Allocation in_buff failed");
+    /* Load or build the frame index */
+    ESP_GOTO_ON_ERROR(mjpeg_index_open(player_ctx.video_path, player_ctx.cache_buff, player_ctx.cache_buff_size,
+                                       &player_ctx.index), err, TAG, "Get frame index failed");
+    ESP_GOTO_ON_FALSE(player_ctx.index.count > 0, ESP_ERR_INVALID_SIZE, err, TAG, "No frame in video file");
+    player_ctx.frame_pos = 0;
+    atomic_store(&player_ctx.seek_frame, NO_SEEK);
+    atomic_store(&player_ctx.frame_count, player_ctx.index.count);
 
     /* Init video decoder */
     ESP_GOTO_ON_ERROR(video_decoder_init(), err, TAG, "Initialize video decoder failed");
@@ -395,20 +990,21 @@ static void show_video_task(void *arg)
     uint32_t height = 0;
     uint32_t width = 0;
     ESP_GOTO_ON_ERROR(get_video_size(&width, &height), err, TAG, "Get video file size failed");
-    width = ALIGN_UP(width, 16);
+    ESP_GOTO_ON_ERROR(video_scaler_init(width, height), err, TAG, "Initialize video scaler failed");
+    width = player_ctx.out_width;
+    height = player_ctx.out_height;
 
-    /* Create output buffer */
-    player_ctx.out_buff_size = width * height * 3;
-    player_ctx.out_buff = video_decoder_malloc(player_ctx.out_buff_size, false, &player_ctx.out_buff_size);
-    ESP_GOTO_ON_FALSE(player_ctx.out_buff, ESP_ERR_NO_MEM, err, TAG, "Allocation out_buff failed");
+    /* Create pipeline buffers */
+    ESP_GOTO_ON_ERROR(pipeline_alloc(), err, TAG, "Create pipeline failed");
 
     bsp_display_lock(0);
 	/* Set buffer to LVGL canvas */
-    lv_canvas_set_buffer(player_ctx.canvas, player_ctx.out_buff, width, height, LV_IMG_CF_TRUE_COLOR);
+    memset(player_ctx.out_buffs[shown_buf], 0, player_ctx.out_buff_size);
+    lv_canvas_set_buffer(player_ctx.canvas, player_ctx.out_buffs[shown_buf], width, height, LV_IMG_CF_TRUE_COLOR);
     lv_obj_invalidate(player_ctx.canvas);
 
     if (player_ctx.auto_width || player_ctx.auto_height) {
-        uint32_t h = (player_ctx.auto_height ? (height+120) : lv_obj_get_height(player_ctx.main));
+        uint32_t h = (player_ctx.auto_height ? (height + CONTROLS_HEIGHT) : lv_obj_get_height(player_ctx.main));
         uint32_t w = (player_ctx.auto_width ? width : lv_obj_get_width(player_ctx.main));
         lv_obj_set_size(player_ctx.main, w, h);
     }
@@ -419,6 +1015,8 @@ static void show_video_task(void *arg)
     lv_obj_clear_state(player_ctx.btn_stop, LV_STATE_DISABLED);
     lv_obj_clear_state(player_ctx.btn_pause, LV_STATE_DISABLED);
     lv_obj_clear_state(player_ctx.btn_repeat, LV_STATE_DISABLED);
+    lv_obj_clear_state(player_ctx.btn_skip_back, LV_STATE_DISABLED);
+    lv_obj_clear_state(player_ctx.btn_skip_forward, LV_STATE_DISABLED);
     /* Hide Stop button */
     lv_obj_add_flag(player_ctx.img_stop, LV_OBJ_FLAG_HIDDEN);
     /* Set slider range */
@@ -432,59 +1030,93 @@ static void show_video_task(void *arg)
     if ((player_ctx.bgm_path != NULL) && bsp_extra_player_play_file(player_ctx.bgm_path) != ESP_OK) {
         ESP_LOGE(TAG, "Play bgm failed");
     }
-    media_src_storage_seek(&player_ctx.file, 0);
 
+    /* Reader and decoder run ahead of this task, which presents the frames */
+    ESP_GOTO_ON_FALSE(xTaskCreate(read_task, "video read", STAGE_TASK_STACK_SIZE, NULL, READ_TASK_PRIORITY, NULL) == pdPASS,
+                      ESP_ERR_NO_MEM, err, TAG, "Create read task failed");
+    stage_num++;
+    ESP_GOTO_ON_FALSE(xTaskCreate(decode_task, "video decode", STAGE_TASK_STACK_SIZE, NULL, DECODE_TASK_PRIORITY, NULL) == pdPASS,
+                      ESP_ERR_NO_MEM, err, TAG, "Create decode task failed");
+    stage_num++;
+
+    int64_t start_us = esp_timer_get_time();
+    int64_t last_log_us = start_us;
     while (player_ctx.state != PLAYER_STATE_STOPPED) {
-        if (player_ctx.state == PLAYER_STATE_PAUSED) {
+        frame_msg_t msg;
+        int64_t wait_start_us = esp_timer_get_time();
+        bool got = (xQueuePeek(player_ctx.out_full_queue, &msg, pdMS_TO_TICKS(STAGE_WAIT_MS)) == pdTRUE);
+        player_ctx.stats.present.wait_in_us += esp_timer_get_time() - wait_start_us;
+
+        if (got && frame_is_stale(&msg)) {
+            xQueueReceive(player_ctx.out_full_queue, &msg, 0);
+            if (msg.buf != NO_BUF) {
+                xQueueSend(player_ctx.out_free_queue, &msg.buf, portMAX_DELAY);
+            }
+            player_ctx.stats.dropped++;
+            continue;
+        }
+
+        /* While paused, only the first frame after a seek is shown */
+        if ((player_ctx.state == PLAYER_STATE_PAUSED) && !(got && (msg.flags & FRAME_FLAG_SEEK))) {
+            /* The clock restarts from the first frame shown after resuming */
+            clock_unanchor();
             if (bsp_display_lock(10)) {
                 lv_obj_clear_flag(player_ctx.img_pause, LV_OBJ_FLAG_HIDDEN);
                 bsp_display_unlock();
             }
-            vTaskDelay(pdMS_TO_TICKS(500));
+            if (got) {
+                vTaskDelay(pdMS_TO_TICKS(STAGE_WAIT_MS));
+            }
+            continue;
+        }
+        if (!got) {
             continue;
         }
 
-        jpeg_image_size = video_decoder_read_jpeg_image(&file_seek_pos, &file_seek_offset);
-        if (jpeg_image_size < 0) {
-            ESP_LOGE(TAG, "Read JPEG image failed. Skip frame.");
-            break;
-        } else if (jpeg_image_size == 0) {
-            ESP_LOGI(TAG, "Playing finished.");
-            if (player_ctx.loop) {
-                ESP_LOGI(TAG, "Playing loop enabled. Play again...");
-                media_src_storage_seek(&player_ctx.file, 0);
-                file_seek_pos = 0;
-                file_seek_offset = 0;
-                all_size = 0;
-                continue;
-            } else {
-                esp_lvgl_simple_player_stop();
+        /* Hold the frame until its presentation time, still watching for seeks and pauses */
+        if (msg.frame != END_FRAME) {
+            clock_select_master();
+            int64_t wait_us = frame_time_to_due_us(&msg);
+            if (wait_us >= 1000) {
+                int64_t pace_start_us = esp_timer_get_time();
+                uint32_t wait_ms = (wait_us / 1000 < STAGE_WAIT_MS) ? (uint32_t)(wait_us / 1000) : STAGE_WAIT_MS;
+                vTaskDelay(pdMS_TO_TICKS(wait_ms));
+                player_ctx.stats.present.wait_out_us += esp_timer_get_time() - pace_start_us;
                 continue;
             }
         }
+        xQueueReceive(player_ctx.out_full_queue, &msg, 0);
 
-        /* Decode one frame */
-        processed = video_decoder_decode(jpeg_image_size);
-        if (processed < 0) {
-            ESP_LOGE(TAG, "Decode JPEG image failed. Skip frame.");
-            break;
-        } else {
-            all_size += processed;
+        if (msg.frame == END_FRAME) {
+            ESP_LOGI(TAG, "Playing finished.");
+            esp_lvgl_simple_player_stop();
+            continue;
         }
 
-        if (bsp_display_lock(10)) {
-            /* Refresh video canvas object */
-            lv_obj_invalidate(player_ctx.canvas);
-            /* Set slider */
-            lv_slider_set_value(player_ctx.slider, ((float)all_size/(float)player_ctx.filesize)*1000, LV_ANIM_ON);
-            bsp_display_unlock();
+        present_frame(&msg);
+        /* The previous frame is no longer referenced by the canvas */
+        xQueueSend(player_ctx.out_free_queue, &shown_buf, portMAX_DELAY);
+        shown_buf = msg.buf;
+
+        if (esp_timer_get_time() - last_log_us >= STATS_LOG_PERIOD_US) {
+            last_log_us = esp_timer_get_time();
+            log_pipeline_stats(last_log_us - start_us);
         }
     }
+    log_pipeline_stats(esp_timer_get_time() - start_us);
 
 err:
+    /* Make sure the stages are gone before their buffers */
+    player_ctx.state = PLAYER_STATE_STOPPED;
+    while (stage_num-- > 0) {
+        xSemaphoreTake(player_ctx.stage_exit_sem, portMAX_DELAY);
+    }
+
     bsp_display_lock(0);
     /* Show black on screen */
-    memset(player_ctx.out_buff, 0, player_ctx.out_buff_size);
+    if (player_ctx.out_buffs[shown_buf]) {
+        memset(player_ctx.out_buffs[shown_buf], 0, player_ctx.out_buff_size);
+    }
     if (player_ctx.auto_height) {
         lv_obj_set_height(player_ctx.main, 320);
     }
@@ -506,16 +1138,11 @@ err:
 
     /* Deinit video decoder */
     video_decoder_deinit();
+    video_scaler_deinit();
 
-    if (player_ctx.in_buff) {
-        heap_caps_free(player_ctx.in_buff);
-        player_ctx.in_buff = NULL;
-    }
-    if (player_ctx.out_buff) {
-        heap_caps_free(player_ctx.out_buff);
-        player_ctx.out_buff = NULL;
-        player_ctx.out_buff_size = 0;
-    }
+    atomic_store(&player_ctx.frame_count, 0);
+    mjpeg_index_free(&player_ctx.index);
+    pipeline_free();
 
     ESP_LOGI(TAG, "Video player task finished.");
 
@@ -532,10 +1159,11 @@ lv_obj_t * esp_lvgl_simple_player_create(esp_lvgl_simple_player_cfg_t * params)
 
     player_ctx.video_path = params->video_path;
     player_ctx.bgm_path = params->bgm_path;
-    player_ctx.in_buff_size = params->buff_size;
 
     player_ctx.cache_buff_size = ALIGN_UP(params->cache_buff_size, CACHE_BUF_ALIGN);
     player_ctx.cache_buff_in_psram = params->cache_buff_in_psram;
+    player_ctx.read_ahead_size = params->read_ahead_size;
+    player_ctx.scale = params->scale;
     /* Create split buffer */
     uint32_t flag = player_ctx.cache_buff_in_psram ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL;
     player_ctx.cache_buff = (uint8_t *)heap_caps_aligned_alloc(128, player_ctx.cache_buff_size, flag);
@@ -546,6 +1174,7 @@ lv_obj_t * esp_lvgl_simple_player_create(esp_lvgl_simple_player_cfg_t * params)
 
     player_ctx.screen_width = params->screen_width;
     player_ctx.screen_height = params->screen_height;
+    player_ctx.frame_us = params->fps ? (1000000 / params->fps) : 0;
     player_ctx.hide_controls = params->flags.hide_controls;
     player_ctx.hide_slider = params->flags.hide_slider;
     player_ctx.hide_status = params->flags.hide_status;
@@ -680,6 +1309,8 @@ void esp_lvgl_simple_player_stop(void)
     lv_obj_add_state(player_ctx.btn_stop, LV_STATE_DISABLED);
     lv_obj_add_state(player_ctx.btn_pause, LV_STATE_DISABLED);
     lv_obj_add_state(player_ctx.btn_repeat, LV_STATE_DISABLED);
+    lv_obj_add_state(player_ctx.btn_skip_back, LV_STATE_DISABLED);
+    lv_obj_add_state(player_ctx.btn_skip_forward, LV_STATE_DISABLED);
     lv_obj_clear_flag(player_ctx.img_stop, LV_OBJ_FLAG_HIDDEN);
     bsp_display_unlock();
 }
@@ -695,6 +1326,49 @@ void esp_lvgl_simple_player_repeat(bool repeat)
     player_ctx.loop = repeat;
 }
 
+void esp_lvgl_simple_player_seek(uint32_t frame)
+{
+    if (!player_ctx.is_init) {
+        ESP_LOGW(TAG, "Not init");
+        return;
+    }
+
+    uint32_t count = atomic_load(&player_ctx.frame_count);
+    if ((player_ctx.state == PLAYER_STATE_STOPPED) || (count == 0)) {
+        return;
+    }
+
+    if (frame >= count) {
+        frame = count - 1;
+    }
+    atomic_store(&player_ctx.seek_frame, (int32_t)frame);
+}
+
+void esp_lvgl_simple_player_skip(int32_t frames)
+{
+    if (!player_ctx.is_init) {
+        ESP_LOGW(TAG, "Not init");
+        return;
+    }
+
+    int32_t frame = (int32_t)player_ctx.frame_pos + frames;
+    esp_lvgl_simple_player_seek(frame < 0 ? 0 : (uint32_t)frame);
+}
+
+uint32_t esp_lvgl_simple_player_get_frame_count(void)
+{
+    return atomic_load(&player_ctx.frame_count);
+}
+
+esp_err_t esp_lvgl_simple_player_get_stats(esp_lvgl_simple_player_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    *stats = player_ctx.stats;
+
+    return ESP_OK;
+}
+
 esp_err_t esp_lvgl_simple_player_del(void)
 {
     if (!player_ctx.is_init) {
@@ -21,6 +21,41 @@ typedef enum
     PLAYER_STATE_STOPPED,
 } player_state_t;
 
+/**
+ * @brief How a video is sized to the player object
+ *
+ * Scaling is done by the PPA, in steps of 1/16.
+ */
+typedef enum {
+    ESP_LVGL_SIMPLE_PLAYER_SCALE_NONE = 0,  /* Shown at its own size, cropped by the player object */
+    ESP_LVGL_SIMPLE_PLAYER_SCALE_FIT,       /* Whole video shown as large as it fits, aspect ratio kept */
+    ESP_LVGL_SIMPLE_PLAYER_SCALE_FILL,      /* Player object covered, aspect ratio kept, edges of the video cropped */
+    ESP_LVGL_SIMPLE_PLAYER_SCALE_STRETCH,   /* Player object covered, aspect ratio not kept */
+} esp_lvgl_simple_player_scale_t;
+
+/**
+ * @brief Counters of one player pipeline stage
+ */
+typedef struct {
+    uint32_t    frames;         /* Frames handled by the stage */
+    uint64_t    busy_us;        /* Time spent reading, decoding or presenting */
+    uint64_t    wait_in_us;     /* Time waiting for a frame from the previous stage */
+    uint64_t    wait_out_us;    /* Time waiting for a free buffer of the next stage, or for the frame to be due */
+} esp_lvgl_simple_player_stage_stats_t;
+
+/**
+ * @brief Player pipeline counters, since the start of the playback
+ */
+typedef struct {
+    esp_lvgl_simple_player_stage_stats_t read;      /* SD card to compressed frame buffers */
+    esp_lvgl_simple_player_stage_stats_t decode;    /* JPEG decoder (and PPA scaling) to RGB buffers */
+    esp_lvgl_simple_player_stage_stats_t present;   /* RGB buffer swapped into the LVGL canvas */
+    uint32_t    dropped;        /* Frames decoded or read before a seek and never shown */
+    uint32_t    late_skipped;   /* Frames not decoded because they were already late */
+    int32_t     drift_us;       /* Clock minus timestamp of the last frame shown, positive when the video lags */
+    int32_t     max_drift_us;   /* Largest drift seen, with its sign */
+} esp_lvgl_simple_player_stats_t;
+
 /**
  * @brief Player configuration structure
  */
@@ -31,8 +66,13 @@ typedef struct {
     uint32_t    buff_size;      /* Size of the buffer for one video frame */
     uint32_t    cache_buff_size;      /* Size of the buffer for one video frame */
     bool        cache_buff_in_psram;    /* Use PSRAM for split buffer */
+    uint32_t    read_ahead_size;    /* Bytes read ahead of the playback position in the background (PSRAM),
+                                       0 reads frames on demand */
     uint32_t    screen_width;   /* Width of the video player object */
     uint32_t    screen_height;  /* Height of the video player object */
+    esp_lvgl_simple_player_scale_t scale;   /* Sizing of the video to the player object, less the controls */
+    uint32_t    fps;            /* Frame rate of the video, frames are paced on the BGM or the system clock.
+                                   0 shows frames as soon as they are decoded */
     struct {
         unsigned int hide_controls: 1;  /* Hide control buttons */
         unsigned int hide_slider: 1;  /* Hide indication slider */
@@ -90,6 +130,28 @@ void esp_lvgl_simple_player_stop(void);
  */
 void esp_lvgl_simple_player_repeat(bool repeat);
 
+/**
+ * @brief Jump to a frame, also shown while paused
+ *
+ * Frames are located through an index kept next to the video file, it is built on the first play.
+ */
+void esp_lvgl_simple_player_seek(uint32_t frame);
+
+/**
+ * @brief Jump forward (positive) or back (negative) by a number of frames
+ */
+void esp_lvgl_simple_player_skip(int32_t frames);
+
+/**
+ * @brief Get the number of frames of the playing video, 0 when stopped
+ */
+uint32_t esp_lvgl_simple_player_get_frame_count(void);
+
+/**
+ * @brief Get the pipeline counters of the current or last playback
+ */
+esp_err_t esp_lvgl_simple_player_get_stats(esp_lvgl_simple_player_stats_t *stats);
+
 /**
  * @brief Delete Player
  *
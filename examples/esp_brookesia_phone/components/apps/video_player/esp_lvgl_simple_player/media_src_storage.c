@@ -1,120 +1,262 @@
-
 #include <stdio.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <string.h>
 #include <sys/unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_heap_caps.h"
+#include "esp_dma_utils.h"
+#include "esp_timer.h"
 #include "media_src_storage.h"
 #include "bsp/esp-bsp.h"
 
-#define CACHE_SIZE (64 * 1024)
+#define READ_AHEAD_TASK_STACK_SIZE  (4 * 1024)
+#define READ_AHEAD_WAIT_MS          (100)
 
-// #define USE_ALIGN_CACHE
+typedef struct {
+    uint8_t* buf;       // DMA capable, the file system reads whole sectors straight into it
+    uint64_t pos;       // File offset of buf[0]
+    uint32_t filled;    // Valid bytes
+} read_ahead_block_t;
 
 typedef struct {
-#ifdef USE_ALIGN_CACHE
-    uint8_t* align_buffer;
-    int      readed;
-    int      filled;
-    bool     eof;
-    int      seek_pos;
-    int      align_pos;
-    int      buffer_pos;
-#endif
     FILE*    fp;
+    uint64_t read_pos;  // Offset of the next media_src_storage_read
+    media_src_storage_stats_t stats;
+
+    // Read-ahead window, only with a block size configured
+    media_src_storage_cfg_t cfg;
+    read_ahead_block_t* blocks;
+    uint32_t head;      // Oldest filled block
+    uint32_t count;     // Filled blocks from head, in file order
+    uint64_t fill_pos;  // Offset of the next block the task reads
+    uint32_t gen;       // Incremented when the window restarts somewhere else
+    bool     eof;
+    bool     error;
+    bool     running;
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t data_sem;     // Given by the task when a block is filled
+    SemaphoreHandle_t space_sem;    // Given by the reader when a block is freed or the window moved
+    SemaphoreHandle_t exit_sem;
 } storage_src_t;
 
-#define ALIGN_TO(pos, align) (pos & (~((align)-1)))
+#define ALIGN_TO(pos, align) ((pos) - ((pos) % (align)))
 
 static const char *TAG = "media_src_storage";
 
-static void media_src_storage_flush(storage_src_t* m)
-{
-#ifdef USE_ALIGN_CACHE
-    m->filled = m->readed = 0;
-    m->eof = false;
-    m->align_pos = m->seek_pos = 0;
-    m->buffer_pos = 0;
-#endif
-}
-
-#ifdef USE_ALIGN_CACHE
-static int cache_data(storage_src_t* m, void *data, int n) {
-    int sent = 0;
-    if (m->filled > m->readed) {
-        sent = m->filled - m->readed;
-        if (m->align_pos < m->seek_pos) {
-            int need_skip = m->seek_pos - m->align_pos;
-            if (need_skip > sent) {
-                m->readed += sent;
-                sent = 0;
-                m->align_pos += sent;
-            } else {
-                sent -= need_skip;
-                m->readed += need_skip;
-                m->align_pos += need_skip;
-            }
+static void read_ahead_task(void *arg)
+{
+    storage_src_t* m = (storage_src_t*)arg;
+    int fd = fileno(m->fp);
+
+    xSemaphoreTake(m->lock, portMAX_DELAY);
+    while (m->running) {
+        if ((m->count == m->cfg.block_num) || m->eof) {
+            xSemaphoreGive(m->lock);
+            xSemaphoreTake(m->space_sem, pdMS_TO_TICKS(READ_AHEAD_WAIT_MS));
+            xSemaphoreTake(m->lock, portMAX_DELAY);
+            continue;
         }
-        if (sent > n) {
-            sent = n;
+        read_ahead_block_t* block = &m->blocks[(m->head + m->count) % m->cfg.block_num];
+        uint64_t pos = m->fill_pos;
+        uint32_t gen = m->gen;
+        xSemaphoreGive(m->lock);
+
+        // The reader does not look at the block before it is counted, fill it unlocked
+        int64_t start_us = esp_timer_get_time();
+        int n = pread(fd, block->buf, m->cfg.block_size, (off_t)pos);
+        int64_t read_us = esp_timer_get_time() - start_us;
+
+        xSemaphoreTake(m->lock, portMAX_DELAY);
+        if (gen != m->gen) {
+            // The reader moved the window meanwhile
+            continue;
         }
-        if (sent) {
-            memcpy(data, m->align_buffer + m->readed, sent);
-            m->readed += sent;
+        if (n < 0) {
+            ESP_LOGE(TAG, "Fail to read at %" PRIu64, pos);
+            m->error = m->eof = true;
+        } else {
+            if (n > 0) {
+                block->pos = pos;
+                block->filled = n;
+                m->count++;
+                m->fill_pos += n;
+            }
+            m->eof = (n < m->cfg.block_size);
+            m->stats.device_bytes += n;
+            m->stats.device_us += read_us;
         }
+        xSemaphoreGive(m->data_sem);
     }
-    if (m->readed >= m->filled) {
-        m->buffer_pos += m->filled;
-        m->readed = m->filled = 0;
+    xSemaphoreGive(m->lock);
+
+    xSemaphoreGive(m->exit_sem);
+    vTaskDelete(NULL);
+}
+
+static int read_ahead_start(storage_src_t* m)
+{
+    m->head = m->count = 0;
+    m->fill_pos = 0;
+    m->eof = m->error = false;
+    m->gen++;
+    m->running = true;
+    if (xTaskCreatePinnedToCore(read_ahead_task, "media read ahead", READ_AHEAD_TASK_STACK_SIZE, m,
+                                m->cfg.task_priority, NULL, m->cfg.task_core) != pdPASS) {
+        ESP_LOGE(TAG, "Fail to create read-ahead task");
+        m->running = false;
+        return -1;
     }
-    if (m->filled == 0) {
-        int n = read(fileno(m->fp), m->align_buffer, CACHE_SIZE);
-        if (n < 0) {
-            return n;
+    return 0;
+}
+
+static void read_ahead_stop(storage_src_t* m)
+{
+    if (!m->running) {
+        return;
+    }
+    xSemaphoreTake(m->lock, portMAX_DELAY);
+    m->running = false;
+    xSemaphoreGive(m->lock);
+    xSemaphoreGive(m->space_sem);
+    xSemaphoreTake(m->exit_sem, portMAX_DELAY);
+}
+
+static int read_ahead_read(storage_src_t* m, uint8_t* data, size_t len)
+{
+    size_t done = 0;
+    bool stalled = false;
+
+    xSemaphoreTake(m->lock, portMAX_DELAY);
+    while (done < len) {
+        // Blocks behind the read position are not needed any more
+        while (m->count && (m->blocks[m->head].pos + m->blocks[m->head].filled <= m->read_pos)) {
+            m->head = (m->head + 1) % m->cfg.block_num;
+            m->count--;
+            xSemaphoreGive(m->space_sem);
+        }
+
+        read_ahead_block_t* block = &m->blocks[m->head];
+        if (m->count && (block->pos <= m->read_pos)) {
+            uint32_t offset = m->read_pos - block->pos;
+            size_t n = block->filled - offset;
+            if (n > len - done) {
+                n = len - done;
+            }
+            memcpy(data + done, block->buf + offset, n);
+            done += n;
+            m->read_pos += n;
+            continue;
+        }
+
+        uint64_t window_start = m->count ? block->pos : m->fill_pos;
+        uint64_t window_end = m->fill_pos + (uint64_t)m->cfg.block_size * m->cfg.block_num;
+        if ((m->read_pos < window_start) || (m->read_pos >= window_end)) {
+            // Seek out of the window, restart it from the block holding the read position
+            m->head = m->count = 0;
+            m->fill_pos = ALIGN_TO(m->read_pos, m->cfg.block_size);
+            m->eof = m->error = false;
+            m->gen++;
+            m->stats.restart_count++;
+            xSemaphoreGive(m->space_sem);
+            continue;
         }
-        if (n < CACHE_SIZE) {
-            m->eof = true;
+        if (m->eof) {
+            break;
+        }
+
+        // The task has not read that far yet
+        if (!stalled) {
+            stalled = true;
+            m->stats.stall_count++;
         }
-        m->filled = n;
+        int64_t start_us = esp_timer_get_time();
+        xSemaphoreGive(m->lock);
+        xSemaphoreTake(m->data_sem, pdMS_TO_TICKS(READ_AHEAD_WAIT_MS));
+        xSemaphoreTake(m->lock, portMAX_DELAY);
+        m->stats.stall_us += esp_timer_get_time() - start_us;
     }
-    return sent;
+    m->stats.served_bytes += done;
+    bool error = m->error;
+    xSemaphoreGive(m->lock);
 
+    return (done == 0 && error) ? -1 : (int)done;
 }
 
-static int read_from_cache(storage_src_t* m, void *data, size_t len) {
-    int read = 0;
-    while (len > 0) {
-        if (m->eof && m->filled == 0) {
-            break;
+static void read_ahead_free(storage_src_t* m)
+{
+    if (m->blocks) {
+        for (uint32_t i = 0; i < m->cfg.block_num; i++) {
+            free(m->blocks[i].buf);
         }
-        int n = cache_data(m, data, len);
-        if (n < 0) {
-            ESP_LOGE(TAG, "Fail to read from cache");
-            return n;
+        free(m->blocks);
+    }
+    if (m->lock) {
+        vSemaphoreDelete(m->lock);
+    }
+    if (m->data_sem) {
+        vSemaphoreDelete(m->data_sem);
+    }
+    if (m->space_sem) {
+        vSemaphoreDelete(m->space_sem);
+    }
+    if (m->exit_sem) {
+        vSemaphoreDelete(m->exit_sem);
+    }
+}
+
+static int read_ahead_alloc(storage_src_t* m)
+{
+    esp_dma_mem_info_t dma_mem_info = {
+        .extra_heap_caps = MALLOC_CAP_SPIRAM,
+        .dma_alignment_bytes = 4,
+    };
+
+    m->blocks = calloc(m->cfg.block_num, sizeof(read_ahead_block_t));
+    if (m->blocks == NULL) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < m->cfg.block_num; i++) {
+        if (esp_dma_capable_malloc(m->cfg.block_size, &dma_mem_info, (void **)&m->blocks[i].buf, NULL) != ESP_OK) {
+            return -1;
         }
-        data += n;
-        len -= n;
-        read += n;
     }
-    return read;
+    m->lock = xSemaphoreCreateMutex();
+    m->data_sem = xSemaphoreCreateBinary();
+    m->space_sem = xSemaphoreCreateBinary();
+    m->exit_sem = xSemaphoreCreateBinary();
+    if (!m->lock || !m->data_sem || !m->space_sem || !m->exit_sem) {
+        return -1;
+    }
+    return 0;
 }
-#endif
 
 int media_src_storage_open(media_src_t *src)
+{
+    media_src_storage_cfg_t cfg = { 0 };
+    return media_src_storage_open_with_cfg(src, &cfg);
+}
+
+int media_src_storage_open_with_cfg(media_src_t *src, const media_src_storage_cfg_t *cfg)
 {
     storage_src_t* m = calloc(1, sizeof(storage_src_t));
     if (m == NULL) {
         return -1;
     }
-#ifdef USE_ALIGN_CACHE
-    m->align_buffer = heap_caps_aligned_alloc(128, CACHE_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-    if (m->align_buffer == NULL) {
-        ESP_LOGE(TAG, "No memory");
-        free(m);
-        return -1;
+    m->cfg = *cfg;
+    if (m->cfg.block_size && m->cfg.block_num) {
+        if (read_ahead_alloc(m) != 0) {
+            ESP_LOGE(TAG, "No memory for %" PRIu32 " x %" PRIu32 " read-ahead blocks", m->cfg.block_num, m->cfg.block_size);
+            read_ahead_free(m);
+            free(m);
+            return -1;
+        }
+    } else {
+        m->cfg.block_size = m->cfg.block_num = 0;
     }
-#endif
     src->sub_src = m;
     return 0;
 }
@@ -122,28 +264,34 @@ int media_src_storage_open(media_src_t *src)
 int media_src_storage_connect(media_src_t *src, const char *uri)
 {
     storage_src_t* m = (storage_src_t*)src->sub_src;
-    if (m->fp) {
-        fclose(m->fp);
-        m->fp = NULL;
-    }
-    media_src_storage_flush(m);
+    media_src_storage_disconnect(src);
     ESP_LOGI(TAG, "Open file %s", uri);
     m->fp = fopen(uri, "rb");
-    if (m->fp) {
-        return 0;
+    if (m->fp == NULL) {
+        ESP_LOGE(TAG, "Fail to open file");
+        return -1;
     }
-    ESP_LOGE(TAG, "Fail to open file");
-    return -1;
+    m->read_pos = 0;
+    memset(&m->stats, 0, sizeof(m->stats));
+    if (m->cfg.block_size && (read_ahead_start(m) != 0)) {
+        fclose(m->fp);
+        m->fp = NULL;
+        return -1;
+    }
+    return 0;
 }
 
 int media_src_storage_disconnect(media_src_t *src)
 {
     storage_src_t* m = (storage_src_t*)src->sub_src;
+    if (m == NULL) {
+        return -1;
+    }
+    read_ahead_stop(m);
     if (m->fp) {
         fclose(m->fp);
         m->fp = NULL;
     }
-    media_src_storage_flush(m);
     return 0;
 }
 
@@ -151,12 +299,18 @@ int media_src_storage_read(media_src_t *src, void *data, size_t len)
 {
     storage_src_t* m = (storage_src_t*)src->sub_src;
     if (m->fp) {
-#ifdef USE_ALIGN_CACHE
-        return read_from_cache(m, data, len);
-#else
+        if (m->cfg.block_size) {
+            return read_ahead_read(m, data, len);
+        }
+        int64_t start_us = esp_timer_get_time();
         int n = read(fileno(m->fp), data, len);
+        if (n > 0) {
+            m->read_pos += n;
+            m->stats.device_bytes += n;
+            m->stats.served_bytes += n;
+        }
+        m->stats.device_us += esp_timer_get_time() - start_us;
         return n;
-#endif
     }
     ESP_LOGE(TAG, "Fail to read file");
     return -1;
@@ -166,21 +320,19 @@ int media_src_storage_seek(media_src_t *src, uint64_t position)
 {
     storage_src_t* m = (storage_src_t*)src->sub_src;
     if (m->fp) {
-#ifdef USE_ALIGN_CACHE
-        if (m->filled && position >= m->buffer_pos && position <= m->buffer_pos + m->filled) {
-            // Still in cached memory
-            m->readed = (position - m->buffer_pos);
+        if (m->cfg.block_size) {
+            // The next read finds out whether the position is in the window
+            xSemaphoreTake(m->lock, portMAX_DELAY);
+            m->read_pos = position;
+            xSemaphoreGive(m->lock);
             return 0;
         }
-#endif
-        media_src_storage_flush(m);
-#ifdef USE_ALIGN_CACHE
-        m->align_pos = (int) ALIGN_TO(position, 1024);
-        m->seek_pos = (int)position;
-        m->buffer_pos = m->align_pos;
-        position = m->align_pos;
-#endif
-        return fseek(m->fp, position, SEEK_SET);
+        // Reads bypass stdio, move the descriptor itself: fseek may leave it elsewhere
+        if (lseek(fileno(m->fp), (off_t)position, SEEK_SET) < 0) {
+            return -1;
+        }
+        m->read_pos = position;
+        return 0;
     }
     ESP_LOGE(TAG, "Fail to seek file");
     return -1;
@@ -190,7 +342,7 @@ int media_src_storage_get_position(media_src_t *src, uint64_t *position)
 {
     storage_src_t* m = (storage_src_t*)src->sub_src;
     if (m->fp) {
-        *position = ftell(m->fp);
+        *position = m->read_pos;
         return 0;
     }
     ESP_LOGE(TAG, "Fail to get position");
@@ -212,18 +364,31 @@ int media_src_storage_get_size(media_src_t *src, uint64_t *size)
     return -1;
 }
 
-int media_src_storage_close(media_src_t *src)
+int media_src_storage_get_stats(media_src_t *src, media_src_storage_stats_t *stats)
 {
     storage_src_t* m = (storage_src_t*)src->sub_src;
-    if (m->fp) {
-        fclose((FILE *) m->fp);
-        m->fp = NULL;
+    if (m == NULL || stats == NULL) {
+        return -1;
+    }
+    if (m->lock) {
+        xSemaphoreTake(m->lock, portMAX_DELAY);
+    }
+    *stats = m->stats;
+    if (m->lock) {
+        xSemaphoreGive(m->lock);
     }
-#ifdef USE_ALIGN_CACHE
-    if (m->align_buffer) {
-        free(m->align_buffer);
+    return 0;
+}
+
+int media_src_storage_close(media_src_t *src)
+{
+    storage_src_t* m = (storage_src_t*)src->sub_src;
+    if (m == NULL) {
+        return -1;
     }
-#endif
+    media_src_storage_disconnect(src);
+    read_ahead_free(m);
     free(m);
+    src->sub_src = NULL;
     return 0;
 }
@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -14,13 +17,40 @@ typedef struct {
     void                *sub_src;   /*!< Sub source to keep media source extra data */
 } media_src_t;
 
+/**
+ * @brief Read-ahead configuration
+ *
+ * With a block size set, a background task reads the file in blocks of `block_size` bytes, at offsets multiple of
+ * `block_size`, into a window of `block_num` blocks ahead of the read position. Reads are served from the window.
+ */
+typedef struct {
+    uint32_t    block_size;         /*!< Size of one file system read, best a multiple of the cluster size. 0 reads on demand */
+    uint32_t    block_num;          /*!< Blocks in the read-ahead window */
+    uint32_t    task_priority;      /*!< Priority of the read-ahead task */
+    int         task_core;          /*!< Core of the read-ahead task, tskNO_AFFINITY for any */
+} media_src_storage_cfg_t;
+
+/**
+ * @brief Counters of a storage source, since it was connected
+ */
+typedef struct {
+    uint64_t    device_bytes;       /*!< Bytes read from the file system */
+    uint64_t    device_us;          /*!< Time spent in file system reads, device_bytes / device_us gives the throughput */
+    uint64_t    served_bytes;       /*!< Bytes returned by `media_src_storage_read` */
+    uint32_t    stall_count;        /*!< Reads that had to wait for the read-ahead task */
+    uint64_t    stall_us;           /*!< Time spent waiting for the read-ahead task */
+    uint32_t    restart_count;      /*!< Seeks out of the read-ahead window */
+} media_src_storage_stats_t;
+
 int media_src_storage_open(media_src_t *src);
+int media_src_storage_open_with_cfg(media_src_t *src, const media_src_storage_cfg_t *cfg);
 int media_src_storage_connect(media_src_t *src, const char *uri);
 int media_src_storage_disconnect(media_src_t *src);
 int media_src_storage_read(media_src_t *src, void *data, size_t len);
 int media_src_storage_seek(media_src_t *src, uint64_t position);
 int media_src_storage_get_position(media_src_t *src, uint64_t *position);
 int media_src_storage_get_size(media_src_t *src, uint64_t *size);
+int media_src_storage_get_stats(media_src_t *src, media_src_storage_stats_t *stats);
 int media_src_storage_close(media_src_t *src);
 
 #ifdef __cplusplus
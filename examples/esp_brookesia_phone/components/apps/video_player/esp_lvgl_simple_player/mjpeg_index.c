@@ -0,0 +1,266 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "mjpeg_index.h"
+
+#define INDEX_MAGIC             (0x58494a4d)    /* "MJIX" */
+#define INDEX_VERSION           (1)
+#define INDEX_INIT_CAPACITY     (256)
+#define INDEX_PATH_MAX          (128)
+
+#define JPEG_MARKER             (0xff)
+#define JPEG_SOI                (0xd8)
+#define JPEG_EOI                (0xd9)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t file_size;
+    int64_t  mtime;
+    uint32_t count;
+    uint32_t max_frame_size;
+} index_header_t;
+
+static const char *TAG = "mjpeg_index";
+
+static esp_err_t index_reserve(mjpeg_index_t *index, uint32_t capacity)
+{
+    if (capacity <= index->capacity) {
+        return ESP_OK;
+    }
+
+    mjpeg_index_entry_t *entries = realloc(index->entries, capacity * sizeof(mjpeg_index_entry_t));
+    ESP_RETURN_ON_FALSE(entries, ESP_ERR_NO_MEM, TAG, "No memory for %" PRIu32 " entries", capacity);
+    index->entries = entries;
+    index->capacity = capacity;
+
+    return ESP_OK;
+}
+
+static esp_err_t index_append(mjpeg_index_t *index, uint32_t offset, uint32_t size)
+{
+    if (index->count == index->capacity) {
+        ESP_RETURN_ON_ERROR(index_reserve(index, index->capacity ? index->capacity * 2 : INDEX_INIT_CAPACITY), TAG,
+                            "Grow index failed");
+    }
+    index->entries[index->count].offset = offset;
+    index->entries[index->count].size = size;
+    index->count++;
+    if (size > index->max_frame_size) {
+        index->max_frame_size = size;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t mjpeg_index_build(FILE *fp, uint8_t *buf, size_t buf_size, mjpeg_index_t *index)
+{
+    ESP_RETURN_ON_FALSE(fp && buf && (buf_size > 0) && index, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    index->count = 0;
+    index->max_frame_size = 0;
+    ESP_RETURN_ON_FALSE(fseek(fp, 0, SEEK_SET) == 0, ESP_FAIL, TAG, "Seek failed");
+
+    uint64_t base = 0;                  /* File offset of buf[0] */
+    uint64_t frame_start = 0;
+    bool in_frame = false;
+    bool pending_marker = false;        /* The previous chunk ended with 0xFF */
+    size_t len;
+
+    while ((len = fread(buf, 1, buf_size, fp)) > 0) {
+        size_t i = 0;
+        /* Markers are 0xFF followed by a code, jump from one 0xFF to the next */
+        while (pending_marker || (i < len)) {
+            uint64_t pos;
+            uint8_t code;
+            if (pending_marker) {
+                pending_marker = false;
+                pos = base - 1;
+                code = buf[0];
+                i = 1;
+            } else {
+                const uint8_t *p = memchr(buf + i, JPEG_MARKER, len - i);
+                if (!p) {
+                    break;
+                }
+                i = p - buf;
+                if (i + 1 == len) {
+                    pending_marker = true;
+                    break;
+                }
+                pos = base + i;
+                code = buf[i + 1];
+                i += 2;
+            }
+
+            if (code == JPEG_MARKER) {
+                /* Fill byte, the second 0xFF may start a marker */
+                i--;
+            } else if (!in_frame && (code == JPEG_SOI)) {
+                frame_start = pos;
+                in_frame = true;
+            } else if (in_frame && (code == JPEG_EOI)) {
+                ESP_RETURN_ON_FALSE(pos + 2 <= UINT32_MAX, ESP_ERR_INVALID_SIZE, TAG, "File too large");
+                ESP_RETURN_ON_ERROR(index_append(index, (uint32_t)frame_start, (uint32_t)(pos + 2 - frame_start)), TAG,
+                                    "Append frame failed");
+                in_frame = false;
+            }
+        }
+        base += len;
+    }
+    ESP_RETURN_ON_FALSE(!ferror(fp), ESP_FAIL, TAG, "Read failed");
+
+    if (in_frame) {
+        ESP_LOGW(TAG, "Truncated last frame at %" PRIu64 " skipped", frame_start);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t mjpeg_index_save(const mjpeg_index_t *index, const char *index_path, uint64_t file_size, int64_t mtime)
+{
+    ESP_RETURN_ON_FALSE(index && index_path, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    esp_err_t ret = ESP_OK;
+    index_header_t header = {
+        .magic = INDEX_MAGIC,
+        .version = INDEX_VERSION,
+        .file_size = file_size,
+        .mtime = mtime,
+        .count = index->count,
+        .max_frame_size = index->max_frame_size,
+    };
+
+    FILE *fp = fopen(index_path, "wb");
+    ESP_RETURN_ON_FALSE(fp, ESP_FAIL, TAG, "Open %s failed", index_path);
+    ESP_GOTO_ON_FALSE(fwrite(&header, sizeof(header), 1, fp) == 1, ESP_FAIL, err, TAG, "Write header failed");
+    ESP_GOTO_ON_FALSE(fwrite(index->entries, sizeof(mjpeg_index_entry_t), index->count, fp) == index->count, ESP_FAIL,
+                      err, TAG, "Write entries failed");
+    ESP_GOTO_ON_FALSE(fclose(fp) == 0, ESP_FAIL, err_closed, TAG, "Close failed");
+
+    return ESP_OK;
+
+err:
+    fclose(fp);
+err_closed:
+    /* A partial index must not be taken for a valid one */
+    remove(index_path);
+    return ret;
+}
+
+esp_err_t mjpeg_index_load(mjpeg_index_t *index, const char *index_path, uint64_t file_size, int64_t mtime)
+{
+    ESP_RETURN_ON_FALSE(index && index_path, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    esp_err_t ret = ESP_OK;
+    index_header_t header;
+
+    FILE *fp = fopen(index_path, "rb");
+    if (!fp) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_GOTO_ON_FALSE(fread(&header, sizeof(header), 1, fp) == 1, ESP_ERR_INVALID_STATE, err, TAG, "Short header");
+    ESP_GOTO_ON_FALSE((header.magic == INDEX_MAGIC) && (header.version == INDEX_VERSION), ESP_ERR_INVALID_STATE, err,
+                      TAG, "Not an index file");
+    if ((header.file_size != file_size) || (header.mtime != mtime)) {
+        ESP_LOGI(TAG, "Index %s is stale", index_path);
+        ret = ESP_ERR_INVALID_STATE;
+        goto err;
+    }
+
+    /* The count sizes the allocation, it must describe exactly the entries present in the file */
+    struct stat st;
+    ESP_GOTO_ON_FALSE(fstat(fileno(fp), &st) == 0, ESP_FAIL, err, TAG, "Stat %s failed", index_path);
+    ESP_GOTO_ON_FALSE((st.st_size >= (off_t)sizeof(header)) &&
+                      ((uint64_t)(st.st_size - sizeof(header)) == (uint64_t)header.count * sizeof(mjpeg_index_entry_t)),
+                      ESP_ERR_INVALID_STATE, err, TAG, "Index size does not match %" PRIu32 " entries", header.count);
+
+    ESP_GOTO_ON_ERROR(index_reserve(index, header.count), err, TAG, "Reserve index failed");
+    ESP_GOTO_ON_FALSE(fread(index->entries, sizeof(mjpeg_index_entry_t), header.count, fp) == header.count,
+                      ESP_ERR_INVALID_STATE, err, TAG, "Short index");
+    index->count = header.count;
+    index->max_frame_size = header.max_frame_size;
+
+err:
+    fclose(fp);
+    return ret;
+}
+
+static void index_path_from_video(const char *video_path, char *index_path, size_t size)
+{
+    /* Replace the extension, so the name also fits 8.3 file systems */
+    const char *dot = strrchr(video_path, '.');
+    const char *slash = strrchr(video_path, '/');
+    int base_len = (dot && (!slash || dot > slash)) ? (int)(dot - video_path) : (int)strlen(video_path);
+
+    snprintf(index_path, size, "%.*s.idx", base_len, video_path);
+}
+
+esp_err_t mjpeg_index_open(const char *video_path, uint8_t *buf, size_t buf_size, mjpeg_index_t *index)
+{
+    ESP_RETURN_ON_FALSE(video_path && index, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    esp_err_t ret = ESP_OK;
+    struct stat st;
+    char index_path[INDEX_PATH_MAX];
+    ESP_RETURN_ON_FALSE(stat(video_path, &st) == 0, ESP_FAIL, TAG, "Stat %s failed", video_path);
+    index_path_from_video(video_path, index_path, sizeof(index_path));
+
+    if (mjpeg_index_load(index, index_path, (uint64_t)st.st_size, (int64_t)st.st_mtime) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded %s: %" PRIu32 " frames", index_path, index->count);
+        return ESP_OK;
+    }
+
+    FILE *fp = fopen(video_path, "rb");
+    ESP_RETURN_ON_FALSE(fp, ESP_FAIL, TAG, "Open %s failed", video_path);
+    ret = mjpeg_index_build(fp, buf, buf_size, index);
+    fclose(fp);
+    ESP_RETURN_ON_ERROR(ret, TAG, "Build index failed");
+
+    ESP_LOGI(TAG, "Built index of %s: %" PRIu32 " frames, largest %" PRIu32 " bytes", video_path, index->count,
+             index->max_frame_size);
+    if (mjpeg_index_save(index, index_path, (uint64_t)st.st_size, (int64_t)st.st_mtime) != ESP_OK) {
+        ESP_LOGW(TAG, "Index not saved, it will be built again next time");
+    }
+
+    return ESP_OK;
+}
+
+uint32_t mjpeg_index_find_frame(const mjpeg_index_t *index, uint64_t offset)
+{
+    uint32_t lo = 0;
+    uint32_t hi = index->count;
+
+    /* Last entry with entries[i].offset <= offset */
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (index->entries[mid].offset <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+void mjpeg_index_free(mjpeg_index_t *index)
+{
+    if (index) {
+        free(index->entries);
+        index->entries = NULL;
+        index->count = 0;
+        index->capacity = 0;
+        index->max_frame_size = 0;
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Location of one JPEG frame in an MJPEG file
+ */
+typedef struct {
+    uint32_t offset;                    /*!< Offset of the SOI marker */
+    uint32_t size;                      /*!< Size up to and including the EOI marker */
+} mjpeg_index_entry_t;
+
+/**
+ * @brief Frame index of an MJPEG file
+ */
+typedef struct {
+    mjpeg_index_entry_t *entries;       /*!< One entry per frame, in file order */
+    uint32_t count;                     /*!< Number of frames */
+    uint32_t capacity;                  /*!< Allocated entries */
+    uint32_t max_frame_size;            /*!< Size of the largest frame */
+} mjpeg_index_t;
+
+/**
+ * @brief Build the index by scanning a whole MJPEG file for SOI/EOI markers
+ *
+ * Frames are the bytes from an SOI marker to the next EOI marker. Data between frames is skipped.
+ * The file position is left at the end of the file.
+ *
+ * @param fp        File to scan, read from its start
+ * @param buf       Scan buffer
+ * @param buf_size  Size of the scan buffer, larger buffers mean fewer reads
+ * @param index     Index to fill, must be zero initialized or freed
+ *
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   Invalid argument
+ *      - ESP_ERR_NO_MEM        Out of memory
+ *      - ESP_FAIL              Read error
+ */
+esp_err_t mjpeg_index_build(FILE *fp, uint8_t *buf, size_t buf_size, mjpeg_index_t *index);
+
+/**
+ * @brief Write the index to a file, tagged with the size and modification time of the video
+ *
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   Invalid argument
+ *      - ESP_FAIL              Write error
+ */
+esp_err_t mjpeg_index_save(const mjpeg_index_t *index, const char *index_path, uint64_t file_size, int64_t mtime);
+
+/**
+ * @brief Read an index file, only if it was saved for a video of the same size and modification time
+ *
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_ARG   Invalid argument
+ *      - ESP_ERR_NOT_FOUND     No index file
+ *      - ESP_ERR_INVALID_STATE The index file is stale or not an index
+ *      - ESP_ERR_NO_MEM        Out of memory
+ */
+esp_err_t mjpeg_index_load(mjpeg_index_t *index, const char *index_path, uint64_t file_size, int64_t mtime);
+
+/**
+ * @brief Get the index of a video: load it from next to the video, or build and save it
+ *
+ * The index file has the name of the video with an `.idx` extension.
+ *
+ * @param video_path Path of the MJPEG file
+ * @param buf        Scan buffer used when the index has to be built
+ * @param buf_size   Size of the scan buffer
+ * @param index      Index to fill, must be zero initialized or freed
+ *
+ * @return
+ *      - ESP_OK                On success, even if the built index could not be saved
+ *      - Others                See `mjpeg_index_build`
+ */
+esp_err_t mjpeg_index_open(const char *video_path, uint8_t *buf, size_t buf_size, mjpeg_index_t *index);
+
+/**
+ * @brief Get the frame containing a file offset, or the last frame starting before it
+ *
+ * @return Frame number, 0 for an empty index
+ */
+uint32_t mjpeg_index_find_frame(const mjpeg_index_t *index, uint64_t offset);
+
+/**
+ * @brief Free the entries of an index
+ */
+void mjpeg_index_free(mjpeg_index_t *index);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,3 +1,4 @@
+#include "esp_timer.h"
 #include "human_face_detect.hpp"
 
 #if CONFIG_HUMAN_FACE_DETECT_MODEL_IN_FLASH_RODATA
@@ -6,8 +7,16 @@ static const char *path = (const char *)human_face_detect_espdl;
 #elif CONFIG_HUMAN_FACE_DETECT_MODEL_IN_FLASH_PARTITION
 static const char *path = "human_face_det";
 #endif
+
 namespace human_face_detect {
 
+static latency_hook_t s_latency_hook = nullptr;
+
+void set_latency_hook(latency_hook_t hook)
+{
+    s_latency_hook = hook;
+}
+
 MSR::MSR(const char *model_name)
 {
 #if !CONFIG_HUMAN_FACE_DETECT_MODEL_IN_SDCARD
@@ -63,7 +72,8 @@ MNP::~MNP()
 
 std::list<dl::detect::result_t> &MNP::run(const dl::image::img_t &img, std::list<dl::detect::result_t> &candidates)
 {
-    dl::tool::Latency latency[3] = {dl::tool::Latency(10), dl::tool::Latency(10), dl::tool::Latency(10)};
+    int64_t stage_us[3] = {0, 0, 0};
+    int64_t t0, t1, t2, t3;
     m_postprocessor->clear_result();
     for (auto &candidate : candidates) {
         int center_x = (candidate.box[0] + candidate.box[2]) >> 1;
@@ -75,28 +85,26 @@ std::list<dl::detect::result_t> &MNP::run(const dl::image::img_t &img, std::list
         candidate.box[3] = candidate.box[1] + side;
         candidate.limit_box(img.width, img.height);
 
-        latency[0].start();
+        t0 = esp_timer_get_time();
         m_image_preprocessor->preprocess(img, candidate.box);
-        latency[0].end();
-
-        latency[1].start();
+        t1 = esp_timer_get_time();
         m_model->run();
-        latency[1].end();
-
-        latency[2].start();
+        t2 = esp_timer_get_time();
         m_postprocessor->set_resize_scale_x(m_image_preprocessor->get_resize_scale_x());
         m_postprocessor->set_resize_scale_y(m_image_preprocessor->get_resize_scale_y());
         m_postprocessor->set_top_left_x(m_image_preprocessor->get_top_left_x());
         m_postprocessor->set_top_left_y(m_image_preprocessor->get_top_left_y());
         m_postprocessor->postprocess();
-        latency[2].end();
+        t3 = esp_timer_get_time();
+
+        stage_us[0] += t1 - t0;
+        stage_us[1] += t2 - t1;
+        stage_us[2] += t3 - t2;
     }
     m_postprocessor->nms();
     std::list<dl::detect::result_t> &result = m_postprocessor->get_result(img.width, img.height);
-    if (candidates.size() > 0) {
-        latency[0].print("detect", "preprocess");
-        latency[1].print("detect", "forward");
-        latency[2].print("detect", "postprocess");
+    if (s_latency_hook && candidates.size() > 0) {
+        s_latency_hook(stage_us[0], stage_us[1], stage_us[2]);
     }
     return result;
 }
@@ -113,10 +121,64 @@ MSRMNP::~MSRMNP()
     }
 }
 
-std::list<dl::detect::result_t> &MSRMNP::run(const dl::image::img_t &img)
+std::list<dl::detect::result_t> &MSRMNP::run_msr(const dl::image::img_t &img, const region_t &region)
 {
+    m_frames_since_msr = 0;
     std::list<dl::detect::result_t> &candidates = m_msr->run(img);
-    return m_mnp->run(img, candidates);
+    std::list<dl::detect::result_t> &result = m_mnp->run(img, candidates);
+    update_seeds(region, result);
+
+    return result;
+}
+
+void MSRMNP::update_seeds(const region_t &region, const std::list<dl::detect::result_t> &result)
+{
+    m_seeds.reset(region);
+    for (const auto &face : result) {
+        if (!m_seeds.add(region, face.box.data())) {
+            break;
+        }
+    }
+}
+
+void MSRMNP::set_region(const region_t &region)
+{
+    m_region = region;
+    m_region_set = true;
+}
+
+std::list<dl::detect::result_t> &MSRMNP::run(const dl::image::img_t &img)
+{
+    region_t region = {0, 0, img.width, img.height, img.width, img.height};
+    if (m_region_set && (m_region.width == img.width) && (m_region.height == img.height)) {
+        region = m_region;
+    }
+    m_region_set = false;
+
+    m_frames_since_msr++;
+    if ((m_seeds.size() == 0) || (m_frames_since_msr >= CONFIG_HUMAN_FACE_DETECT_MSR_INTERVAL)) {
+        return run_msr(img, region);
+    }
+
+    // The seeds are in full-frame coordinates, move them into this region, MNP squares them in place
+    int seed_num = m_seeds.size();
+    m_candidates.resize(seed_num);
+    int index = 0;
+    for (auto &candidate : m_candidates) {
+        candidate.box.resize(4);
+        if (!m_seeds.map(region, index++, candidate.box.data())) {
+            // Another frame size, or the face is outside the region, search the whole image again
+            return run_msr(img, region);
+        }
+    }
+    std::list<dl::detect::result_t> &result = m_mnp->run(img, m_candidates);
+    if ((int)result.size() < seed_num) {
+        // A face was lost or moved out of its seed box, search the whole image again
+        return run_msr(img, region);
+    }
+    update_seeds(region, result);
+
+    return result;
 }
 
 } // namespace human_face_detect
@@ -147,3 +209,10 @@ HumanFaceDetect::HumanFaceDetect(const char *sdcard_model_dir, model_type_t mode
     }
     }
 }
+
+void HumanFaceDetect::set_region(const human_face_detect::region_t &region)
+{
+    if (m_model) {
+        static_cast<human_face_detect::MSRMNP *>(m_model)->set_region(region);
+    }
+}
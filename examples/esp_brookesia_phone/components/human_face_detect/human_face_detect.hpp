@@ -3,7 +3,19 @@
 #include "dl_detect_base.hpp"
 #include "dl_detect_mnp_postprocessor.hpp"
 #include "dl_detect_msr_postprocessor.hpp"
+#include "human_face_detect_seed.hpp"
 namespace human_face_detect {
+/**
+ * @brief Stage latency hook, called after every MNP run with the preprocess/forward/postprocess
+ *        times accumulated over all candidates, in microseconds.
+ */
+typedef void (*latency_hook_t)(int64_t preprocess_us, int64_t forward_us, int64_t postprocess_us);
+
+/**
+ * @brief Register the stage latency hook, NULL to disable.
+ */
+void set_latency_hook(latency_hook_t hook);
+
 class MSR : public dl::detect::DetectImpl {
 public:
     MSR(const char *model_name);
@@ -21,15 +33,37 @@ public:
     std::list<dl::detect::result_t> &run(const dl::image::img_t &img, std::list<dl::detect::result_t> &candidates);
 };
 
+/**
+ * @brief Two-stage face detector: MSR proposes candidates, MNP refines them.
+ *
+ * In incremental mode (`CONFIG_HUMAN_FACE_DETECT_MSR_INTERVAL` > 1) the faces refined in the previous
+ * frame seed MNP directly, and MSR only runs every `CONFIG_HUMAN_FACE_DETECT_MSR_INTERVAL` frames, when
+ * no face was seen, when the frame size changes or when a seeded face is lost.
+ */
 class MSRMNP : public dl::detect::Detect {
 private:
     MSR *m_msr;
     MNP *m_mnp;
+    SeedMap m_seeds;                              // Candidates for the next frame
+    std::list<dl::detect::result_t> m_candidates; // Seeds moved into the analysed region, nodes are reused
+    region_t m_region;
+    bool m_region_set;
+    int m_frames_since_msr;
+
+    std::list<dl::detect::result_t> &run_msr(const dl::image::img_t &img, const region_t &region);
+    void update_seeds(const region_t &region, const std::list<dl::detect::result_t> &result);
 
 public:
     MSRMNP(const char *msr_model_name, const char *mnp_model_name) :
-        m_msr(new MSR(msr_model_name)), m_mnp(new MNP(mnp_model_name)) {};
+        m_msr(new MSR(msr_model_name)), m_mnp(new MNP(mnp_model_name)), m_region(), m_region_set(false),
+        m_frames_since_msr(0) {};
     ~MSRMNP();
+
+    /**
+     * @brief Tell where the next image sits in the full frame, for the next `run` only. Without it the
+     *        image is taken as the full frame.
+     */
+    void set_region(const region_t &region);
     std::list<dl::detect::result_t> &run(const dl::image::img_t &img) override;
 };
 
@@ -40,4 +74,9 @@ public:
     typedef enum { MSRMNP_S8_V1 } model_type_t;
     HumanFaceDetect(const char *sdcard_model_dir = nullptr,
                     model_type_t model_type = static_cast<model_type_t>(CONFIG_HUMAN_FACE_DETECT_MODEL_TYPE));
+
+    /**
+     * @brief Tell where the next image sits in the full frame, see `human_face_detect::MSRMNP::set_region`.
+     */
+    void set_region(const human_face_detect::region_t &region);
 };
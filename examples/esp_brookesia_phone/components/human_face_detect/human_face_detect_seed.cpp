@@ -0,0 +1,53 @@
+#include "human_face_detect_seed.hpp"
+
+#define SEED_MARGIN_SHIFT    (3)     // Seeds grow by 1/8 of their size on each side
+
+namespace human_face_detect {
+
+void SeedMap::reset(const region_t &region)
+{
+    m_num = 0;
+    m_frame_width = region.frame_width;
+    m_frame_height = region.frame_height;
+}
+
+bool SeedMap::add(const region_t &region, const int box[4])
+{
+    if (m_num >= MAX_SEEDS) {
+        return false;
+    }
+
+    // Leave room for the motion until the next frame, MNP squares and clips the box itself
+    int margin_x = (box[2] - box[0]) >> SEED_MARGIN_SHIFT;
+    int margin_y = (box[3] - box[1]) >> SEED_MARGIN_SHIFT;
+    int *seed = m_seeds[m_num++];
+    seed[0] = region.x + box[0] - margin_x;
+    seed[1] = region.y + box[1] - margin_y;
+    seed[2] = region.x + box[2] + margin_x;
+    seed[3] = region.y + box[3] + margin_y;
+
+    return true;
+}
+
+bool SeedMap::map(const region_t &region, int index, int box[4]) const
+{
+    if ((index < 0) || (index >= m_num) || (region.frame_width != m_frame_width) ||
+            (region.frame_height != m_frame_height)) {
+        return false;
+    }
+
+    const int *seed = m_seeds[index];
+    int center_x = ((seed[0] + seed[2]) >> 1) - region.x;
+    int center_y = ((seed[1] + seed[3]) >> 1) - region.y;
+    if ((center_x < 0) || (center_x >= region.width) || (center_y < 0) || (center_y >= region.height)) {
+        return false;
+    }
+    box[0] = seed[0] - region.x;
+    box[1] = seed[1] - region.y;
+    box[2] = seed[2] - region.x;
+    box[3] = seed[3] - region.y;
+
+    return true;
+}
+
+} // namespace human_face_detect
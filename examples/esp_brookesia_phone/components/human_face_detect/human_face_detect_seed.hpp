@@ -0,0 +1,55 @@
+#pragma once
+
+namespace human_face_detect {
+
+/**
+ * @brief Part of the full frame handed to the detector, in full-frame pixels.
+ */
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+    int frame_width;
+    int frame_height;
+} region_t;
+
+/**
+ * @brief Faces refined in the previous frame, kept in full-frame coordinates so they still seed MNP
+ *        when the analysed region moves or changes size between frames.
+ */
+class SeedMap {
+public:
+    static const int MAX_SEEDS = 10;    // MNP keeps at most 10 faces
+
+    SeedMap() : m_num(0), m_frame_width(0), m_frame_height(0) {};
+
+    /**
+     * @brief Drop the seeds, the next ones belong to the frame `region` is part of.
+     */
+    void reset(const region_t &region);
+
+    /**
+     * @brief Store a face box found in `region`, in region coordinates, grown for the motion until the next frame.
+     *
+     * @return false when the map is full
+     */
+    bool add(const region_t &region, const int box[4]);
+
+    /**
+     * @brief Move a seed into `region` coordinates.
+     *
+     * @return false when the seed comes from another frame size or its center is outside `region`
+     */
+    bool map(const region_t &region, int index, int box[4]) const;
+
+    int size() const { return m_num; }
+
+private:
+    int m_seeds[MAX_SEEDS][4];
+    int m_num;
+    int m_frame_width;
+    int m_frame_height;
+};
+
+} // namespace human_face_detect
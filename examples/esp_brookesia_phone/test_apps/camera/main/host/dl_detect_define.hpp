@@ -0,0 +1,14 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/* Host stand-in: the tracker only uses the plain result blocks, esp-dl results are never built here */
+namespace dl {
+namespace detect {
+struct result_t;
+}
+}
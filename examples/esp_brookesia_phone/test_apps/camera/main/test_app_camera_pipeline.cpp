@@ -0,0 +1,492 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "unity.h"
+#include "app_camera_pipeline.hpp"
+#include "test_pipeline_slist.h"
+
+#define TEST_ELEM_MAX           (8)
+#define TEST_STRESS_FRAMES      (200000)
+#define TEST_FILL_WORDS         (16)        /* Words of the buffer stamped with the sequence number */
+#define TEST_BENCH_FRAMES       (200000)
+#define TEST_BENCH_ELEM_NUM     (4)
+#define TEST_TASK_STACK         (4096)
+#define TEST_TASK_PRIORITY      (5)
+
+enum {
+    TEST_OWNER_NONE = 0,
+    TEST_OWNER_PRODUCER,
+    TEST_OWNER_CONSUMER,
+};
+
+/*
+ * A producer task standing in for the PPA done callback and a consumer task standing in for the detection task.
+ * Every element is owned by at most one side at a time: taking an element that the other side still holds, or
+ * finding its buffer rewritten while holding it, is counted as an error and checked once both tasks are done.
+ */
+typedef struct {
+    pipeline_handle_t pipeline;
+    std::atomic<int> owner[TEST_ELEM_MAX];
+    std::atomic<bool> producer_done;
+    std::atomic<uint32_t> owner_errors;
+    std::atomic<uint32_t> recycled;
+    uint32_t data_errors;
+    uint32_t order_errors;
+    uint32_t pipeline_errors;
+    uint32_t published;
+    uint32_t dropped;
+    uint32_t received;
+    SemaphoreHandle_t exit_sem;
+} test_stress_t;
+
+static void test_take_owner(test_stress_t *s, const camera_pipeline_buffer_element *element, int owner)
+{
+    if (s->owner[element->index].exchange(owner) != TEST_OWNER_NONE) {
+        s->owner_errors++;
+    }
+}
+
+static void test_release_owner(test_stress_t *s, const camera_pipeline_buffer_element *element)
+{
+    s->owner[element->index].store(TEST_OWNER_NONE);
+}
+
+/* Runs in the producer context; the replaced element was only referenced by the pipeline */
+static void test_recycle_cb(camera_pipeline_buffer_element *element, void *user_ctx)
+{
+    test_stress_t *s = static_cast<test_stress_t *>(user_ctx);
+
+    if (s->owner[element->index].load() != TEST_OWNER_NONE) {
+        s->owner_errors++;
+    }
+    s->recycled++;
+}
+
+static void test_producer_task(void *arg)
+{
+    test_stress_t *s = static_cast<test_stress_t *>(arg);
+
+    for (uint32_t seq = 1; seq <= TEST_STRESS_FRAMES; seq++) {
+        camera_pipeline_buffer_element *element = camera_pipeline_get_queued_element(s->pipeline);
+        if (!element) {
+            s->dropped++;
+            taskYIELD();
+            continue;
+        }
+
+        test_take_owner(s, element, TEST_OWNER_PRODUCER);
+        element->frame_seq = seq;
+        for (int w = 0; w < TEST_FILL_WORDS; w++) {
+            element->buffer[w] = (uint16_t)(seq + w);
+        }
+        test_release_owner(s, element);
+        if (camera_pipeline_done_element(s->pipeline, element) != ESP_OK) {
+            s->pipeline_errors++;
+        }
+        s->published++;
+    }
+
+    s->producer_done.store(true);
+    camera_pipeline_wakeup_recv(s->pipeline);
+    xSemaphoreGive(s->exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void test_consumer_task(void *arg)
+{
+    test_stress_t *s = static_cast<test_stress_t *>(arg);
+    uint32_t last_seq = 0;
+
+    while (true) {
+        camera_pipeline_buffer_element *element = camera_pipeline_recv_element(s->pipeline, pdMS_TO_TICKS(10));
+        if (!element) {
+            if (!s->producer_done.load()) {
+                continue;
+            }
+            /* Everything published before `producer_done` is visible to the non-blocking get */
+            element = camera_pipeline_get_done_element(s->pipeline);
+            if (!element) {
+                break;
+            }
+        }
+
+        test_take_owner(s, element, TEST_OWNER_CONSUMER);
+        if (element->frame_seq <= last_seq) {
+            s->order_errors++;
+        }
+        last_seq = element->frame_seq;
+        for (int w = 0; w < TEST_FILL_WORDS; w++) {
+            if (element->buffer[w] != (uint16_t)(element->frame_seq + w)) {
+                s->data_errors++;
+                break;
+            }
+        }
+        test_release_owner(s, element);
+        s->received++;
+        if (camera_pipeline_queue_element_index(s->pipeline, element->index) != ESP_OK) {
+            s->pipeline_errors++;
+        }
+    }
+
+    xSemaphoreGive(s->exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void test_stress_run(camera_pipeline_mode_t mode, int elem_num)
+{
+    test_stress_t *s = new test_stress_t();
+    camera_pipeline_cfg_t cfg = {
+        .elem_num = elem_num,
+        .elements = NULL,
+        .align_size = 4,
+        .caps = 0,
+        .buffer_size = TEST_FILL_WORDS * sizeof(uint16_t),
+        .mode = mode,
+        .recycle_cb = test_recycle_cb,
+        .recycle_ctx = s,
+    };
+
+    s->exit_sem = xSemaphoreCreateCounting(2, 0);
+    TEST_ASSERT_NOT_NULL(s->exit_sem);
+    TEST_ESP_OK(camera_element_pipeline_new(&cfg, &s->pipeline));
+
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(test_consumer_task, "consumer", TEST_TASK_STACK, s, TEST_TASK_PRIORITY, NULL));
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(test_producer_task, "producer", TEST_TASK_STACK, s, TEST_TASK_PRIORITY, NULL));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(s->exit_sem, portMAX_DELAY));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(s->exit_sem, portMAX_DELAY));
+
+    camera_pipeline_stats_t stats;
+    TEST_ESP_OK(camera_pipeline_get_stats(s->pipeline, &stats));
+    printf("%-6s %d elements: %" PRIu32 " published, %" PRIu32 " received, %" PRIu32 " dropped, %" PRIu32 " replaced\n",
+           mode == CAMERA_PIPELINE_MODE_LATEST ? "latest" : "fifo", elem_num, s->published, s->received, s->dropped,
+           stats.overwrite_count);
+
+    TEST_ASSERT_EQUAL(0, s->owner_errors.load());
+    TEST_ASSERT_EQUAL(0, s->data_errors);
+    TEST_ASSERT_EQUAL(0, s->order_errors);
+    TEST_ASSERT_EQUAL(0, s->pipeline_errors);
+    TEST_ASSERT_GREATER_THAN(0, s->received);
+    TEST_ASSERT_EQUAL(TEST_STRESS_FRAMES, s->published + s->dropped);
+    TEST_ASSERT_EQUAL(s->published, stats.done_count);
+    TEST_ASSERT_EQUAL(s->received, stats.recv_count);
+    TEST_ASSERT_EQUAL(s->dropped, stats.drop_count);
+    if (mode == CAMERA_PIPELINE_MODE_LATEST) {
+        TEST_ASSERT_EQUAL(s->published, s->received + stats.overwrite_count);
+        TEST_ASSERT_EQUAL(stats.overwrite_count, s->recycled.load());
+    } else {
+        TEST_ASSERT_EQUAL(s->published, s->received);
+        TEST_ASSERT_EQUAL(0, stats.overwrite_count);
+        TEST_ASSERT_EQUAL(0, s->recycled.load());
+    }
+
+    /* Nothing is lost or handed out twice: every element comes back exactly once */
+    bool seen[TEST_ELEM_MAX] = {false};
+    for (int i = 0; i < elem_num; i++) {
+        camera_pipeline_buffer_element *element = camera_pipeline_get_queued_element(s->pipeline);
+        TEST_ASSERT_NOT_NULL(element);
+        TEST_ASSERT_FALSE(seen[element->index]);
+        seen[element->index] = true;
+    }
+    TEST_ASSERT_NULL(camera_pipeline_get_queued_element(s->pipeline));
+
+    TEST_ESP_OK(camera_element_pipeline_delete(s->pipeline));
+    vSemaphoreDelete(s->exit_sem);
+    delete s;
+}
+
+TEST_CASE("pipeline fifo mode hands every element to one side at a time", "[camera_pipeline]")
+{
+    const int elem_nums[] = {2, 3, TEST_ELEM_MAX};
+
+    for (size_t i = 0; i < sizeof(elem_nums) / sizeof(elem_nums[0]); i++) {
+        test_stress_run(CAMERA_PIPELINE_MODE_FIFO, elem_nums[i]);
+    }
+}
+
+TEST_CASE("pipeline latest mode recycles replaced elements without losing any", "[camera_pipeline]")
+{
+    const int elem_nums[] = {2, 3, TEST_ELEM_MAX};
+
+    for (size_t i = 0; i < sizeof(elem_nums) / sizeof(elem_nums[0]); i++) {
+        test_stress_run(CAMERA_PIPELINE_MODE_LATEST, elem_nums[i]);
+    }
+}
+
+TEST_CASE("pipeline rejects indices out of range and a full queue", "[camera_pipeline]")
+{
+    pipeline_handle_t pipeline = NULL;
+    camera_pipeline_cfg_t cfg = {
+        .elem_num = 4,
+        .elements = NULL,
+        .align_size = 4,
+        .caps = 0,
+        .buffer_size = 16,
+        .mode = CAMERA_PIPELINE_MODE_FIFO,
+        .recycle_cb = NULL,
+        .recycle_ctx = NULL,
+    };
+
+    TEST_ESP_OK(camera_element_pipeline_new(&cfg, &pipeline));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, camera_pipeline_queue_element_index(pipeline, -1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, camera_pipeline_queue_element_index(pipeline, 4));
+
+    /* All 4 elements are queued after creation, which fills the ring */
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, camera_pipeline_queue_element_index(pipeline, 0));
+
+    /* Queued elements come out in the order they went in */
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(i, camera_pipeline_get_queued_element(pipeline)->index);
+    }
+    TEST_ASSERT_NULL(camera_pipeline_get_queued_element(pipeline));
+    TEST_ESP_OK(camera_pipeline_queue_element_index(pipeline, 2));
+    TEST_ESP_OK(camera_pipeline_queue_element_index(pipeline, 0));
+    TEST_ASSERT_EQUAL(2, camera_pipeline_get_queued_element(pipeline)->index);
+    TEST_ASSERT_EQUAL(0, camera_pipeline_get_queued_element(pipeline)->index);
+    TEST_ASSERT_NULL(camera_pipeline_get_queued_element(pipeline));
+    TEST_ASSERT_NULL(camera_pipeline_recv_element(pipeline, 0));
+
+    TEST_ESP_OK(camera_element_pipeline_delete(pipeline));
+}
+
+/* The same producer and consumer loops run against both pipelines, through index based entry points */
+typedef struct {
+    const char *name;
+    void *(*create)(int elem_num);
+    void (*destroy)(void *pipeline);
+    int (*get_queued)(void *pipeline);
+    void (*done)(void *pipeline, int index);
+    int (*recv)(void *pipeline, uint32_t ticks);
+    void (*queue)(void *pipeline, int index);
+    void (*wakeup)(void *pipeline);
+} test_pipeline_ops_t;
+
+static void *test_ring_create(int elem_num)
+{
+    pipeline_handle_t pipeline = NULL;
+    camera_pipeline_cfg_t cfg = {
+        .elem_num = elem_num,
+        .elements = NULL,
+        .align_size = 4,
+        .caps = 0,
+        .buffer_size = 16,
+        .mode = CAMERA_PIPELINE_MODE_FIFO,
+        .recycle_cb = NULL,
+        .recycle_ctx = NULL,
+    };
+
+    TEST_ESP_OK(camera_element_pipeline_new(&cfg, &pipeline));
+    return pipeline;
+}
+
+static void test_ring_destroy(void *pipeline)
+{
+    camera_element_pipeline_delete(pipeline);
+}
+
+/* Only used from the producer task, between getting an element and marking it done */
+static camera_pipeline_buffer_element *test_ring_elements[TEST_BENCH_ELEM_NUM];
+
+static int test_ring_get_queued(void *pipeline)
+{
+    camera_pipeline_buffer_element *element = camera_pipeline_get_queued_element(pipeline);
+    if (!element) {
+        return -1;
+    }
+    test_ring_elements[element->index] = element;
+    return element->index;
+}
+
+static void test_ring_done(void *pipeline, int index)
+{
+    camera_pipeline_done_element(pipeline, test_ring_elements[index]);
+}
+
+static int test_ring_recv(void *pipeline, uint32_t ticks)
+{
+    camera_pipeline_buffer_element *element = camera_pipeline_recv_element(pipeline, ticks);
+    return element ? (int)element->index : -1;
+}
+
+static void test_ring_queue(void *pipeline, int index)
+{
+    camera_pipeline_queue_element_index(pipeline, index);
+}
+
+static void test_ring_wakeup(void *pipeline)
+{
+    camera_pipeline_wakeup_recv(pipeline);
+}
+
+static void *test_slist_create(int elem_num)
+{
+    return test_slist_pipeline_new(elem_num);
+}
+
+static void test_slist_destroy(void *pipeline)
+{
+    test_slist_pipeline_delete(static_cast<test_slist_handle_t>(pipeline));
+}
+
+static int test_slist_get_queued(void *pipeline)
+{
+    return test_slist_get_queued_element(static_cast<test_slist_handle_t>(pipeline));
+}
+
+static void test_slist_done(void *pipeline, int index)
+{
+    test_slist_done_element(static_cast<test_slist_handle_t>(pipeline), index);
+}
+
+static int test_slist_recv(void *pipeline, uint32_t ticks)
+{
+    return test_slist_recv_element(static_cast<test_slist_handle_t>(pipeline), ticks);
+}
+
+static void test_slist_queue(void *pipeline, int index)
+{
+    test_slist_queue_element_index(static_cast<test_slist_handle_t>(pipeline), index);
+}
+
+static void test_slist_wakeup(void *pipeline)
+{
+    test_slist_wakeup_recv(static_cast<test_slist_handle_t>(pipeline));
+}
+
+static const test_pipeline_ops_t test_ring_ops = {
+    "spsc rings", test_ring_create, test_ring_destroy, test_ring_get_queued, test_ring_done, test_ring_recv,
+    test_ring_queue, test_ring_wakeup,
+};
+
+static const test_pipeline_ops_t test_slist_ops = {
+    "slist/portmux", test_slist_create, test_slist_destroy, test_slist_get_queued, test_slist_done, test_slist_recv,
+    test_slist_queue, test_slist_wakeup,
+};
+
+typedef struct {
+    const test_pipeline_ops_t *ops;
+    void *pipeline;
+    uint32_t *producer_cycles;              /* get queued + done, per frame */
+    uint32_t *handoff_cycles;               /* done to received, per received frame */
+    uint32_t stamp[TEST_BENCH_ELEM_NUM];
+    uint32_t dropped;
+    uint32_t received;
+    std::atomic<bool> stop;
+    SemaphoreHandle_t exit_sem;
+} test_bench_t;
+
+static void test_bench_producer_task(void *arg)
+{
+    test_bench_t *b = static_cast<test_bench_t *>(arg);
+
+    for (int i = 0; i < TEST_BENCH_FRAMES; i++) {
+        uint32_t start = esp_cpu_get_cycle_count();
+        int index = b->ops->get_queued(b->pipeline);
+        if (index >= 0) {
+            b->stamp[index] = start;
+            b->ops->done(b->pipeline, index);
+        }
+        b->producer_cycles[i] = esp_cpu_get_cycle_count() - start;
+        if (index < 0) {
+            b->dropped++;
+            taskYIELD();
+        }
+    }
+
+    b->stop.store(true);
+    b->ops->wakeup(b->pipeline);
+    xSemaphoreGive(b->exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void test_bench_consumer_task(void *arg)
+{
+    test_bench_t *b = static_cast<test_bench_t *>(arg);
+
+    while (true) {
+        int index = b->ops->recv(b->pipeline, pdMS_TO_TICKS(100));
+        if (index < 0) {
+            if (b->stop.load()) {
+                break;
+            }
+            continue;
+        }
+        b->handoff_cycles[b->received++] = esp_cpu_get_cycle_count() - b->stamp[index];
+        b->ops->queue(b->pipeline, index);
+    }
+
+    xSemaphoreGive(b->exit_sem);
+    vTaskDelete(NULL);
+}
+
+static uint32_t test_percentile(uint32_t *samples, uint32_t num, uint32_t percent)
+{
+    return samples[std::min(num - 1, (uint32_t)((uint64_t)num * percent / 100))];
+}
+
+static void test_bench_run(const test_pipeline_ops_t *ops)
+{
+    test_bench_t *b = new test_bench_t();
+
+    b->ops = ops;
+    b->producer_cycles = static_cast<uint32_t *>(malloc(TEST_BENCH_FRAMES * sizeof(uint32_t)));
+    b->handoff_cycles = static_cast<uint32_t *>(malloc(TEST_BENCH_FRAMES * sizeof(uint32_t)));
+    b->exit_sem = xSemaphoreCreateCounting(2, 0);
+    TEST_ASSERT_NOT_NULL(b->producer_cycles);
+    TEST_ASSERT_NOT_NULL(b->handoff_cycles);
+    TEST_ASSERT_NOT_NULL(b->exit_sem);
+    b->pipeline = ops->create(TEST_BENCH_ELEM_NUM);
+
+    int64_t start_us = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(test_bench_consumer_task, "consumer", TEST_TASK_STACK, b, TEST_TASK_PRIORITY,
+                                          NULL));
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(test_bench_producer_task, "producer", TEST_TASK_STACK, b, TEST_TASK_PRIORITY,
+                                          NULL));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(b->exit_sem, portMAX_DELAY));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(b->exit_sem, portMAX_DELAY));
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    TEST_ASSERT_GREATER_THAN(0, b->received);
+    std::sort(b->producer_cycles, b->producer_cycles + TEST_BENCH_FRAMES);
+    std::sort(b->handoff_cycles, b->handoff_cycles + b->received);
+    printf("%-14s %9.0f frames/s, %4.1f%% dropped, producer p50 %4" PRIu32 " p99 %5" PRIu32 " max %7" PRIu32
+           ", handoff p50 %6" PRIu32 " p99 %7" PRIu32 " max %8" PRIu32 " cycles\n",
+           ops->name, b->received * 1e6 / elapsed_us, 100.0 * b->dropped / TEST_BENCH_FRAMES,
+           test_percentile(b->producer_cycles, TEST_BENCH_FRAMES, 50),
+           test_percentile(b->producer_cycles, TEST_BENCH_FRAMES, 99), b->producer_cycles[TEST_BENCH_FRAMES - 1],
+           test_percentile(b->handoff_cycles, b->received, 50), test_percentile(b->handoff_cycles, b->received, 99),
+           b->handoff_cycles[b->received - 1]);
+
+    ops->destroy(b->pipeline);
+    vSemaphoreDelete(b->exit_sem);
+    free(b->producer_cycles);
+    free(b->handoff_cycles);
+    delete b;
+}
+
+TEST_CASE("pipeline throughput and tail latency against the slist pipeline", "[camera_pipeline][performance]")
+{
+    printf("%d frames through %d elements, producer never waits\n", TEST_BENCH_FRAMES, TEST_BENCH_ELEM_NUM);
+    test_bench_run(&test_slist_ops);
+    test_bench_run(&test_ring_ops);
+}
+
+extern "C" void app_main(void)
+{
+    printf("camera host test, cycles are nanoseconds on the linux target\n");
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    UNITY_END();
+}
@@ -0,0 +1,239 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "unity.h"
+#include "app_frame_scaler_sw.h"
+
+#define TEST_WIDTH              (1280)      /* The camera frame size set up in main.cpp */
+#define TEST_HEIGHT             (720)
+#define TEST_ODD_WIDTH          (1286)      /* Not a multiple of 4 */
+#define TEST_ODD_HEIGHT         (723)
+#define TEST_BENCH_RUNS         (50)
+
+static uint32_t test_rand_state;
+
+static uint16_t test_rand_pixel(void)
+{
+    test_rand_state = test_rand_state * 1664525 + 1013904223;
+    return (uint16_t)(test_rand_state >> 16);
+}
+
+/* A frame of random pixels, allocated to its exact size so that reads past the end show up under a sanitizer */
+static uint16_t *test_make_frame(uint32_t width, uint32_t height)
+{
+    uint16_t *frame = malloc(width * height * sizeof(uint16_t));
+
+    TEST_ASSERT_NOT_NULL(frame);
+    test_rand_state = width * height;
+    for (uint32_t i = 0; i < width * height; i++) {
+        frame[i] = test_rand_pixel();
+    }
+    return frame;
+}
+
+/*
+ * Output pixel (x, y) of a 1 / `div` scale is source pixel (x * div, y * div) when the frame size is a multiple of
+ * `div`, otherwise the ratio of the frame sizes spreads the skipped source columns and rows over the frame
+ */
+static void test_check_scale(uint32_t width, uint32_t height, uint32_t div, bool byte_swap)
+{
+    const uint32_t dst_width = width / div;
+    const uint32_t dst_height = height / div;
+    uint16_t *src = test_make_frame(width, height);
+    uint16_t *dst = malloc(dst_width * dst_height * sizeof(uint16_t));
+
+    TEST_ASSERT_NOT_NULL(dst);
+    app_frame_scale_rgb565_sw(src, width, height, dst, dst_width, dst_height, byte_swap);
+
+    for (uint32_t y = 0; y < dst_height; y++) {
+        for (uint32_t x = 0; x < dst_width; x++) {
+            const uint32_t src_x = (width % div) ? x * width / dst_width : x * div;
+            const uint32_t src_y = (height % div) ? y * height / dst_height : y * div;
+            uint16_t expected = src[src_y * width + src_x];
+            if (byte_swap) {
+                expected = (uint16_t)((expected << 8) | (expected >> 8));
+            }
+            if (dst[y * dst_width + x] != expected) {
+                printf("%" PRIu32 "x%" PRIu32 " / %" PRIu32 ": pixel (%" PRIu32 ", %" PRIu32 ") is 0x%04x, expected 0x%04x\n",
+                       width, height, div, x, y, dst[y * dst_width + x], expected);
+                TEST_FAIL();
+            }
+        }
+    }
+
+    free(src);
+    free(dst);
+}
+
+TEST_CASE("software scaler halves and quarters a frame", "[frame_scaler]")
+{
+    const uint32_t divs[] = {2, 4};
+
+    for (int i = 0; i < sizeof(divs) / sizeof(divs[0]); i++) {
+        test_check_scale(TEST_WIDTH, TEST_HEIGHT, divs[i], false);
+        test_check_scale(TEST_WIDTH, TEST_HEIGHT, divs[i], true);
+        test_check_scale(TEST_ODD_WIDTH, TEST_ODD_HEIGHT, divs[i], false);
+        test_check_scale(TEST_ODD_WIDTH, TEST_ODD_HEIGHT, divs[i], true);
+    }
+}
+
+TEST_CASE("software scaler copies a frame at scale 1", "[frame_scaler]")
+{
+    uint16_t *src = test_make_frame(TEST_ODD_WIDTH, TEST_ODD_HEIGHT);
+    uint16_t *dst = malloc(TEST_ODD_WIDTH * TEST_ODD_HEIGHT * sizeof(uint16_t));
+
+    TEST_ASSERT_NOT_NULL(dst);
+    app_frame_scale_rgb565_sw(src, TEST_ODD_WIDTH, TEST_ODD_HEIGHT, dst, TEST_ODD_WIDTH, TEST_ODD_HEIGHT, false);
+    TEST_ASSERT_EQUAL_MEMORY(src, dst, TEST_ODD_WIDTH * TEST_ODD_HEIGHT * sizeof(uint16_t));
+
+    free(src);
+    free(dst);
+}
+
+TEST_CASE("software scaler samples only the picture of a frame with padded rows", "[frame_scaler]")
+{
+    const uint32_t stride = TEST_ODD_WIDTH + 10;
+    const uint32_t dst_width = TEST_ODD_WIDTH / 4;
+    const uint32_t dst_height = TEST_ODD_HEIGHT / 4;
+    uint16_t *padded = test_make_frame(stride, TEST_ODD_HEIGHT + 13);
+    uint16_t *src = malloc(TEST_ODD_WIDTH * TEST_ODD_HEIGHT * sizeof(uint16_t));
+    uint16_t *expected = malloc(dst_width * dst_height * sizeof(uint16_t));
+    uint16_t *dst = malloc(dst_width * dst_height * sizeof(uint16_t));
+
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(expected);
+    TEST_ASSERT_NOT_NULL(dst);
+    for (uint32_t y = 0; y < TEST_ODD_HEIGHT; y++) {
+        memcpy(src + y * TEST_ODD_WIDTH, padded + y * stride, TEST_ODD_WIDTH * sizeof(uint16_t));
+    }
+    app_frame_scale_rgb565_sw(src, TEST_ODD_WIDTH, TEST_ODD_HEIGHT, expected, dst_width, dst_height, true);
+    app_frame_scale_rgb565_sw_stride(padded, stride, TEST_ODD_WIDTH, TEST_ODD_HEIGHT, dst, dst_width, dst_height,
+                                     true);
+    TEST_ASSERT_EQUAL_MEMORY(expected, dst, dst_width * dst_height * sizeof(uint16_t));
+
+    free(padded);
+    free(src);
+    free(expected);
+    free(dst);
+}
+
+TEST_CASE("scaler fit gives the exact output size on the PPA scale grid", "[frame_scaler]")
+{
+    /* Source, output, then the expected block and scale: integer ratios keep the whole frame */
+    const uint32_t cases[][5] = {
+        {1280, 224, 42, 1195, 3},
+        {720, 224, 1, 717, 5},
+        {1280, 640, 0, 1280, 8},
+        {720, 180, 0, 720, 4},
+        {224, 224, 0, 224, 16},
+        {TEST_ODD_WIDTH, 321, 1, 1284, 4},
+    };
+
+    for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint32_t offset, size, steps;
+        TEST_ASSERT_TRUE(app_frame_scaler_fit(cases[i][0], cases[i][1], &offset, &size, &steps));
+        TEST_ASSERT_EQUAL_UINT32(cases[i][2], offset);
+        TEST_ASSERT_EQUAL_UINT32(cases[i][3], size);
+        TEST_ASSERT_EQUAL_UINT32(cases[i][4], steps);
+        /* What the PPA writes from that block */
+        TEST_ASSERT_EQUAL_UINT32(cases[i][1], size * steps / APP_FRAME_SCALER_STEPS);
+        TEST_ASSERT_TRUE(offset + size <= cases[i][0]);
+    }
+
+    uint32_t offset, size, steps;
+    TEST_ASSERT_FALSE(app_frame_scaler_fit(224, 225, &offset, &size, &steps));
+    TEST_ASSERT_FALSE(app_frame_scaler_fit(224, 0, &offset, &size, &steps));
+}
+
+TEST_CASE("software scaler writes a block as RGB888 in the model channel order", "[frame_scaler]")
+{
+    /* 4 x 2 frame, the block is its 2 x 2 right half, scaled 1:1 */
+    const uint16_t src[8] = {
+        0x0000, 0x0000, 0xF800, 0x07E0,
+        0x0000, 0x0000, 0x001F, 0x8410,
+    };
+    const app_frame_scaler_block_t block = {2, 0, 2, 2};
+    const uint8_t expected_rgb[12] = {
+        0xF8, 0x00, 0x00, 0x00, 0xFC, 0x00,
+        0x00, 0x00, 0xF8, 0x80, 0x80, 0x80,
+    };
+    uint8_t dst[12];
+
+    app_frame_scale_sw(src, 4, &block, dst, 2, 2, APP_FRAME_SCALER_FMT_RGB888, false, false);
+    TEST_ASSERT_EQUAL_MEMORY(expected_rgb, dst, sizeof(dst));
+
+    /* B, G, R order */
+    app_frame_scale_sw(src, 4, &block, dst, 2, 2, APP_FRAME_SCALER_FMT_RGB888, false, true);
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_HEX8(expected_rgb[i * 3 + 2], dst[i * 3]);
+        TEST_ASSERT_EQUAL_HEX8(expected_rgb[i * 3 + 1], dst[i * 3 + 1]);
+        TEST_ASSERT_EQUAL_HEX8(expected_rgb[i * 3], dst[i * 3 + 2]);
+    }
+
+    /* A big endian source gives the same colors */
+    uint16_t swapped[8];
+    for (int i = 0; i < 8; i++) {
+        swapped[i] = (uint16_t)((src[i] << 8) | (src[i] >> 8));
+    }
+    app_frame_scale_sw(swapped, 4, &block, dst, 2, 2, APP_FRAME_SCALER_FMT_RGB888, true, false);
+    TEST_ASSERT_EQUAL_MEMORY(expected_rgb, dst, sizeof(dst));
+}
+
+TEST_CASE("software scaler samples the fitted block of a frame", "[frame_scaler]")
+{
+    app_frame_scaler_block_t block;
+    uint32_t steps;
+    uint16_t *src = test_make_frame(TEST_WIDTH, TEST_HEIGHT);
+    uint16_t *dst = malloc(224 * 224 * sizeof(uint16_t));
+
+    TEST_ASSERT_NOT_NULL(dst);
+    TEST_ASSERT_TRUE(app_frame_scaler_fit(TEST_WIDTH, 224, &block.x, &block.width, &steps));
+    TEST_ASSERT_TRUE(app_frame_scaler_fit(TEST_HEIGHT, 224, &block.y, &block.height, &steps));
+    app_frame_scale_sw(src, TEST_WIDTH, &block, dst, 224, 224, APP_FRAME_SCALER_FMT_RGB565, false, false);
+
+    for (uint32_t y = 0; y < 224; y++) {
+        for (uint32_t x = 0; x < 224; x++) {
+            const uint32_t src_x = block.x + x * block.width / 224;
+            const uint32_t src_y = block.y + y * block.height / 224;
+            TEST_ASSERT_EQUAL_HEX16(src[src_y * TEST_WIDTH + src_x], dst[y * 224 + x]);
+        }
+    }
+
+    free(src);
+    free(dst);
+}
+
+TEST_CASE("software scaler cycles per output pixel", "[frame_scaler][performance]")
+{
+    uint16_t *src = test_make_frame(TEST_WIDTH, TEST_HEIGHT);
+    uint16_t *dst = malloc(TEST_WIDTH / 2 * TEST_HEIGHT / 2 * sizeof(uint16_t));
+
+    TEST_ASSERT_NOT_NULL(dst);
+    for (uint32_t div = 2; div <= 4; div *= 2) {
+        const uint32_t dst_width = TEST_WIDTH / div;
+        const uint32_t dst_height = TEST_HEIGHT / div;
+
+        for (int byte_swap = 0; byte_swap < 2; byte_swap++) {
+            uint64_t cycles = 0;
+            for (int r = 0; r < TEST_BENCH_RUNS; r++) {
+                uint32_t start = esp_cpu_get_cycle_count();
+                app_frame_scale_rgb565_sw(src, TEST_WIDTH, TEST_HEIGHT, dst, dst_width, dst_height, byte_swap);
+                cycles += esp_cpu_get_cycle_count() - start;
+            }
+            printf("%dx%d / %" PRIu32 "%s: %" PRIu64 " cycles per frame, %.2f per output pixel\n", TEST_WIDTH,
+                   TEST_HEIGHT, div, byte_swap ? " with byte swap" : "", cycles / TEST_BENCH_RUNS,
+                   (double)cycles / TEST_BENCH_RUNS / (dst_width * dst_height));
+        }
+    }
+
+    free(src);
+    free(dst);
+}
@@ -0,0 +1,30 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "unity.h"
+#include "app_latency_stats.h"
+
+TEST_CASE("latency summary keeps the samples a logged line reports", "[latency_stats]")
+{
+    app_latency_summary_t summary;
+
+    app_latency_reset();
+    for (uint32_t us = 1; us <= 100; us++) {
+        app_latency_record(APP_LATENCY_STAGE_REFRESH, us * 10);
+    }
+    app_latency_log_periodic(0);
+    app_latency_record(APP_LATENCY_STAGE_REFRESH, 5000);
+
+    TEST_ASSERT_EQUAL(ESP_OK, app_latency_get_summary(APP_LATENCY_STAGE_REFRESH, &summary));
+    TEST_ASSERT_EQUAL_UINT32(101, summary.count);
+    TEST_ASSERT_EQUAL_UINT32(5000, summary.max);
+    TEST_ASSERT_UINT32_WITHIN(500 / 8, 500, summary.p50);
+
+    app_latency_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, app_latency_get_summary(APP_LATENCY_STAGE_REFRESH, &summary));
+    TEST_ASSERT_EQUAL_UINT32(0, summary.count);
+    TEST_ASSERT_EQUAL_UINT32(0, summary.max);
+}
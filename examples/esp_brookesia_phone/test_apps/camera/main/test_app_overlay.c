@@ -0,0 +1,251 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "unity.h"
+#include "app_overlay.h"
+
+#define TEST_WIDTH              (16)
+#define TEST_HEIGHT             (9)
+#define TEST_PADDING            (6)         /* Bytes after every line, keeps RGB565 lines 2-byte aligned only */
+#define TEST_OFFSET             (2)         /* First pixel off the word boundary */
+#define TEST_GUARD_SIZE         (16)
+#define TEST_GUARD              (0x55)
+#define TEST_COLOR              APP_OVERLAY_RGB(0xFF, 0x80, 0x10)
+#define TEST_BENCH_WIDTH        (1280)
+#define TEST_BENCH_HEIGHT       (720)
+#define TEST_BENCH_RUNS         (20)
+#define TEST_BENCH_BOXES        (50)
+
+typedef struct {
+    const char *name;
+    app_overlay_fmt_t format;
+    bool swap_bytes;
+    int bpp;
+    uint8_t bytes[3];                       /* TEST_COLOR as stored in memory, on a little endian CPU */
+} test_format_t;
+
+static const test_format_t test_formats[] = {
+    {"rgb565", APP_OVERLAY_FMT_RGB565, false, 2, {0x02, 0xFC}},
+    {"rgb565 swapped", APP_OVERLAY_FMT_RGB565, true, 2, {0xFC, 0x02}},
+    {"rgb888", APP_OVERLAY_FMT_RGB888, false, 3, {0xFF, 0x80, 0x10}},
+    {"bgr888", APP_OVERLAY_FMT_RGB888, true, 3, {0x10, 0x80, 0xFF}},
+};
+
+typedef void (*test_draw_fn_t)(const app_overlay_canvas_t *canvas);
+
+/*
+ * Draw on a black canvas surrounded by guard bytes and compare it with a golden image, '#' for TEST_COLOR and '.'
+ * for black. The line padding and the guard bytes must be left untouched.
+ */
+static void test_check_golden(const test_format_t *f, test_draw_fn_t draw, const char *const golden[TEST_HEIGHT])
+{
+    const int stride = TEST_WIDTH * f->bpp + TEST_PADDING;
+    const size_t size = TEST_OFFSET + TEST_HEIGHT * stride + TEST_GUARD_SIZE;
+    uint8_t *memory = malloc(size);
+    app_overlay_canvas_t canvas = {
+        .buffer = memory + TEST_OFFSET,
+        .width = TEST_WIDTH,
+        .height = TEST_HEIGHT,
+        .stride = stride,
+        .format = f->format,
+        .swap_bytes = f->swap_bytes,
+    };
+    char image[TEST_HEIGHT][TEST_WIDTH + 1] = {0};
+    bool match = true;
+
+    TEST_ASSERT_NOT_NULL(memory);
+    memset(memory, TEST_GUARD, size);
+    for (int y = 0; y < TEST_HEIGHT; y++) {
+        memset(canvas.buffer + y * stride, 0, TEST_WIDTH * f->bpp);
+    }
+    draw(&canvas);
+
+    for (int y = 0; y < TEST_HEIGHT; y++) {
+        const uint8_t *row = canvas.buffer + y * stride;
+
+        for (int x = 0; x < TEST_WIDTH; x++) {
+            const uint8_t *pixel = row + x * f->bpp;
+            static const uint8_t black[3] = {0};
+            image[y][x] = !memcmp(pixel, f->bytes, f->bpp) ? '#' : !memcmp(pixel, black, f->bpp) ? '.' : '?';
+        }
+        if (strcmp(image[y], golden[y])) {
+            match = false;
+        }
+        for (int i = TEST_WIDTH * f->bpp; i < stride; i++) {
+            TEST_ASSERT_EQUAL_HEX8(TEST_GUARD, row[i]);
+        }
+    }
+    for (int i = 0; i < TEST_OFFSET; i++) {
+        TEST_ASSERT_EQUAL_HEX8(TEST_GUARD, memory[i]);
+    }
+    for (size_t i = TEST_OFFSET + TEST_HEIGHT * stride; i < size; i++) {
+        TEST_ASSERT_EQUAL_HEX8(TEST_GUARD, memory[i]);
+    }
+    free(memory);
+
+    if (!match) {
+        printf("%s, drawn and golden:\n", f->name);
+        for (int y = 0; y < TEST_HEIGHT; y++) {
+            printf("%s   %s\n", image[y], golden[y]);
+        }
+        TEST_FAIL();
+    }
+}
+
+static void test_check_golden_all_formats(test_draw_fn_t draw, const char *const golden[TEST_HEIGHT])
+{
+    for (int i = 0; i < sizeof(test_formats) / sizeof(test_formats[0]); i++) {
+        test_check_golden(&test_formats[i], draw, golden);
+    }
+}
+
+static void test_draw_boxes(const app_overlay_canvas_t *canvas)
+{
+    app_overlay_draw_box(canvas, -2, -2, 4, 3, 2, TEST_COLOR);      /* Top left corner off the canvas */
+    app_overlay_draw_box(canvas, 19, 12, 10, 5, 1, TEST_COLOR);     /* Bottom right corner off, corners swapped */
+    app_overlay_draw_box(canvas, 7, 6, 8, 7, 1, TEST_COLOR);        /* Too small for a hole: filled */
+    app_overlay_draw_box(canvas, 16, 0, 30, 5, 1, TEST_COLOR);      /* Right of the canvas */
+    app_overlay_draw_box(canvas, 0, -8, 5, -1, 1, TEST_COLOR);      /* Above the canvas */
+}
+
+TEST_CASE("overlay boxes are clipped at the canvas edges", "[overlay]")
+{
+    static const char *const golden[TEST_HEIGHT] = {
+        "...##...........",
+        "...##...........",
+        "#####...........",
+        "#####...........",
+        "................",
+        "..........######",
+        ".......##.#.....",
+        ".......##.#.....",
+        "..........#.....",
+    };
+
+    test_check_golden_all_formats(test_draw_boxes, golden);
+}
+
+static void test_draw_text(const app_overlay_canvas_t *canvas)
+{
+    app_overlay_draw_text(canvas, -3, -2, "A1", 1, TEST_COLOR);     /* Cut on the left and at the top */
+    app_overlay_draw_text(canvas, 12, 5, "7", 2, TEST_COLOR);       /* Cut on the right and at the bottom */
+    app_overlay_draw_text(canvas, 5, 10, "8", 1, TEST_COLOR);       /* Below the canvas */
+}
+
+TEST_CASE("overlay text is clipped at the canvas edges", "[overlay]")
+{
+    static const char *const golden[TEST_HEIGHT] = {
+        ".#...#..........",
+        ".#...#..........",
+        "##...#..........",
+        ".#...#..........",
+        ".#..###.........",
+        "............####",
+        "............####",
+        "................",
+        "................",
+    };
+
+    test_check_golden_all_formats(test_draw_text, golden);
+}
+
+static void test_draw_points(const app_overlay_canvas_t *canvas)
+{
+    app_overlay_draw_point(canvas, 0, 0, 1, TEST_COLOR);            /* Corners */
+    app_overlay_draw_point(canvas, 15, 8, 1, TEST_COLOR);
+    app_overlay_draw_point(canvas, -1, 4, 1, TEST_COLOR);           /* Center just off the left edge */
+    app_overlay_draw_point(canvas, 8, -1, 1, TEST_COLOR);           /* Center just off the top edge */
+    app_overlay_draw_point(canvas, 16, 4, 1, TEST_COLOR);           /* Center just off the right edge */
+    app_overlay_draw_point(canvas, 15, 0, 0, TEST_COLOR);           /* A single pixel */
+    app_overlay_draw_point(canvas, 8, 11, 1, TEST_COLOR);           /* Below the canvas */
+    app_overlay_draw_point(canvas, 5, 5, -1, TEST_COLOR);           /* Negative radius: nothing */
+}
+
+TEST_CASE("overlay keypoints are clipped at the canvas edges", "[overlay]")
+{
+    static const char *const golden[TEST_HEIGHT] = {
+        "##.....###.....#",
+        "##..............",
+        "................",
+        "#..............#",
+        "#..............#",
+        "#..............#",
+        "................",
+        "..............##",
+        "..............##",
+    };
+
+    test_check_golden_all_formats(test_draw_points, golden);
+}
+
+static uint32_t test_bench_cycles(const app_overlay_canvas_t *canvas, test_draw_fn_t draw)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    for (int r = 0; r < TEST_BENCH_RUNS; r++) {
+        draw(canvas);
+    }
+    return (esp_cpu_get_cycle_count() - start) / TEST_BENCH_RUNS;
+}
+
+static void test_bench_fill(const app_overlay_canvas_t *canvas)
+{
+    app_overlay_fill_rect(canvas, 0, 0, TEST_BENCH_WIDTH - 1, TEST_BENCH_HEIGHT - 1, TEST_COLOR);
+}
+
+/* Detection boxes of 200 x 150 with a 3 pixel line, spread over the frame and some cut by the edges */
+static void test_bench_boxes(const app_overlay_canvas_t *canvas)
+{
+    for (int i = 0; i < TEST_BENCH_BOXES; i++) {
+        int x = (i * 97) % (TEST_BENCH_WIDTH + 100) - 100;
+        int y = (i * 61) % (TEST_BENCH_HEIGHT + 75) - 75;
+        app_overlay_draw_box(canvas, x, y, x + 199, y + 149, 3, TEST_COLOR);
+    }
+}
+
+static void test_bench_text(const app_overlay_canvas_t *canvas)
+{
+    for (int i = 0; i < TEST_BENCH_BOXES; i++) {
+        app_overlay_draw_text(canvas, (i * 97) % TEST_BENCH_WIDTH, (i * 61) % TEST_BENCH_HEIGHT, "PERSON 87%", 2,
+                              TEST_COLOR);
+    }
+}
+
+TEST_CASE("overlay fill rate", "[overlay][performance]")
+{
+    const int box_pixels = 2 * 3 * 200 + 2 * 3 * (150 - 6);
+    int text_width, text_height;
+
+    app_overlay_get_text_size("PERSON 87%", 2, &text_width, &text_height);
+    for (int i = 0; i < sizeof(test_formats) / sizeof(test_formats[0]); i += 2) {
+        const test_format_t *f = &test_formats[i];
+        uint8_t *buffer = calloc(TEST_BENCH_WIDTH * TEST_BENCH_HEIGHT, f->bpp);
+        const app_overlay_canvas_t canvas = {
+            .buffer = buffer,
+            .width = TEST_BENCH_WIDTH,
+            .height = TEST_BENCH_HEIGHT,
+            .stride = 0,
+            .format = f->format,
+            .swap_bytes = false,
+        };
+
+        TEST_ASSERT_NOT_NULL(buffer);
+        uint32_t fill = test_bench_cycles(&canvas, test_bench_fill);
+        uint32_t boxes = test_bench_cycles(&canvas, test_bench_boxes);
+        uint32_t text = test_bench_cycles(&canvas, test_bench_text);
+        printf("%-6s frame fill %8" PRIu32 " cycles, %.3f per pixel; %d boxes %6" PRIu32 " cycles, %.2f per box pixel; "
+               "%d labels %6" PRIu32 " cycles, %.2f per label pixel\n", f->name, fill,
+               (double)fill / (TEST_BENCH_WIDTH * TEST_BENCH_HEIGHT), TEST_BENCH_BOXES, boxes,
+               (double)boxes / (TEST_BENCH_BOXES * box_pixels), TEST_BENCH_BOXES, text,
+               (double)text / (TEST_BENCH_BOXES * text_width * text_height));
+        free(buffer);
+    }
+}
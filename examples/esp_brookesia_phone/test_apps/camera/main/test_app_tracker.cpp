@@ -0,0 +1,271 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "unity.h"
+#include "app_tracker.hpp"
+
+#define TEST_MATCH_PX           (12)        /* Largest distance between a tracked box center and the true one */
+#define TEST_BENCH_FRAMES       (1000)
+#define TEST_BENCH_PERIOD_US    (33333)     /* 30 fps */
+
+typedef struct {
+    int32_t time_ms;
+    uint8_t count;
+    int16_t box[2][4];
+} test_frame_t;
+
+/*
+ * Pedestrian detections at 10 fps, as logged from the detect task. Walker A (80 x 160) moves right at 200 px/s and
+ * is missed from 500 to 700 ms. Walker B (70 x 150) moves left at 150 px/s, is listed first at 100 ms and leaves
+ * after 900 ms. At 1700 ms walker C shows up where B was last seen.
+ */
+static const test_frame_t test_recording[] = {
+    {0,    2, {{100, 200, 180, 360}, {900, 220, 970, 370}}},
+    {100,  2, {{885, 220, 955, 370}, {120, 200, 200, 360}}},
+    {200,  2, {{140, 200, 220, 360}, {870, 220, 940, 370}}},
+    {300,  2, {{160, 200, 240, 360}, {855, 220, 925, 370}}},
+    {400,  2, {{180, 200, 260, 360}, {840, 220, 910, 370}}},
+    {500,  1, {{825, 220, 895, 370}}},
+    {600,  1, {{810, 220, 880, 370}}},
+    {700,  1, {{795, 220, 865, 370}}},
+    {800,  2, {{260, 200, 340, 360}, {780, 220, 850, 370}}},
+    {900,  2, {{280, 200, 360, 360}, {765, 220, 835, 370}}},
+    {1000, 1, {{300, 200, 380, 360}}},
+    {1100, 1, {{320, 200, 400, 360}}},
+    {1200, 1, {{340, 200, 420, 360}}},
+    {1300, 1, {{360, 200, 440, 360}}},
+    {1400, 1, {{380, 200, 460, 360}}},
+    {1500, 1, {{400, 200, 480, 360}}},
+    {1600, 1, {{420, 200, 500, 360}}},
+    {1700, 2, {{440, 200, 520, 360}, {765, 220, 835, 370}}},
+};
+
+#define TEST_FRAME_NUM          (sizeof(test_recording) / sizeof(test_recording[0]))
+#define TEST_B_LAST_FRAME       (9)
+#define TEST_C_FRAME            (17)
+
+static float test_a_cx(int32_t time_ms)
+{
+    return 140 + 0.2f * time_ms;
+}
+
+static float test_b_cx(int32_t time_ms)
+{
+    return 935 - 0.15f * time_ms;
+}
+
+static void test_feed(app_tracker_handle_t tracker, const test_frame_t *frame)
+{
+    app_detect_result_t detections = {};
+
+    detections.timestamp_us = frame->time_ms * 1000LL;
+    detections.count = frame->count;
+    for (int i = 0; i < frame->count; i++) {
+        memcpy(detections.objects[i].box, frame->box[i], sizeof(frame->box[i]));
+        detections.objects[i].model = APP_DETECT_MODEL_PEDESTRIAN;
+        detections.objects[i].score = 80;
+    }
+    app_tracker_update(tracker, &detections);
+}
+
+/* The tracked object centered near (cx, cy), NULL if there is none */
+static const app_detect_object_t *test_find(const app_detect_result_t *result, float cx, float cy)
+{
+    for (uint32_t i = 0; i < result->count; i++) {
+        const app_detect_object_t *obj = &result->objects[i];
+        float dx = (obj->box[0] + obj->box[2]) * 0.5f - cx;
+        float dy = (obj->box[1] + obj->box[3]) * 0.5f - cy;
+        if ((dx * dx + dy * dy) <= TEST_MATCH_PX * TEST_MATCH_PX) {
+            return obj;
+        }
+    }
+    return NULL;
+}
+
+static app_tracker_handle_t test_new_tracker(void)
+{
+    app_tracker_cfg_t cfg = APP_TRACKER_DEFAULT_CONFIG();
+    app_tracker_handle_t tracker = NULL;
+
+    TEST_ESP_OK(app_tracker_new(&cfg, &tracker));
+    return tracker;
+}
+
+TEST_CASE("tracker keeps identifiers through a recorded sequence", "[tracker]")
+{
+    app_tracker_handle_t tracker = test_new_tracker();
+    app_detect_result_t result;
+    uint16_t id_a = 0;
+    uint16_t id_b = 0;
+
+    for (size_t f = 0; f < TEST_FRAME_NUM; f++) {
+        const int32_t t = test_recording[f].time_ms;
+        test_feed(tracker, &test_recording[f]);
+        app_tracker_predict(tracker, t * 1000LL, &result);
+
+        /* A is followed while it is detected and while it is coasted from 500 to 700 ms */
+        const app_detect_object_t *a = test_find(&result, test_a_cx(t), 280);
+        if (!a) {
+            printf("%" PRId32 " ms: walker A lost\n", t);
+        }
+        TEST_ASSERT_NOT_NULL(a);
+        id_a = id_a ? id_a : a->track_id;
+        TEST_ASSERT_EQUAL(id_a, a->track_id);
+
+        if (f <= TEST_B_LAST_FRAME) {
+            const app_detect_object_t *b = test_find(&result, test_b_cx(t), 295);
+            TEST_ASSERT_NOT_NULL(b);
+            id_b = id_b ? id_b : b->track_id;
+            TEST_ASSERT_EQUAL(id_b, b->track_id);
+        }
+    }
+    TEST_ASSERT_NOT_EQUAL(0, id_a);
+    TEST_ASSERT_NOT_EQUAL(0, id_b);
+    TEST_ASSERT_NOT_EQUAL(id_a, id_b);
+
+    app_tracker_del(tracker);
+}
+
+TEST_CASE("tracker coasts a lost track, then drops it", "[tracker]")
+{
+    app_tracker_handle_t tracker = test_new_tracker();
+    app_tracker_cfg_t cfg = APP_TRACKER_DEFAULT_CONFIG();
+    app_detect_result_t result;
+    app_tracker_stats_t stats;
+    uint16_t id_b = 0;
+
+    /* B is last detected at 900 ms, moving left, and extrapolated for `max_predict_us` at most */
+    const int32_t last_ms = test_recording[TEST_B_LAST_FRAME].time_ms;
+    const float coast_cx = test_b_cx(last_ms + cfg.max_predict_us / 1000);
+
+    for (size_t f = 0; f < TEST_FRAME_NUM; f++) {
+        const int32_t t = test_recording[f].time_ms;
+        test_feed(tracker, &test_recording[f]);
+        app_tracker_predict(tracker, t * 1000LL, &result);
+        TEST_ESP_OK(app_tracker_get_stats(tracker, &stats));
+
+        if (f == TEST_B_LAST_FRAME) {
+            const app_detect_object_t *b = test_find(&result, test_b_cx(t), 295);
+            TEST_ASSERT_NOT_NULL(b);
+            id_b = b->track_id;
+        } else if ((f > TEST_B_LAST_FRAME) && (t - last_ms <= (int32_t)cfg.max_age_us / 1000)) {
+            /* Coasting: shown until `max_age_us`, frozen once the prediction horizon is reached */
+            const float cx = (t - last_ms >= (int32_t)cfg.max_predict_us / 1000) ? coast_cx : test_b_cx(t);
+            const app_detect_object_t *b = test_find(&result, cx, 295);
+            if (!b) {
+                printf("%" PRId32 " ms: walker B not coasted at %.0f\n", t, cx);
+            }
+            TEST_ASSERT_NOT_NULL(b);
+            TEST_ASSERT_EQUAL(id_b, b->track_id);
+            TEST_ASSERT_EQUAL(0, stats.dropped_count);
+            TEST_ASSERT_EQUAL(2, stats.live_count);
+        } else if ((f > TEST_B_LAST_FRAME) && (f < TEST_C_FRAME)) {
+            /* Dead: no longer reported, its slot is free */
+            TEST_ASSERT_EQUAL(1, result.count);
+            TEST_ASSERT_EQUAL(1, stats.dropped_count);
+            TEST_ASSERT_EQUAL(1, stats.live_count);
+        }
+    }
+
+    /* C is where B was last seen, but B is gone: C gets a new identifier */
+    const app_detect_object_t *c = test_find(&result, test_b_cx(last_ms), 295);
+    TEST_ASSERT_NOT_NULL(c);
+    TEST_ASSERT_NOT_EQUAL(id_b, c->track_id);
+    TEST_ASSERT_EQUAL(2, result.count);
+    TEST_ESP_OK(app_tracker_get_stats(tracker, &stats));
+    TEST_ASSERT_EQUAL(3, stats.created_count);
+    TEST_ASSERT_EQUAL(1, stats.dropped_count);
+    TEST_ASSERT_EQUAL(TEST_FRAME_NUM, stats.update_count);
+
+    app_tracker_del(tracker);
+}
+
+TEST_CASE("tracker replays a recording to the same tracks", "[tracker]")
+{
+    app_tracker_handle_t trackers[2] = {test_new_tracker(), test_new_tracker()};
+    app_detect_result_t results[2];
+
+    for (size_t f = 0; f < TEST_FRAME_NUM; f++) {
+        const int64_t t = test_recording[f].time_ms * 1000LL;
+        for (int i = 0; i < 2; i++) {
+            memset(&results[i], 0, sizeof(results[i]));
+            test_feed(trackers[i], &test_recording[f]);
+            /* Drawn half way to the next detection */
+            app_tracker_predict(trackers[i], t + 50000, &results[i]);
+        }
+        TEST_ASSERT_EQUAL_MEMORY(&results[0], &results[1], sizeof(results[0]));
+    }
+
+    app_tracker_del(trackers[0]);
+    app_tracker_del(trackers[1]);
+}
+
+/*
+ * `APP_TRACKER_TRACK_MAX` objects every frame. Spread: a 4 x 4 grid of walkers that never overlap. Crowded: boxes
+ * 4 px apart, so every track overlaps every detection and the greedy assignment scans the whole IoU matrix.
+ */
+/* Back and forth between 0 and `range`, one pixel per step */
+static int test_sweep(int step, int range)
+{
+    step %= 2 * range;
+    return (step < range) ? step : 2 * range - step;
+}
+
+static void test_bench_run(const char *name, int spacing, bool stable_ids)
+{
+    app_tracker_handle_t tracker = test_new_tracker();
+    app_detect_result_t detections = {};
+    app_detect_result_t result;
+    app_tracker_stats_t stats;
+    uint64_t update_cycles = 0;
+    uint64_t predict_cycles = 0;
+    uint32_t update_max = 0;
+
+    for (int f = 0; f < TEST_BENCH_FRAMES; f++) {
+        detections.timestamp_us = (int64_t)f * TEST_BENCH_PERIOD_US;
+        detections.count = APP_TRACKER_TRACK_MAX;
+        for (int i = 0; i < APP_TRACKER_TRACK_MAX; i++) {
+            app_detect_object_t *obj = &detections.objects[i];
+            int x = (i % 4) * spacing * 2 + test_sweep(f * (i % 3 + 1), 200);
+            int y = (i / 4) * spacing * 3 + test_sweep(f * (i % 2 + 1), 100);
+            obj->box[0] = x;
+            obj->box[1] = y;
+            obj->box[2] = x + 60;
+            obj->box[3] = y + 120;
+            obj->model = APP_DETECT_MODEL_PEDESTRIAN;
+        }
+
+        uint32_t start = esp_cpu_get_cycle_count();
+        app_tracker_update(tracker, &detections);
+        uint32_t update = esp_cpu_get_cycle_count() - start;
+        start = esp_cpu_get_cycle_count();
+        app_tracker_predict(tracker, detections.timestamp_us + TEST_BENCH_PERIOD_US / 2, &result);
+        predict_cycles += esp_cpu_get_cycle_count() - start;
+        update_cycles += update;
+        update_max = (update > update_max) ? update : update_max;
+    }
+
+    TEST_ESP_OK(app_tracker_get_stats(tracker, &stats));
+    printf("%-8s %d tracks: update %6" PRIu64 " cycles (max %7" PRIu32 "), predict %5" PRIu64 " cycles, %" PRIu32
+           " tracks created\n", name, APP_TRACKER_TRACK_MAX, update_cycles / TEST_BENCH_FRAMES, update_max,
+           predict_cycles / TEST_BENCH_FRAMES, stats.created_count);
+    TEST_ASSERT_EQUAL(APP_TRACKER_TRACK_MAX, stats.live_count);
+    if (stable_ids) {
+        TEST_ASSERT_EQUAL(APP_TRACKER_TRACK_MAX, stats.created_count);
+    }
+    app_tracker_del(tracker);
+}
+
+TEST_CASE("tracker cycles per frame with many tracks", "[tracker][performance]")
+{
+    test_bench_run("spread", 80, true);
+    test_bench_run("crowded", 2, false);
+}
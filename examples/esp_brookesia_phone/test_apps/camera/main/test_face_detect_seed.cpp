@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "unity.h"
+#include "human_face_detect_seed.hpp"
+
+using human_face_detect::region_t;
+using human_face_detect::SeedMap;
+
+#define TEST_FRAME_WIDTH        (320)
+#define TEST_FRAME_HEIGHT       (240)
+
+/* A 40 x 40 face at (50, 50)-(90, 90) of the frame, found in a region at (40, 30) */
+static const region_t test_region_a = {40, 30, 200, 150, TEST_FRAME_WIDTH, TEST_FRAME_HEIGHT};
+static const int test_face_in_a[4] = {10, 20, 50, 60};
+
+TEST_CASE("face seeds follow the region when it moves and changes size", "[face_detect_seed]")
+{
+    SeedMap seeds;
+    int box[4];
+
+    seeds.reset(test_region_a);
+    TEST_ASSERT_TRUE(seeds.add(test_region_a, test_face_in_a));
+    TEST_ASSERT_EQUAL_INT(1, seeds.size());
+
+    // Same region: the face box grown by 1/8 on each side
+    const int expect_a[4] = {5, 15, 55, 65};
+    TEST_ASSERT_TRUE(seeds.map(test_region_a, 0, box));
+    TEST_ASSERT_EQUAL_INT_ARRAY(expect_a, box, 4);
+
+    // The next region starts elsewhere, the seed must still cover (45, 45)-(95, 95) of the frame
+    const region_t region_b = {20, 10, 120, 100, TEST_FRAME_WIDTH, TEST_FRAME_HEIGHT};
+    const int expect_b[4] = {25, 35, 75, 85};
+    TEST_ASSERT_TRUE(seeds.map(region_b, 0, box));
+    TEST_ASSERT_EQUAL_INT_ARRAY(expect_b, box, 4);
+
+    // The whole frame
+    const region_t frame = {0, 0, TEST_FRAME_WIDTH, TEST_FRAME_HEIGHT, TEST_FRAME_WIDTH, TEST_FRAME_HEIGHT};
+    const int expect_frame[4] = {45, 45, 95, 95};
+    TEST_ASSERT_TRUE(seeds.map(frame, 0, box));
+    TEST_ASSERT_EQUAL_INT_ARRAY(expect_frame, box, 4);
+
+    // Faces found in region b are stored back in frame coordinates
+    const int face_in_b[4] = {32, 40, 72, 80};
+    seeds.reset(region_b);
+    TEST_ASSERT_TRUE(seeds.add(region_b, face_in_b));
+    const int expect_frame_b[4] = {47, 45, 97, 95};
+    TEST_ASSERT_TRUE(seeds.map(frame, 0, box));
+    TEST_ASSERT_EQUAL_INT_ARRAY(expect_frame_b, box, 4);
+}
+
+TEST_CASE("face seeds are refused outside their region or frame size", "[face_detect_seed]")
+{
+    SeedMap seeds;
+    int box[4];
+
+    seeds.reset(test_region_a);
+    TEST_ASSERT_TRUE(seeds.add(test_region_a, test_face_in_a));
+
+    // The face center (70, 70) is left of this region, MSR has to search it
+    const region_t region_right = {100, 30, 200, 150, TEST_FRAME_WIDTH, TEST_FRAME_HEIGHT};
+    TEST_ASSERT_FALSE(seeds.map(region_right, 0, box));
+
+    // Same region size, but in a frame of another resolution
+    const region_t region_other = {40, 30, 200, 150, TEST_FRAME_WIDTH * 2, TEST_FRAME_HEIGHT * 2};
+    TEST_ASSERT_FALSE(seeds.map(region_other, 0, box));
+
+    TEST_ASSERT_FALSE(seeds.map(test_region_a, 1, box));
+
+    for (int i = 1; i < SeedMap::MAX_SEEDS; i++) {
+        TEST_ASSERT_TRUE(seeds.add(test_region_a, test_face_in_a));
+    }
+    TEST_ASSERT_FALSE(seeds.add(test_region_a, test_face_in_a));
+    TEST_ASSERT_EQUAL_INT(SeedMap::MAX_SEEDS, seeds.size());
+}
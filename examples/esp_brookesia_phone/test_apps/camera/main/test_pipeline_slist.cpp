@@ -0,0 +1,114 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <sys/queue.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "test_pipeline_slist.h"
+
+struct test_slist_element {
+    SLIST_ENTRY(test_slist_element) node;
+    bool free;
+    int index;
+};
+
+SLIST_HEAD(test_slist_list, test_slist_element);
+
+struct test_slist_pipeline {
+    test_slist_list queued_list;
+    test_slist_list done_list;
+    test_slist_element *element;
+    portMUX_TYPE stream_lock;
+    SemaphoreHandle_t ready_sem;
+};
+
+test_slist_handle_t test_slist_pipeline_new(int elem_num)
+{
+    test_slist_pipeline *stream = static_cast<test_slist_pipeline *>(calloc(1, sizeof(test_slist_pipeline)));
+    stream->element = static_cast<test_slist_element *>(calloc(elem_num, sizeof(test_slist_element)));
+    SLIST_INIT(&stream->queued_list);
+    SLIST_INIT(&stream->done_list);
+    portMUX_INITIALIZE(&stream->stream_lock);
+    stream->ready_sem = xSemaphoreCreateCounting(elem_num, 0);
+
+    for (int i = 0; i < elem_num; i++) {
+        stream->element[i].index = i;
+        stream->element[i].free = true;
+        test_slist_queue_element_index(stream, i);
+    }
+
+    return stream;
+}
+
+void test_slist_pipeline_delete(test_slist_handle_t pipeline)
+{
+    vSemaphoreDelete(pipeline->ready_sem);
+    free(pipeline->element);
+    free(pipeline);
+}
+
+void test_slist_queue_element_index(test_slist_handle_t pipeline, int index)
+{
+    test_slist_element *element = &pipeline->element[index];
+
+    portENTER_CRITICAL_SAFE(&pipeline->stream_lock);
+    if (element->free) {
+        element->free = false;
+        SLIST_INSERT_HEAD(&pipeline->queued_list, element, node);
+    }
+    portEXIT_CRITICAL_SAFE(&pipeline->stream_lock);
+}
+
+static int test_slist_take(test_slist_handle_t pipeline, test_slist_list *list)
+{
+    test_slist_element *element = NULL;
+
+    portENTER_CRITICAL_SAFE(&pipeline->stream_lock);
+    if (!SLIST_EMPTY(list)) {
+        element = SLIST_FIRST(list);
+        SLIST_REMOVE(list, element, test_slist_element, node);
+        element->free = true;
+    }
+    portEXIT_CRITICAL_SAFE(&pipeline->stream_lock);
+
+    return element ? element->index : -1;
+}
+
+int test_slist_get_queued_element(test_slist_handle_t pipeline)
+{
+    return test_slist_take(pipeline, &pipeline->queued_list);
+}
+
+void test_slist_done_element(test_slist_handle_t pipeline, int index)
+{
+    test_slist_element *element = &pipeline->element[index];
+
+    portENTER_CRITICAL_SAFE(&pipeline->stream_lock);
+    if (!element->free) {
+        portEXIT_CRITICAL_SAFE(&pipeline->stream_lock);
+        return;
+    }
+    element->free = false;
+    SLIST_INSERT_HEAD(&pipeline->done_list, element, node);
+    portEXIT_CRITICAL_SAFE(&pipeline->stream_lock);
+
+    xSemaphoreGive(pipeline->ready_sem);
+}
+
+int test_slist_recv_element(test_slist_handle_t pipeline, uint32_t ticks)
+{
+    if (xSemaphoreTake(pipeline->ready_sem, (TickType_t)ticks) != pdTRUE) {
+        return -1;
+    }
+
+    return test_slist_take(pipeline, &pipeline->done_list);
+}
+
+void test_slist_wakeup_recv(test_slist_handle_t pipeline)
+{
+    xSemaphoreGive(pipeline->ready_sem);
+}
@@ -0,0 +1,24 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+/*
+ * The camera pipeline as it was before the lock-free rings: one SLIST per state guarded by a portMUX, plus the
+ * counting semaphore. Only kept as the baseline of the pipeline benchmark; elements are handled by index.
+ */
+typedef struct test_slist_pipeline *test_slist_handle_t;
+
+test_slist_handle_t test_slist_pipeline_new(int elem_num);
+void test_slist_pipeline_delete(test_slist_handle_t pipeline);
+void test_slist_queue_element_index(test_slist_handle_t pipeline, int index);
+int test_slist_get_queued_element(test_slist_handle_t pipeline);
+void test_slist_done_element(test_slist_handle_t pipeline, int index);
+int test_slist_recv_element(test_slist_handle_t pipeline, uint32_t ticks);
+void test_slist_wakeup_recv(test_slist_handle_t pipeline);
@@ -0,0 +1,60 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/i2s_std.h"
+#include "bsp_extra_pcm_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Host stand-in for the board functions used by the mixer and the spectrum analyzer, see `test_host_audio.c` */
+esp_err_t bsp_extra_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
+uint32_t bsp_extra_i2s_get_period_frames(void);
+void bsp_extra_codec_get_fs(uint32_t *rate, uint32_t *bits_cfg, uint32_t *ch);
+void bsp_extra_i2s_set_tap(bsp_extra_pcm_ring_handle_t ring);
+
+/**
+ * @brief Frames written to the recording sink since the last reset, interleaved stereo.
+ */
+const int16_t *test_sink_get(size_t *frames);
+
+/**
+ * @brief Empty the recording sink.
+ */
+void test_sink_reset(void);
+
+/**
+ * @brief Wait until the mixer stops writing to the sink.
+ */
+void test_sink_wait_idle(void);
+
+/**
+ * @brief Set the format reported by `bsp_extra_codec_get_fs`.
+ */
+void test_codec_set_fs(uint32_t rate, uint32_t bits_cfg, uint32_t ch);
+
+/**
+ * @brief Take the codec from the mixer session or give it back, as a capture session does.
+ */
+void test_codec_session_set_granted(bool granted);
+
+/**
+ * @brief Copy played audio to the tap as `bsp_extra_i2s_write` does, dropped when it does not fit.
+ *
+ * @return Bytes copied, 0 without a tap or without room.
+ */
+size_t test_tap_write(const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+
+/* Host stand-in for the DMA capable allocator, see `test_host_dma.c` */
+typedef struct {
+    int extra_heap_caps;
+    size_t dma_alignment_bytes;
+} esp_dma_mem_info_t;
+
+esp_err_t esp_dma_capable_malloc(size_t size, const esp_dma_mem_info_t *dma_mem_info, void **out_ptr,
+                                 size_t *actual_size);
@@ -0,0 +1,30 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Host stand-in for the SD card: the test apps link with `--wrap=read` and `--wrap=pread`, so every file read goes
+ * through an emulated card with a fixed cost per command and a transfer rate. See `test_host_card.c`.
+ */
+
+/**
+ * @brief Set the emulated card timing, 0 and 0 read at host speed.
+ *
+ * @param command_us Cost of every read command
+ * @param kb_per_ms Transfer rate, 0 for no transfer time
+ */
+void test_card_set_timing(uint32_t command_us, uint32_t kb_per_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,126 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include "bsp_board_extra.h"
+#include "bsp_extra_codec_session.h"
+
+#define TEST_SINK_FRAMES        (44100 * 8)
+#define TEST_PERIOD_FRAMES      (120)
+#define TEST_WRITE_DELAY_US     (200)       /* Faster than real time, still lets the writers interleave */
+#define TEST_IDLE_POLL_US       (30000)
+
+static int16_t sink[TEST_SINK_FRAMES * 2];
+static volatile size_t sink_samples;
+
+static uint32_t codec_rate;
+static uint32_t codec_bits;
+static uint32_t codec_ch;
+static bsp_extra_pcm_ring_handle_t volatile tap;
+
+esp_err_t bsp_extra_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    size_t samples = len / sizeof(int16_t);
+
+    if (sink_samples + samples <= TEST_SINK_FRAMES * 2) {
+        memcpy(sink + sink_samples, audio_buffer, len);
+        sink_samples += samples;
+    }
+    usleep(TEST_WRITE_DELAY_US);
+    *bytes_written = len;
+
+    return ESP_OK;
+}
+
+uint32_t bsp_extra_i2s_get_period_frames(void)
+{
+    return TEST_PERIOD_FRAMES;
+}
+
+const int16_t *test_sink_get(size_t *frames)
+{
+    *frames = sink_samples / 2;
+    return sink;
+}
+
+void test_sink_reset(void)
+{
+    sink_samples = 0;
+}
+
+void test_sink_wait_idle(void)
+{
+    size_t last;
+
+    do {
+        last = sink_samples;
+        usleep(TEST_IDLE_POLL_US);
+    } while (sink_samples != last);
+}
+
+/* The mixer is the only session, it holds the codec unless a test takes it */
+static bsp_extra_codec_session_cfg_t session_cfg;
+static bool session_granted;
+
+esp_err_t bsp_extra_codec_session_open(const bsp_extra_codec_session_cfg_t *config,
+                                       bsp_extra_codec_session_handle_t *ret_session)
+{
+    session_cfg = *config;
+    session_granted = true;
+    *ret_session = (bsp_extra_codec_session_handle_t)1;
+    return ESP_OK;
+}
+
+void bsp_extra_codec_session_close(bsp_extra_codec_session_handle_t session)
+{
+    session_cfg.cb = NULL;
+}
+
+bool bsp_extra_codec_session_is_granted(bsp_extra_codec_session_handle_t session)
+{
+    return session_granted;
+}
+
+void test_codec_session_set_granted(bool granted)
+{
+    if (granted == session_granted) {
+        return;
+    }
+    session_granted = granted;
+    if (session_cfg.cb) {
+        session_cfg.cb((bsp_extra_codec_session_handle_t)1, granted, session_cfg.user_ctx);
+    }
+}
+
+void bsp_extra_codec_get_fs(uint32_t *rate, uint32_t *bits_cfg, uint32_t *ch)
+{
+    *rate = codec_rate;
+    *bits_cfg = codec_bits;
+    *ch = codec_ch;
+}
+
+void bsp_extra_i2s_set_tap(bsp_extra_pcm_ring_handle_t ring)
+{
+    tap = ring;
+}
+
+void test_codec_set_fs(uint32_t rate, uint32_t bits_cfg, uint32_t ch)
+{
+    codec_rate = rate;
+    codec_bits = bits_cfg;
+    codec_ch = ch;
+}
+
+size_t test_tap_write(const void *data, size_t len)
+{
+    bsp_extra_pcm_ring_handle_t ring = tap;
+
+    if (!ring || (bsp_extra_pcm_ring_get_free(ring) < len)) {
+        return 0;
+    }
+    return bsp_extra_pcm_ring_write(ring, data, len);
+}
@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "test_host_card.h"
+
+static uint32_t card_command_us;
+static uint32_t card_kb_per_ms;
+
+ssize_t __real_read(int fd, void *buf, size_t len);
+ssize_t __real_pread(int fd, void *buf, size_t len, off_t offset);
+
+static void test_card_wait(size_t len)
+{
+    uint64_t ns = card_command_us * 1000ULL;
+
+    if (card_kb_per_ms) {
+        ns += len * 1000000ULL / 1024 / card_kb_per_ms;
+    }
+    if (ns) {
+        struct timespec ts = {
+            .tv_sec = ns / 1000000000ULL,
+            .tv_nsec = ns % 1000000000ULL,
+        };
+        nanosleep(&ts, NULL);
+    }
+}
+
+ssize_t __wrap_read(int fd, void *buf, size_t len)
+{
+    test_card_wait(len);
+    return __real_read(fd, buf, len);
+}
+
+ssize_t __wrap_pread(int fd, void *buf, size_t len, off_t offset)
+{
+    test_card_wait(len);
+    return __real_pread(fd, buf, len, offset);
+}
+
+void test_card_set_timing(uint32_t command_us, uint32_t kb_per_ms)
+{
+    card_command_us = command_us;
+    card_kb_per_ms = kb_per_ms;
+}
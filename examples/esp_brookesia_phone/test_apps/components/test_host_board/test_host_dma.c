@@ -0,0 +1,22 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include "esp_dma_utils.h"
+
+#define TEST_DMA_ALIGN      (64)    /* Cache line of the target PSRAM */
+
+esp_err_t esp_dma_capable_malloc(size_t size, const esp_dma_mem_info_t *dma_mem_info, void **out_ptr,
+                                 size_t *actual_size)
+{
+    size_t aligned = (size + TEST_DMA_ALIGN - 1) / TEST_DMA_ALIGN * TEST_DMA_ALIGN;
+
+    *out_ptr = aligned_alloc(TEST_DMA_ALIGN, aligned);
+    if (actual_size) {
+        *actual_size = aligned;
+    }
+    return *out_ptr ? ESP_OK : ESP_ERR_NO_MEM;
+}
@@ -0,0 +1,160 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "unity.h"
+#include "app_fft.h"
+
+#define TEST_INPUT_MAX          (16383)     /* Half of the Q15 range, what `app_fft_real` takes */
+#define TEST_BENCH_POINTS       (1 << 20)   /* Points transformed per size, so small sizes run many times */
+
+static uint32_t test_rand_state;
+
+/* Repeatable pseudo random samples within the input range */
+static int16_t test_rand_sample(void)
+{
+    test_rand_state = test_rand_state * 1664525 + 1013904223;
+    return (int16_t)((int32_t)((test_rand_state >> 15) % (2 * TEST_INPUT_MAX + 1)) - TEST_INPUT_MAX);
+}
+
+/* Largest difference between the fixed-point bins and the DFT of `x` divided by `n` */
+static double test_dft_error(const double *x, const int16_t *bins, uint32_t n)
+{
+    double err = 0;
+
+    for (uint32_t k = 0; k <= n / 2; k++) {
+        double re = 0, im = 0;
+        for (uint32_t t = 0; t < n; t++) {
+            double phase = 2 * M_PI * (double)((uint64_t)k * t % n) / n;
+            re += x[t] * cos(phase);
+            im -= x[t] * sin(phase);
+        }
+        re /= n;
+        im /= n;
+
+        if (k == 0) {
+            err = fmax(err, fabs(bins[0] - re));
+        } else if (k == n / 2) {
+            err = fmax(err, fabs(bins[1] - re));
+        } else {
+            err = fmax(err, fmax(fabs(bins[2 * k] - re), fabs(bins[2 * k + 1] - im)));
+        }
+    }
+
+    return err;
+}
+
+TEST_CASE("fft rejects sizes that are not a power of two in range", "[fft]")
+{
+    app_fft_t fft = {0};
+    const uint32_t sizes[] = {0, APP_FFT_SIZE_MIN / 2, 1000, APP_FFT_SIZE_MAX * 2};
+
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_fft_init(&fft, sizes[i]));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_fft_init(NULL, 1024));
+}
+
+TEST_CASE("fft matches a double precision DFT from 16 to 4096 points", "[fft]")
+{
+    int16_t *data = malloc(APP_FFT_SIZE_MAX * sizeof(int16_t));
+    double *ref = malloc(APP_FFT_SIZE_MAX * sizeof(double));
+    app_fft_t fft = {0};
+
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(ref);
+    test_rand_state = 1;
+    for (uint32_t n = APP_FFT_SIZE_MIN, stages = 4; n <= APP_FFT_SIZE_MAX; n <<= 1, stages++) {
+        TEST_ESP_OK(app_fft_init(&fft, n));
+        for (uint32_t t = 0; t < n; t++) {
+            data[t] = test_rand_sample();
+            ref[t] = data[t];
+        }
+        app_fft_real(&fft, data);
+
+        /* Every stage truncates before halving, adding less than 1 LSB of error per stage */
+        double err = test_dft_error(ref, data, n);
+        printf("%4" PRIu32 " points: max error %.2f LSB\n", n, err);
+        TEST_ASSERT_TRUE(err <= stages);
+        app_fft_deinit(&fft);
+    }
+
+    free(data);
+    free(ref);
+}
+
+TEST_CASE("fft window and power keep a tone in its bin", "[fft]")
+{
+    const uint32_t n = 1024;
+    const uint32_t bin = n / 8;
+    int16_t *data = malloc(n * sizeof(int16_t));
+    uint32_t *power = malloc(n / 2 * sizeof(uint32_t));
+    app_fft_t fft = {0};
+
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(power);
+    TEST_ESP_OK(app_fft_init(&fft, n));
+    for (uint32_t t = 0; t < n; t++) {
+        data[t] = (int16_t)lrint(INT16_MAX * cos(2 * M_PI * bin * t / n));
+    }
+    app_fft_window(&fft, data);
+    app_fft_real(&fft, data);
+    app_fft_power(&fft, data, power);
+
+    /* Full scale halved by `app_fft_window`, by the Hann gain and by the real split: amplitude / 8 in the bin */
+    const double peak = INT16_MAX / 8.0;
+    TEST_ASSERT_DOUBLE_WITHIN(peak * 0.02, peak, sqrt(power[bin]));
+    /* The Hann window spreads an exact bin over its two neighbours only, at a quarter of the amplitude */
+    TEST_ASSERT_DOUBLE_WITHIN(peak * 0.02, peak / 2, sqrt(power[bin - 1]));
+    TEST_ASSERT_DOUBLE_WITHIN(peak * 0.02, peak / 2, sqrt(power[bin + 1]));
+    for (uint32_t k = 0; k < n / 2; k++) {
+        if ((k + 1 < bin) || (k > bin + 1)) {
+            TEST_ASSERT_LESS_THAN(power[bin] / 10000, power[k]);
+        }
+    }
+
+    app_fft_deinit(&fft);
+    free(data);
+    free(power);
+}
+
+TEST_CASE("fft cycles per transform", "[fft][performance]")
+{
+    int16_t *input = malloc(APP_FFT_SIZE_MAX * sizeof(int16_t));
+    int16_t *data = malloc(APP_FFT_SIZE_MAX * sizeof(int16_t));
+    app_fft_t fft = {0};
+
+    TEST_ASSERT_NOT_NULL(input);
+    TEST_ASSERT_NOT_NULL(data);
+    test_rand_state = 1;
+    for (uint32_t t = 0; t < APP_FFT_SIZE_MAX; t++) {
+        input[t] = test_rand_sample();
+    }
+
+    for (uint32_t n = APP_FFT_SIZE_MIN; n <= APP_FFT_SIZE_MAX; n <<= 1) {
+        const uint32_t runs = TEST_BENCH_POINTS / n;
+        uint64_t cycles = 0;
+
+        TEST_ESP_OK(app_fft_init(&fft, n));
+        for (uint32_t r = 0; r < runs; r++) {
+            memcpy(data, input, n * sizeof(int16_t));
+            uint32_t start = esp_cpu_get_cycle_count();
+            app_fft_real(&fft, data);
+            cycles += esp_cpu_get_cycle_count() - start;
+        }
+        printf("%4" PRIu32 " points: %" PRIu64 " cycles per app_fft_real, %.2f per point\n", n, cycles / runs,
+               (double)cycles / runs / n);
+        app_fft_deinit(&fft);
+    }
+
+    free(input);
+    free(data);
+}
@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "unity.h"
+#include "bsp_board_extra.h"
+#include "app_spectrum.h"
+
+#define TEST_RATE               (44100)
+#define TEST_CHUNK_FRAMES       (TEST_RATE * APP_SPECTRUM_FRAME_MS / 1000)
+#define TEST_TONE_MS            (800)       /* Long enough for the last band to decay to 0 */
+#define TEST_LEVEL_MIN          (40)        /* Half scale tone, 6 dB below the top of the bands */
+#define TEST_LEVEL_MARGIN       (24)        /* The other bands are at least 18 dB lower */
+
+static int16_t test_chunk[TEST_CHUNK_FRAMES * 2];
+
+/* Play a stereo tone in real time through the tap */
+static void test_play_tone(double freq, int16_t amplitude, uint32_t ms)
+{
+    static uint64_t t;
+
+    for (uint32_t elapsed = 0; elapsed < ms; elapsed += APP_SPECTRUM_FRAME_MS) {
+        for (int i = 0; i < TEST_CHUNK_FRAMES; i++, t++) {
+            test_chunk[2 * i] = (int16_t)lrint(amplitude * sin(2 * M_PI * freq * (double)t / TEST_RATE));
+            test_chunk[2 * i + 1] = test_chunk[2 * i];
+        }
+        test_tap_write(test_chunk, sizeof(test_chunk));
+        vTaskDelay(pdMS_TO_TICKS(APP_SPECTRUM_FRAME_MS));
+    }
+}
+
+TEST_CASE("spectrum shows a tone in its band only", "[spectrum]")
+{
+    /* One tone in the middle of each band: bass, low mid, high mid, treble */
+    const double freqs[APP_SPECTRUM_BAND_NUM] = {100, 700, 3500, 10000};
+    uint16_t levels[APP_SPECTRUM_BAND_NUM];
+
+    test_codec_set_fs(TEST_RATE, 16, 2);
+    TEST_ESP_OK(app_spectrum_start());
+
+    for (int b = 0; b < APP_SPECTRUM_BAND_NUM; b++) {
+        test_play_tone(freqs[b], INT16_MAX / 2, TEST_TONE_MS);
+        app_spectrum_get_levels(levels);
+        printf("%5.0f Hz: %2u %2u %2u %2u\n", freqs[b], levels[0], levels[1], levels[2], levels[3]);
+        TEST_ASSERT_GREATER_OR_EQUAL(TEST_LEVEL_MIN, levels[b]);
+        for (int other = 0; other < APP_SPECTRUM_BAND_NUM; other++) {
+            if (other != b) {
+                TEST_ASSERT_LESS_OR_EQUAL(levels[b] - TEST_LEVEL_MARGIN, levels[other]);
+            }
+        }
+    }
+
+    app_spectrum_stats_t stats;
+    TEST_ESP_OK(app_spectrum_get_stats(&stats));
+    TEST_ASSERT_GREATER_THAN(0, stats.fft_count);
+    TEST_ASSERT_LESS_OR_EQUAL(stats.frames, stats.fft_count);
+
+    TEST_ESP_OK(app_spectrum_stop());
+}
+
+TEST_CASE("spectrum decays without audio and drops to 0 on stop", "[spectrum]")
+{
+    uint16_t levels[APP_SPECTRUM_BAND_NUM];
+
+    test_codec_set_fs(TEST_RATE, 16, 2);
+    TEST_ESP_OK(app_spectrum_start());
+    test_play_tone(1000, INT16_MAX, 200);
+    app_spectrum_get_levels(levels);
+    TEST_ASSERT_GREATER_THAN(0, levels[1]);
+
+    /* Nothing written: a paused player */
+    vTaskDelay(pdMS_TO_TICKS(APP_SPECTRUM_LEVEL_MAX / 4 * APP_SPECTRUM_FRAME_MS + 200));
+    app_spectrum_get_levels(levels);
+    for (int b = 0; b < APP_SPECTRUM_BAND_NUM; b++) {
+        TEST_ASSERT_EQUAL(0, levels[b]);
+    }
+
+    test_play_tone(1000, INT16_MAX, 200);
+    TEST_ESP_OK(app_spectrum_stop());
+    app_spectrum_get_levels(levels);
+    for (int b = 0; b < APP_SPECTRUM_BAND_NUM; b++) {
+        TEST_ASSERT_EQUAL(0, levels[b]);
+    }
+}
+
+void app_main(void)
+{
+    printf("music player host test, cycles are nanoseconds on the linux target\n");
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    UNITY_END();
+}
@@ -0,0 +1,246 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "unity.h"
+#include "test_host_card.h"
+#include "media_src_storage.h"
+
+#define TEST_FILE               "/tmp/test_media_src_storage.bin"
+#define TEST_FILE_SIZE          (1024 * 1024 + 1234)    /* Not a multiple of any block size */
+#define TEST_SEEK_NUM           (300)
+#define TEST_READ_MAX           (70000)
+#define TEST_BENCH_FILE_SIZE    (16 * 1024 * 1024)
+#define TEST_BENCH_FRAME_MIN    (20000)
+#define TEST_BENCH_FRAME_MAX    (60000)
+#define TEST_BENCH_DECODE_US    (3000)
+#define TEST_CARD_COMMAND_US    (300)                   /* Emulated SD card: 0.3 ms per command, 20 MB/s */
+#define TEST_CARD_KB_PER_MS     (20)
+
+static uint8_t *test_data;
+static uint32_t test_rand_state;
+
+static uint32_t test_rand(void)
+{
+    test_rand_state = test_rand_state * 1664525 + 1013904223;
+    return test_rand_state >> 8;
+}
+
+/* A file of `size` pseudo random bytes, also kept in `test_data` */
+static void test_make_file(size_t size)
+{
+    free(test_data);
+    test_data = malloc(size);
+    TEST_ASSERT_NOT_NULL(test_data);
+    test_rand_state = 1;
+    for (size_t i = 0; i < size; i++) {
+        test_data[i] = (uint8_t)test_rand();
+    }
+
+    FILE *fp = fopen(TEST_FILE, "wb");
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ASSERT_EQUAL(size, fwrite(test_data, 1, size, fp));
+    fclose(fp);
+}
+
+/* Read until `len` bytes or the end of the file */
+static size_t test_read_all(media_src_t *src, uint8_t *buf, size_t len)
+{
+    size_t got = 0;
+    int n;
+
+    while ((got < len) && ((n = media_src_storage_read(src, buf + got, len - got)) > 0)) {
+        got += n;
+    }
+    return got;
+}
+
+/*
+ * Random seeks and reads compared with the file. A third of the seeks land on the last byte of a block, a third of
+ * the reads continue from where the last one stopped, and some seeks go back into the window or past the end.
+ */
+static void test_random_reads(const media_src_storage_cfg_t *cfg)
+{
+    media_src_t src = {0};
+    uint8_t *buf = malloc(TEST_READ_MAX);
+    uint64_t pos = 0;
+
+    TEST_ASSERT_NOT_NULL(buf);
+    TEST_ASSERT_EQUAL(0, media_src_storage_open_with_cfg(&src, cfg));
+    TEST_ASSERT_EQUAL(0, media_src_storage_connect(&src, TEST_FILE));
+
+    for (int i = 0; i < TEST_SEEK_NUM; i++) {
+        const size_t len = 1 + test_rand() % TEST_READ_MAX;
+        switch (i % 3) {
+        case 0:
+            pos = test_rand() % (TEST_FILE_SIZE + 4096);
+            if (cfg->block_size) {
+                pos = pos / cfg->block_size * cfg->block_size + cfg->block_size - 1;
+            }
+            break;
+        case 1:
+            pos = (pos > 10000) ? pos - test_rand() % 10000 : test_rand() % TEST_FILE_SIZE;
+            break;
+        default:
+            break;
+        }
+        if (i % 3 != 2) {
+            TEST_ASSERT_EQUAL(0, media_src_storage_seek(&src, pos));
+        }
+
+        const size_t expected = (pos >= TEST_FILE_SIZE) ? 0 :
+                                (pos + len > TEST_FILE_SIZE) ? TEST_FILE_SIZE - pos : len;
+        TEST_ASSERT_EQUAL(expected, test_read_all(&src, buf, len));
+        TEST_ASSERT_EQUAL_MEMORY(test_data + pos, buf, expected);
+        pos += expected;
+
+        uint64_t position = 0;
+        TEST_ASSERT_EQUAL(0, media_src_storage_get_position(&src, &position));
+        TEST_ASSERT_EQUAL(pos, position);
+    }
+
+    media_src_storage_stats_t stats;
+    TEST_ASSERT_EQUAL(0, media_src_storage_get_stats(&src, &stats));
+    printf("block %" PRIu32 " x %" PRIu32 ": %" PRIu32 " restarts, %" PRIu32 " stalls, %" PRIu64 " bytes served\n",
+           cfg->block_num, cfg->block_size, stats.restart_count, stats.stall_count, stats.served_bytes);
+    if (cfg->block_size) {
+        TEST_ASSERT_GREATER_THAN(0, stats.restart_count);
+    }
+    TEST_ASSERT_EQUAL(0, media_src_storage_close(&src));
+    free(buf);
+}
+
+TEST_CASE("storage source matches the file through random seeks", "[media_src_storage]")
+{
+    const media_src_storage_cfg_t cfgs[] = {
+        {0},
+        {.block_size = 64 * 1024, .block_num = 8, .task_core = -1},
+        {.block_size = 4096, .block_num = 2, .task_core = -1},
+        {.block_size = 1000, .block_num = 3, .task_core = -1},
+    };
+
+    test_make_file(TEST_FILE_SIZE);
+    test_card_set_timing(0, 0);
+    for (int i = 0; i < sizeof(cfgs) / sizeof(cfgs[0]); i++) {
+        test_random_reads(&cfgs[i]);
+    }
+    remove(TEST_FILE);
+}
+
+TEST_CASE("storage source restarts the window while the card reads", "[media_src_storage]")
+{
+    const media_src_storage_cfg_t cfg = {.block_size = 64 * 1024, .block_num = 4, .task_core = -1};
+
+    /* Slow reads: most seeks land while the task is in the middle of a block of the old window */
+    test_make_file(TEST_FILE_SIZE);
+    test_card_set_timing(2000, TEST_CARD_KB_PER_MS);
+    test_random_reads(&cfg);
+    test_card_set_timing(0, 0);
+    remove(TEST_FILE);
+}
+
+TEST_CASE("storage source reads up to the end of the file", "[media_src_storage]")
+{
+    const media_src_storage_cfg_t cfg = {.block_size = 4096, .block_num = 4, .task_core = -1};
+    media_src_t src = {0};
+    uint8_t buf[8192];
+
+    test_make_file(TEST_FILE_SIZE);
+    TEST_ASSERT_EQUAL(0, media_src_storage_open_with_cfg(&src, &cfg));
+    TEST_ASSERT_EQUAL(0, media_src_storage_connect(&src, TEST_FILE));
+
+    uint64_t size = 0;
+    TEST_ASSERT_EQUAL(0, media_src_storage_get_size(&src, &size));
+    TEST_ASSERT_EQUAL(TEST_FILE_SIZE, size);
+    TEST_ASSERT_EQUAL(0, media_src_storage_seek(&src, TEST_FILE_SIZE - 100));
+    TEST_ASSERT_EQUAL(100, media_src_storage_read(&src, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_MEMORY(test_data + TEST_FILE_SIZE - 100, buf, 100);
+    TEST_ASSERT_EQUAL(0, media_src_storage_read(&src, buf, sizeof(buf)));
+
+    /* Reconnecting starts over from the beginning */
+    TEST_ASSERT_EQUAL(0, media_src_storage_connect(&src, TEST_FILE));
+    TEST_ASSERT_EQUAL(sizeof(buf), test_read_all(&src, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_MEMORY(test_data, buf, sizeof(buf));
+
+    TEST_ASSERT_EQUAL(0, media_src_storage_close(&src));
+    remove(TEST_FILE);
+}
+
+/* Play frames of random size one after the other, as the player reader does, with a decode time per frame */
+static void test_bench_run(const char *name, const media_src_storage_cfg_t *cfg, const uint32_t *offsets,
+                           const uint32_t *sizes, int frames)
+{
+    media_src_t src = {0};
+    uint8_t *buf = malloc(TEST_BENCH_FRAME_MAX);
+    media_src_storage_stats_t stats;
+
+    TEST_ASSERT_NOT_NULL(buf);
+    TEST_ASSERT_EQUAL(0, media_src_storage_open_with_cfg(&src, cfg));
+    TEST_ASSERT_EQUAL(0, media_src_storage_connect(&src, TEST_FILE));
+
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < frames; i++) {
+        TEST_ASSERT_EQUAL(0, media_src_storage_seek(&src, offsets[i]));
+        TEST_ASSERT_EQUAL(sizes[i], test_read_all(&src, buf, sizes[i]));
+        TEST_ASSERT_EQUAL(test_data[offsets[i]], buf[0]);
+        int64_t decode_start_us = esp_timer_get_time();
+        while (esp_timer_get_time() - decode_start_us < TEST_BENCH_DECODE_US) {
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    TEST_ASSERT_EQUAL(0, media_src_storage_get_stats(&src, &stats));
+    printf("%-20s %6.1f fps, card %5.1f MB/s, %5" PRIu32 " stalls (%6.1f ms), %" PRIu32 " restarts\n", name,
+           frames * 1e6 / elapsed_us, stats.device_us ? (double)stats.device_bytes / stats.device_us : 0,
+           stats.stall_count, stats.stall_us / 1000.0, stats.restart_count);
+    TEST_ASSERT_EQUAL(0, media_src_storage_close(&src));
+    free(buf);
+}
+
+TEST_CASE("storage source frame rate on an emulated card", "[media_src_storage][performance]")
+{
+    const int frame_max = TEST_BENCH_FILE_SIZE / TEST_BENCH_FRAME_MIN;
+    uint32_t *offsets = malloc(frame_max * sizeof(uint32_t));
+    uint32_t *sizes = malloc(frame_max * sizeof(uint32_t));
+    const media_src_storage_cfg_t on_demand = {0};
+    const media_src_storage_cfg_t read_ahead = {.block_size = 64 * 1024, .block_num = 8, .task_core = -1};
+    int frames = 0;
+
+    TEST_ASSERT_NOT_NULL(offsets);
+    TEST_ASSERT_NOT_NULL(sizes);
+    test_make_file(TEST_BENCH_FILE_SIZE);
+
+    /* Frames of 20 to 60 KB, a few bytes apart like the JPEG markers between MJPEG frames */
+    for (uint32_t pos = 0; pos + TEST_BENCH_FRAME_MAX + 64 < TEST_BENCH_FILE_SIZE; frames++) {
+        pos += test_rand() % 64;
+        offsets[frames] = pos;
+        sizes[frames] = TEST_BENCH_FRAME_MIN + test_rand() % (TEST_BENCH_FRAME_MAX - TEST_BENCH_FRAME_MIN);
+        pos += sizes[frames];
+    }
+    printf("%d frames, %d ms decode each, card %d us per command, %d MB/s\n", frames, TEST_BENCH_DECODE_US / 1000,
+           TEST_CARD_COMMAND_US, TEST_CARD_KB_PER_MS);
+
+    test_card_set_timing(TEST_CARD_COMMAND_US, TEST_CARD_KB_PER_MS);
+    test_bench_run("on demand", &on_demand, offsets, sizes, frames);
+    test_bench_run("read-ahead 8 x 64 KB", &read_ahead, offsets, sizes, frames);
+    test_card_set_timing(0, 0);
+
+    remove(TEST_FILE);
+    free(offsets);
+    free(sizes);
+}
+
+void app_main(void)
+{
+    printf("video player host test\n");
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    UNITY_END();
+}
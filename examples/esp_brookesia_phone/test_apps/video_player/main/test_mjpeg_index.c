@@ -0,0 +1,311 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include "esp_timer.h"
+#include "unity.h"
+#include "mjpeg_index.h"
+
+#define TEST_VIDEO              "/tmp/test_mjpeg_index.mjpeg"
+#define TEST_INDEX              "/tmp/test_mjpeg_index.idx"     /* Where `mjpeg_index_open` puts it */
+#define TEST_FRAME_NUM          (500)
+#define TEST_FRAME_MIN          (1000)
+#define TEST_FRAME_MAX          (30000)
+#define TEST_SCAN_BUF_MAX       (64 * 1024)
+#define TEST_BENCH_SIZE         (64 * 1024 * 1024)
+#define TEST_BENCH_FRAME_MAX    (60000)
+
+static uint32_t test_rand_state;
+
+static uint32_t test_rand(void)
+{
+    test_rand_state = test_rand_state * 1103515245 + 12345;
+    return test_rand_state >> 8;
+}
+
+/*
+ * Write an MJPEG file of frames with random entropy coded data: every 0xFF in it is stuffed with 0x00, as in a real
+ * JPEG. Between frames come a few bytes of padding, sometimes fill bytes (0xFF 0xFF) right before the SOI.
+ */
+static uint32_t test_make_video(const char *path, uint32_t size_max, uint32_t frame_max, mjpeg_index_t *expected)
+{
+    FILE *fp = fopen(path, "wb");
+    uint32_t pos = 0;
+
+    TEST_ASSERT_NOT_NULL(fp);
+    test_rand_state = 1;
+    expected->count = 0;
+    expected->max_frame_size = 0;
+    while (pos + frame_max + 16 < size_max) {
+        for (uint32_t gap = test_rand() % 4; gap; gap--, pos++) {
+            fputc(0x00, fp);
+        }
+        if (test_rand() % 4 == 0) {
+            fputc(0xFF, fp);
+            pos++;
+        }
+
+        const uint32_t start = pos;
+        const uint32_t data = TEST_FRAME_MIN + test_rand() % (frame_max - TEST_FRAME_MIN);
+        fputc(0xFF, fp);
+        fputc(0xD8, fp);
+        pos += 2;
+        for (uint32_t i = 0; i < data; i++, pos++) {
+            uint8_t byte = (uint8_t)test_rand();
+            fputc(byte, fp);
+            if (byte == 0xFF) {
+                fputc(0x00, fp);
+                pos++;
+            }
+        }
+        fputc(0xFF, fp);
+        fputc(0xD9, fp);
+        pos += 2;
+
+        if (expected->count == expected->capacity) {
+            expected->capacity = expected->capacity ? expected->capacity * 2 : 256;
+            expected->entries = realloc(expected->entries, expected->capacity * sizeof(mjpeg_index_entry_t));
+            TEST_ASSERT_NOT_NULL(expected->entries);
+        }
+        expected->entries[expected->count].offset = start;
+        expected->entries[expected->count].size = pos - start;
+        expected->max_frame_size = (pos - start > expected->max_frame_size) ? pos - start : expected->max_frame_size;
+        expected->count++;
+    }
+    fclose(fp);
+
+    return pos;
+}
+
+static void test_assert_index_equal(const mjpeg_index_t *expected, const mjpeg_index_t *index)
+{
+    TEST_ASSERT_EQUAL(expected->count, index->count);
+    TEST_ASSERT_EQUAL(expected->max_frame_size, index->max_frame_size);
+    TEST_ASSERT_EQUAL_MEMORY(expected->entries, index->entries, expected->count * sizeof(mjpeg_index_entry_t));
+}
+
+static void test_stat(const char *path, uint64_t *size, int64_t *mtime)
+{
+    struct stat st;
+
+    TEST_ASSERT_EQUAL(0, stat(path, &st));
+    *size = st.st_size;
+    *mtime = st.st_mtime;
+}
+
+TEST_CASE("mjpeg index finds every frame with any scan buffer size", "[mjpeg_index]")
+{
+    const size_t buf_sizes[] = {1, 2, 3, 7, 512, 4096, TEST_SCAN_BUF_MAX};
+    uint8_t *buf = malloc(TEST_SCAN_BUF_MAX);
+    mjpeg_index_t expected = {0};
+
+    TEST_ASSERT_NOT_NULL(buf);
+    test_make_video(TEST_VIDEO, TEST_FRAME_NUM * TEST_FRAME_MAX, TEST_FRAME_MAX, &expected);
+    FILE *fp = fopen(TEST_VIDEO, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+
+    /* Markers straddle the buffer edges at the small sizes */
+    for (int i = 0; i < sizeof(buf_sizes) / sizeof(buf_sizes[0]); i++) {
+        mjpeg_index_t index = {0};
+        TEST_ESP_OK(mjpeg_index_build(fp, buf, buf_sizes[i], &index));
+        test_assert_index_equal(&expected, &index);
+        mjpeg_index_free(&index);
+    }
+
+    fclose(fp);
+    mjpeg_index_free(&expected);
+    remove(TEST_VIDEO);
+    free(buf);
+}
+
+TEST_CASE("mjpeg index skips fill bytes, stray markers and a truncated frame", "[mjpeg_index]")
+{
+    const uint8_t video[] = {
+        0x00, 0xFF, 0xD9,                               /* EOI outside a frame */
+        0xFF, 0xFF, 0xFF, 0xD8,                         /* Fill bytes before the SOI of frame 0 at 5 */
+        0x12, 0xFF, 0x00, 0xFF, 0xD8, 0x34,             /* SOI inside a frame */
+        0xFF, 0xFF, 0xD9,                               /* Fill byte before the EOI */
+        0xAA,
+        0xFF, 0xD8, 0xFF, 0xD9,                         /* Empty frame 1 at 17 */
+        0xFF, 0xD8, 0x56, 0x78,                         /* Frame cut by the end of the file */
+    };
+    const mjpeg_index_entry_t entries[] = {{5, 11}, {17, 4}};
+    uint8_t buf[4];
+    mjpeg_index_t index = {0};
+
+    FILE *fp = fopen(TEST_VIDEO, "wb+");
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ASSERT_EQUAL(sizeof(video), fwrite(video, 1, sizeof(video), fp));
+    for (size_t buf_size = 1; buf_size <= sizeof(buf); buf_size++) {
+        TEST_ESP_OK(mjpeg_index_build(fp, buf, buf_size, &index));
+        TEST_ASSERT_EQUAL(2, index.count);
+        TEST_ASSERT_EQUAL(11, index.max_frame_size);
+        TEST_ASSERT_EQUAL_MEMORY(entries, index.entries, sizeof(entries));
+    }
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mjpeg_index_build(fp, buf, 0, &index));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, mjpeg_index_build(NULL, buf, sizeof(buf), &index));
+    mjpeg_index_free(&index);
+    fclose(fp);
+    remove(TEST_VIDEO);
+}
+
+TEST_CASE("mjpeg index saved and loaded back, stale files rejected", "[mjpeg_index]")
+{
+    const uint64_t size = 123456789;
+    const int64_t mtime = 1700000000;
+    uint8_t buf[4096];
+    mjpeg_index_t expected = {0};
+    mjpeg_index_t index = {0};
+
+    test_make_video(TEST_VIDEO, 100 * TEST_FRAME_MAX, TEST_FRAME_MAX, &expected);
+    FILE *fp = fopen(TEST_VIDEO, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ESP_OK(mjpeg_index_build(fp, buf, sizeof(buf), &index));
+    fclose(fp);
+
+    TEST_ESP_OK(mjpeg_index_save(&index, TEST_INDEX, size, mtime));
+    mjpeg_index_free(&index);
+    TEST_ESP_OK(mjpeg_index_load(&index, TEST_INDEX, size, mtime));
+    test_assert_index_equal(&expected, &index);
+    mjpeg_index_free(&index);
+
+    /* Saved for another version of the video */
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, mjpeg_index_load(&index, TEST_INDEX, size + 1, mtime));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, mjpeg_index_load(&index, TEST_INDEX, size, mtime + 1));
+    TEST_ASSERT_EQUAL(0, index.count);
+
+    /* Not an index, cut short, missing */
+    fp = fopen(TEST_INDEX, "r+b");
+    TEST_ASSERT_NOT_NULL(fp);
+    fputc('X', fp);
+    fclose(fp);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, mjpeg_index_load(&index, TEST_INDEX, size, mtime));
+    TEST_ESP_OK(mjpeg_index_save(&expected, TEST_INDEX, size, mtime));
+    TEST_ASSERT_EQUAL(0, truncate(TEST_INDEX, 40));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, mjpeg_index_load(&index, TEST_INDEX, size, mtime));
+    TEST_ASSERT_EQUAL(0, index.count);
+
+    /* A count larger than the file is rejected before anything is allocated for it */
+    TEST_ESP_OK(mjpeg_index_save(&expected, TEST_INDEX, size, mtime));
+    fp = fopen(TEST_INDEX, "r+b");
+    TEST_ASSERT_NOT_NULL(fp);
+    const uint32_t huge_count = UINT32_MAX;
+    TEST_ASSERT_EQUAL(0, fseek(fp, 24, SEEK_SET));
+    TEST_ASSERT_EQUAL(1, fwrite(&huge_count, sizeof(huge_count), 1, fp));
+    fclose(fp);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, mjpeg_index_load(&index, TEST_INDEX, size, mtime));
+    TEST_ASSERT_EQUAL(0, index.count);
+    TEST_ASSERT_NULL(index.entries);
+    remove(TEST_INDEX);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, mjpeg_index_load(&index, TEST_INDEX, size, mtime));
+
+    mjpeg_index_free(&index);
+    mjpeg_index_free(&expected);
+    remove(TEST_VIDEO);
+}
+
+TEST_CASE("mjpeg index open builds once, loads, and rebuilds a stale index", "[mjpeg_index]")
+{
+    uint8_t buf[4096];
+    mjpeg_index_t expected = {0};
+    mjpeg_index_t index = {0};
+    uint64_t size;
+    int64_t mtime;
+
+    test_make_video(TEST_VIDEO, 100 * TEST_FRAME_MAX, TEST_FRAME_MAX, &expected);
+    remove(TEST_INDEX);
+    TEST_ESP_OK(mjpeg_index_open(TEST_VIDEO, buf, sizeof(buf), &index));
+    test_assert_index_equal(&expected, &index);
+    mjpeg_index_free(&index);
+
+    /* Replace the saved index by one with a frame less: the next open must return it as is, without a scan */
+    test_stat(TEST_VIDEO, &size, &mtime);
+    expected.count--;
+    TEST_ESP_OK(mjpeg_index_save(&expected, TEST_INDEX, size, mtime));
+    TEST_ESP_OK(mjpeg_index_open(TEST_VIDEO, buf, sizeof(buf), &index));
+    TEST_ASSERT_EQUAL(expected.count, index.count);
+    mjpeg_index_free(&index);
+    expected.count++;
+
+    /* The video changed since: the index is stale, scanned again and saved for the new time */
+    struct utimbuf times = {.actime = mtime - 100, .modtime = mtime - 100};
+    TEST_ASSERT_EQUAL(0, utime(TEST_VIDEO, &times));
+    TEST_ESP_OK(mjpeg_index_open(TEST_VIDEO, buf, sizeof(buf), &index));
+    test_assert_index_equal(&expected, &index);
+    mjpeg_index_free(&index);
+    TEST_ESP_OK(mjpeg_index_load(&index, TEST_INDEX, size, mtime - 100));
+    test_assert_index_equal(&expected, &index);
+
+    mjpeg_index_free(&index);
+    mjpeg_index_free(&expected);
+    remove(TEST_INDEX);
+    remove(TEST_VIDEO);
+}
+
+TEST_CASE("mjpeg index finds the frame holding an offset", "[mjpeg_index]")
+{
+    mjpeg_index_entry_t entries[] = {{10, 100}, {120, 50}, {170, 30}, {300, 10}};
+    mjpeg_index_t index = {.entries = entries, .count = 4, .capacity = 4};
+    mjpeg_index_t empty = {0};
+
+    TEST_ASSERT_EQUAL(0, mjpeg_index_find_frame(&empty, 1000));
+    TEST_ASSERT_EQUAL(0, mjpeg_index_find_frame(&index, 0));
+    TEST_ASSERT_EQUAL(0, mjpeg_index_find_frame(&index, 10));
+    TEST_ASSERT_EQUAL(0, mjpeg_index_find_frame(&index, 119));
+    TEST_ASSERT_EQUAL(1, mjpeg_index_find_frame(&index, 120));
+    TEST_ASSERT_EQUAL(2, mjpeg_index_find_frame(&index, 250));
+    TEST_ASSERT_EQUAL(3, mjpeg_index_find_frame(&index, 300));
+    TEST_ASSERT_EQUAL(3, mjpeg_index_find_frame(&index, UINT64_MAX));
+}
+
+TEST_CASE("mjpeg index build and load time on a large file", "[mjpeg_index][performance]")
+{
+    const size_t buf_sizes[] = {4096, 16 * 1024, TEST_SCAN_BUF_MAX};
+    uint8_t *buf = malloc(TEST_SCAN_BUF_MAX);
+    mjpeg_index_t expected = {0};
+    mjpeg_index_t index = {0};
+    uint64_t size;
+    int64_t mtime;
+
+    TEST_ASSERT_NOT_NULL(buf);
+    test_make_video(TEST_VIDEO, TEST_BENCH_SIZE, TEST_BENCH_FRAME_MAX, &expected);
+    test_stat(TEST_VIDEO, &size, &mtime);
+    printf("%" PRIu64 " bytes, %" PRIu32 " frames\n", size, expected.count);
+
+    /* The file was just written, it is read from the page cache: this is the CPU cost of the marker scan */
+    for (int i = 0; i < sizeof(buf_sizes) / sizeof(buf_sizes[0]); i++) {
+        FILE *fp = fopen(TEST_VIDEO, "rb");
+        TEST_ASSERT_NOT_NULL(fp);
+        int64_t start_us = esp_timer_get_time();
+        TEST_ESP_OK(mjpeg_index_build(fp, buf, buf_sizes[i], &index));
+        int64_t build_us = esp_timer_get_time() - start_us;
+        fclose(fp);
+        test_assert_index_equal(&expected, &index);
+        printf("build, %5zu bytes buffer: %7.1f ms, %6.1f MB/s\n", buf_sizes[i], build_us / 1000.0,
+               (double)size / build_us);
+        mjpeg_index_free(&index);
+    }
+
+    TEST_ESP_OK(mjpeg_index_save(&expected, TEST_INDEX, size, mtime));
+    int64_t start_us = esp_timer_get_time();
+    TEST_ESP_OK(mjpeg_index_load(&index, TEST_INDEX, size, mtime));
+    int64_t load_us = esp_timer_get_time() - start_us;
+    test_assert_index_equal(&expected, &index);
+    printf("load: %.2f ms\n", load_us / 1000.0);
+
+    mjpeg_index_free(&index);
+    mjpeg_index_free(&expected);
+    remove(TEST_INDEX);
+    remove(TEST_VIDEO);
+    free(buf);
+}